@@ -0,0 +1,702 @@
+/*
+* Copyright (c) 2008, Björn Rehm (bjoern@shugaa.de)
+* 
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+* 
+* The above copyright notice and this permission notice shall be included in
+* all copies or substantial portions of the Software.
+* 
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+* THE SOFTWARE.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <sys/resource.h>
+#include <dll_list.h>
+#include <dll_util.h>
+#include <dll_perf.h>
+#include <dll_typed.h>
+#include <dll_sorted.h>
+
+/* Times the basic list operations across list sizes from 1e2 up to 1e7 and
+ * prints the results as JSON on stdout, one record per operation and size:
+ *
+ *   {"op": "append", "size": 1000, "ops": 2048000, "ns_per_op": 21.3,
+ *    "ops_per_sec": 46948356.8, "peak_rss_kb": 10240}
+ *
+ * Every operation is repeated until DLLBENCH_MINTIME has passed, list setup
+ * is not part of the measurement. Operations that need to walk the list
+ * (insert at the middle, get by index, indexof) only run as often as
+ * DLLBENCH_WORK allows. Peak RSS is the process' high water mark so far.
+ *
+ * Sorting, iteration, indexof and clear are profiled with the hardware
+ * counters as well if the machine lets us have them, their records get a
+ * "perf" object with the counts per element, e.g. {"cycles": 12.1, ...}.
+ *
+ * merge joins two sorted lists of n/2 random ints, merge_k64 64 sorted lists
+ * of n/64 and splice_sort64 does the same by splicing and sorting again.
+ *
+ * sorted_insert builds a dll_sorted_t of n random ints, sorted_find looks
+ * up n random keys in one, compare with indexof.
+ *
+ * The typed_ operations run on a DLL_DEFINE_TYPED() list of ints instead.
+ *
+ *   dllbench [maxsize] */
+
+#define DLLBENCH_MINSIZE        (100)
+#define DLLBENCH_MAXSIZE        (10000000)
+#define DLLBENCH_MINTIME        (0.2e9)
+#define DLLBENCH_WORK           (100000000UL)
+#define DLLBENCH_SEED           (4711)
+#define DLLBENCH_DUPS           (16)
+#define DLLBENCH_PARTS          (64)
+
+enum {
+        FILL_SEQ,
+        FILL_RANDOM,
+        FILL_SORTED,
+        FILL_REVERSE,
+        FILL_DUPS
+};
+
+/* Runs an operation once on a list of n items, returns the time taken in ns
+ * and sets ops to the number of operations done */
+typedef double (*bench_fct_t)(unsigned int n, unsigned long *ops);
+
+typedef struct {
+        const char *name;
+        bench_fct_t fct;
+        int profile;
+} bench_t;
+
+/* Results of the read-only operations go here so they aren't optimized out */
+static volatile long sink;
+
+/* Hardware counters for the benchmark being run, if it is profiled */
+static dll_perf_t perf;
+static int profiling;
+
+static double now(void)
+{
+        struct timespec ts;
+
+        clock_gettime(CLOCK_MONOTONIC, &ts);
+        return (double)ts.tv_sec*1e9 + (double)ts.tv_nsec;
+}
+
+/* Timed regions go between start() and stop() */
+static double start(void)
+{
+        if (profiling)
+                dll_perf_begin(&perf);
+
+        return now();
+}
+
+static double stop(double t, unsigned long ops)
+{
+        t = now() - t;
+
+        if (profiling)
+                dll_perf_end(&perf, ops);
+
+        return t;
+}
+
+static long peak_rss(void)
+{
+        struct rusage ru;
+
+        if (getrusage(RUSAGE_SELF, &ru) != 0)
+                return -1;
+
+        return ru.ru_maxrss;
+}
+
+/* How often to run an operation that walks the list */
+static unsigned long walk_ops(unsigned int n)
+{
+        unsigned long ops = DLLBENCH_WORK / n;
+
+        if (ops > n)
+                ops = n;
+        if (ops == 0)
+                ops = 1;
+
+        return ops;
+}
+
+static void fill(dll_list_t *list, unsigned int n, int mode)
+{
+        unsigned int i;
+        int *data;
+
+        dll_init(list);
+        for (i=0; i<n; i++) {
+                if (dll_append(list, (void**)&data, sizeof(int)) != EDLLOK) {
+                        fprintf(stderr, "dllbench: out of memory\n");
+                        exit(1);
+                }
+
+                switch (mode) {
+                case FILL_RANDOM:  *data = (int)random(); break;
+                case FILL_SORTED:  *data = (int)i; break;
+                case FILL_REVERSE: *data = (int)(n-i); break;
+                case FILL_DUPS:    *data = (int)(random() % DLLBENCH_DUPS); break;
+                default:           *data = (int)i; break;
+                }
+        }
+}
+
+static double bench_append(unsigned int n, unsigned long *ops)
+{
+        dll_list_t list;
+        unsigned int i;
+        int *data;
+        double t;
+
+        dll_init(&list);
+
+        t = start();
+        for (i=0; i<n; i++) {
+                dll_append(&list, (void**)&data, sizeof(int));
+                *data = (int)i;
+        }
+        t = stop(t, n);
+
+        dll_clear(&list);
+        *ops = n;
+
+        return t;
+}
+
+static double bench_insert_middle(unsigned int n, unsigned long *ops)
+{
+        dll_list_t list;
+        unsigned long i, k = walk_ops(n);
+        int *data;
+        double t;
+
+        fill(&list, n, FILL_SEQ);
+
+        t = start();
+        for (i=0; i<k; i++) {
+                dll_insert(&list, (void**)&data, sizeof(int), list.count/2);
+                *data = (int)i;
+        }
+        t = stop(t, k);
+
+        dll_clear(&list);
+        *ops = k;
+
+        return t;
+}
+
+static double bench_remove_head(unsigned int n, unsigned long *ops)
+{
+        dll_list_t list;
+        unsigned int i;
+        double t;
+
+        fill(&list, n, FILL_SEQ);
+
+        t = start();
+        for (i=0; i<n; i++)
+                dll_remove(&list, 0);
+        t = stop(t, n);
+
+        dll_clear(&list);
+        *ops = n;
+
+        return t;
+}
+
+static double bench_get_index(unsigned int n, unsigned long *ops)
+{
+        dll_list_t list;
+        unsigned long i, k = walk_ops(n);
+        long sum = 0;
+        int *data;
+        double t;
+
+        fill(&list, n, FILL_SEQ);
+
+        t = start();
+        for (i=0; i<k; i++) {
+                dll_get(&list, (void**)&data, NULL, (unsigned int)(random() % n));
+                sum += *data;
+        }
+        t = stop(t, k);
+
+        dll_clear(&list);
+        sink = sum;
+        *ops = k;
+
+        return t;
+}
+
+static double bench_indexof(unsigned int n, unsigned long *ops)
+{
+        dll_list_t list;
+        unsigned long i, k = walk_ops(n);
+        dll_count_t index;
+        int key;
+        double t;
+
+        fill(&list, n, FILL_SEQ);
+
+        t = start();
+        for (i=0; i<k; i++) {
+                key = (int)(random() % n);
+                dll_indexof(&list, dll_compar_int, &key, &index);
+        }
+        t = stop(t, k);
+
+        dll_clear(&list);
+        *ops = k;
+
+        return t;
+}
+
+static double bench_iterate(unsigned int n, unsigned long *ops)
+{
+        dll_list_t list;
+        dll_iterator_t it;
+        long sum = 0;
+        int *data;
+        double t;
+
+        fill(&list, n, FILL_SEQ);
+
+        t = start();
+        dll_iterator_init(&it, &list);
+        while (dll_iterator_next(&it, (void**)&data, NULL) == EDLLOK)
+                sum += *data;
+        t = stop(t, n);
+
+        dll_clear(&list);
+        sink = sum;
+        *ops = n;
+
+        return t;
+}
+
+static double bench_sort(unsigned int n, unsigned long *ops, int mode)
+{
+        dll_list_t list;
+        double t;
+
+        fill(&list, n, mode);
+
+        t = start();
+        dll_sort(&list, dll_compar_int);
+        t = stop(t, n);
+
+        dll_clear(&list);
+        *ops = n;
+
+        return t;
+}
+
+static double bench_sort_random(unsigned int n, unsigned long *ops)
+{
+        return bench_sort(n, ops, FILL_RANDOM);
+}
+
+static double bench_sort_sorted(unsigned int n, unsigned long *ops)
+{
+        return bench_sort(n, ops, FILL_SORTED);
+}
+
+static double bench_sort_reverse(unsigned int n, unsigned long *ops)
+{
+        return bench_sort(n, ops, FILL_REVERSE);
+}
+
+static double bench_sort_dups(unsigned int n, unsigned long *ops)
+{
+        return bench_sort(n, ops, FILL_DUPS);
+}
+
+static double bench_reverse(unsigned int n, unsigned long *ops)
+{
+        dll_list_t list;
+        double t;
+
+        fill(&list, n, FILL_SEQ);
+
+        t = start();
+        dll_reverse(&list);
+        t = stop(t, n);
+
+        dll_clear(&list);
+        *ops = n;
+
+        return t;
+}
+
+static double bench_clear(unsigned int n, unsigned long *ops)
+{
+        dll_list_t list;
+        double t;
+
+        fill(&list, n, FILL_SEQ);
+
+        t = start();
+        dll_clear(&list);
+        t = stop(t, n);
+
+        *ops = n;
+
+        return t;
+}
+
+static double bench_extend(unsigned int n, unsigned long *ops)
+{
+        dll_list_t list, lext;
+        double t;
+
+        dll_init(&list);
+        fill(&lext, n, FILL_SEQ);
+
+        t = start();
+        dll_extend(&list, &lext);
+        t = stop(t, n);
+
+        dll_clear(&list);
+        dll_clear(&lext);
+        *ops = n;
+
+        return t;
+}
+
+static double bench_deepcopy(unsigned int n, unsigned long *ops)
+{
+        dll_list_t list, copy;
+        double t;
+
+        dll_init(&copy);
+        fill(&list, n, FILL_SEQ);
+
+        t = start();
+        dll_deepcopy(&list, &copy);
+        t = stop(t, n);
+
+        dll_clear(&list);
+        dll_clear(&copy);
+        *ops = n;
+
+        return t;
+}
+
+/* Splits n random ints over k lists (k at most DLLBENCH_PARTS) and sorts
+ * each of them */
+static void fill_parts(dll_list_t *parts, unsigned int k, unsigned int n)
+{
+        unsigned int i;
+
+        for (i=0; i<k; i++) {
+                fill(&parts[i], n/k + (i < n%k), FILL_RANDOM);
+                dll_sort(&parts[i], dll_compar_int);
+        }
+}
+
+static double bench_merge(unsigned int n, unsigned long *ops)
+{
+        dll_list_t parts[2];
+        double t;
+
+        fill_parts(parts, 2, n);
+
+        t = start();
+        dll_merge(&parts[0], &parts[1], dll_compar_int);
+        t = stop(t, n);
+
+        dll_clear(&parts[0]);
+        *ops = n;
+
+        return t;
+}
+
+static double bench_merge_k64(unsigned int n, unsigned long *ops)
+{
+        dll_list_t list, parts[DLLBENCH_PARTS], *ptrs[DLLBENCH_PARTS];
+        unsigned int i;
+        double t;
+
+        dll_init(&list);
+        fill_parts(parts, DLLBENCH_PARTS, n);
+        for (i=0; i<DLLBENCH_PARTS; i++)
+                ptrs[i] = &parts[i];
+
+        t = start();
+        dll_merge_k(&list, ptrs, DLLBENCH_PARTS, dll_compar_int);
+        t = stop(t, n);
+
+        dll_clear(&list);
+        *ops = n;
+
+        return t;
+}
+
+/* What merge_k64 replaces, putting the parts together and sorting again */
+static double bench_splice_sort64(unsigned int n, unsigned long *ops)
+{
+        dll_list_t list, parts[DLLBENCH_PARTS];
+        unsigned int i;
+        double t;
+
+        dll_init(&list);
+        fill_parts(parts, DLLBENCH_PARTS, n);
+
+        t = start();
+        for (i=0; i<DLLBENCH_PARTS; i++)
+                dll_splice(&list, &parts[i]);
+        dll_sort(&list, dll_compar_int);
+        t = stop(t, n);
+
+        dll_clear(&list);
+        *ops = n;
+
+        return t;
+}
+
+static double bench_sorted_insert(unsigned int n, unsigned long *ops)
+{
+        dll_sorted_t sorted;
+        unsigned int i;
+        int value;
+        double t;
+
+        dll_sorted_init(&sorted, dll_compar_int);
+
+        t = start();
+        for (i=0; i<n; i++) {
+                value = (int)random();
+                dll_insert_sorted(&sorted, NULL, sizeof(int), &value);
+        }
+        t = stop(t, n);
+
+        dll_sorted_clear(&sorted);
+        *ops = n;
+
+        return t;
+}
+
+static double bench_sorted_find(unsigned int n, unsigned long *ops)
+{
+        dll_sorted_t sorted;
+        dll_item_t *item;
+        unsigned int i;
+        int key;
+        double t;
+
+        dll_sorted_init(&sorted, dll_compar_int);
+        for (i=0; i<n; i++) {
+                key = (int)i;
+                dll_insert_sorted(&sorted, NULL, sizeof(int), &key);
+        }
+
+        t = start();
+        for (i=0; i<n; i++) {
+                key = (int)(random() % n);
+                dll_find_sorted(&sorted, &key, &item);
+        }
+        t = stop(t, n);
+
+        dll_sorted_clear(&sorted);
+        *ops = n;
+
+        return t;
+}
+
+/* The typed_ benchmarks repeat some of the above with a list generated by
+ * DLL_DEFINE_TYPED(), ints are embedded in the nodes */
+#define BENCH_ICMP(a, b) ((*(a) > *(b)) - (*(a) < *(b)))
+
+DLL_DEFINE_TYPED(bench_ilist, int, BENCH_ICMP)
+
+static void typed_fill(bench_ilist_t *list, unsigned int n, int mode)
+{
+        unsigned int i;
+        int *data;
+
+        bench_ilist_init(list);
+        for (i=0; i<n; i++) {
+                if (bench_ilist_append(list, &data) != EDLLOK) {
+                        fprintf(stderr, "dllbench: out of memory\n");
+                        exit(1);
+                }
+
+                *data = (mode == FILL_RANDOM) ? (int)random() : (int)i;
+        }
+}
+
+static double bench_typed_append(unsigned int n, unsigned long *ops)
+{
+        bench_ilist_t list;
+        unsigned int i;
+        int *data;
+        double t;
+
+        bench_ilist_init(&list);
+
+        t = start();
+        for (i=0; i<n; i++) {
+                if (bench_ilist_append(&list, &data) == EDLLOK)
+                        *data = (int)i;
+        }
+        t = stop(t, n);
+
+        bench_ilist_clear(&list);
+        *ops = n;
+
+        return t;
+}
+
+static double bench_typed_iterate(unsigned int n, unsigned long *ops)
+{
+        bench_ilist_t list;
+        bench_ilist_node_t *node;
+        long sum = 0;
+        double t;
+
+        typed_fill(&list, n, FILL_SEQ);
+
+        t = start();
+        DLL_TYPED_FOREACH(&list, node)
+                sum += node->value;
+        t = stop(t, n);
+
+        bench_ilist_clear(&list);
+        sink = sum;
+        *ops = n;
+
+        return t;
+}
+
+static double bench_typed_sort_random(unsigned int n, unsigned long *ops)
+{
+        bench_ilist_t list;
+        double t;
+
+        typed_fill(&list, n, FILL_RANDOM);
+
+        t = start();
+        bench_ilist_sort(&list);
+        t = stop(t, n);
+
+        bench_ilist_clear(&list);
+        *ops = n;
+
+        return t;
+}
+
+static const bench_t benches[] = {
+        {"append",        bench_append,        0},
+        {"insert_middle", bench_insert_middle, 0},
+        {"remove_head",   bench_remove_head,   0},
+        {"get_index",     bench_get_index,     0},
+        {"indexof",       bench_indexof,       1},
+        {"iterate",       bench_iterate,       1},
+        {"sort_random",   bench_sort_random,   1},
+        {"sort_sorted",   bench_sort_sorted,   1},
+        {"sort_reverse",  bench_sort_reverse,  1},
+        {"sort_dups",     bench_sort_dups,     1},
+        {"reverse",       bench_reverse,       0},
+        {"clear",         bench_clear,         1},
+        {"extend",        bench_extend,        0},
+        {"deepcopy",      bench_deepcopy,      0},
+        {"merge",         bench_merge,         1},
+        {"merge_k64",     bench_merge_k64,     1},
+        {"splice_sort64", bench_splice_sort64, 1},
+        {"sorted_insert", bench_sorted_insert, 1},
+        {"sorted_find",   bench_sorted_find,   1},
+        {"typed_append",  bench_typed_append,  0},
+        {"typed_iterate", bench_typed_iterate, 1},
+        {"typed_sort_random", bench_typed_sort_random, 1},
+};
+
+static void run(const bench_t *bench, unsigned int n, int first, int haveperf)
+{
+        unsigned long ops, total = 0;
+        unsigned int i;
+        double t = 0.0, value;
+        const char *sep = "";
+
+        profiling = haveperf && bench->profile;
+        dll_perf_reset(&perf);
+
+        /* Repeat until the clock's resolution doesn't matter any more */
+        do {
+                t += bench->fct(n, &ops);
+                total += ops;
+        } while (t < DLLBENCH_MINTIME);
+
+        printf("%s    {\"op\": \"%s\", \"size\": %u, \"ops\": %lu, "
+                        "\"ns_per_op\": %.2f, \"ops_per_sec\": %.1f, "
+                        "\"peak_rss_kb\": %ld",
+                        first ? "" : ",\n", bench->name, n, total,
+                        t/total, total/(t/1e9), peak_rss());
+
+        if (profiling) {
+                printf(", \"perf\": {");
+                for (i=0; i<DLL_PERF_NEVENTS; i++) {
+                        if (dll_perf_get(&perf, i, &value) != EDLLOK)
+                                continue;
+                        printf("%s\"%s\": %.2f", sep, dll_perf_name(i), value);
+                        sep = ", ";
+                }
+                printf("}");
+        }
+
+        printf("}");
+        fflush(stdout);
+}
+
+int main(int argc, char *argv[])
+{
+        unsigned int n, maxsize = DLLBENCH_MAXSIZE;
+        size_t i;
+        int first = 1, haveperf;
+
+        if (argc > 1)
+                maxsize = (unsigned int)strtoul(argv[1], NULL, 10);
+
+        srandom(DLLBENCH_SEED);
+
+        haveperf = (dll_perf_init(&perf) == EDLLOK);
+        if (!haveperf)
+                fprintf(stderr, "dllbench: no hardware counters, running without\n");
+
+        printf("{\n  \"benchmark\": \"dllbench\",\n  \"results\": [\n");
+
+        for (n=DLLBENCH_MINSIZE; n<=maxsize; n*=10) {
+                for (i=0; i<sizeof(benches)/sizeof(bench_t); i++) {
+                        run(&benches[i], n, first, haveperf);
+                        first = 0;
+                }
+
+                if (n > maxsize/10)
+                        break;
+        }
+
+        printf("\n  ]\n}\n");
+
+        dll_perf_destroy(&perf);
+
+        return 0;
+}
@@ -0,0 +1,423 @@
+/*
+* Copyright (c) 2008, Björn Rehm (bjoern@shugaa.de)
+* 
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+* 
+* The above copyright notice and this permission notice shall be included in
+* all copies or substantial portions of the Software.
+* 
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+* THE SOFTWARE.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <sys/resource.h>
+#include <dll_list.h>
+#include <dll_inline.h>
+#include <dll_compact.h>
+#include <dll_hooks.h>
+#include <dll_trace.h>
+
+/* Replays a trace recorded with dll_trace_start() and reports how long it
+ * took and how much memory it needed, as JSON on stdout:
+ *
+ *   dllreplay [-m plain|compact] [-i interval] trace
+ *
+ * In plain mode the operations are replayed as they were recorded. Compact
+ * mode additionally runs dll_compact() with DLL_COMPACT_DATA on every list
+ * after each interval (default 100000) records, iterators are moved over to
+ * the relocated items. For other allocators preload them, e.g. with
+ * LD_PRELOAD, or tune glibc's through GLIBC_TUNABLES.
+ *
+ * Item data isn't part of a trace. Every item gets a random int at the front
+ * (items get at least sizeof(int) bytes) which is what sorting compares.
+ * "failed" counts the calls that didn't return EDLLOK, usually because they
+ * had failed when they were recorded as well. */
+
+#define DLLREPLAY_CHUNK         (4096)
+#define DLLREPLAY_INTERVAL      (100000)
+#define DLLREPLAY_NOPS          (DLL_TRACE_MERGE+1)
+
+enum {
+        MODE_PLAIN,
+        MODE_COMPACT
+};
+
+/* Whatever has been recorded under an id */
+typedef struct {
+        dll_list_t *list;
+        dll_iterator_t *it;
+        dll_compactor_t *compactor;
+} object_t;
+
+static object_t *objects;
+static size_t nobjects;
+
+static void **batch;
+static size_t batchsize;
+
+/* Item memory as seen through the hooks */
+static size_t live, peak;
+
+static unsigned long counts[DLLREPLAY_NOPS];
+static unsigned long failed;
+
+static const char *opnames[DLLREPLAY_NOPS] = {
+        "unknown", "init", "clear", "append", "splice", "insert", "remove",
+        "count", "sort", "reverse", "iterinit", "iternext", "iterprev",
+        "iternextbatch", "iterprevbatch", "snapshot", "unshare",
+        "compactinit", "compactstep", "merge"
+};
+
+static double now(void)
+{
+        struct timespec ts;
+
+        clock_gettime(CLOCK_MONOTONIC, &ts);
+        return (double)ts.tv_sec*1e9 + (double)ts.tv_nsec;
+}
+
+static void *xcalloc(size_t n, size_t size)
+{
+        void *ptr = calloc(n, size);
+
+        if (ptr == NULL) {
+                fprintf(stderr, "dllreplay: out of memory\n");
+                exit(1);
+        }
+
+        return ptr;
+}
+
+static void hook_alloc(void *ctx, dll_list_t *list, const void *ptr, size_t size)
+{
+        live += size;
+        if (live > peak)
+                peak = live;
+}
+
+static void hook_free(void *ctx, dll_list_t *list, const void *ptr, size_t size)
+{
+        live -= size;
+}
+
+static int compar(const void *item1, const void *item2)
+{
+        int int1 = *((const int*)item1);
+        int int2 = *((const int*)item2);
+
+        return (int1 > int2) - (int1 < int2);
+}
+
+static object_t *object(uint32_t id)
+{
+        size_t n;
+
+        if (id >= nobjects) {
+                n = (nobjects > 0) ? nobjects : 1024;
+                while (n <= id)
+                        n *= 2;
+
+                objects = (object_t*)realloc(objects, n*sizeof(object_t));
+                if (objects == NULL) {
+                        fprintf(stderr, "dllreplay: out of memory\n");
+                        exit(1);
+                }
+                memset(objects + nobjects, 0, (n - nobjects)*sizeof(object_t));
+                nobjects = n;
+        }
+
+        return &objects[id];
+}
+
+/* Lists that were around before recording started show up without an init */
+static dll_list_t *list(uint32_t id)
+{
+        object_t *obj = object(id);
+
+        if (obj->list == NULL) {
+                obj->list = (dll_list_t*)xcalloc(1, sizeof(dll_list_t));
+                dll_init(obj->list);
+        }
+
+        return obj->list;
+}
+
+static dll_iterator_t *iterator(uint32_t id)
+{
+        object_t *obj = object(id);
+
+        if (obj->it == NULL)
+                obj->it = (dll_iterator_t*)xcalloc(1, sizeof(dll_iterator_t));
+
+        return obj->it;
+}
+
+static dll_compactor_t *compactor(uint32_t id)
+{
+        object_t *obj = object(id);
+
+        if (obj->compactor == NULL)
+                obj->compactor = (dll_compactor_t*)xcalloc(1, sizeof(dll_compactor_t));
+
+        return obj->compactor;
+}
+
+static void fill(void *data, size_t datasize)
+{
+        memset(data, 0, datasize);
+        *(int*)data = (int)random();
+}
+
+static size_t datasize(uint32_t size)
+{
+        return (size < sizeof(int)) ? sizeof(int) : size;
+}
+
+static int replay(const dll_trace_record_t *rec)
+{
+        void *data;
+        dll_count_t count;
+        size_t got;
+        int rc;
+
+        switch (rec->op) {
+        case DLL_TRACE_INIT:
+                return dll_init(list(rec->id));
+        case DLL_TRACE_CLEAR:
+                return dll_clear(list(rec->id));
+        case DLL_TRACE_APPEND:
+                rc = dll_append(list(rec->id), &data, datasize(rec->datasize));
+                if (rc == EDLLOK)
+                        fill(data, datasize(rec->datasize));
+                return rc;
+        case DLL_TRACE_SPLICE:
+                return dll_splice(list(rec->id), list(rec->arg));
+        case DLL_TRACE_INSERT:
+                rc = dll_insert(list(rec->id), &data, datasize(rec->datasize), rec->arg);
+                if (rc == EDLLOK)
+                        fill(data, datasize(rec->datasize));
+                return rc;
+        case DLL_TRACE_REMOVE:
+                return dll_remove(list(rec->id), rec->arg);
+        case DLL_TRACE_COUNT:
+                return dll_count(list(rec->id), &count);
+        case DLL_TRACE_SORT:
+                return dll_sort(list(rec->id), compar);
+        case DLL_TRACE_REVERSE:
+                return dll_reverse(list(rec->id));
+        case DLL_TRACE_ITERINIT:
+                return dll_iterator_init(iterator(rec->id), list(rec->arg));
+        case DLL_TRACE_ITERNEXT:
+                rc = dll_iterator_next(iterator(rec->id), &data, NULL);
+                return (rc == EDLLTILT) ? EDLLOK : rc;
+        case DLL_TRACE_ITERPREV:
+                rc = dll_iterator_prev(iterator(rec->id), &data, NULL);
+                return (rc == EDLLTILT) ? EDLLOK : rc;
+        case DLL_TRACE_ITERNEXTBATCH:
+        case DLL_TRACE_ITERPREVBATCH:
+                if (rec->arg > batchsize) {
+                        free(batch);
+                        batchsize = rec->arg;
+                        batch = (void**)xcalloc(batchsize, sizeof(void*));
+                }
+                if (rec->op == DLL_TRACE_ITERNEXTBATCH)
+                        rc = dll_iterator_next_batch(iterator(rec->id), batch, NULL, rec->arg, &got);
+                else
+                        rc = dll_iterator_prev_batch(iterator(rec->id), batch, NULL, rec->arg, &got);
+                return (rc == EDLLTILT) ? EDLLOK : rc;
+        case DLL_TRACE_SNAPSHOT:
+                return dll_snapshot(list(rec->id), list(rec->arg));
+        case DLL_TRACE_UNSHARE:
+                return dll_unshare(list(rec->id));
+        case DLL_TRACE_COMPACTINIT:
+                return dll_compact_init(compactor(rec->id), list(rec->arg), (int)rec->datasize);
+        case DLL_TRACE_COMPACTSTEP:
+                return dll_compact_step(compactor(rec->id), rec->arg, NULL);
+        case DLL_TRACE_MERGE:
+                return dll_merge(list(rec->id), list(rec->arg), compar);
+        default:
+                return EDLLERROR;
+        }
+}
+
+/* Compact every list. Iterators and compactors point to item containers,
+ * they are given the new container at the same position afterwards. */
+static void compact_all(void)
+{
+        size_t i, j;
+        unsigned int pos;
+        dll_item_t *item;
+        dll_iterator_t it;
+        void *data;
+
+        for (i=0; i<nobjects; i++) {
+                if ((objects[i].list == NULL) || (objects[i].list->count == 0))
+                        continue;
+
+                /* Remember positions, the items are looked up by address only
+                 * so stale iterators don't hurt */
+                for (j=0; j<nobjects; j++) {
+                        if ((objects[j].it == NULL) || (objects[j].it->list != objects[i].list))
+                                continue;
+                        if (objects[j].it->item == NULL)
+                                continue;
+
+                        dll_iterator_init(&it, objects[i].list);
+                        for (pos=0; dll_iterator_next(&it, &data, NULL) == EDLLOK; pos++)
+                                if (it.item == objects[j].it->item)
+                                        break;
+
+                        objects[j].it->item = (dll_item_t*)(size_t)(pos + 1);
+                }
+
+                /* Incremental compactions in progress keep going on their own
+                 * blocks, leave those lists alone */
+                for (j=0; j<nobjects; j++)
+                        if ((objects[j].compactor != NULL) && (objects[j].compactor->list == objects[i].list) &&
+                                        (objects[j].compactor->item != NULL))
+                                break;
+
+                if (j == nobjects)
+                        dll_compact(objects[i].list, DLL_COMPACT_DATA);
+
+                for (j=0; j<nobjects; j++) {
+                        if ((objects[j].it == NULL) || (objects[j].it->list != objects[i].list))
+                                continue;
+                        if (objects[j].it->item == NULL)
+                                continue;
+
+                        pos = (unsigned int)(size_t)objects[j].it->item;
+                        item = objects[i].list->first;
+                        while ((--pos > 0) && (item != NULL))
+                                item = item->next;
+                        objects[j].it->item = item;
+                }
+        }
+}
+
+static long peak_rss(void)
+{
+        struct rusage ru;
+
+        if (getrusage(RUSAGE_SELF, &ru) != 0)
+                return -1;
+
+        return ru.ru_maxrss;
+}
+
+static void usage(void)
+{
+        fprintf(stderr, "usage: dllreplay [-m plain|compact] [-i interval] trace\n");
+        exit(2);
+}
+
+int main(int argc, char *argv[])
+{
+        int i, mode = MODE_PLAIN;
+        unsigned long interval = DLLREPLAY_INTERVAL, records = 0, next;
+        const char *path = NULL;
+        char magic[4];
+        uint32_t version;
+        dll_trace_record_t *chunk;
+        dll_hooks_t hooks;
+        size_t n, k;
+        double t, elapsed = 0.0;
+        FILE *f;
+
+        for (i=1; i<argc; i++) {
+                if ((strcmp(argv[i], "-m") == 0) && (i+1 < argc)) {
+                        i++;
+                        if (strcmp(argv[i], "plain") == 0)
+                                mode = MODE_PLAIN;
+                        else if (strcmp(argv[i], "compact") == 0)
+                                mode = MODE_COMPACT;
+                        else
+                                usage();
+                } else if ((strcmp(argv[i], "-i") == 0) && (i+1 < argc)) {
+                        interval = strtoul(argv[++i], NULL, 10);
+                        if (interval == 0)
+                                usage();
+                } else if (path == NULL) {
+                        path = argv[i];
+                } else {
+                        usage();
+                }
+        }
+
+        if (path == NULL)
+                usage();
+
+        f = fopen(path, "rb");
+        if (f == NULL) {
+                perror(path);
+                return 1;
+        }
+
+        if ((fread(magic, 4, 1, f) != 1) || (memcmp(magic, DLL_TRACE_MAGIC, 4) != 0) ||
+                        (fread(&version, sizeof(version), 1, f) != 1) || 
+                        (version != DLL_TRACE_VERSION)) {
+                fprintf(stderr, "dllreplay: %s is not a trace this version can read\n", path);
+                return 1;
+        }
+
+        memset(&hooks, 0, sizeof(hooks));
+        hooks.item_alloc = hook_alloc;
+        hooks.data_alloc = hook_alloc;
+        hooks.item_free = hook_free;
+        hooks.data_free = hook_free;
+        dll_set_hooks(&hooks);
+
+        chunk = (dll_trace_record_t*)xcalloc(DLLREPLAY_CHUNK, sizeof(dll_trace_record_t));
+        srandom(4711);
+        next = interval;
+
+        while ((n = fread(chunk, sizeof(dll_trace_record_t), DLLREPLAY_CHUNK, f)) > 0) {
+                t = now();
+                for (k=0; k<n; k++) {
+                        if (chunk[k].op < DLLREPLAY_NOPS)
+                                counts[chunk[k].op]++;
+                        if (replay(&chunk[k]) != EDLLOK)
+                                failed++;
+
+                        if ((++records == next) && (mode == MODE_COMPACT)) {
+                                compact_all();
+                                next += interval;
+                        }
+                }
+                elapsed += now() - t;
+        }
+
+        fclose(f);
+        free(chunk);
+
+        printf("{\n  \"trace\": \"%s\",\n  \"mode\": \"%s\",\n", path, 
+                        (mode == MODE_PLAIN) ? "plain" : "compact");
+        printf("  \"records\": %lu,\n  \"failed\": %lu,\n", records, failed);
+        printf("  \"seconds\": %.6f,\n  \"ns_per_op\": %.2f,\n", elapsed/1e9,
+                        (records > 0) ? elapsed/records : 0.0);
+        printf("  \"peak_item_bytes\": %lu,\n  \"peak_rss_kb\": %ld,\n",
+                        (unsigned long)peak, peak_rss());
+        printf("  \"ops\": {");
+        for (i=1, k=0; i<DLLREPLAY_NOPS; i++) {
+                if (counts[i] == 0)
+                        continue;
+                printf("%s\"%s\": %lu", (k++ > 0) ? ", " : "", opnames[i], counts[i]);
+        }
+        printf("}\n}\n");
+
+        return 0;
+}
@@ -0,0 +1,217 @@
+/*
+* Copyright (c) 2008, Björn Rehm (bjoern@shugaa.de)
+* 
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+* 
+* The above copyright notice and this permission notice shall be included in
+* all copies or substantial portions of the Software.
+* 
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+* THE SOFTWARE.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <pthread.h>
+#include <dll_list.h>
+#include <dll_sharded.h>
+
+/* Measures append/remove throughput with 1 up to 64 threads (or as many as
+ * given) and prints the results as JSON on stdout, one record per workload
+ * and thread count:
+ *
+ *   {"op": "local_int", "threads": 8, "ops": 6400000, "ns_per_op": 1.9,
+ *    "ops_per_sec": 526315789.5}
+ *
+ * Every thread builds a list of DLLTHREADS_LISTSIZE items and empties it
+ * again, DLLTHREADS_ROUNDS times over. An op is one item appended and
+ * removed, ops_per_sec is the total over all threads. The local_ workloads
+ * empty their own lists, the remote_ ones their neighbour's from the round
+ * before, so every item is freed by a thread other than the one which
+ * allocated it. In the sharded_ ones all threads append to one sharded
+ * list with a shard per thread, the first thread collects and empties it
+ * after each round. The _int workloads store ints (inline with the item),
+ * the _small ones payloads just too big for that.
+ *
+ * Compare a build with -DDLL_THREAD_CACHE=ON against one without.
+ *
+ *   dllthreads [maxthreads] */
+
+#define DLLTHREADS_MAXTHREADS   (64)
+#define DLLTHREADS_LISTSIZE     (1000)
+#define DLLTHREADS_ROUNDS       (200)
+#define DLLTHREADS_SMALL        (32)
+
+typedef struct {
+        const char *name;
+        size_t datasize;
+        int remote;
+        int sharded;
+} workload_t;
+
+typedef struct {
+        const workload_t *work;
+        unsigned int idx;
+        unsigned int nthreads;
+        dll_list_t *lists;
+        dll_sharded_t *sharded;
+        pthread_barrier_t *barrier;
+} worker_t;
+
+static const workload_t workloads[] = {
+        {"local_int",     sizeof(int),       0, 0},
+        {"local_small",   DLLTHREADS_SMALL,  0, 0},
+        {"remote_int",    sizeof(int),       1, 0},
+        {"remote_small",  DLLTHREADS_SMALL,  1, 0},
+        {"sharded_int",   sizeof(int),       1, 1},
+        {"sharded_small", DLLTHREADS_SMALL,  1, 1}
+};
+
+static double now(void)
+{
+        struct timespec ts;
+
+        clock_gettime(CLOCK_MONOTONIC, &ts);
+        return (double)ts.tv_sec*1e9 + (double)ts.tv_nsec;
+}
+
+static void *worker(void *arg)
+{
+        worker_t *w = (worker_t*)arg;
+        dll_list_t *own = &w->lists[w->idx];
+        dll_list_t *next = &w->lists[(w->idx + 1) % w->nthreads];
+        unsigned int round, i;
+        int rc;
+        void *data;
+
+        pthread_barrier_wait(w->barrier);
+
+        for (round=0; round<DLLTHREADS_ROUNDS; round++) {
+                for (i=0; i<DLLTHREADS_LISTSIZE; i++) {
+                        if (w->work->sharded)
+                                rc = dll_sharded_append(w->sharded, &data, w->work->datasize);
+                        else
+                                rc = dll_append(own, &data, w->work->datasize);
+                        if (rc == EDLLOK)
+                                *(unsigned int*)data = i;
+                }
+
+                if (!w->work->remote) {
+                        dll_clear(own);
+                        continue;
+                }
+
+                /* Everybody's list is full, empty the neighbour's or
+                 * collect all of them */
+                pthread_barrier_wait(w->barrier);
+                if (!w->work->sharded) {
+                        dll_clear(next);
+                } else if (w->idx == 0) {
+                        dll_sharded_collect(w->sharded, own);
+                        dll_clear(own);
+                }
+                pthread_barrier_wait(w->barrier);
+        }
+
+        return NULL;
+}
+
+/* Returns the time taken in ns */
+static double run(const workload_t *work, unsigned int nthreads)
+{
+        pthread_t threads[DLLTHREADS_MAXTHREADS];
+        worker_t workers[DLLTHREADS_MAXTHREADS];
+        dll_list_t lists[DLLTHREADS_MAXTHREADS];
+        dll_sharded_t sharded;
+        pthread_barrier_t barrier;
+        unsigned int i;
+        double t;
+
+        pthread_barrier_init(&barrier, NULL, nthreads + 1);
+
+        if (work->sharded && (dll_sharded_init(&sharded, nthreads) != EDLLOK)) {
+                fprintf(stderr, "dllthreads: unable to set up the sharded list\n");
+                exit(1);
+        }
+
+        for (i=0; i<nthreads; i++) {
+                dll_init(&lists[i]);
+                workers[i].work = work;
+                workers[i].idx = i;
+                workers[i].nthreads = nthreads;
+                workers[i].lists = lists;
+                workers[i].sharded = &sharded;
+                workers[i].barrier = &barrier;
+
+                if (pthread_create(&threads[i], NULL, worker, &workers[i]) != 0) {
+                        fprintf(stderr, "dllthreads: unable to start thread %u\n", i);
+                        exit(1);
+                }
+        }
+
+        /* Start everybody at once, the remote workloads keep using the
+         * barrier among themselves. The main thread has to join in. */
+        t = now();
+        pthread_barrier_wait(&barrier);
+        if (work->remote) {
+                for (i=0; i<DLLTHREADS_ROUNDS; i++) {
+                        pthread_barrier_wait(&barrier);
+                        pthread_barrier_wait(&barrier);
+                }
+        }
+
+        for (i=0; i<nthreads; i++)
+                pthread_join(threads[i], NULL);
+        t = now() - t;
+
+        if (work->sharded)
+                dll_sharded_destroy(&sharded);
+        pthread_barrier_destroy(&barrier);
+
+        return t;
+}
+
+int main(int argc, char *argv[])
+{
+        unsigned int nthreads, maxthreads = DLLTHREADS_MAXTHREADS;
+        unsigned long ops;
+        size_t i;
+        int first = 1;
+        double t;
+
+        if (argc > 1)
+                maxthreads = (unsigned int)strtoul(argv[1], NULL, 10);
+        if ((maxthreads == 0) || (maxthreads > DLLTHREADS_MAXTHREADS))
+                maxthreads = DLLTHREADS_MAXTHREADS;
+
+        printf("{\n  \"benchmark\": \"dllthreads\",\n  \"results\": [\n");
+
+        for (i=0; i<sizeof(workloads)/sizeof(workload_t); i++) {
+                for (nthreads=1; nthreads<=maxthreads; nthreads*=2) {
+                        t = run(&workloads[i], nthreads);
+                        ops = (unsigned long)nthreads*DLLTHREADS_ROUNDS*DLLTHREADS_LISTSIZE;
+
+                        printf("%s    {\"op\": \"%s\", \"threads\": %u, \"ops\": %lu, "
+                                        "\"ns_per_op\": %.2f, \"ops_per_sec\": %.1f}",
+                                        first ? "" : ",\n", workloads[i].name, nthreads,
+                                        ops, t/ops, ops/(t/1e9));
+                        fflush(stdout);
+                        first = 0;
+                }
+        }
+
+        printf("\n  ]\n}\n");
+
+        return 0;
+}
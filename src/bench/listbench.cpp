@@ -0,0 +1,377 @@
+/*
+* Copyright (c) 2008, Björn Rehm (bjoern@shugaa.de)
+* 
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+* 
+* The above copyright notice and this permission notice shall be included in
+* all copies or substantial portions of the Software.
+* 
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+* THE SOFTWARE.
+*/
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <list>
+#include <vector>
+#include <random>
+#include <algorithm>
+#ifdef LISTBENCH_HAVE_PAR
+#include <execution>
+#endif
+#include <dll_list.hpp>
+extern "C" {
+#include <dll_util.h>
+}
+
+/* Compares the C++ interface with the C interface it is built on and with
+ * std::list. The same operations are run on lists of ints with each of
+ * them, sizes go from 1e2 up to 1e6 (or argv[1]):
+ *
+ *   {"op": "sort", "impl": "dll::list", "size": 1000, "ops": 2048000,
+ *    "ns_per_op": 41.7}
+ *
+ * An operation's ops are the elements it touches. The lists each
+ * implementation ends up with are compared, a mismatch is an error.
+ *
+ * for_each_par runs std::for_each(std::execution::par, ...) over the list
+ * and is only there if the standard library supports it.
+ *
+ *   listbench [maxsize] */
+
+#define LISTBENCH_MINSIZE       (100)
+#define LISTBENCH_MAXSIZE       (1000000)
+#define LISTBENCH_MINTIME       (0.2e9)
+#define LISTBENCH_SEED          (4711)
+
+/* Input for every run, the same for all implementations */
+static std::vector<int> values;
+
+/* Results of the read-only operations go here so they aren't optimized out */
+static volatile long sink;
+
+static double now(void)
+{
+        struct timespec ts;
+
+        clock_gettime(CLOCK_MONOTONIC, &ts);
+        return (double)ts.tv_sec*1e9 + (double)ts.tv_nsec;
+}
+
+/* ######################################################################### */
+/*                            Implementations                                */
+/* ######################################################################### */
+
+/* Every implementation provides the same handful of members, the
+ * benchmarks are templates over them */
+
+struct impl_c
+{
+        static const char *name() { return "c"; }
+
+        dll_list_t l;
+
+        impl_c() { dll_init(&l); }
+        ~impl_c() { dll_clear(&l); }
+
+        void append(int value)
+        {
+                void *data;
+
+                if (dll_append(&l, &data, sizeof(int)) != EDLLOK) {
+                        fprintf(stderr, "listbench: out of memory\n");
+                        exit(1);
+                }
+                memcpy(data, &value, sizeof(int));
+        }
+
+        long walk()
+        {
+                dll_iterator_t it;
+                void *data;
+                long sum = 0;
+
+                dll_iterator_init(&it, &l);
+                while (dll_iterator_next(&it, &data, NULL) == EDLLOK)
+                        sum += *(int*)data;
+
+                return sum;
+        }
+
+        void sort() { dll_sort(&l, dll_compar_int); }
+
+        void erase_odd()
+        {
+                dll_item_t *item, *next;
+
+                for (item = l.first; item != NULL; item = next) {
+                        next = item->next;
+                        if (*(int*)item->data & 1)
+                                dll_remove_item(&l, item);
+                }
+        }
+
+        void result(std::vector<int> &out)
+        {
+                dll_cursor_t c;
+                void *data;
+
+                DLL_FOREACH(&l, c, data)
+                        out.push_back(*(int*)data);
+        }
+};
+
+/* Shared by dll::list and std::list */
+template <typename L>
+struct impl_cxx
+{
+        L l;
+
+        void append(int value) { l.emplace_back(value); }
+
+        long walk()
+        {
+                long sum = 0;
+
+                for (typename L::const_iterator it = l.begin(); it != l.end(); ++it)
+                        sum += *it;
+
+                return sum;
+        }
+
+        void sort() { l.sort([](int a, int b) { return a < b; }); }
+
+        void erase_odd()
+        {
+                for (typename L::iterator it = l.begin(); it != l.end();) {
+                        if (*it & 1)
+                                it = l.erase(it);
+                        else
+                                ++it;
+                }
+        }
+
+#ifdef LISTBENCH_HAVE_PAR
+        void for_each_par()
+        {
+                std::for_each(std::execution::par, l.begin(), l.end(),
+                                [](int &v) { v = v*3 + 1; });
+        }
+#endif
+
+        void result(std::vector<int> &out) { out.assign(l.begin(), l.end()); }
+};
+
+struct impl_dll : impl_cxx< dll::list<int> >
+{
+        static const char *name() { return "dll::list"; }
+};
+
+struct impl_std : impl_cxx< std::list<int> >
+{
+        static const char *name() { return "std::list"; }
+};
+
+/* ######################################################################### */
+/*                            Benchmarks                                     */
+/* ######################################################################### */
+
+/* Runs an operation once on a list of n items, returns the time taken in ns.
+ * The list's final contents go to out. */
+typedef double (*bench_fct_t)(unsigned int n, std::vector<int> &out);
+
+template <typename I>
+static void fill(I &impl, unsigned int n)
+{
+        unsigned int i;
+
+        for (i=0; i<n; i++)
+                impl.append(values[i]);
+}
+
+template <typename I>
+static double bench_append(unsigned int n, std::vector<int> &out)
+{
+        I impl;
+        unsigned int i;
+        double t;
+
+        t = now();
+        for (i=0; i<n; i++)
+                impl.append(values[i]);
+        t = now() - t;
+
+        impl.result(out);
+
+        return t;
+}
+
+template <typename I>
+static double bench_walk(unsigned int n, std::vector<int> &out)
+{
+        I impl;
+        double t;
+
+        fill(impl, n);
+
+        t = now();
+        sink = impl.walk();
+        t = now() - t;
+
+        impl.result(out);
+
+        return t;
+}
+
+template <typename I>
+static double bench_sort(unsigned int n, std::vector<int> &out)
+{
+        I impl;
+        double t;
+
+        fill(impl, n);
+
+        t = now();
+        impl.sort();
+        t = now() - t;
+
+        impl.result(out);
+
+        return t;
+}
+
+template <typename I>
+static double bench_erase(unsigned int n, std::vector<int> &out)
+{
+        I impl;
+        double t;
+
+        fill(impl, n);
+
+        t = now();
+        impl.erase_odd();
+        t = now() - t;
+
+        impl.result(out);
+
+        return t;
+}
+
+#ifdef LISTBENCH_HAVE_PAR
+template <typename I>
+static double bench_for_each_par(unsigned int n, std::vector<int> &out)
+{
+        I impl;
+        double t;
+
+        fill(impl, n);
+
+        t = now();
+        impl.for_each_par();
+        t = now() - t;
+
+        impl.result(out);
+
+        return t;
+}
+#endif
+
+struct bench_t
+{
+        const char *op;
+        const char *impl;
+        bench_fct_t fct;
+};
+
+#define LISTBENCH_OP(op, fct) \
+        {op, impl_c::name(), fct<impl_c>}, \
+        {op, impl_dll::name(), fct<impl_dll>}, \
+        {op, impl_std::name(), fct<impl_std>}
+
+static const bench_t benches[] = {
+        LISTBENCH_OP("append", bench_append),
+        LISTBENCH_OP("walk",   bench_walk),
+        LISTBENCH_OP("sort",   bench_sort),
+        LISTBENCH_OP("erase",  bench_erase),
+#ifdef LISTBENCH_HAVE_PAR
+        {"for_each_par", impl_dll::name(), bench_for_each_par<impl_dll>},
+        {"for_each_par", impl_std::name(), bench_for_each_par<impl_std>},
+#endif
+};
+
+/* Returns the list contents of the last run */
+static std::vector<int> run(const bench_t *bench, unsigned int n, int first)
+{
+        std::vector<int> out;
+        unsigned long total = 0;
+        double t = 0.0;
+
+        /* Repeat until the clock's resolution doesn't matter any more */
+        do {
+                out.clear();
+                t += bench->fct(n, out);
+                total += n;
+        } while (t < LISTBENCH_MINTIME);
+
+        printf("%s    {\"op\": \"%s\", \"impl\": \"%s\", \"size\": %u, "
+                        "\"ops\": %lu, \"ns_per_op\": %.2f}",
+                        first ? "" : ",\n", bench->op, bench->impl, n,
+                        total, t/total);
+        fflush(stdout);
+
+        return out;
+}
+
+int main(int argc, char *argv[])
+{
+        unsigned int n, maxsize = LISTBENCH_MAXSIZE;
+        size_t i;
+        int first = 1;
+        std::vector<int> out, expect;
+        std::mt19937 rng(LISTBENCH_SEED);
+
+        if (argc > 1)
+                maxsize = (unsigned int)strtoul(argv[1], NULL, 10);
+
+        printf("{\n  \"benchmark\": \"listbench\",\n  \"results\": [\n");
+
+        for (n=LISTBENCH_MINSIZE; n<=maxsize; n*=10) {
+                values.resize(n);
+                for (i=0; i<n; i++)
+                        values[i] = (int)(rng() % n);
+
+                for (i=0; i<sizeof(benches)/sizeof(bench_t); i++) {
+                        out = run(&benches[i], n, first);
+                        first = 0;
+
+                        /* Every op is listed with all its implementations
+                         * in a row, they must agree with the first one */
+                        if ((i == 0) || (strcmp(benches[i].op, benches[i-1].op) != 0))
+                                expect.swap(out);
+                        else if (out != expect) {
+                                fprintf(stderr, "listbench: %s %s differs\n",
+                                                benches[i].op, benches[i].impl);
+                                return 1;
+                        }
+                }
+
+                if (n > maxsize/10)
+                        break;
+        }
+
+        printf("\n  ]\n}\n");
+
+        return 0;
+}
@@ -0,0 +1,340 @@
+/*
+* Copyright (c) 2008, Björn Rehm (bjoern@shugaa.de)
+* 
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+* 
+* The above copyright notice and this permission notice shall be included in
+* all copies or substantial portions of the Software.
+* 
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+* THE SOFTWARE.
+*/
+
+#include <string.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <sys/mman.h>
+
+#include "dll_list.h"
+#include "dll_list_prv.h"
+#include "dll_compact.h"
+
+/* ######################################################################### */
+/*                            TODO / Notes                                   */
+/* ######################################################################### */
+
+/* ######################################################################### */
+/*                            Types & Defines                                */
+/* ######################################################################### */
+
+#define PRV_ARENA_ROUND(size) \
+        (((size) + DLL_ARENA_ALIGN - 1) & ~((size_t)DLL_ARENA_ALIGN - 1))
+
+/** A compaction arena. The block is freed when the last container or data
+ * chunk in it has been released, which may happen on any thread (the
+ * lists sharing its items can be). Placed arenas are mappings of their
+ * own, 'mapped' is their length then. */
+typedef struct {
+        size_t live;
+        size_t mapped;
+} prv_arena_t;
+
+/** Every chunk in an arena is preceded by a reference to the arena */
+typedef union {
+        prv_arena_t *arena;
+        char pad[DLL_ARENA_ALIGN];
+} prv_arena_ref_t;
+
+/* ######################################################################### */
+/*                           Private interface (Module)                      */
+/* ######################################################################### */
+
+static int prv_step(dll_compactor_t *compactor, dll_count_t n, dll_count_t *moved, const dll_prv_place_t *place);
+static size_t prv_copysize(dll_item_t *item, int movedata);
+static int prv_inplace(dll_item_t *item, int flags);
+static void prv_arenadrop(prv_arena_t *arena);
+
+/* ######################################################################### */
+/*                           Implementation                                  */
+/* ######################################################################### */
+
+int dll_compact(dll_list_t *list, int flags)
+{
+        return dll_prv_compact(list, flags, NULL);
+}
+
+int dll_prv_compact(dll_list_t *list, int flags, const dll_prv_place_t *place)
+{
+        int rc;
+        dll_compactor_t compactor;
+
+        rc = dll_compact_init(&compactor, list, flags);
+        if (rc != EDLLOK)
+                return rc;
+
+        if (list->count == 0)
+                return EDLLOK;
+
+        /* Traced as one big step, replays compact on the heap */
+        DLL_TRACE(DLL_TRACE_COMPACTSTEP, &compactor, NULL, list->count, 0);
+
+        return prv_step(&compactor, list->count, NULL, place);
+}
+
+int dll_compact_init(dll_compactor_t *compactor, dll_list_t *list, int flags)
+{
+        if (!compactor)
+                return EDLLINV;
+        if (!list)
+                return EDLLINV;
+        if (flags & ~(DLL_COMPACT_DATA|DLL_COMPACT_INLINE))
+                return EDLLINV;
+
+        compactor->flags = flags;
+        compactor->list = list;
+        compactor->item = list->first;
+
+        DLL_TRACE(DLL_TRACE_COMPACTINIT, compactor, list, 0, (size_t)flags);
+
+        return EDLLOK;
+}
+
+int dll_compact_step(dll_compactor_t *compactor, dll_count_t n, dll_count_t *moved)
+{
+        if (!compactor)
+                return EDLLINV;
+
+        DLL_TRACE(DLL_TRACE_COMPACTSTEP, compactor, NULL, n, 0);
+
+        return prv_step(compactor, n, moved, NULL);
+}
+
+static int prv_step(dll_compactor_t *compactor, dll_count_t n, dll_count_t *moved, const dll_prv_place_t *place)
+{
+        dll_count_t i, count, skip;
+        size_t size;
+        char *pos;
+        void *arena;
+        dll_item_t *item, *itemnew, *itemnext;
+        dll_list_t *list;
+        int movedata;
+
+        list = compactor->list;
+
+        if (moved != NULL)
+                *moved = 0;
+
+        /* A snapshot may have been taken since the last step. Unsharing
+         * replaces the containers, so find our place again afterwards. */
+        if (list->share != NULL) {
+                for (skip=0, item=list->first; item != compactor->item; item=item->next)
+                        skip++;
+
+                if (dll_prv_unshare(list) != EDLLOK)
+                        return EDLLNOMEM;
+
+                for (item=list->first; skip > 0; skip--)
+                        item = item->next;
+                compactor->item = item;
+        }
+
+        /* Size up the block for the next n items */
+        size = 0;
+        item = compactor->item;
+        for (count=0; (count<n) && (item!=NULL); count++) {
+                if (!prv_inplace(item, compactor->flags)) {
+                        movedata = (compactor->flags & DLL_COMPACT_DATA) ||
+                                (item->flags & DLL_ITEM_INLINEDATA);
+
+                        size += dll_prv_arenachunk(prv_copysize(item, movedata));
+                        if (movedata && (item->datasize > DLL_ITEM_INLINEMAX))
+                                size += dll_prv_arenachunk(item->datasize);
+                }
+
+                item = item->next;
+        }
+
+        if (count == 0)
+                return EDLLOK;
+
+        /* Nothing but items staying where they are */
+        if (size == 0) {
+                compactor->item = item;
+                if (moved != NULL)
+                        *moved = count;
+                return EDLLOK;
+        }
+
+        arena = dll_prv_arenanew(size, &pos, place);
+        if (arena == NULL)
+                return EDLLNOMEM;
+
+        /* Copy the items over in list order and relink their neighbours. The
+         * predecessor has already been moved at this point, so the new
+         * container picks up the right prev handle when it's copied. */
+        item = compactor->item;
+        for (i=0; i<count; i++) {
+                itemnext = item->next;
+
+                if (prv_inplace(item, compactor->flags)) {
+                        item = itemnext;
+                        continue;
+                }
+
+                /* Inline data can only move along with its container */
+                movedata = (compactor->flags & DLL_COMPACT_DATA) ||
+                        (item->flags & DLL_ITEM_INLINEDATA);
+
+                DLL_STATS_SUB(list, bytes, dll_prv_itembytes(item));
+
+                itemnew = (dll_item_t*)dll_prv_arenatake(arena, &pos, prv_copysize(item, movedata));
+                *itemnew = *item;
+                itemnew->flags &= ~(DLL_ITEM_SLAB|DLL_ITEM_TCACHE);
+                itemnew->flags |= DLL_ITEM_ARENA;
+
+                if (movedata) {
+                        itemnew->flags &= ~(DLL_ITEM_SHAREDDATA|DLL_ITEM_INLINEDATA|DLL_ITEM_HOSTEDDATA|
+                                        DLL_ITEM_ARENADATA|DLL_ITEM_TCACHEDATA);
+
+                        /* Small data goes inline, wherever it was before */
+                        if (item->datasize <= DLL_ITEM_INLINEMAX) {
+                                itemnew->data = (char*)itemnew + DLL_ITEM_INLINEOFF;
+                                itemnew->flags |= DLL_ITEM_INLINEDATA;
+                        } else {
+                                itemnew->data = dll_prv_arenatake(arena, &pos, item->datasize);
+                                itemnew->flags |= DLL_ITEM_ARENADATA;
+                        }
+                        memcpy(itemnew->data, item->data, item->datasize);
+
+                        DLL_HOOK_DATAALLOC(list, itemnew);
+                        dll_prv_datafree(list, item);
+                }
+
+                DLL_STATS_ADD(list, bytes, dll_prv_itembytes(itemnew));
+
+                if (itemnew->prev != NULL)
+                        itemnew->prev->next = itemnew;
+                else
+                        list->first = itemnew;
+
+                if (itemnew->next != NULL)
+                        itemnew->next->prev = itemnew;
+                else
+                        list->last = itemnew;
+
+                DLL_HOOK_ITEMALLOC(list, itemnew);
+                dll_prv_itemfree(list, item);
+
+                item = itemnext;
+        }
+
+        compactor->item = item;
+
+        if (moved != NULL)
+                *moved = count;
+
+        return EDLLOK;
+}
+
+/* Size of an item's new container, with the data if it goes inline */
+static size_t prv_copysize(dll_item_t *item, int movedata)
+{
+        if (movedata && (item->datasize <= DLL_ITEM_INLINEMAX))
+                return DLL_ITEM_INLINEOFF + item->datasize;
+
+        return sizeof(dll_item_t);
+}
+
+/* Items with inline data stay where they are unless the caller agreed to
+ * their data moving. Relocating just the container would mean keeping the
+ * old block for the data, which costs more memory than it saves. */
+static int prv_inplace(dll_item_t *item, int flags)
+{
+        if (flags & (DLL_COMPACT_DATA|DLL_COMPACT_INLINE))
+                return 0;
+
+        return (item->flags & DLL_ITEM_INLINEDATA) != 0;
+}
+
+size_t dll_prv_arenachunk(size_t size)
+{
+        return sizeof(prv_arena_ref_t) + PRV_ARENA_ROUND(size);
+}
+
+void *dll_prv_arenanew(size_t size, char **pos, const dll_prv_place_t *place)
+{
+        prv_arena_t *arena;
+        size_t mapped = 0, page;
+
+        size += PRV_ARENA_ROUND(sizeof(prv_arena_t));
+
+        if (place == NULL) {
+                arena = (prv_arena_t*)malloc(size);
+                if (arena == NULL)
+                        return NULL;
+        } else {
+                /* Binding only affects pages faulted in afterwards, so
+                 * nothing may be written to the block before */
+                page = (size_t)sysconf(_SC_PAGESIZE);
+                mapped = (size + page - 1) & ~(page - 1);
+
+                arena = (prv_arena_t*)mmap(NULL, mapped, PROT_READ|PROT_WRITE,
+                                MAP_PRIVATE|MAP_ANONYMOUS, -1, 0);
+                if (arena == MAP_FAILED)
+                        return NULL;
+
+                if (dll_prv_numabind(arena, mapped, place) != EDLLOK) {
+                        munmap(arena, mapped);
+                        return NULL;
+                }
+        }
+
+        arena->live = 0;
+        arena->mapped = mapped;
+        *pos = (char*)arena + PRV_ARENA_ROUND(sizeof(prv_arena_t));
+
+        return arena;
+}
+
+void *dll_prv_arenatake(void *arena, char **pos, size_t size)
+{
+        prv_arena_ref_t *ref = (prv_arena_ref_t*)*pos;
+
+        ref->arena = (prv_arena_t*)arena;
+        ref->arena->live++;
+
+        *pos += dll_prv_arenachunk(size);
+
+        return (void*)(ref + 1);
+}
+
+void dll_prv_arenafree(void *arena)
+{
+        prv_arenadrop((prv_arena_t*)arena);
+}
+
+void dll_prv_arenarelease(void *ptr)
+{
+        prv_arena_t *arena = ((prv_arena_ref_t*)ptr - 1)->arena;
+
+        if (DLL_ATOMIC_DEC(&arena->live) == 0)
+                prv_arenadrop(arena);
+}
+
+static void prv_arenadrop(prv_arena_t *arena)
+{
+        if (arena->mapped > 0)
+                munmap(arena, arena->mapped);
+        else
+                free(arena);
+}
@@ -0,0 +1,137 @@
+/*
+* Copyright (c) 2008, Björn Rehm (bjoern@shugaa.de)
+* 
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+* 
+* The above copyright notice and this permission notice shall be included in
+* all copies or substantial portions of the Software.
+* 
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+* THE SOFTWARE.
+*/
+
+/** @file dll_compact.h
+ *
+ * @brief Relocating list items for better cache locality
+ *
+ * */
+
+#ifndef _DLL_COMPACT_H
+#define _DLL_COMPACT_H
+
+#include "dll_list.h"
+
+/* ######################################################################### */
+/*                            TODO / Notes                                   */
+/* ######################################################################### */
+
+/* ######################################################################### */
+/*                            Types & Defines                                */
+/* ######################################################################### */
+
+/** Relocate item data as well as the item containers. Only pass this if
+ * there are no outstanding references to item data, they become invalid. */
+#define DLL_COMPACT_DATA        (1<<0)
+
+/** Relocate data stored inline (see dll_append()) along with its
+ * container. References to such data become invalid, others stay valid. */
+#define DLL_COMPACT_INLINE      (1<<1)
+
+/** Incremental compaction state */
+typedef struct dll_compactor dll_compactor_t;
+
+struct dll_compactor
+{
+        int flags;
+        dll_list_t *list;
+        dll_item_t *item;
+};
+
+/* ######################################################################### */
+/*                            Public interface                               */
+/* ######################################################################### */
+
+/** Move all items of a list into one contiguous block of memory
+ *
+ * Lists which have seen a lot of inserts and removes end up with their items
+ * scattered all over the heap, so walking them costs a cache miss (and often
+ * a TLB miss) per item. Compaction copies the item containers into a single
+ * allocation in list order and relinks them, turning traversal into a linear
+ * memory scan.
+ *
+ * Without flags only the containers are moved and references to item data
+ * stay valid. Items whose data is stored inline (see dll_append()) can't
+ * be moved without their data and are left where they are, so compacting
+ * a list of small items this way doesn't achieve anything. Pass
+ * DLL_COMPACT_INLINE to move them along with their data, which invalidates
+ * references to inline data only. With DLL_COMPACT_DATA each item's data
+ * is copied right behind its container, which is best for locality but
+ * invalidates every data reference handed out before. Iterators and
+ * cursors are invalidated in any case.
+ *
+ * Memory: every moved item takes up its container (with inline data, if
+ * any) rounded up to 16 bytes plus another 16 bytes of bookkeeping in the
+ * block, its old allocation is freed right away. Data that isn't moved keeps its own
+ * allocation, so the list needs about as much memory afterwards as it did
+ * before.
+ *
+ * The block is released once all items in it have been removed. Removing
+ * items doesn't return their share of the block to the system until then,
+ * compacting again does. Lists sharing items from one block (e.g. after
+ * dll_splice() or dll_snapshot()) may be used from different threads.
+ *
+ * See dll_numa_place() (dll_numa.h) for putting the block on a particular
+ * NUMA node.
+ *
+ * @param list       Pointer to the list
+ * @param flags      0, DLL_COMPACT_INLINE or DLL_COMPACT_DATA
+ *
+ * @return EDLLOK    No errors occured
+ * @return EDLLINV   An invalid argument has been passed
+ * @return EDLLNOMEM Unable to allocate enough memory
+ * @return EDLLERROR Something went wrong
+ */
+int dll_compact(dll_list_t *list, int flags);
+
+/** Prepare an incremental compaction of a list
+ *
+ * Incremental compaction works like dll_compact() but relocates a bounded
+ * number of items per call to dll_compact_step(), each step into its own
+ * block. Between steps the list may be used and appended to, but no items
+ * must be removed from it until the compaction has finished.
+ *
+ * @param compactor  Pointer to a dll_compactor_t to be initialized
+ * @param list       Pointer to the list
+ * @param flags      0, DLL_COMPACT_INLINE or DLL_COMPACT_DATA
+ *
+ * @return EDLLOK    No errors occured
+ * @return EDLLINV   An invalid argument has been passed
+ * @return EDLLERROR Something went wrong
+ */
+int dll_compact_init(dll_compactor_t *compactor, dll_list_t *list, int flags);
+
+/** Relocate up to n more items
+ *
+ * @param compactor  Pointer to the compaction state
+ * @param n          Maximum number of items to relocate
+ * @param moved      Where to store the number of items relocated (may be
+ *                   NULL), less than n once the end of the list was reached
+ *
+ * @return EDLLOK    No errors occured
+ * @return EDLLINV   An invalid argument has been passed
+ * @return EDLLNOMEM Unable to allocate enough memory
+ * @return EDLLERROR Something went wrong
+ */
+int dll_compact_step(dll_compactor_t *compactor, dll_count_t n, dll_count_t *moved);
+
+#endif /* _DLL_COMPACT_H */
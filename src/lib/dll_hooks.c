@@ -0,0 +1,90 @@
+/*
+* Copyright (c) 2008, Björn Rehm (bjoern@shugaa.de)
+* 
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+* 
+* The above copyright notice and this permission notice shall be included in
+* all copies or substantial portions of the Software.
+* 
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+* THE SOFTWARE.
+*/
+
+#include "dll_list.h"
+#include "dll_list_prv.h"
+#include "dll_hooks.h"
+
+/* ######################################################################### */
+/*                            TODO / Notes                                   */
+/* ######################################################################### */
+
+/* ######################################################################### */
+/*                            Types & Defines                                */
+/* ######################################################################### */
+
+/* ######################################################################### */
+/*                           Private interface (Module)                      */
+/* ######################################################################### */
+
+static void prv_nomem(void *ctx, dll_list_t *list, const void *ptr, size_t size);
+static void prv_nolist(void *ctx, dll_list_t *list);
+static void prv_noseek(void *ctx, dll_list_t *list, dll_count_t position, dll_count_t distance);
+
+/* ######################################################################### */
+/*                           Implementation                                  */
+/* ######################################################################### */
+
+const dll_hooks_t *dll_prv_hooks = NULL;
+static dll_hooks_t prv_hooks;
+
+int dll_set_hooks(const dll_hooks_t *hooks)
+{
+        if (hooks == NULL) {
+                dll_prv_hooks = NULL;
+                return EDLLOK;
+        }
+
+        /* Unset hooks are filled in with stubs, that way the call sites
+         * don't need to check each one */
+        prv_hooks = *hooks;
+        if (prv_hooks.item_alloc == NULL)
+                prv_hooks.item_alloc = prv_nomem;
+        if (prv_hooks.item_free == NULL)
+                prv_hooks.item_free = prv_nomem;
+        if (prv_hooks.data_alloc == NULL)
+                prv_hooks.data_alloc = prv_nomem;
+        if (prv_hooks.data_free == NULL)
+                prv_hooks.data_free = prv_nomem;
+        if (prv_hooks.sort_begin == NULL)
+                prv_hooks.sort_begin = prv_nolist;
+        if (prv_hooks.sort_end == NULL)
+                prv_hooks.sort_end = prv_nolist;
+        if (prv_hooks.seek == NULL)
+                prv_hooks.seek = prv_noseek;
+
+        dll_prv_hooks = &prv_hooks;
+
+        return EDLLOK;
+}
+
+static void prv_nomem(void *ctx, dll_list_t *list, const void *ptr, size_t size)
+{
+}
+
+static void prv_nolist(void *ctx, dll_list_t *list)
+{
+}
+
+static void prv_noseek(void *ctx, dll_list_t *list, dll_count_t position, dll_count_t distance)
+{
+}
@@ -0,0 +1,87 @@
+/*
+* Copyright (c) 2008, Björn Rehm (bjoern@shugaa.de)
+* 
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+* 
+* The above copyright notice and this permission notice shall be included in
+* all copies or substantial portions of the Software.
+* 
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+* THE SOFTWARE.
+*/
+
+/** @file dll_hooks.h
+ *
+ * @brief Callbacks on allocations and operations, for heap profiling
+ *
+ * */
+
+#ifndef _DLL_HOOKS_H
+#define _DLL_HOOKS_H
+
+#include "dll_list.h"
+
+/* ######################################################################### */
+/*                            TODO / Notes                                   */
+/* ######################################################################### */
+
+/* ######################################################################### */
+/*                            Types & Defines                                */
+/* ######################################################################### */
+
+/** Memory hook prototype, ptr is the item container or data in question */
+typedef void(*dll_fcthookmem_t)(void *ctx, dll_list_t *list, const void *ptr, size_t size);
+
+/** Operation hook prototype */
+typedef void(*dll_fcthooklist_t)(void *ctx, dll_list_t *list);
+
+/** Seek hook prototype, distance is the number of items walked past */
+typedef void(*dll_fcthookseek_t)(void *ctx, dll_list_t *list, dll_count_t position, dll_count_t distance);
+
+/** Hook set type */
+typedef struct dll_hooks dll_hooks_t;
+
+struct dll_hooks
+{
+        dll_fcthookmem_t item_alloc;    /* Item container allocated */
+        dll_fcthookmem_t item_free;     /* Item container freed */
+        dll_fcthookmem_t data_alloc;    /* Item data allocated */
+        dll_fcthookmem_t data_free;     /* Item data freed */
+        dll_fcthooklist_t sort_begin;   /* dll_sort() starts */
+        dll_fcthooklist_t sort_end;     /* dll_sort() is done */
+        dll_fcthookseek_t seek;         /* Positional lookup by get/insert/remove */
+        void *ctx;                      /* Passed to every hook */
+};
+
+/* ######################################################################### */
+/*                            Public interface                               */
+/* ######################################################################### */
+
+/** Set the hooks for all lists
+ *
+ * Hooks are called synchronously from whichever thread does the operation,
+ * any of them may be NULL. Compaction, loading and snapshots report their
+ * allocations and frees just like the basic operations do, items moved
+ * between lists by dll_splice() are reported neither as freed nor as
+ * allocated. Set the hooks while no other thread is using the library.
+ *
+ * The same events are available as static tracepoints (provider "libdll")
+ * if the library was built with sys/sdt.h around.
+ *
+ * @param hooks      Pointer to the hooks, they are copied. NULL removes them.
+ *
+ * @return EDLLOK    No errors occured
+ */
+int dll_set_hooks(const dll_hooks_t *hooks);
+
+#endif /* _DLL_HOOKS_H */
@@ -0,0 +1,177 @@
+/*
+* Copyright (c) 2008, Björn Rehm (bjoern@shugaa.de)
+* 
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+* 
+* The above copyright notice and this permission notice shall be included in
+* all copies or substantial portions of the Software.
+* 
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+* THE SOFTWARE.
+*/
+
+/** @file dll_inline.h
+ *
+ * @brief Inline fast paths for list traversal
+ *
+ * */
+
+#ifndef _DLL_INLINE_H
+#define _DLL_INLINE_H
+
+#include "dll_list.h"
+
+/* ######################################################################### */
+/*                            TODO / Notes                                   */
+/* ######################################################################### */
+
+/* ######################################################################### */
+/*                            Types & Defines                                */
+/* ######################################################################### */
+
+#if defined(__cplusplus) || (defined(__STDC_VERSION__) && (__STDC_VERSION__ >= 199901L))
+#define DLL_INLINE              static inline
+#elif defined(__GNUC__)
+#define DLL_INLINE              static __inline__
+#else
+#define DLL_INLINE              static
+#endif
+
+/** Hint the CPU to start loading an address we're going to touch soon */
+#if defined(__GNUC__)
+#define DLL_PREFETCH(addr)      __builtin_prefetch(addr)
+#else
+#define DLL_PREFETCH(addr)
+#endif
+
+/** How many items ahead of the current one DLL_FOREACH prefetches. Define
+ * this to 0 before including this file to turn prefetching off. */
+#ifndef DLL_PREFETCH_DISTANCE
+#define DLL_PREFETCH_DISTANCE   (4)
+#endif
+
+/** Item containers are normally only dealt with by the library. The inline
+ * traversal below needs to know their layout, treat them as read-only. */
+struct dll_item
+{
+        void *data;
+        struct dll_item *prev;
+        struct dll_item *next;
+        size_t datasize;
+        unsigned int flags;
+        unsigned int slot;
+};
+
+/** Cursor type for DLL_FOREACH and DLL_FOREACH_REVERSE */
+typedef struct dll_cursor
+{
+        dll_item_t *item;
+        dll_item_t *ahead;
+} dll_cursor_t;
+
+/** Walk a list from the first to the last item
+ *
+ * This is the fast path equivalent of a dll_iterator_next() loop. Everything
+ * is inlined, there's no turnaround handling and no argument checking, and
+ * the payloads DLL_PREFETCH_DISTANCE items ahead are prefetched while the
+ * current one is being processed. The list must not be modified inside the
+ * loop.
+ *
+ * @code
+ * dll_cursor_t c;
+ * int *data;
+ *
+ * DLL_FOREACH(&list, c, data)
+ *         sum += *data;
+ * @endcode
+ *
+ * @param list       Pointer to the list
+ * @param cursor     A dll_cursor_t variable (not a pointer)
+ * @param data       Pointer variable receiving each item's data
+ */
+#define DLL_FOREACH(list, cursor, data) \
+        for (dll_cursor_first(&(cursor), (list)); \
+             ((cursor).item != NULL) && (((data) = (cursor).item->data), 1); \
+             dll_cursor_next(&(cursor)))
+
+/** Walk a list from the last to the first item
+ *
+ * @see DLL_FOREACH
+ *
+ * @param list       Pointer to the list
+ * @param cursor     A dll_cursor_t variable (not a pointer)
+ * @param data       Pointer variable receiving each item's data
+ */
+#define DLL_FOREACH_REVERSE(list, cursor, data) \
+        for (dll_cursor_last(&(cursor), (list)); \
+             ((cursor).item != NULL) && (((data) = (cursor).item->data), 1); \
+             dll_cursor_prev(&(cursor)))
+
+/** Size of the data BLOB of the item a cursor is on */
+#define DLL_CURSOR_DATASIZE(cursor)     ((cursor).item->datasize)
+
+/* ######################################################################### */
+/*                            Public interface                               */
+/* ######################################################################### */
+
+DLL_INLINE void dll_cursor_first(dll_cursor_t *cursor, dll_list_t *list)
+{
+        int i;
+
+        cursor->item = list->first;
+        cursor->ahead = list->first;
+
+        for (i=0; (i<DLL_PREFETCH_DISTANCE) && (cursor->ahead != NULL); i++) {
+                DLL_PREFETCH(cursor->ahead->data);
+                cursor->ahead = cursor->ahead->next;
+        }
+}
+
+DLL_INLINE void dll_cursor_next(dll_cursor_t *cursor)
+{
+        /* Payloads don't depend on each other, so while we chase the next
+         * pointers the payloads further ahead can already be on their way */
+        if (DLL_PREFETCH_DISTANCE && (cursor->ahead != NULL)) {
+                DLL_PREFETCH(cursor->ahead->data);
+                DLL_PREFETCH(cursor->ahead->next);
+                cursor->ahead = cursor->ahead->next;
+        }
+
+        cursor->item = cursor->item->next;
+}
+
+DLL_INLINE void dll_cursor_last(dll_cursor_t *cursor, dll_list_t *list)
+{
+        int i;
+
+        cursor->item = list->last;
+        cursor->ahead = list->last;
+
+        for (i=0; (i<DLL_PREFETCH_DISTANCE) && (cursor->ahead != NULL); i++) {
+                DLL_PREFETCH(cursor->ahead->data);
+                cursor->ahead = cursor->ahead->prev;
+        }
+}
+
+DLL_INLINE void dll_cursor_prev(dll_cursor_t *cursor)
+{
+        if (DLL_PREFETCH_DISTANCE && (cursor->ahead != NULL)) {
+                DLL_PREFETCH(cursor->ahead->data);
+                DLL_PREFETCH(cursor->ahead->prev);
+                cursor->ahead = cursor->ahead->prev;
+        }
+
+        cursor->item = cursor->item->prev;
+}
+
+#endif /* _DLL_INLINE_H */
@@ -0,0 +1,178 @@
+/*
+* Copyright (c) 2008, Björn Rehm (bjoern@shugaa.de)
+* 
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+* 
+* The above copyright notice and this permission notice shall be included in
+* all copies or substantial portions of the Software.
+* 
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+* THE SOFTWARE.
+*/
+
+#include <stddef.h>
+
+#include "dll_list.h"
+#include "dll_list_prv.h"
+#include "dll_intrusive.h"
+
+/* ######################################################################### */
+/*                            TODO / Notes                                   */
+/* ######################################################################### */
+
+/* ######################################################################### */
+/*                            Types & Defines                                */
+/* ######################################################################### */
+
+/* ######################################################################### */
+/*                           Private interface (Module)                      */
+/* ######################################################################### */
+
+/* ######################################################################### */
+/*                           Implementation                                  */
+/* ######################################################################### */
+
+int dll_ilist_init(dll_ilist_t *list)
+{
+        if (!list)
+                return EDLLINV;
+
+        list->count = 0;
+        list->first = NULL;
+        list->last = NULL;
+
+        return EDLLOK;
+}
+
+int dll_ilist_append(dll_ilist_t *list, dll_link_t *link)
+{
+        return dll_ilist_insert(list, link, NULL);
+}
+
+int dll_ilist_insert(dll_ilist_t *list, dll_link_t *link, dll_link_t *before)
+{
+        if (!list)
+                return EDLLINV;
+        if (!link)
+                return EDLLINV;
+
+        if (before == NULL) {
+                link->prev = list->last;
+                link->next = NULL;
+                if (list->last != NULL)
+                        list->last->next = link;
+                else
+                        list->first = link;
+                list->last = link;
+        } else {
+                link->prev = before->prev;
+                link->next = before;
+                if (before->prev != NULL)
+                        before->prev->next = link;
+                else
+                        list->first = link;
+                before->prev = link;
+        }
+
+        list->count++;
+
+        return EDLLOK;
+}
+
+int dll_ilist_unlink(dll_ilist_t *list, dll_link_t *link)
+{
+        if (!list)
+                return EDLLINV;
+        if (!link)
+                return EDLLINV;
+        if (list->count == 0)
+                return EDLLINV;
+
+        if (link->prev != NULL)
+                link->prev->next = link->next;
+        else
+                list->first = link->next;
+        if (link->next != NULL)
+                link->next->prev = link->prev;
+        else
+                list->last = link->prev;
+
+        link->prev = NULL;
+        link->next = NULL;
+        list->count--;
+
+        return EDLLOK;
+}
+
+int dll_ilist_splice(dll_ilist_t *list, dll_ilist_t *lext)
+{
+        if (!list)
+                return EDLLINV;
+        if (!lext)
+                return EDLLINV;
+        if (list == lext)
+                return EDLLINV;
+
+        if (lext->count == 0)
+                return EDLLOK;
+
+        if (list->last != NULL) {
+                list->last->next = lext->first;
+                lext->first->prev = list->last;
+        } else {
+                list->first = lext->first;
+        }
+        list->last = lext->last;
+        list->count += lext->count;
+
+        return dll_ilist_init(lext);
+}
+
+int dll_ilist_count(dll_ilist_t *list, dll_count_t *count)
+{
+        if (!list)
+                return EDLLINV;
+        if (!count)
+                return EDLLINV;
+
+        *count = list->count;
+
+        return EDLLOK;
+}
+
+int dll_ilist_sort(dll_ilist_t *list, dll_fctcompare_t compar, size_t offset)
+{
+        void *last;
+        dll_prv_linksort_t sort;
+
+        if (!list)
+                return EDLLINV;
+        if (!compar)
+                return EDLLINV;
+        if (list->count < 2)
+                return EDLLOK;
+
+        /* The comparator gets the objects the links are embedded in */
+        sort.nextoff = offsetof(dll_link_t, next);
+        sort.prevoff = offsetof(dll_link_t, prev);
+        sort.keyoff = -(ptrdiff_t)offset;
+        sort.deref = 0;
+        sort.base = NULL;
+        sort.compar = compar;
+        sort.compares = 0;
+
+        list->first = (dll_link_t*)dll_prv_linksort(list->first, &sort, &last);
+        list->last = (dll_link_t*)last;
+
+        return EDLLOK;
+}
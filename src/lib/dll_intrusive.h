@@ -0,0 +1,198 @@
+/*
+* Copyright (c) 2008, Björn Rehm (bjoern@shugaa.de)
+* 
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+* 
+* The above copyright notice and this permission notice shall be included in
+* all copies or substantial portions of the Software.
+* 
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+* THE SOFTWARE.
+*/
+
+/** @file dll_intrusive.h
+ *
+ * @brief Intrusive lists, links embedded in the caller's objects
+ *
+ * */
+
+#ifndef _DLL_INTRUSIVE_H
+#define _DLL_INTRUSIVE_H
+
+#include <stddef.h>
+
+#include "dll_list.h"
+
+/* ######################################################################### */
+/*                            TODO / Notes                                   */
+/* ######################################################################### */
+
+/*
+ * The caller's struct carries a dll_link_t for every intrusive list it may
+ * be on, the library only ever touches those links. Nothing is allocated
+ * or freed and an object can be on as many lists at once as it has links.
+ *
+ * struct conn {
+ *         int fd;
+ *         dll_link_t all;         <- on the list of all connections
+ *         dll_link_t idle;        <- on the idle list as well, sometimes
+ * };
+ */
+
+/* ######################################################################### */
+/*                            Types & Defines                                */
+/* ######################################################################### */
+
+/** Link type, embedded in the caller's objects */
+typedef struct dll_link dll_link_t;
+
+/** Intrusive list instance type */
+typedef struct dll_ilist dll_ilist_t;
+
+struct dll_link
+{
+        dll_link_t *prev;
+        dll_link_t *next;
+};
+
+struct dll_ilist
+{
+        dll_count_t count;
+        dll_link_t *first;
+        dll_link_t *last;
+};
+
+/** Get the object a link is embedded in
+ *
+ * @param link       Pointer to the dll_link_t
+ * @param type       Type of the object
+ * @param member     Name of the dll_link_t member in type
+ */
+#define DLL_CONTAINER_OF(link, type, member) \
+        ((type*)((char*)(link) - offsetof(type, member)))
+
+/** Walk an intrusive list from the first to the last link
+ *
+ * The current link may be unlinked inside the loop only if the next one
+ * has been saved before.
+ *
+ * @code
+ * dll_link_t *link;
+ *
+ * DLL_ILIST_FOREACH(&idle, link)
+ *         close(DLL_CONTAINER_OF(link, struct conn, idle)->fd);
+ * @endcode
+ *
+ * @param list       Pointer to the dll_ilist_t
+ * @param link       dll_link_t pointer variable
+ */
+#define DLL_ILIST_FOREACH(list, link) \
+        for ((link) = (list)->first; (link) != NULL; (link) = (link)->next)
+
+/** Walk an intrusive list from the last to the first link
+ *
+ * @see DLL_ILIST_FOREACH
+ */
+#define DLL_ILIST_FOREACH_REVERSE(list, link) \
+        for ((link) = (list)->last; (link) != NULL; (link) = (link)->prev)
+
+/* ######################################################################### */
+/*                            Public interface                               */
+/* ######################################################################### */
+
+/** Initialize an intrusive list instance
+ *
+ * @param list       Pointer to a dll_ilist_t to be initialized
+ *
+ * @return EDLLOK    No errors occured
+ * @return EDLLINV   An invalid argument has been passed
+ */
+int dll_ilist_init(dll_ilist_t *list);
+
+/** Append a link to the end of a list
+ *
+ * The link must not be on this list already, being on other lists through
+ * other links of the same object is fine.
+ *
+ * @param list       Pointer to the list
+ * @param link       Pointer to the link to be appended
+ *
+ * @return EDLLOK    No errors occured
+ * @return EDLLINV   An invalid argument has been passed
+ */
+int dll_ilist_append(dll_ilist_t *list, dll_link_t *link);
+
+/** Insert a link in front of another one
+ *
+ * @param list       Pointer to the list
+ * @param link       Pointer to the link to be inserted
+ * @param before     Link on the list to insert in front of, NULL appends
+ *
+ * @return EDLLOK    No errors occured
+ * @return EDLLINV   An invalid argument has been passed
+ */
+int dll_ilist_insert(dll_ilist_t *list, dll_link_t *link, dll_link_t *before);
+
+/** Take a link off a list
+ *
+ * Constant time, the object itself is left alone.
+ *
+ * @param list       Pointer to the list
+ * @param link       Pointer to a link on the list
+ *
+ * @return EDLLOK    No errors occured
+ * @return EDLLINV   An invalid argument has been passed
+ */
+int dll_ilist_unlink(dll_ilist_t *list, dll_link_t *link);
+
+/** Move all links of lext to the end of list
+ *
+ * Constant time, lext is empty afterwards.
+ *
+ * @param list       Pointer to the list to be extended
+ * @param lext       Pointer to the list whose links are moved
+ *
+ * @return EDLLOK    No errors occured
+ * @return EDLLINV   An invalid argument has been passed
+ */
+int dll_ilist_splice(dll_ilist_t *list, dll_ilist_t *lext);
+
+/** Number of links on a list
+ *
+ * @param list       Pointer to the list
+ * @param count      Pointer to the variable receiving the count
+ *
+ * @return EDLLOK    No errors occured
+ * @return EDLLINV   An invalid argument has been passed
+ */
+int dll_ilist_count(dll_ilist_t *list, dll_count_t *count);
+
+/** Sort a list
+ *
+ * Stable merge sort of the links. The comparator gets the objects, found
+ * by subtracting offset from the links' addresses.
+ *
+ * @code
+ * dll_ilist_sort(&all, compar_fd, offsetof(struct conn, all));
+ * @endcode
+ *
+ * @param list       Pointer to the list
+ * @param compar     Comparator function, see dll_sort()
+ * @param offset     Offset of the link within the objects
+ *
+ * @return EDLLOK    No errors occured
+ * @return EDLLINV   An invalid argument has been passed
+ */
+int dll_ilist_sort(dll_ilist_t *list, dll_fctcompare_t compar, size_t offset);
+
+#endif /* _DLL_INTRUSIVE_H */
@@ -0,0 +1,1192 @@
+/*
+* Copyright (c) 2008, Björn Rehm (bjoern@shugaa.de)
+* 
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+* 
+* The above copyright notice and this permission notice shall be included in
+* all copies or substantial portions of the Software.
+* 
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+* THE SOFTWARE.
+*/
+
+#include <string.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <limits.h>
+#include <errno.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/uio.h>
+
+#include "dll_list.h"
+#include "dll_list_prv.h"
+#include "dll_io.h"
+
+/* ######################################################################### */
+/*                            TODO / Notes                                   */
+/* ######################################################################### */
+
+/* ######################################################################### */
+/*                            Types & Defines                                */
+/* ######################################################################### */
+
+#define PRV_IO_MAGIC            "DLLS"
+#define PRV_IO_VERSION          (1)
+#define PRV_IO_HDRSIZE          (32)
+#define PRV_IO_BUFSIZE          (1024*1024)
+
+/* Loaded items are carved from blocks of this size. That way memory goes
+ * back as items are removed, not only once the last of them is gone. */
+#define PRV_LOAD_BLOCKSIZE      (256*1024)
+
+/* Streamed files are dropped from the page cache in steps of this size */
+#define PRV_IO_DROPSIZE         (64*1024*1024)
+
+/* What an item costs while sorting a run: its data, its container and
+ * what the allocator needs to keep track of both */
+#define PRV_SORT_ITEMCOST(size) ((size) + sizeof(dll_item_t) + 32)
+
+/* What each run being merged costs, mostly its read buffer */
+#define PRV_SORT_RUNCOST        (PRV_IO_BUFSIZE + 64*1024)
+
+#define PRV_CHECKSUM_INIT       ((uint64_t)0xcbf29ce484222325ULL)
+#define PRV_CHECKSUM_PRIME      ((uint64_t)0x100000001b3ULL)
+
+typedef struct {
+        uint64_t count;
+        uint64_t databytes;
+        uint64_t checksum;
+} prv_header_t;
+
+typedef struct {
+        int fd;
+        size_t used;
+        unsigned char *buf;
+} prv_writer_t;
+
+typedef struct {
+        int fd;
+        int stream;
+        off_t offset;
+        off_t dropped;
+        uint64_t left;          /* Bytes of the list not read yet, at least */
+        size_t pos;
+        size_t end;
+        unsigned char *buf;
+} prv_reader_t;
+
+typedef struct {
+        prv_reader_t r;
+        prv_header_t hdr;
+        uint64_t index;
+        uint64_t databytes;
+        uint64_t checksum;
+        size_t recsize;
+        void *rec;
+} prv_stream_t;
+
+/* Where the external sort puts the sorted items, either a list or a file */
+typedef struct {
+        int tofile;
+        off_t start;
+        dll_list_t merged;
+        prv_header_t hdr;
+        prv_writer_t w;
+} prv_sink_t;
+
+typedef struct {
+        unsigned int n;
+        unsigned int size;
+        int *fds;
+} prv_runs_t;
+
+typedef struct {
+        dll_stream_iterator_t it;
+        void *data;
+        size_t size;
+} prv_mergerun_t;
+
+/* ######################################################################### */
+/*                           Private interface (Module)                      */
+/* ######################################################################### */
+
+static uint64_t prv_checksum(uint64_t sum, const void *data, size_t size);
+static void prv_put64(unsigned char *buf, uint64_t val);
+static uint64_t prv_get64(const unsigned char *buf);
+static void prv_header_encode(unsigned char *buf, const prv_header_t *hdr);
+static int prv_header_decode(const unsigned char *buf, prv_header_t *hdr);
+
+static int prv_write_all(int fd, const void *buf, size_t n);
+static int prv_writer_flush(prv_writer_t *w);
+static int prv_writer_put(prv_writer_t *w, const void *data, size_t n);
+static int prv_writer_putsize(prv_writer_t *w, size_t size);
+
+static int prv_extsort(int infd, prv_sink_t *sink, dll_fctcompare_t compar, const dll_extsort_opts_t *opts);
+static int prv_spill(dll_list_t *run, dll_fctcompare_t compar, const char *tmpdir, prv_runs_t *runs);
+static int prv_tmpfile(const char *tmpdir, int *fd);
+static int prv_merge(int *fds, unsigned int n, dll_fctcompare_t compar, prv_sink_t *sink);
+static void prv_siftdown(prv_mergerun_t *m, unsigned int *heap, unsigned int n, unsigned int i, dll_fctcompare_t compar);
+static int prv_sink_file(prv_sink_t *sink, int fd);
+static int prv_sink_put(prv_sink_t *sink, const void *data, size_t size);
+static int prv_sink_close(prv_sink_t *sink, dll_list_t *list, int rc);
+
+static void prv_reader_init(prv_reader_t *r, int fd, unsigned char *buf);
+static int prv_reader_header(prv_reader_t *r, prv_header_t *hdr);
+static void prv_reader_advance(prv_reader_t *r, size_t n);
+static int prv_reader_fill(prv_reader_t *r);
+static int prv_reader_get(prv_reader_t *r, void *dst, size_t n);
+static int prv_reader_getsize(prv_reader_t *r, size_t *size);
+
+/* ######################################################################### */
+/*                           Implementation                                  */
+/* ######################################################################### */
+
+int dll_save(dll_list_t *list, int fd)
+{
+        int rc;
+        dll_item_t *item;
+        prv_header_t hdr;
+        prv_writer_t w;
+        unsigned char hdrbuf[PRV_IO_HDRSIZE];
+
+        if (!list)
+                return EDLLINV;
+        if (fd < 0)
+                return EDLLINV;
+
+        /* The header goes first, so work out the checksum beforehand. That
+         * way the descriptor doesn't need to be seekable. */
+        hdr.count = list->count;
+        hdr.databytes = 0;
+        hdr.checksum = PRV_CHECKSUM_INIT;
+
+        for (item = list->first; item != NULL; item = item->next) {
+                hdr.databytes += item->datasize;
+                hdr.checksum = prv_checksum(hdr.checksum, item->data, item->datasize);
+        }
+
+        w.fd = fd;
+        w.used = 0;
+        w.buf = (unsigned char*)malloc(PRV_IO_BUFSIZE);
+        if (w.buf == NULL)
+                return EDLLNOMEM;
+
+        prv_header_encode(hdrbuf, &hdr);
+        rc = prv_writer_put(&w, hdrbuf, PRV_IO_HDRSIZE);
+
+        for (item = list->first; (item != NULL) && (rc == EDLLOK); item = item->next) {
+                rc = prv_writer_putsize(&w, item->datasize);
+                if (rc == EDLLOK)
+                        rc = prv_writer_put(&w, item->data, item->datasize);
+        }
+
+        if (rc == EDLLOK)
+                rc = prv_writer_flush(&w);
+
+        free(w.buf);
+
+        return rc;
+}
+
+int dll_load(dll_list_t *list, int fd)
+{
+        int rc;
+        uint64_t i, databytes, checksum;
+        size_t datasize, size;
+        char *pos = NULL, *end = NULL, *bigpos;
+        void *arena = NULL, *big;
+        dll_item_t *item;
+        dll_list_t loaded;
+        prv_header_t hdr;
+        prv_reader_t r;
+
+        if (!list)
+                return EDLLINV;
+        if (fd < 0)
+                return EDLLINV;
+
+        prv_reader_init(&r, fd, (unsigned char*)malloc(PRV_IO_BUFSIZE));
+        if (r.buf == NULL)
+                return EDLLNOMEM;
+
+        dll_init(&loaded);
+
+        rc = prv_reader_header(&r, &hdr);
+        if (rc != EDLLOK)
+                goto finish;
+
+        if (hdr.count > (uint64_t)(DLL_COUNT_MAX - list->count)) {
+                rc = EDLLINV;
+                goto finish;
+        }
+
+        databytes = 0;
+        checksum = PRV_CHECKSUM_INIT;
+
+        for (i=0; i<hdr.count; i++) {
+                rc = prv_reader_getsize(&r, &datasize);
+                if (rc != EDLLOK)
+                        break;
+
+                /* Never trust the file, nothing is allocated for a size
+                 * the header doesn't allow for */
+                databytes += datasize;
+                if (databytes > hdr.databytes) {
+                        rc = EDLLERROR;
+                        break;
+                }
+                if (datasize > SIZE_MAX - 2*PRV_LOAD_BLOCKSIZE) {
+                        rc = EDLLNOMEM;
+                        break;
+                }
+
+                /* Small data goes inline, like dll_append() does it */
+                if (datasize <= DLL_ITEM_INLINEMAX)
+                        size = dll_prv_arenachunk(DLL_ITEM_INLINEOFF + datasize);
+                else
+                        size = dll_prv_arenachunk(sizeof(dll_item_t)) + dll_prv_arenachunk(datasize);
+
+                /* Items which don't fit into a block get one of their own,
+                 * the current block is carried on with afterwards */
+                if (size > PRV_LOAD_BLOCKSIZE/4) {
+                        big = dll_prv_arenanew(size, &bigpos, NULL);
+                        if (big == NULL) {
+                                rc = EDLLNOMEM;
+                                break;
+                        }
+
+                        item = (dll_item_t*)dll_prv_arenatake(big, &bigpos, sizeof(dll_item_t));
+                        item->data = dll_prv_arenatake(big, &bigpos, datasize);
+                        item->flags = DLL_ITEM_ARENA|DLL_ITEM_ARENADATA;
+                } else {
+                        if (size > (size_t)(end - pos)) {
+                                arena = dll_prv_arenanew(PRV_LOAD_BLOCKSIZE, &pos, NULL);
+                                if (arena == NULL) {
+                                        rc = EDLLNOMEM;
+                                        break;
+                                }
+                                end = pos + PRV_LOAD_BLOCKSIZE;
+                        }
+
+                        if (datasize <= DLL_ITEM_INLINEMAX) {
+                                item = (dll_item_t*)dll_prv_arenatake(arena, &pos, DLL_ITEM_INLINEOFF + datasize);
+                                item->data = (char*)item + DLL_ITEM_INLINEOFF;
+                                item->flags = DLL_ITEM_ARENA|DLL_ITEM_INLINEDATA;
+                        } else {
+                                item = (dll_item_t*)dll_prv_arenatake(arena, &pos, sizeof(dll_item_t));
+                                item->data = dll_prv_arenatake(arena, &pos, datasize);
+                                item->flags = DLL_ITEM_ARENA|DLL_ITEM_ARENADATA;
+                        }
+                }
+
+                item->datasize = datasize;
+
+                item->next = NULL;
+                item->prev = loaded.last;
+                if (loaded.last != NULL)
+                        loaded.last->next = item;
+                else
+                        loaded.first = item;
+
+                loaded.last = item;
+                loaded.count++;
+
+                DLL_STATS_ITEMNEW(&loaded, item);
+                DLL_HOOK_ITEMALLOC(list, item);
+                DLL_HOOK_DATAALLOC(list, item);
+
+                rc = prv_reader_get(&r, item->data, datasize);
+                if (rc != EDLLOK)
+                        break;
+
+                checksum = prv_checksum(checksum, item->data, datasize);
+        }
+
+        if ((rc == EDLLOK) && ((databytes != hdr.databytes) || (checksum != hdr.checksum)))
+                rc = EDLLERROR;
+
+        if (rc == EDLLOK)
+                rc = dll_splice(list, &loaded);
+
+finish:
+        /* Nothing references the blocks unless the items made it into the
+         * list. A block goes with the last item in it. */
+        if (rc != EDLLOK) {
+                while (loaded.first != NULL) {
+                        item = loaded.first;
+                        loaded.first = item->next;
+
+                        dll_prv_datafree(list, item);
+                        dll_prv_itemfree(list, item);
+                }
+        }
+
+        free(r.buf);
+
+        return rc;
+}
+
+int dll_stream_iterator_init(dll_stream_iterator_t *iterator, int fd)
+{
+        int rc;
+        prv_stream_t *st;
+
+        if (!iterator)
+                return EDLLINV;
+        if (fd < 0)
+                return EDLLINV;
+
+        /* State and read buffer in one go */
+        st = (prv_stream_t*)malloc(sizeof(prv_stream_t) + PRV_IO_BUFSIZE);
+        if (st == NULL)
+                return EDLLNOMEM;
+
+        prv_reader_init(&st->r, fd, (unsigned char*)(st + 1));
+        st->r.stream = 1;
+        st->r.offset = lseek(fd, 0, SEEK_CUR);
+        st->r.dropped = st->r.offset;
+
+        /* Not a regular file, no need to give hints */
+        if (st->r.offset < 0)
+                st->r.stream = 0;
+#ifdef POSIX_FADV_SEQUENTIAL
+        if (st->r.stream)
+                posix_fadvise(fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+#endif
+
+        rc = prv_reader_header(&st->r, &st->hdr);
+        if (rc != EDLLOK) {
+                free(st);
+                return rc;
+        }
+
+        st->index = 0;
+        st->databytes = 0;
+        st->checksum = PRV_CHECKSUM_INIT;
+        st->recsize = 0;
+        st->rec = NULL;
+
+        iterator->flags = 0;
+        iterator->state = st;
+
+        return EDLLOK;
+}
+
+int dll_stream_iterator_next(dll_stream_iterator_t *iterator, void **data, size_t *datasize)
+{
+        int rc;
+        size_t size, recsize;
+        void *rec;
+        prv_stream_t *st;
+
+        if (!iterator)
+                return EDLLINV;
+        if (!iterator->state)
+                return EDLLINV;
+        if (!data)
+                return EDLLINV;
+
+        st = (prv_stream_t*)iterator->state;
+
+        if (st->index == st->hdr.count) {
+                if ((st->databytes != st->hdr.databytes) || (st->checksum != st->hdr.checksum))
+                        return EDLLERROR;
+                return EDLLTILT;
+        }
+
+        rc = prv_reader_getsize(&st->r, &size);
+        if (rc != EDLLOK)
+                return rc;
+
+        st->databytes += size;
+        if (st->databytes > st->hdr.databytes)
+                return EDLLERROR;
+
+        /* The item buffer only ever grows to the largest item. It's a
+         * separate allocation so the data comes back suitably aligned. */
+        if (size > st->recsize) {
+                recsize = (st->recsize == 0) ? 64 : st->recsize;
+                while (recsize < size)
+                        recsize = (recsize > SIZE_MAX/2) ? size : recsize*2;
+
+                rec = realloc(st->rec, recsize);
+                if (rec == NULL)
+                        return EDLLNOMEM;
+
+                st->rec = rec;
+                st->recsize = recsize;
+        }
+
+        rc = prv_reader_get(&st->r, st->rec, size);
+        if (rc != EDLLOK)
+                return rc;
+
+        st->checksum = prv_checksum(st->checksum, st->rec, size);
+        st->index++;
+
+        *data = st->rec;
+        if (datasize != NULL)
+                *datasize = size;
+
+        return EDLLOK;
+}
+
+int dll_stream_iterator_destroy(dll_stream_iterator_t *iterator)
+{
+        prv_stream_t *st;
+
+        if (!iterator)
+                return EDLLINV;
+        if (!iterator->state)
+                return EDLLINV;
+
+        st = (prv_stream_t*)iterator->state;
+        free(st->rec);
+        free(st);
+
+        iterator->state = NULL;
+
+        return EDLLOK;
+}
+
+int dll_extsort_file(int infd, int outfd, dll_fctcompare_t compar, const dll_extsort_opts_t *opts)
+{
+        int rc;
+        prv_sink_t sink;
+
+        if (infd < 0)
+                return EDLLINV;
+        if (outfd < 0)
+                return EDLLINV;
+        if (!compar)
+                return EDLLINV;
+
+        rc = prv_sink_file(&sink, outfd);
+        if (rc == EDLLOK)
+                rc = prv_extsort(infd, &sink, compar, opts);
+
+        return prv_sink_close(&sink, NULL, rc);
+}
+
+int dll_extsort_list(int infd, dll_list_t *list, dll_fctcompare_t compar, const dll_extsort_opts_t *opts)
+{
+        int rc;
+        prv_sink_t sink;
+
+        if (infd < 0)
+                return EDLLINV;
+        if (!list)
+                return EDLLINV;
+        if (!compar)
+                return EDLLINV;
+
+        /* Items are collected separately and only handed over if all went
+         * well */
+        sink.tofile = 0;
+        sink.w.buf = NULL;
+        dll_init(&sink.merged);
+
+        rc = prv_extsort(infd, &sink, compar, opts);
+
+        return prv_sink_close(&sink, list, rc);
+}
+
+/* 
+ * FNV style hash over 64 bit little endian words rather than single bytes.
+ * Each record's size is mixed in as well, so moving bytes from one record to
+ * the next is detected.
+ */
+static uint64_t prv_checksum(uint64_t sum, const void *data, size_t size)
+{
+        size_t i;
+        uint64_t word;
+        const unsigned char *p = (const unsigned char*)data;
+
+        sum = (sum ^ (uint64_t)size) * PRV_CHECKSUM_PRIME;
+
+        for (; size >= 8; size -= 8, p += 8) {
+                word = (uint64_t)p[0] | ((uint64_t)p[1] << 8) | 
+                        ((uint64_t)p[2] << 16) | ((uint64_t)p[3] << 24) | 
+                        ((uint64_t)p[4] << 32) | ((uint64_t)p[5] << 40) | 
+                        ((uint64_t)p[6] << 48) | ((uint64_t)p[7] << 56);
+                sum = (sum ^ word) * PRV_CHECKSUM_PRIME;
+        }
+
+        if (size > 0) {
+                word = 0;
+                for (i=0; i<size; i++)
+                        word |= (uint64_t)p[i] << (8*i);
+                sum = (sum ^ word) * PRV_CHECKSUM_PRIME;
+        }
+
+        return sum;
+}
+
+static void prv_put64(unsigned char *buf, uint64_t val)
+{
+        int i;
+
+        for (i=0; i<8; i++)
+                buf[i] = (unsigned char)(val >> (8*i));
+}
+
+static uint64_t prv_get64(const unsigned char *buf)
+{
+        int i;
+        uint64_t val = 0;
+
+        for (i=0; i<8; i++)
+                val |= (uint64_t)buf[i] << (8*i);
+
+        return val;
+}
+
+static void prv_header_encode(unsigned char *buf, const prv_header_t *hdr)
+{
+        memcpy(buf, PRV_IO_MAGIC, 4);
+        buf[4] = PRV_IO_VERSION;
+        buf[5] = buf[6] = buf[7] = 0;
+        prv_put64(buf+8, hdr->count);
+        prv_put64(buf+16, hdr->databytes);
+        prv_put64(buf+24, hdr->checksum);
+}
+
+static int prv_header_decode(const unsigned char *buf, prv_header_t *hdr)
+{
+        if (memcmp(buf, PRV_IO_MAGIC, 4) != 0)
+                return EDLLERROR;
+        if ((buf[4] != PRV_IO_VERSION) || buf[5] || buf[6] || buf[7])
+                return EDLLERROR;
+
+        hdr->count = prv_get64(buf+8);
+        hdr->databytes = prv_get64(buf+16);
+        hdr->checksum = prv_get64(buf+24);
+
+        return EDLLOK;
+}
+
+static int prv_write_all(int fd, const void *buf, size_t n)
+{
+        ssize_t written;
+        const char *p = (const char*)buf;
+
+        while (n > 0) {
+                written = write(fd, p, n);
+                if (written < 0) {
+                        if (errno == EINTR)
+                                continue;
+                        return EDLLIO;
+                }
+
+                p += written;
+                n -= (size_t)written;
+        }
+
+        return EDLLOK;
+}
+
+static int prv_writer_flush(prv_writer_t *w)
+{
+        int rc;
+
+        rc = prv_write_all(w->fd, w->buf, w->used);
+        w->used = 0;
+
+        return rc;
+}
+
+static int prv_writer_put(prv_writer_t *w, const void *data, size_t n)
+{
+        int rc;
+        ssize_t written;
+        size_t done;
+        struct iovec iov[2];
+
+        /* Small stuff is gathered in the buffer */
+        if (n <= PRV_IO_BUFSIZE/2) {
+                if (w->used + n > PRV_IO_BUFSIZE) {
+                        rc = prv_writer_flush(w);
+                        if (rc != EDLLOK)
+                                return rc;
+                }
+
+                memcpy(w->buf + w->used, data, n);
+                w->used += n;
+
+                return EDLLOK;
+        }
+
+        /* Big items are written together with whatever is buffered, without
+         * copying them first */
+        iov[0].iov_base = w->buf;
+        iov[0].iov_len = w->used;
+        iov[1].iov_base = (void*)data;
+        iov[1].iov_len = n;
+
+        do {
+                written = writev(w->fd, iov, 2);
+        } while ((written < 0) && (errno == EINTR));
+
+        if (written < 0)
+                return EDLLIO;
+
+        /* Short write, finish the job piecewise */
+        done = (size_t)written;
+        if (done < w->used) {
+                rc = prv_write_all(w->fd, w->buf + done, w->used - done);
+                if (rc == EDLLOK)
+                        rc = prv_write_all(w->fd, data, n);
+        } else {
+                done -= w->used;
+                rc = prv_write_all(w->fd, (const char*)data + done, n - done);
+        }
+
+        w->used = 0;
+
+        return rc;
+}
+
+static int prv_writer_putsize(prv_writer_t *w, size_t size)
+{
+        size_t n = 0;
+        unsigned char buf[16];
+
+        do {
+                buf[n] = (unsigned char)(size & 0x7f);
+                size >>= 7;
+                if (size != 0)
+                        buf[n] |= 0x80;
+                n++;
+        } while (size != 0);
+
+        return prv_writer_put(w, buf, n);
+}
+
+static int prv_extsort(int infd, prv_sink_t *sink, dll_fctcompare_t compar, const dll_extsort_opts_t *opts)
+{
+        int rc, fd, *fds;
+        unsigned int i, j, k, fanin;
+        size_t budget, used, size;
+        const char *tmpdir;
+        void *data = NULL, *itemdata = NULL;
+        dll_list_t run;
+        dll_iterator_t it;
+        dll_stream_iterator_t in;
+        prv_runs_t runs, merged;
+        prv_sink_t tmp;
+
+        budget = ((opts != NULL) && (opts->budget > 0)) ? opts->budget : DLL_EXTSORT_BUDGET;
+        tmpdir = (opts != NULL) ? opts->tmpdir : NULL;
+        if (tmpdir == NULL)
+                tmpdir = getenv("TMPDIR");
+        if (tmpdir == NULL)
+                tmpdir = "/tmp";
+
+        /* How many runs fit into memory for merging */
+        fanin = (budget / PRV_SORT_RUNCOST > UINT_MAX) ? UINT_MAX : (unsigned int)(budget / PRV_SORT_RUNCOST);
+        if (fanin < 2)
+                fanin = 2;
+
+        rc = dll_stream_iterator_init(&in, infd);
+        if (rc != EDLLOK)
+                return rc;
+
+        dll_init(&run);
+        runs.n = runs.size = 0;
+        runs.fds = NULL;
+        used = 0;
+
+        /* Cut the input into sorted runs */
+        for (;;) {
+                rc = dll_stream_iterator_next(&in, &data, &size);
+                if (rc == EDLLTILT) {
+                        rc = EDLLOK;
+                        break;
+                }
+                if (rc != EDLLOK)
+                        break;
+
+                if ((run.count > 0) && (used + PRV_SORT_ITEMCOST(size) > budget)) {
+                        rc = prv_spill(&run, compar, tmpdir, &runs);
+                        if (rc != EDLLOK)
+                                break;
+                        used = 0;
+                }
+
+                rc = dll_append(&run, &itemdata, size);
+                if (rc != EDLLOK)
+                        break;
+
+                memcpy(itemdata, data, size);
+                used += PRV_SORT_ITEMCOST(size);
+        }
+
+        dll_stream_iterator_destroy(&in);
+
+        if (rc != EDLLOK)
+                goto finish;
+
+        /* Everything fit, no need to go through files at all */
+        if (runs.n == 0) {
+                dll_sort(&run, compar);
+
+                if (!sink->tofile) {
+                        rc = dll_splice(&sink->merged, &run);
+                } else {
+                        dll_iterator_init(&it, &run);
+                        while ((rc == EDLLOK) && (dll_iterator_next(&it, &data, &size) == EDLLOK))
+                                rc = prv_sink_put(sink, data, size);
+                }
+
+                goto finish;
+        }
+
+        if (run.count > 0) {
+                rc = prv_spill(&run, compar, tmpdir, &runs);
+                if (rc != EDLLOK)
+                        goto finish;
+        }
+
+        /* Merge groups of runs into longer ones until they can all be
+         * merged at once. Groups are consecutive, so the sort stays
+         * stable. */
+        while (runs.n > fanin) {
+                merged.n = merged.size = 0;
+                merged.fds = NULL;
+
+                for (i=0; (i < runs.n) && (rc == EDLLOK); i += k) {
+                        k = (runs.n - i < fanin) ? runs.n - i : fanin;
+
+                        rc = prv_tmpfile(tmpdir, &fd);
+                        if (rc != EDLLOK)
+                                break;
+
+                        rc = prv_sink_file(&tmp, fd);
+                        if (rc == EDLLOK)
+                                rc = prv_merge(runs.fds + i, k, compar, &tmp);
+                        rc = prv_sink_close(&tmp, NULL, rc);
+
+                        if ((rc == EDLLOK) && (lseek(fd, 0, SEEK_SET) != 0))
+                                rc = EDLLIO;
+
+                        /* merged takes care of fd, even on failure */
+                        fds = (int*)realloc(merged.fds, (merged.n+1)*sizeof(int));
+                        if (fds == NULL) {
+                                close(fd);
+                                rc = EDLLNOMEM;
+                                break;
+                        }
+                        merged.fds = fds;
+                        merged.fds[merged.n++] = fd;
+                }
+
+                for (j=0; j<runs.n; j++)
+                        close(runs.fds[j]);
+                free(runs.fds);
+
+                runs = merged;
+                if (rc != EDLLOK)
+                        goto finish;
+        }
+
+        rc = prv_merge(runs.fds, runs.n, compar, sink);
+
+finish:
+        for (j=0; j<runs.n; j++)
+                close(runs.fds[j]);
+        free(runs.fds);
+
+        dll_clear(&run);
+
+        return rc;
+}
+
+static int prv_spill(dll_list_t *run, dll_fctcompare_t compar, const char *tmpdir, prv_runs_t *runs)
+{
+        int rc, fd, *fds;
+
+        dll_sort(run, compar);
+
+        rc = prv_tmpfile(tmpdir, &fd);
+        if (rc != EDLLOK)
+                return rc;
+
+        rc = dll_save(run, fd);
+        if ((rc == EDLLOK) && (lseek(fd, 0, SEEK_SET) != 0))
+                rc = EDLLIO;
+
+        if ((rc == EDLLOK) && (runs->n == runs->size)) {
+                fds = (int*)realloc(runs->fds, (runs->size ? runs->size*2 : 16)*sizeof(int));
+                if (fds != NULL) {
+                        runs->fds = fds;
+                        runs->size = runs->size ? runs->size*2 : 16;
+                } else {
+                        rc = EDLLNOMEM;
+                }
+        }
+
+        if (rc != EDLLOK) {
+                close(fd);
+                return rc;
+        }
+
+        runs->fds[runs->n++] = fd;
+        dll_clear(run);
+
+        return EDLLOK;
+}
+
+static int prv_tmpfile(const char *tmpdir, int *fd)
+{
+        char *path;
+
+        path = (char*)malloc(strlen(tmpdir) + sizeof("/dllsortXXXXXX"));
+        if (path == NULL)
+                return EDLLNOMEM;
+
+        /* Nobody else needs to see it, and it's gone once it's closed */
+        strcpy(path, tmpdir);
+        strcat(path, "/dllsortXXXXXX");
+
+        *fd = mkstemp(path);
+        if (*fd >= 0)
+                unlink(path);
+
+        free(path);
+
+        return (*fd >= 0) ? EDLLOK : EDLLIO;
+}
+
+static int prv_merge(int *fds, unsigned int n, dll_fctcompare_t compar, prv_sink_t *sink)
+{
+        int rc = EDLLOK;
+        unsigned int i, top, ninit = 0, nheap = 0;
+        unsigned int *heap;
+        prv_mergerun_t *m;
+
+        m = (prv_mergerun_t*)malloc(n*(sizeof(prv_mergerun_t) + sizeof(unsigned int)));
+        if (m == NULL)
+                return EDLLNOMEM;
+        heap = (unsigned int*)(m + n);
+
+        for (i=0; i<n; i++) {
+                rc = dll_stream_iterator_init(&m[i].it, fds[i]);
+                if (rc != EDLLOK)
+                        goto finish;
+                ninit++;
+
+                rc = dll_stream_iterator_next(&m[i].it, &m[i].data, &m[i].size);
+                if (rc == EDLLOK)
+                        heap[nheap++] = i;
+                else if (rc != EDLLTILT)
+                        goto finish;
+        }
+
+        rc = EDLLOK;
+
+        for (i=nheap/2; i>0; i--)
+                prv_siftdown(m, heap, nheap, i-1, compar);
+
+        /* Take the smallest item, refill from the run it came from */
+        while (nheap > 0) {
+                top = heap[0];
+
+                rc = prv_sink_put(sink, m[top].data, m[top].size);
+                if (rc != EDLLOK)
+                        break;
+
+                rc = dll_stream_iterator_next(&m[top].it, &m[top].data, &m[top].size);
+                if (rc == EDLLTILT) {
+                        heap[0] = heap[--nheap];
+                        rc = EDLLOK;
+                } else if (rc != EDLLOK) {
+                        break;
+                }
+
+                prv_siftdown(m, heap, nheap, 0, compar);
+        }
+
+finish:
+        for (i=0; i<ninit; i++)
+                dll_stream_iterator_destroy(&m[i].it);
+        free(m);
+
+        return rc;
+}
+
+static void prv_siftdown(prv_mergerun_t *m, unsigned int *heap, unsigned int n, unsigned int i, dll_fctcompare_t compar)
+{
+        int c;
+        unsigned int child, tmp;
+
+        /* Equal items are taken from the earlier run first */
+        for (;;) {
+                child = 2*i + 1;
+                if (child >= n)
+                        break;
+
+                if (child + 1 < n) {
+                        c = compar(m[heap[child+1]].data, m[heap[child]].data);
+                        if ((c < 0) || ((c == 0) && (heap[child+1] < heap[child])))
+                                child++;
+                }
+
+                c = compar(m[heap[child]].data, m[heap[i]].data);
+                if ((c > 0) || ((c == 0) && (heap[child] > heap[i])))
+                        break;
+
+                tmp = heap[i];
+                heap[i] = heap[child];
+                heap[child] = tmp;
+                i = child;
+        }
+}
+
+static int prv_sink_file(prv_sink_t *sink, int fd)
+{
+        unsigned char hdrbuf[PRV_IO_HDRSIZE];
+
+        /* The header is written last, once the checksum is known */
+        sink->tofile = 1;
+        sink->w.buf = NULL;
+        sink->start = lseek(fd, 0, SEEK_CUR);
+        if (sink->start < 0)
+                return EDLLINV;
+
+        sink->hdr.count = 0;
+        sink->hdr.databytes = 0;
+        sink->hdr.checksum = PRV_CHECKSUM_INIT;
+
+        sink->w.fd = fd;
+        sink->w.used = 0;
+        sink->w.buf = (unsigned char*)malloc(PRV_IO_BUFSIZE);
+        if (sink->w.buf == NULL)
+                return EDLLNOMEM;
+
+        memset(hdrbuf, 0, PRV_IO_HDRSIZE);
+
+        return prv_writer_put(&sink->w, hdrbuf, PRV_IO_HDRSIZE);
+}
+
+static int prv_sink_put(prv_sink_t *sink, const void *data, size_t size)
+{
+        int rc;
+        void *itemdata = NULL;
+
+        if (!sink->tofile) {
+                rc = dll_append(&sink->merged, &itemdata, size);
+                if (rc == EDLLOK)
+                        memcpy(itemdata, data, size);
+                return rc;
+        }
+
+        sink->hdr.count++;
+        sink->hdr.databytes += size;
+        sink->hdr.checksum = prv_checksum(sink->hdr.checksum, data, size);
+
+        rc = prv_writer_putsize(&sink->w, size);
+        if (rc == EDLLOK)
+                rc = prv_writer_put(&sink->w, data, size);
+
+        return rc;
+}
+
+static int prv_sink_close(prv_sink_t *sink, dll_list_t *list, int rc)
+{
+        ssize_t written;
+        size_t done = 0;
+        unsigned char hdrbuf[PRV_IO_HDRSIZE];
+
+        if (!sink->tofile) {
+                if (rc == EDLLOK)
+                        rc = dll_splice(list, &sink->merged);
+                dll_clear(&sink->merged);
+                return rc;
+        }
+
+        if (rc == EDLLOK)
+                rc = prv_writer_flush(&sink->w);
+
+        free(sink->w.buf);
+
+        if (rc != EDLLOK)
+                return rc;
+
+        prv_header_encode(hdrbuf, &sink->hdr);
+        while (done < PRV_IO_HDRSIZE) {
+                written = pwrite(sink->w.fd, hdrbuf + done, PRV_IO_HDRSIZE - done, sink->start + (off_t)done);
+                if (written < 0) {
+                        if (errno == EINTR)
+                                continue;
+                        return EDLLIO;
+                }
+                done += (size_t)written;
+        }
+
+        return EDLLOK;
+}
+
+static void prv_reader_init(prv_reader_t *r, int fd, unsigned char *buf)
+{
+        r->fd = fd;
+        r->stream = 0;
+        r->offset = 0;
+        r->dropped = 0;
+        r->left = PRV_IO_HDRSIZE;
+        r->pos = 0;
+        r->end = 0;
+        r->buf = buf;
+}
+
+/* Reads the header and bounds the reader by what it says. Every record is
+ * at least its data plus a single byte for its size. */
+static int prv_reader_header(prv_reader_t *r, prv_header_t *hdr)
+{
+        int rc;
+        unsigned char hdrbuf[PRV_IO_HDRSIZE];
+
+        rc = prv_reader_get(r, hdrbuf, PRV_IO_HDRSIZE);
+        if (rc == EDLLOK)
+                rc = prv_header_decode(hdrbuf, hdr);
+        if (rc != EDLLOK)
+                return rc;
+
+        if (hdr->count > UINT64_MAX - hdr->databytes)
+                return EDLLERROR;
+
+        r->left = hdr->count + hdr->databytes;
+
+        return EDLLOK;
+}
+
+static void prv_reader_advance(prv_reader_t *r, size_t n)
+{
+        r->offset += (off_t)n;
+        r->left -= n;
+        if (!r->stream)
+                return;
+
+        /* Whatever has been read won't be needed again */
+#ifdef POSIX_FADV_DONTNEED
+        if (r->offset - r->dropped >= PRV_IO_DROPSIZE) {
+                posix_fadvise(r->fd, r->dropped, r->offset - r->dropped, POSIX_FADV_DONTNEED);
+                r->dropped = r->offset;
+        }
+#endif
+}
+
+static int prv_reader_fill(prv_reader_t *r)
+{
+        ssize_t got;
+        size_t n;
+
+        /* Whatever follows the list is left alone */
+        if (r->left == 0)
+                return EDLLERROR;
+
+        n = (r->left < PRV_IO_BUFSIZE) ? (size_t)r->left : PRV_IO_BUFSIZE;
+
+        do {
+                got = read(r->fd, r->buf, n);
+        } while ((got < 0) && (errno == EINTR));
+
+        if (got < 0)
+                return EDLLIO;
+        if (got == 0)
+                return EDLLERROR;
+
+        r->pos = 0;
+        r->end = (size_t)got;
+        prv_reader_advance(r, r->end);
+
+        return EDLLOK;
+}
+
+static int prv_reader_get(prv_reader_t *r, void *dst, size_t n)
+{
+        int rc;
+        ssize_t got;
+        size_t avail;
+        char *p = (char*)dst;
+
+        for (;;) {
+                avail = r->end - r->pos;
+                if (avail >= n) {
+                        memcpy(p, r->buf + r->pos, n);
+                        r->pos += n;
+                        return EDLLOK;
+                }
+
+                memcpy(p, r->buf + r->pos, avail);
+                r->pos = r->end;
+                p += avail;
+                n -= avail;
+
+                if (n > r->left)
+                        return EDLLERROR;
+
+                /* Big chunks go straight to their destination */
+                while (n >= PRV_IO_BUFSIZE) {
+                        got = read(r->fd, p, n);
+                        if (got < 0) {
+                                if (errno == EINTR)
+                                        continue;
+                                return EDLLIO;
+                        }
+                        if (got == 0)
+                                return EDLLERROR;
+
+                        prv_reader_advance(r, (size_t)got);
+                        p += got;
+                        n -= (size_t)got;
+                }
+
+                if (n == 0)
+                        return EDLLOK;
+
+                rc = prv_reader_fill(r);
+                if (rc != EDLLOK)
+                        return rc;
+        }
+}
+
+static int prv_reader_getsize(prv_reader_t *r, size_t *size)
+{
+        int rc, shift = 0;
+        unsigned char byte;
+
+        *size = 0;
+
+        do {
+                if (shift >= (int)(sizeof(size_t)*8))
+                        return EDLLERROR;
+
+                if (r->pos < r->end) {
+                        byte = r->buf[r->pos++];
+                } else {
+                        rc = prv_reader_get(r, &byte, 1);
+                        if (rc != EDLLOK)
+                                return rc;
+                }
+
+                *size |= (size_t)(byte & 0x7f) << shift;
+                shift += 7;
+
+                /* The size was only counted as a single byte */
+                if (byte & 0x80)
+                        r->left++;
+        } while (byte & 0x80);
+
+        return EDLLOK;
+}
@@ -0,0 +1,211 @@
+/*
+* Copyright (c) 2008, Björn Rehm (bjoern@shugaa.de)
+* 
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+* 
+* The above copyright notice and this permission notice shall be included in
+* all copies or substantial portions of the Software.
+* 
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+* THE SOFTWARE.
+*/
+
+/** @file dll_io.h
+ *
+ * @brief Saving lists to and loading them from files
+ *
+ * */
+
+#ifndef _DLL_IO_H
+#define _DLL_IO_H
+
+#include "dll_list.h"
+
+/* ######################################################################### */
+/*                            TODO / Notes                                   */
+/* ######################################################################### */
+
+/*
+ * File format, all integers little endian:
+ *
+ *   magic      4 bytes   "DLLS"
+ *   version    4 bytes   1
+ *   count      8 bytes   Number of records
+ *   databytes  8 bytes   Sum of all record sizes
+ *   checksum   8 bytes   Checksum over all records
+ *
+ * followed by 'count' records, each of which is its size as an unsigned
+ * LEB128 varint followed by that many bytes of item data.
+ *
+ * Readers never read past the last record, so several lists can be saved
+ * one after another to the same descriptor and be read back in turn.
+ */
+
+/* ######################################################################### */
+/*                            Types & Defines                                */
+/* ######################################################################### */
+
+/** Stream iterator type */
+typedef struct dll_stream_iterator dll_stream_iterator_t;
+
+struct dll_stream_iterator
+{
+        int flags;
+        void *state;
+};
+
+/** External sort options type */
+typedef struct dll_extsort_opts dll_extsort_opts_t;
+
+struct dll_extsort_opts
+{
+        size_t budget;          /* Memory for sorting, 0 for DLL_EXTSORT_BUDGET */
+        const char *tmpdir;     /* Where runs go, NULL for $TMPDIR or /tmp */
+};
+
+/** Default memory budget of the external sort */
+#define DLL_EXTSORT_BUDGET      (256*1024*1024)
+
+/* ######################################################################### */
+/*                            Public interface                               */
+/* ######################################################################### */
+
+/** Write all items of a list to a file descriptor
+ *
+ * Item data is written as-is, so this is only useful for data which doesn't
+ * contain pointers. Output is gathered into large buffers, big items are
+ * written straight from the list. The descriptor doesn't need to be
+ * seekable.
+ *
+ * @param list       Pointer to the list
+ * @param fd         File descriptor open for writing
+ *
+ * @return EDLLOK    No errors occured
+ * @return EDLLINV   An invalid argument has been passed
+ * @return EDLLNOMEM Unable to allocate enough memory
+ * @return EDLLIO    Writing failed, errno tells why
+ * @return EDLLERROR Something went wrong
+ */
+int dll_save(dll_list_t *list, int fd);
+
+/** Read items written by dll_save() and append them to a list
+ *
+ * Item containers and data are allocated in blocks of a few hundred
+ * kilobytes (see dll_compact()), small data goes inline. A block is freed
+ * once the last item in it has been removed. The items are only appended
+ * once the whole list has been read and its checksum matched, the list is
+ * left untouched otherwise.
+ *
+ * @param list       Pointer to the list
+ * @param fd         File descriptor open for reading, positioned at the
+ *                   start of the saved list
+ *
+ * @return EDLLOK    No errors occured
+ * @return EDLLINV   An invalid argument has been passed
+ * @return EDLLNOMEM Unable to allocate enough memory
+ * @return EDLLIO    Reading failed, errno tells why
+ * @return EDLLERROR Not a valid file, truncated or checksum mismatch
+ */
+int dll_load(dll_list_t *list, int fd);
+
+/** Create an iterator over the items in a file written by dll_save()
+ *
+ * Items are read one at a time instead of being loaded into a list, memory
+ * use is bounded by a fixed size read buffer plus the largest item. The
+ * kernel is told that the file is read sequentially and data which has
+ * been passed over is dropped from the page cache, so files of any size
+ * can be processed.
+ *
+ * @param iterator   Pointer to a dll_stream_iterator_t to be initialized 
+ * @param fd         File descriptor open for reading, positioned at the
+ *                   start of the saved list
+ *
+ * @return EDLLOK    No errors occured
+ * @return EDLLINV   An invalid argument has been passed
+ * @return EDLLNOMEM Unable to allocate enough memory
+ * @return EDLLIO    Reading failed, errno tells why
+ * @return EDLLERROR Not a valid file
+ */
+int dll_stream_iterator_init(dll_stream_iterator_t *iterator, int fd);
+
+/** Read the next item from a stream iterator
+ *
+ * The data reference stays valid until the next call. Since the checksum
+ * covers the whole file, a damaged file is only detected at its end.
+ *
+ * @param iterator   The stream iterator
+ * @param data       Storage for the reference to this item's data
+ * @param datasize   Size of the data BLOB
+ *
+ * @return EDLLOK    No errors occured
+ * @return EDLLINV   An invalid argument has been passed
+ * @return EDLLTILT  All items have been read and the checksum matched
+ * @return EDLLNOMEM Unable to allocate enough memory for this item
+ * @return EDLLIO    Reading failed, errno tells why
+ * @return EDLLERROR Truncated file or checksum mismatch
+ */
+int dll_stream_iterator_next(dll_stream_iterator_t *iterator, void **data, size_t *datasize);
+
+/** Release a stream iterator
+ *
+ * The file descriptor is left open.
+ *
+ * @param iterator   The stream iterator
+ *
+ * @return EDLLOK    No errors occured
+ * @return EDLLINV   An invalid argument has been passed
+ */
+int dll_stream_iterator_destroy(dll_stream_iterator_t *iterator);
+
+/** Sort the items of a file written by dll_save() into another such file
+ *
+ * Meant for data sets which don't fit into memory. Items are read in runs
+ * which fit the memory budget, each run is sorted with dll_sort() and
+ * written to a temporary file, then all runs are merged into the output
+ * file. If there are too many runs to merge at once they're merged in
+ * several passes. Temporary files are unlinked right after they have been
+ * created, so nothing is left behind. The sort is stable.
+ *
+ * @param infd       File descriptor open for reading, positioned at the
+ *                   start of the saved list
+ * @param outfd      Seekable file descriptor open for writing
+ * @param compar     Pointer to function comparing two data items
+ * @param opts       Memory budget and temporary directory, or NULL
+ *
+ * @return EDLLOK    No errors occured
+ * @return EDLLINV   An invalid argument has been passed
+ * @return EDLLNOMEM Unable to allocate enough memory
+ * @return EDLLIO    Reading or writing a file failed, errno tells why
+ * @return EDLLERROR Input is not a valid file
+ */
+int dll_extsort_file(int infd, int outfd, dll_fctcompare_t compar, const dll_extsort_opts_t *opts);
+
+/** Sort the items of a file written by dll_save() and append them to a list
+ *
+ * Works like dll_extsort_file(), except the final merge appends to a list.
+ *
+ * @param infd       File descriptor open for reading, positioned at the
+ *                   start of the saved list
+ * @param list       List the sorted items are appended to
+ * @param compar     Pointer to function comparing two data items
+ * @param opts       Memory budget and temporary directory, or NULL
+ *
+ * @return EDLLOK    No errors occured
+ * @return EDLLINV   An invalid argument has been passed
+ * @return EDLLNOMEM Unable to allocate enough memory
+ * @return EDLLIO    Reading or writing a file failed, errno tells why
+ * @return EDLLERROR Input is not a valid file
+ */
+int dll_extsort_list(int infd, dll_list_t *list, dll_fctcompare_t compar, const dll_extsort_opts_t *opts);
+
+#endif /* _DLL_IO_H */
@@ -48,6 +48,8 @@ int dll_iterator_init(dll_iterator_t *iterator, dll_list_t *list)
         if (!list)
                 return EDLLINV; 
 
+        DLL_TRACE(DLL_TRACE_ITERINIT, iterator, list, 0, 0);
+
         /* Initialize the iterator */
         iterator->flags = 0;
         iterator->list = list;
@@ -65,6 +67,8 @@ int dll_iterator_next(dll_iterator_t *iterator, void **data, size_t *datasize)
         if (!data)
                 return EDLLINV;
 
+        DLL_TRACE(DLL_TRACE_ITERNEXT, iterator, NULL, 0, 0);
+
         if ((iterator->flags & DLL_ITERATOR_INIT) < DLL_ITERATOR_INIT) {
                 iterator->flags = DLL_ITERATOR_INIT;
                 iterator->item = iterator->list->first;
@@ -72,6 +76,7 @@ int dll_iterator_next(dll_iterator_t *iterator, void **data, size_t *datasize)
                 if (iterator->item == iterator->list->last) {
                         iterator->item = iterator->list->first;
                         ret = EDLLTILT;
+                        DLL_STATS_ADD(iterator->list, tilts, 1);
                 } else if (iterator->item != NULL) {
                         iterator->item = iterator->item->next;
                 }
@@ -96,6 +101,8 @@ int dll_iterator_prev(dll_iterator_t *iterator, void **data, size_t *datasize)
         if (!data)
                 return EDLLINV;
 
+        DLL_TRACE(DLL_TRACE_ITERPREV, iterator, NULL, 0, 0);
+
         if ((iterator->flags & DLL_ITERATOR_INIT) < DLL_ITERATOR_INIT) {
                 iterator->flags = DLL_ITERATOR_INIT;
                 iterator->item = iterator->list->last;
@@ -104,6 +111,7 @@ int dll_iterator_prev(dll_iterator_t *iterator, void **data, size_t *datasize)
                 if (iterator->item == iterator->list->first) {
                         iterator->item = iterator->list->last;
                         ret = EDLLTILT;
+                        DLL_STATS_ADD(iterator->list, tilts, 1);
                 } else if (iterator->item != NULL) {
                         iterator->item = iterator->item->prev;
                 }
@@ -119,3 +127,138 @@ int dll_iterator_prev(dll_iterator_t *iterator, void **data, size_t *datasize)
         return ret;
 }
 
+int dll_iterator_next_batch(dll_iterator_t *iterator, void **data, size_t *datasize, size_t n, size_t *got)
+{
+        int ret = EDLLOK;
+        size_t i;
+        dll_item_t *item, *last, *ahead;
+
+        if (!iterator)
+                return EDLLINV;
+        if (!data)
+                return EDLLINV;
+        if (!got)
+                return EDLLINV;
+        if (n == 0)
+                return EDLLINV;
+
+        DLL_TRACE(DLL_TRACE_ITERNEXTBATCH, iterator, NULL, n, 0);
+
+        *got = 0;
+        last = iterator->list->last;
+
+        /* Find the first item of this batch */
+        if ((iterator->flags & DLL_ITERATOR_INIT) < DLL_ITERATOR_INIT) {
+                iterator->flags = DLL_ITERATOR_INIT;
+                item = iterator->list->first;
+        } else if (iterator->item == last) {
+                item = iterator->list->first;
+                ret = EDLLTILT;
+                DLL_STATS_ADD(iterator->list, tilts, 1);
+        } else if (iterator->item != NULL) {
+                item = iterator->item->next;
+        } else {
+                item = NULL;
+        }
+
+        if (item == NULL)
+                return EDLLERROR;
+
+        /* Gather the batch. The caller is going to look at the payloads
+         * next, so get them on their way to the cache right now. Like
+         * DLL_FOREACH the containers DLL_PREFETCH_DISTANCE items ahead are
+         * requested while we chase the next pointers. */
+        ahead = item;
+        for (i=0; (i<DLL_PREFETCH_DISTANCE) && (ahead != NULL); i++) {
+                DLL_PREFETCH(ahead->data);
+                ahead = ahead->next;
+        }
+
+        for (i=0;;) {
+                if (DLL_PREFETCH_DISTANCE && (ahead != NULL)) {
+                        DLL_PREFETCH(ahead->data);
+                        DLL_PREFETCH(ahead->next);
+                        ahead = ahead->next;
+                }
+
+                data[i] = item->data;
+                if (datasize != NULL)
+                        datasize[i] = item->datasize;
+
+                if ((++i == n) || (item == last))
+                        break;
+
+                item = item->next;
+        }
+
+        iterator->item = item;
+        *got = i;
+
+        return ret;
+}
+
+int dll_iterator_prev_batch(dll_iterator_t *iterator, void **data, size_t *datasize, size_t n, size_t *got)
+{
+        int ret = EDLLOK;
+        size_t i;
+        dll_item_t *item, *first, *ahead;
+
+        if (!iterator)
+                return EDLLINV;
+        if (!data)
+                return EDLLINV;
+        if (!got)
+                return EDLLINV;
+        if (n == 0)
+                return EDLLINV;
+
+        DLL_TRACE(DLL_TRACE_ITERPREVBATCH, iterator, NULL, n, 0);
+
+        *got = 0;
+        first = iterator->list->first;
+
+        /* Find the first item of this batch */
+        if ((iterator->flags & DLL_ITERATOR_INIT) < DLL_ITERATOR_INIT) {
+                iterator->flags = DLL_ITERATOR_INIT;
+                item = iterator->list->last;
+        } else if (iterator->item == first) {
+                item = iterator->list->last;
+                ret = EDLLTILT;
+                DLL_STATS_ADD(iterator->list, tilts, 1);
+        } else if (iterator->item != NULL) {
+                item = iterator->item->prev;
+        } else {
+                item = NULL;
+        }
+
+        if (item == NULL)
+                return EDLLERROR;
+
+        ahead = item;
+        for (i=0; (i<DLL_PREFETCH_DISTANCE) && (ahead != NULL); i++) {
+                DLL_PREFETCH(ahead->data);
+                ahead = ahead->prev;
+        }
+
+        for (i=0;;) {
+                if (DLL_PREFETCH_DISTANCE && (ahead != NULL)) {
+                        DLL_PREFETCH(ahead->data);
+                        DLL_PREFETCH(ahead->prev);
+                        ahead = ahead->prev;
+                }
+
+                data[i] = item->data;
+                if (datasize != NULL)
+                        datasize[i] = item->datasize;
+
+                if ((++i == n) || (item == first))
+                        break;
+
+                item = item->prev;
+        }
+
+        iterator->item = item;
+        *got = i;
+
+        return ret;
+}
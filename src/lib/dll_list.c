@@ -22,10 +22,15 @@
 
 #include <string.h>
 #include <stdlib.h>
+#include <stdint.h>
 
 #include "dll_list.h"
 #include "dll_list_prv.h"
 
+#ifdef DLL_HAVE_MALLOC_USABLE_SIZE
+#include <malloc.h>
+#endif
+
 /* ######################################################################### */
 /*                            TODO / Notes                                   */
 /* ######################################################################### */
@@ -34,18 +39,44 @@
 /*                            Types & Defines                                */
 /* ######################################################################### */
 
+/** dll_merge_k() keeps its heap on the stack for up to this many lists */
+#define PRV_MERGE_STACKHEAP     (64)
+
+/** A list being merged by dll_merge_k(), its next item and where it's from */
+typedef struct {
+        dll_item_t *item;
+        dll_item_t *last;
+        unsigned int src;
+} prv_mergehead_t;
+
 /* ######################################################################### */
 /*                           Private interface (Module)                      */
 /* ######################################################################### */
 
-static int prv_quicksort(dll_list_t *list, dll_fctcompare_t compar, unsigned int lo, unsigned int hi);
-static int prv_newitem(dll_item_t **item, size_t datasize);
+static void prv_merge(dll_list_t *list, dll_list_t *lext, dll_fctcompare_t compar);
+static void prv_heapdown(dll_list_t *list, prv_mergehead_t *heap, unsigned int n, unsigned int i, dll_fctcompare_t compar);
+static void *prv_linkmerge(void *a, void *b, dll_prv_linksort_t *sort);
+static void *prv_linkkey(void *node, const dll_prv_linksort_t *sort);
+static void *prv_getlink(const void *node, size_t off, const char *base);
+static void prv_setlink(void *node, size_t off, void *link, const char *base);
+static int prv_newitem(dll_list_t *list, dll_item_t **item, size_t datasize, size_t inlinemax);
+static int prv_insertafter(dll_list_t *list, dll_item_t *prev, dll_item_t **item, size_t datasize, size_t inlinemax);
+static void prv_unlink(dll_list_t *list, dll_item_t *item);
+static dll_count_t prv_position(dll_list_t *list, dll_item_t *item);
+static void prv_blockfree(dll_item_t *item);
 
 /* Reimplement these for custom memory management */
 static void *prv_malloc(size_t size);
+static dll_item_t *prv_itemmalloc(size_t size);
+static void *prv_datamalloc(size_t size, unsigned int *flags);
+static void prv_datamfree(void *data, unsigned int flags);
 static void prv_free(void *ptr);
 static void *prv_memcpy(void *dest, const void *src, size_t n);
 
+#ifdef DLL_ENABLE_STATS
+static size_t prv_usable(void *ptr, size_t size);
+#endif
+
 /* ######################################################################### */
 /*                           Implementation                                  */
 /* ######################################################################### */
@@ -55,19 +86,34 @@ int dll_init(dll_list_t *list)
         if (!list)
                 return EDLLINV;
 
+        DLL_TRACE(DLL_TRACE_INIT, list, NULL, 0, 0);
+
         /* Initialize the new list */
         list->count = 0;
         list->first = NULL;
         list->last = NULL;
+        list->share = NULL;
+#ifdef DLL_ENABLE_STATS
+        memset(&list->stats, 0, sizeof(dll_stats_t));
+#endif
 
         return EDLLOK;
 }
 
 int dll_clear(dll_list_t *list)
 {
-        unsigned int i;
+        dll_count_t i;
         dll_item_t *itemcurrent, *itemnext;
 
+        DLL_TRACE(DLL_TRACE_CLEAR, list, NULL, 0, 0);
+
+        /* The items are freed along with the last list sharing them */
+        if (list->share != NULL) {
+                dll_prv_release(list);
+                DLL_STATS_SET(list, bytes, 0);
+                return EDLLOK;
+        }
+
         /* Free each item's data member and each container item itself */
         itemcurrent = list->first;
         for (i=0; i<(list->count); i++)
@@ -76,12 +122,15 @@ int dll_clear(dll_list_t *list)
                  * has been freed */
                 itemnext = itemcurrent->next;
 
-                prv_free(itemcurrent->data);
-                prv_free(itemcurrent);
+                dll_prv_datafree(list, itemcurrent);
+                dll_prv_itemfree(list, itemcurrent);
 
                 itemcurrent = itemnext;
         }
 
+        DLL_STATS_ADD(list, frees, list->count);
+        DLL_STATS_SET(list, bytes, 0);
+
         list->count = 0;
         list->first = NULL;
         list->last = NULL;
@@ -100,11 +149,18 @@ int dll_append(dll_list_t *list, void **data, size_t datasize)
         if(!data)
                 return EDLLINV;
 
+        DLL_TRACE(DLL_TRACE_APPEND, list, NULL, 0, datasize);
+
+        if ((list->share != NULL) && (dll_prv_unshare(list) != EDLLOK))
+                return EDLLNOMEM;
+
         /* Make a new item */
-        rc = prv_newitem(&itemnew, datasize);
+        rc = prv_newitem(list, &itemnew, datasize, DLL_ITEM_INLINEMAX);
         if (rc != EDLLOK)
                 return EDLLNOMEM;
 
+        DLL_STATS_ITEMNEW(list, itemnew);
+
         /* newitem is now the last element in the list */
         itemnew->prev = list->last;
 
@@ -161,10 +217,196 @@ int dll_extend(dll_list_t *list, dll_list_t *lext)
         return EDLLOK;
 }
 
-int dll_insert(dll_list_t *list, void **data, size_t datasize, unsigned int position)
+int dll_splice(dll_list_t *list, dll_list_t *lext)
+{
+        /* Basic checks */
+        if (!list)
+                return EDLLINV;
+        if (!lext)
+                return EDLLINV;
+        if (list == lext)
+                return EDLLINV;
+
+        DLL_TRACE(DLL_TRACE_SPLICE, list, lext, 0, 0);
+
+        /* Nothing to do, good for us */
+        if (lext->count == 0)
+                return EDLLOK;
+
+        if ((list->share != NULL) && (dll_prv_unshare(list) != EDLLOK))
+                return EDLLNOMEM;
+        if ((lext->share != NULL) && (dll_prv_unshare(lext) != EDLLOK))
+                return EDLLNOMEM;
+
+        /* Hook the extension's chain onto our last item */
+        if (list->count == 0) {
+                list->first = lext->first;
+        } else {
+                list->last->next = lext->first;
+                lext->first->prev = list->last;
+        }
+
+        list->last = lext->last;
+        list->count += lext->count;
+
+        DLL_STATS_ADD(list, bytes, lext->stats.bytes);
+        DLL_STATS_SET(lext, bytes, 0);
+
+        /* The items belong to list now */
+        lext->count = 0;
+        lext->first = NULL;
+        lext->last = NULL;
+
+        return EDLLOK;
+}
+
+int dll_merge(dll_list_t *list, dll_list_t *lext, dll_fctcompare_t compar)
+{
+        if (!list)
+                return EDLLINV;
+        if (!lext)
+                return EDLLINV;
+        if (list == lext)
+                return EDLLINV;
+        if (!compar)
+                return EDLLINV;
+
+        DLL_TRACE(DLL_TRACE_MERGE, list, lext, 0, 0);
+
+        if (lext->count == 0)
+                return EDLLOK;
+
+        if ((list->share != NULL) && (dll_prv_unshare(list) != EDLLOK))
+                return EDLLNOMEM;
+        if ((lext->share != NULL) && (dll_prv_unshare(lext) != EDLLOK))
+                return EDLLNOMEM;
+
+        prv_merge(list, lext, compar);
+
+        list->count += lext->count;
+
+        DLL_STATS_ADD(list, bytes, lext->stats.bytes);
+        DLL_STATS_SET(lext, bytes, 0);
+
+        lext->count = 0;
+        lext->first = NULL;
+        lext->last = NULL;
+
+        return EDLLOK;
+}
+
+int dll_merge_k(dll_list_t *list, dll_list_t *lists[], unsigned int k, dll_fctcompare_t compar)
+{
+        prv_mergehead_t stackheap[PRV_MERGE_STACKHEAP+1], *heap;
+        dll_item_t *head, *tail, *e;
+        unsigned int i, n;
+
+        if (!list)
+                return EDLLINV;
+        if ((k > 0) && !lists)
+                return EDLLINV;
+        if (!compar)
+                return EDLLINV;
+
+        for (i=0; i<k; i++) {
+                if ((lists[i] == NULL) || (lists[i] == list))
+                        return EDLLINV;
+        }
+
+        /* Two lists are better off without the heap */
+        if (k <= 1)
+                return (k == 0) ? EDLLOK : dll_merge(list, lists[0], compar);
+
+        /* Traced as the pairwise merges it is equivalent to */
+        for (i=0; i<k; i++)
+                DLL_TRACE(DLL_TRACE_MERGE, list, lists[i], 0, 0);
+
+        heap = stackheap;
+        if (k > PRV_MERGE_STACKHEAP) {
+                heap = (prv_mergehead_t*)prv_malloc((k+1)*sizeof(prv_mergehead_t));
+                if (heap == NULL)
+                        return EDLLNOMEM;
+        }
+
+        if ((list->share != NULL) && (dll_prv_unshare(list) != EDLLOK))
+                goto nomem;
+        for (i=0; i<k; i++) {
+                if ((lists[i]->share != NULL) && (dll_prv_unshare(lists[i]) != EDLLOK))
+                        goto nomem;
+        }
+
+        /* The list merged into counts as source 0, the others follow in
+         * order. Equal items are taken from the lowest source first. */
+        n = 0;
+        if (list->first != NULL) {
+                heap[n].item = list->first;
+                heap[n].last = list->last;
+                heap[n++].src = 0;
+        }
+        for (i=0; i<k; i++) {
+                if (lists[i]->first == NULL)
+                        continue;
+
+                heap[n].item = lists[i]->first;
+                heap[n].last = lists[i]->last;
+                heap[n++].src = i+1;
+
+                list->count += lists[i]->count;
+                DLL_STATS_ADD(list, bytes, lists[i]->stats.bytes);
+                DLL_STATS_SET(lists[i], bytes, 0);
+
+                lists[i]->count = 0;
+                lists[i]->first = NULL;
+                lists[i]->last = NULL;
+        }
+
+        for (i=n/2; i>0; i--)
+                prv_heapdown(list, heap, n, i-1, compar);
+
+        /* Keep taking the smallest head. Once one list is left, the rest of
+         * it goes on in one piece. */
+        head = tail = NULL;
+        while (n > 0) {
+                e = heap[0].item;
+                if (tail != NULL)
+                        tail->next = e;
+                else
+                        head = e;
+                e->prev = tail;
+                tail = e;
+
+                if (n == 1) {
+                        tail = heap[0].last;
+                        break;
+                }
+
+                if (e->next != NULL)
+                        heap[0].item = e->next;
+                else
+                        heap[0] = heap[--n];
+
+                prv_heapdown(list, heap, n, 0, compar);
+        }
+
+        list->first = head;
+        list->last = tail;
+
+        if (heap != stackheap)
+                prv_free(heap);
+
+        return EDLLOK;
+
+nomem:
+        if (heap != stackheap)
+                prv_free(heap);
+
+        return EDLLNOMEM;
+}
+
+int dll_insert(dll_list_t *list, void **data, size_t datasize, dll_count_t position)
 {
         int rc;
-        unsigned int i;
+        dll_count_t i;
         dll_item_t *itemnew = NULL;
         dll_item_t *itemseek = NULL;
 
@@ -174,11 +416,20 @@ int dll_insert(dll_list_t *list, void **data, size_t datasize, unsigned int posi
         if (position > list->count)
                 return EDLLINV;
 
+        DLL_TRACE(DLL_TRACE_INSERT, list, NULL, position, datasize);
+
+        if ((list->share != NULL) && (dll_prv_unshare(list) != EDLLOK))
+                return EDLLNOMEM;
+
         /* Create a new item */
-        rc = prv_newitem(&itemnew, datasize);
+        rc = prv_newitem(list, &itemnew, datasize, DLL_ITEM_INLINEMAX);
         if (rc != EDLLOK)
                 return EDLLNOMEM;
 
+        DLL_STATS_ITEMNEW(list, itemnew);
+        DLL_STATS_SEEK(list, (position > 0) ? position-1 : 0);
+        DLL_HOOK_SEEK(list, position, (position > 0) ? position-1 : 0);
+
         /* Seek to item position, which is prev for our new item */
         itemseek = list->first; 
         for (i=1; i<position; i++)
@@ -218,9 +469,9 @@ int dll_insert(dll_list_t *list, void **data, size_t datasize, unsigned int posi
         return EDLLOK;
 }
 
-int dll_remove(dll_list_t *list, unsigned int position)
+int dll_remove(dll_list_t *list, dll_count_t position)
 {
-        unsigned int i;
+        dll_count_t i;
         dll_item_t *itemseek = NULL;
 
         /* Basic secrity precautions */
@@ -229,38 +480,54 @@ int dll_remove(dll_list_t *list, unsigned int position)
         if (position >= list->count)
                 return EDLLINV;
 
+        DLL_TRACE(DLL_TRACE_REMOVE, list, NULL, position, 0);
+
+        if ((list->share != NULL) && (dll_prv_unshare(list) != EDLLOK))
+                return EDLLNOMEM;
+
+        DLL_STATS_SEEK(list, position);
+        DLL_HOOK_SEEK(list, position, position);
+
         /* Seek to item position */
         itemseek = list->first; 
         for (i=0; i<position; i++)
                 itemseek = itemseek->next;
 
-        /* Adjust first/last pointers if necessary */
-        if (position == 0)
-                list->first = itemseek->next;
-        if (position == (list->count-1))
-                list->last = itemseek->prev;
+        prv_unlink(list, itemseek);
 
-        /* Remove the item (interconnect it's prev and next neighbours) */
-        if (itemseek->prev != NULL)
-                itemseek->prev->next = itemseek->next;
-        if (itemseek->next != NULL)
-                itemseek->next->prev = itemseek->prev;
+        return EDLLOK;
+}
 
-        /* Free the item */
-        if (itemseek->data != NULL)
-                prv_free(itemseek->data);
+int dll_remove_item(dll_list_t *list, dll_item_t *item)
+{
+        dll_count_t position;
+
+        if (!list)
+                return EDLLINV;
+        if (!item)
+                return EDLLINV;
 
-        prv_free(itemseek);
+        DLL_TRACE(DLL_TRACE_REMOVE, list, NULL, prv_position(list, item), 0);
 
-        list->count--;
+        /* Unsharing replaces the containers, look the item up again */
+        if (list->share != NULL) {
+                position = prv_position(list, item);
+                if (dll_prv_unshare(list) != EDLLOK)
+                        return EDLLNOMEM;
+
+                for (item = list->first; position > 0; position--)
+                        item = item->next;
+        }
+
+        prv_unlink(list, item);
 
         return EDLLOK;
 }
 
-int dll_get(dll_list_t *list, void **data, size_t *datasize, unsigned int position)
+int dll_get(dll_list_t *list, void **data, size_t *datasize, dll_count_t position)
 {
         int rc;
-        unsigned int i;
+        dll_count_t i;
         void *itemseek = NULL;
         dll_iterator_t it;
 
@@ -280,6 +547,9 @@ int dll_get(dll_list_t *list, void **data, size_t *datasize, unsigned int positi
          * list we move either up or down. Using an iterator will be slightly
          * slower than accessing the list containers directly by their prev and
          * next handles but it makes the code easier to read imho. */
+        DLL_STATS_SEEK(list, (position < (list->count/2)) ? position : list->count-position-1);
+        DLL_HOOK_SEEK(list, position, (position < (list->count/2)) ? position : list->count-position-1);
+
         if (position < (list->count/2)) {
             for (i=0; i<(position+1); i++) {
                 rc = dll_iterator_next(&it, &itemseek, datasize);
@@ -303,13 +573,15 @@ int dll_get(dll_list_t *list, void **data, size_t *datasize, unsigned int positi
         return EDLLOK;
 }
 
-int dll_count(dll_list_t *list, unsigned int *count)
+int dll_count(dll_list_t *list, dll_count_t *count)
 {
         if (!list)
                 return EDLLINV;
         if (!count)
                 return EDLLINV;
 
+        DLL_TRACE(DLL_TRACE_COUNT, list, NULL, 0, 0);
+
         *count = list->count;
 
         return EDLLOK;
@@ -340,18 +612,45 @@ int dll_deepcopy(dll_list_t *from, dll_list_t *to)
 
 int dll_sort(dll_list_t *list, dll_fctcompare_t compar)
 {
+        void *last;
+        dll_prv_linksort_t sort;
+
         if (!list)
                 return EDLLINV;
         if (!compar)
                 return EDLLINV;
 
-        return prv_quicksort(list, compar, 0, list->count-1);
+        DLL_TRACE(DLL_TRACE_SORT, list, NULL, 0, 0);
+
+        if ((list->share != NULL) && (dll_prv_unshare(list) != EDLLOK))
+                return EDLLNOMEM;
+
+        DLL_HOOK_LIST(sort_begin, list);
+
+        /* The comparator gets the data the items point to */
+        if (list->count >= 2) {
+                sort.nextoff = offsetof(dll_item_t, next);
+                sort.prevoff = offsetof(dll_item_t, prev);
+                sort.keyoff = offsetof(dll_item_t, data);
+                sort.deref = 1;
+                sort.base = NULL;
+                sort.compar = compar;
+                sort.compares = 0;
+
+                list->first = (dll_item_t*)dll_prv_linksort(list->first, &sort, &last);
+                list->last = (dll_item_t*)last;
+                DLL_STATS_ADD(list, compares, sort.compares);
+        }
+
+        DLL_HOOK_LIST(sort_end, list);
+
+        return EDLLOK;
 }
 
-int dll_indexof(dll_list_t *list, dll_fctcompare_t compar, void *cmpitem, unsigned int *index)
+int dll_indexof(dll_list_t *list, dll_fctcompare_t compar, void *cmpitem, dll_count_t *index)
 {
         int rc = EDLLERROR;
-        unsigned int i;
+        dll_count_t i;
         dll_iterator_t it;
         void *data;
 
@@ -363,6 +662,7 @@ int dll_indexof(dll_list_t *list, dll_fctcompare_t compar, void *cmpitem, unsign
         i = 0;
         dll_iterator_init(&it, list);
         while(dll_iterator_next(&it, &data, NULL) == EDLLOK) {
+                 DLL_STATS_ADD(list, compares, 1);
                  if (compar(data, cmpitem) == 0) {
                         rc = EDLLOK;
                         break;
@@ -381,238 +681,544 @@ int dll_indexof(dll_list_t *list, dll_fctcompare_t compar, void *cmpitem, unsign
 
 int dll_reverse(dll_list_t *list)
 {
-        int rc;
-        unsigned int upidx, downidx;
-        dll_iterator_t upit, downit;
-        void *datahi, *datalo;
+        dll_item_t *item, *itemtmp;
 
         if (!list)
                 return EDLLINV;
-        if (list->count <= 1)
-                return EDLLOK;
 
-        /* Create up and down iterators and move them to the first and last item
-         * respectively */
-        rc = dll_iterator_init(&upit, list);
-        if (rc != EDLLOK)
-                return EDLLERROR;
-        rc = dll_iterator_init(&downit, list);
-        if (rc != EDLLOK)
-                return EDLLERROR;
+        DLL_TRACE(DLL_TRACE_REVERSE, list, NULL, 0, 0);
 
-        rc = dll_iterator_next(&upit, &datalo, NULL);
-        if (rc != EDLLOK)
-                return EDLLERROR;
-        rc = dll_iterator_prev(&downit, &datahi, NULL);
-        if (rc != EDLLOK)
-                return EDLLERROR;
-
-        upidx = 0;
-        downidx = list->count-1;
-
-        do {
-                /* Replace up and down elements and move the iterators to the
-                 * next elements */
-                void *datatmp = upit.item->data;
-                upit.item->data = downit.item->data;
-                downit.item->data = datatmp;
+        if (list->count <= 1)
+                return EDLLOK;
 
-                rc = dll_iterator_next(&upit, &datalo, NULL);
-                if (rc != EDLLOK)
-                    break;
+        if ((list->share != NULL) && (dll_prv_unshare(list) != EDLLOK))
+                return EDLLNOMEM;
 
-                rc = dll_iterator_prev(&downit, &datahi, NULL);
-                if (rc != EDLLOK)
-                    break;
+        /* Swap each item's prev and next handles, data stays where it is */
+        item = list->first;
+        while (item != NULL) {
+                itemtmp = item->next;
+                item->next = item->prev;
+                item->prev = itemtmp;
 
-                upidx++;
-                downidx--;
-        } while (upidx < downidx);
+                item = itemtmp;
+        }
 
-        if (rc != EDLLOK)
-            return EDLLERROR;
+        itemtmp = list->first;
+        list->first = list->last;
+        list->last = itemtmp;
 
         return EDLLOK;
 }
 
-static int prv_quicksort(dll_list_t *list, dll_fctcompare_t compar, unsigned int lo, unsigned int hi)
+/* Linear merge of two sorted chains into list, lext's items go behind equal
+ * ones of list */
+static void prv_merge(dll_list_t *list, dll_list_t *lext, dll_fctcompare_t compar)
 {
-        int rc;
-        unsigned int upidx, downidx, i;
-        dll_iterator_t upit, downit;
-        dll_item_t *pivotitem;
-        void *datahi, *datalo;
-
-        /* 
-         * This function implements the quicksort algorithm presented in
-         * http://www.cise.ufl.edu/~ddd/cis3020/summer-97/lectures/lec17/sld001.htm
-         */
+        dll_item_t *p, *q, *e, *head, *tail;
 
-        /* 
-         * Some very basic security precautions.
-         * first == last
-         * first > last
-         */
-        if (hi <= lo)
-            return EDLLOK;
+        if (list->count == 0) {
+                list->first = lext->first;
+                list->last = lext->last;
+                return;
+        }
 
-        /* Up and down 'pointers' are lo and hi initially */
-        upidx = lo;
-        downidx = hi;
+        /* One list simply follows the other, e.g. consecutive partitions */
+        DLL_STATS_ADD(list, compares, 1);
+        if (compar(list->last->data, lext->first->data) <= 0) {
+                list->last->next = lext->first;
+                lext->first->prev = list->last;
+                list->last = lext->last;
+                return;
+        }
 
-        /* Create iterators and move to them to the respective lo hand hi
-         * indexes */
-        rc = dll_iterator_init(&upit, list);
-        if (rc != EDLLOK)
-                return EDLLERROR;
-        rc = dll_iterator_init(&downit, list);
-        if (rc != EDLLOK)
-                return EDLLERROR;
+        DLL_STATS_ADD(list, compares, 1);
+        if (compar(lext->last->data, list->first->data) < 0) {
+                lext->last->next = list->first;
+                list->first->prev = lext->last;
+                list->first = lext->first;
+                return;
+        }
 
-        /* Check whether it's better to move the iterator up or down to reach
-         * the desired element. This improves sort speeds tremendously (cuts
-         * sort times in half on my machine). We might actually try to build an
-         * index array of the list or something just for sorting but for now
-         * this is fine with me. */
-        if (lo < (list->count/2))
-                for (i=0;i<(lo+1);i++) {
-                        rc = dll_iterator_next(&upit, &datalo, NULL);
-                        if (rc != EDLLOK)
-                                break;
-                }
-        else
-                for (i=0;i<(list->count-lo);i++) { 
-                        rc = dll_iterator_prev(&upit, &datalo, NULL);
-                        if (rc != EDLLOK)
-                                break;
+        p = list->first;
+        q = lext->first;
+        head = tail = NULL;
+
+        while ((p != NULL) && (q != NULL)) {
+                if (compar(p->data, q->data) <= 0) {
+                        e = p; p = p->next;
+                } else {
+                        e = q; q = q->next;
                 }
+                DLL_STATS_ADD(list, compares, 1);
 
-        if (rc != EDLLOK)
-                return EDLLERROR;
+                if (tail != NULL)
+                        tail->next = e;
+                else
+                        head = e;
 
-        if (hi < (list->count/2))
-                for (i=0;i<(hi+1);i++) {
-                        rc = dll_iterator_next(&downit, &datahi, NULL);
-                        if (rc != EDLLOK)
-                                break;
-                }
-        else
-                for (i=0;i<(list->count-hi);i++) {
-                        rc = dll_iterator_prev(&downit, &datahi, NULL);
-                        if (rc != EDLLOK)
-                                break;
-                }
+                e->prev = tail;
+                tail = e;
+        }
 
-        if (rc != EDLLOK)
-                return EDLLERROR;
+        /* Whatever is left is in order already */
+        e = (p != NULL) ? p : q;
+        tail->next = e;
+        e->prev = tail;
 
-        /* lo is the pivot element. Beware: Client code should never use
-         * iterator instance internals! Do not take this as a good example. */
-        pivotitem = upit.item;
+        list->first = head;
+        if (p == NULL)
+                list->last = lext->last;
+}
 
-        for(;;) {
-                void *datatmp = NULL;
+/* Restore the heap property below i, smallest head on top. Ties go to the
+ * lower source, that's what keeps dll_merge_k() stable. */
+static void prv_heapdown(dll_list_t *list, prv_mergehead_t *heap, unsigned int n, unsigned int i, dll_fctcompare_t compar)
+{
+        prv_mergehead_t tmp;
+        unsigned int child, min;
+        int cmp;
 
-                /* Move up 'pointer' to an element >pivot */
-                for(;;) {
-                        /* End of partition */
-                        if (upidx == hi)
-                                break;
-                        /* Found */
-                        if (compar(datalo, pivotitem->data) > 0)
-                                break;
+        for (;;) {
+                min = i;
 
-                        rc = dll_iterator_next(&upit, &datalo, NULL);
-                        if (rc != EDLLOK)
-                                break;
+                for (child=2*i+1; (child <= 2*i+2) && (child < n); child++) {
+                        cmp = compar(heap[child].item->data, heap[min].item->data);
+                        DLL_STATS_ADD(list, compares, 1);
 
-                        upidx++;
+                        if ((cmp < 0) || ((cmp == 0) && (heap[child].src < heap[min].src)))
+                                min = child;
                 }
 
-                if (rc != EDLLOK)
-                        break;
+                if (min == i)
+                        return;
 
-                /* Move down 'pointer' to an element <= pivot */
-                for(;;) {
-                        /* End of partition */
-                        if (downidx == lo)
-                                break;
-                        /* Found */
-                        if (compar(datahi, pivotitem->data) <= 0)
-                                break;
+                tmp = heap[i];
+                heap[i] = heap[min];
+                heap[min] = tmp;
+                i = min;
+        }
+}
 
-                        rc = dll_iterator_prev(&downit, &datahi, NULL);
-                        if (rc != EDLLOK)
-                                break;
+void *dll_prv_linksort(void *first, dll_prv_linksort_t *sort, void **last)
+{
+        /* Up to 2^k nodes are merged in bins[k] */
+        void *bins[sizeof(dll_count_t)*8+1];
+        void *run, *next, *prev;
+        unsigned int k, top = 0;
+
+        /*
+         * Bottom-up merge sort which takes one node at a time. A run of 2^k
+         * nodes waits in bins[k] until another one of the same size comes
+         * along, the two are then merged and carried on to bins[k+1], much
+         * like adding one to a binary number. Every node is looked at once
+         * per level, there are no passes over the whole chain just to find
+         * the runs. Equal nodes keep their order, b's are only taken when
+         * they compare less than a's.
+         */
+        for (run = first; run != NULL; run = next) {
+                next = prv_getlink(run, sort->nextoff, sort->base);
+                prv_setlink(run, sort->nextoff, NULL, sort->base);
 
-                        downidx--;
+                for (k = 0; (k < top) && (bins[k] != NULL); k++) {
+                        run = prv_linkmerge(bins[k], run, sort);
+                        bins[k] = NULL;
                 }
+                if (k == top)
+                        top++;
+                bins[k] = run;
+        }
 
-                if (rc != EDLLOK)
-                        break;
+        run = NULL;
+        for (k = 0; k < top; k++)
+                if (bins[k] != NULL)
+                        run = (run == NULL) ? bins[k] : prv_linkmerge(bins[k], run, sort);
 
-                if (upidx < downidx) {
-                        /* If the two pointers have not passed each other
-                         * exchange their values. */
-                        datatmp = datalo;
-                        downit.item->data = datalo;
-                        upit.item->data = datahi;
-
-                        /* Prepare lo and hi data pointers for the next
-                         * iteration */
-                        datalo = datahi;
-                        datahi = datatmp;
-                } else {
-                        /* Otherwise exchange pivot and the value downidx is
-                         * pointing to */
-                        datatmp = downit.item->data;
-                        downit.item->data = pivotitem->data;
-                        pivotitem->data = datatmp;
+        /* Only the next links were kept up to date */
+        first = run;
+        for (prev = NULL; run != NULL; run = prv_getlink(run, sort->nextoff, sort->base)) {
+                prv_setlink(run, sort->prevoff, prev, sort->base);
+                prev = run;
+        }
+        *last = prev;
 
-                        break;
+        return first;
+}
+
+/* Merge two NULL terminated chains by their next links, a goes first on
+ * ties. Neither may be empty. */
+static void *prv_linkmerge(void *a, void *b, dll_prv_linksort_t *sort)
+{
+        void *head, *tail, *e;
+
+        for (head = tail = NULL; (a != NULL) && (b != NULL); tail = e) {
+                sort->compares++;
+                if (sort->compar(prv_linkkey(b, sort), prv_linkkey(a, sort)) < 0) {
+                        e = b;
+                        b = prv_getlink(b, sort->nextoff, sort->base);
+                } else {
+                        e = a;
+                        a = prv_getlink(a, sort->nextoff, sort->base);
                 }
+
+                if (tail != NULL)
+                        prv_setlink(tail, sort->nextoff, e, sort->base);
+                else
+                        head = e;
         }
+        prv_setlink(tail, sort->nextoff, (a != NULL) ? a : b, sort->base);
 
-        if (rc != EDLLOK)
-                return EDLLERROR;
+        return head;
+}
 
-        /* Recurse the two partitions that have been created */
-        if (lo != downidx)
-                rc = prv_quicksort(list, compar, lo, downidx-1);
-        
-        if (rc != EDLLOK)
-                return EDLLERROR;
+/* What the comparator gets for a node */
+static void *prv_linkkey(void *node, const dll_prv_linksort_t *sort)
+{
+        void *key;
 
-        if (hi != downidx)
-                rc = prv_quicksort(list, compar, downidx+1, hi);
+        if (!sort->deref)
+                return (char*)node + sort->keyoff;
 
-        if (rc != EDLLOK)
-                return EDLLERROR;
+        memcpy(&key, (char*)node + sort->keyoff, sizeof(void*));
 
-        return EDLLOK;
+        return key;
+}
+
+/* The links are whatever pointer type the nodes use, so they are only ever
+ * copied, never accessed as void pointers. Offsets are turned into
+ * addresses and back. */
+static void *prv_getlink(const void *node, size_t off, const char *base)
+{
+        void *link;
+        uint64_t linkoff;
+
+        if (base != NULL) {
+                memcpy(&linkoff, (const char*)node + off, sizeof(uint64_t));
+                return (linkoff != 0) ? (void*)(base + linkoff) : NULL;
+        }
+
+        memcpy(&link, (const char*)node + off, sizeof(void*));
+
+        return link;
+}
+
+static void prv_setlink(void *node, size_t off, void *link, const char *base)
+{
+        uint64_t linkoff;
+
+        if (base != NULL) {
+                linkoff = (link != NULL) ? (uint64_t)((char*)link - base) : 0;
+                memcpy((char*)node + off, &linkoff, sizeof(uint64_t));
+                return;
+        }
+
+        memcpy((char*)node + off, &link, sizeof(void*));
 }
 
-static int prv_newitem(dll_item_t **item, size_t datasize)
+static int prv_newitem(dll_list_t *list, dll_item_t **item, size_t datasize, size_t inlinemax)
 {
+        void *data;
+        unsigned int dataflags;
+
+        /* Small payloads come with the container, one allocation less */
+        if (datasize <= inlinemax) {
+                if ((*item = prv_itemmalloc(DLL_ITEM_INLINEOFF + datasize)) == NULL)
+                        return EDLLNOMEM;
+
+                (*item)->data = (char*)*item + DLL_ITEM_INLINEOFF;
+                (*item)->datasize = datasize;
+                (*item)->flags |= DLL_ITEM_INLINEDATA;
+
+                DLL_HOOK_ITEMALLOC(list, *item);
+                DLL_HOOK_DATAALLOC(list, *item);
+
+                return EDLLOK;
+        }
+
         /* Make a new item */
-        if ((*item = (dll_item_t*)prv_malloc(sizeof(dll_item_t))) == NULL)
+        if ((data = prv_datamalloc(datasize, &dataflags)) == NULL)
                 return EDLLNOMEM;
 
-        if (((*item)->data = prv_malloc(datasize)) == NULL) {
-                prv_free(*item);
+        if ((*item = prv_itemmalloc(sizeof(dll_item_t))) == NULL) {
+                prv_datamfree(data, dataflags);
                 return EDLLNOMEM;
         }
 
+        (*item)->data = data;
         (*item)->datasize = datasize;
+        (*item)->flags |= dataflags;
+
+        DLL_HOOK_ITEMALLOC(list, *item);
+        DLL_HOOK_DATAALLOC(list, *item);
 
         return EDLLOK;
 }
 
+static void prv_unlink(dll_list_t *list, dll_item_t *item)
+{
+        /* Adjust first/last pointers if necessary */
+        if (item == list->first)
+                list->first = item->next;
+        if (item == list->last)
+                list->last = item->prev;
+
+        /* Remove the item (interconnect it's prev and next neighbours) */
+        if (item->prev != NULL)
+                item->prev->next = item->next;
+        if (item->next != NULL)
+                item->next->prev = item->prev;
+
+        /* Free the item */
+        DLL_STATS_ITEMFREE(list, item);
+        dll_prv_datafree(list, item);
+        dll_prv_itemfree(list, item);
+
+        list->count--;
+}
+
+static dll_count_t prv_position(dll_list_t *list, dll_item_t *item)
+{
+        dll_count_t position = 0;
+        dll_item_t *itemseek;
+
+        for (itemseek = list->first; itemseek != item; itemseek = itemseek->next)
+                position++;
+
+        return position;
+}
+
+int dll_prv_insertafter(dll_list_t *list, dll_item_t *prev, dll_item_t **item, size_t datasize)
+{
+        return prv_insertafter(list, prev, item, datasize, DLL_ITEM_INLINEMAX);
+}
+
+int dll_prv_emplace(dll_list_t *list, dll_item_t **item, size_t datasize, int front)
+{
+        if (!list)
+                return EDLLINV;
+        if (!item)
+                return EDLLINV;
+
+        if ((list->share != NULL) && (dll_prv_unshare(list) != EDLLOK))
+                return EDLLNOMEM;
+
+        return prv_insertafter(list, front ? NULL : list->last, item, datasize, DLL_ITEM_EMPLACEMAX);
+}
+
+static int prv_insertafter(dll_list_t *list, dll_item_t *prev, dll_item_t **item, size_t datasize, size_t inlinemax)
+{
+        dll_count_t position;
+        dll_item_t *itemnew = NULL;
+
+        if (DLL_UNLIKELY(dll_prv_tracing)) {
+                if (prev == NULL)
+                        position = 0;
+                else if (prev == list->last)
+                        position = list->count;
+                else
+                        position = prv_position(list, prev)+1;
+                DLL_TRACE(DLL_TRACE_INSERT, list, NULL, position, datasize);
+        }
+
+        if (prv_newitem(list, &itemnew, datasize, inlinemax) != EDLLOK)
+                return EDLLNOMEM;
+
+        DLL_STATS_ITEMNEW(list, itemnew);
+
+        itemnew->prev = prev;
+        itemnew->next = (prev != NULL) ? prev->next : list->first;
+
+        if (itemnew->next != NULL)
+                itemnew->next->prev = itemnew;
+        else
+                list->last = itemnew;
+
+        if (prev != NULL)
+                prev->next = itemnew;
+        else
+                list->first = itemnew;
+
+        list->count++;
+
+        *item = itemnew;
+
+        return EDLLOK;
+}
+
+void dll_prv_itemfree(dll_list_t *list, dll_item_t *item)
+{
+        DLL_HOOK_MEM(item_free, list, item, DLL_ITEM_HEADSIZE(item));
+
+        /* Inline data goes with the container, unless containers hosting it
+         * (see DLL_ITEM_HOST) still need it. Then the last one frees the
+         * block. */
+        if (item->flags & DLL_ITEM_INLINEDATA) {
+                if ((item->flags & DLL_ITEM_SHAREDDATA) && !dll_prv_slotput(item->slot))
+                        return;
+
+                DLL_HOOK_MEM(data_free, list, item->data, item->datasize);
+        }
+
+        prv_blockfree(item);
+}
+
+void dll_prv_datafree(dll_list_t *list, dll_item_t *item)
+{
+        /* Freed along with the container */
+        if (item->flags & DLL_ITEM_INLINEDATA)
+                return;
+
+        /* Somebody else still needs it */
+        if ((item->flags & DLL_ITEM_SHAREDDATA) && !dll_prv_slotput(item->slot))
+                return;
+
+        DLL_HOOK_MEM(data_free, list, item->data, item->datasize);
+
+        /* The host's container is gone already, only its block is left */
+        if (item->flags & DLL_ITEM_HOSTEDDATA)
+                prv_blockfree(DLL_ITEM_HOST(item));
+        else if (item->flags & DLL_ITEM_ARENADATA)
+                dll_prv_arenarelease(item->data);
+#ifdef DLL_THREAD_CACHE
+        else if (item->flags & DLL_ITEM_TCACHEDATA)
+                dll_prv_tcachefree(item->data);
+#endif
+        else if (item->data != NULL)
+                prv_free(item->data);
+}
+
+/* Give a container's block back to wherever it came from */
+static void prv_blockfree(dll_item_t *item)
+{
+        if (item->flags & DLL_ITEM_ARENA)
+                dll_prv_arenarelease(item);
+#ifdef DLL_LARGE_LISTS
+        else if (item->flags & DLL_ITEM_SLAB)
+                dll_prv_slabfree(item);
+#endif
+#ifdef DLL_THREAD_CACHE
+        else if (item->flags & DLL_ITEM_TCACHE)
+                dll_prv_tcachefree(item);
+#endif
+        else
+                prv_free(item);
+}
+
+#ifdef DLL_ENABLE_STATS
+size_t dll_prv_itembytes(dll_item_t *item)
+{
+        size_t bytes;
+
+        if (item->flags & DLL_ITEM_ARENA)
+                bytes = dll_prv_arenachunk(DLL_ITEM_SIZE(item));
+        else if (item->flags & DLL_ITEM_SLAB)
+                bytes = DLL_SLAB_CHUNK;
+        else if (item->flags & DLL_ITEM_TCACHE)
+                bytes = DLL_TCACHE_CHUNK;
+        else
+                bytes = prv_usable(item, DLL_ITEM_SIZE(item));
+
+        if (item->flags & DLL_ITEM_INLINEDATA)
+                return bytes;
+
+        /* The host's block is counted as a whole with the data */
+        if (item->flags & DLL_ITEM_HOSTEDDATA)
+                bytes += DLL_ITEM_INLINEOFF + item->datasize;
+        else if (item->flags & DLL_ITEM_ARENADATA)
+                bytes += dll_prv_arenachunk(item->datasize);
+        else if (item->flags & DLL_ITEM_TCACHEDATA)
+                bytes += DLL_TCACHE_CHUNK;
+        else if (item->data != NULL)
+                bytes += prv_usable(item->data, item->datasize);
+
+        return bytes;
+}
+
+void dll_prv_statseek(dll_list_t *list, dll_count_t dist)
+{
+        list->stats.seeks++;
+        list->stats.seekdist += dist;
+        if (dist > list->stats.seekmax)
+                list->stats.seekmax = dist;
+}
+
+void dll_prv_statitem(dll_list_t *list, dll_item_t *item, int alloc)
+{
+        if (alloc) {
+                list->stats.allocs++;
+                list->stats.bytes += dll_prv_itembytes(item);
+        } else {
+                list->stats.frees++;
+                list->stats.bytes -= dll_prv_itembytes(item);
+        }
+}
+
+static size_t prv_usable(void *ptr, size_t size)
+{
+        /* Whatever the allocator really handed out plus its chunk header.
+         * Keep this in line with prv_malloc() if you replace it. */
+#ifdef DLL_HAVE_MALLOC_USABLE_SIZE
+        return malloc_usable_size(ptr) + sizeof(size_t);
+#else
+        return size + sizeof(size_t);
+#endif
+}
+#endif
+
 static void *prv_malloc(size_t size)
 {
         return malloc(size);
 }
 
+/* New item container with its flags set up, data is left to the caller */
+static dll_item_t *prv_itemmalloc(size_t size)
+{
+        dll_item_t *item;
+
+#if defined(DLL_THREAD_CACHE)
+        (void)size;
+        if ((item = (dll_item_t*)dll_prv_tcachealloc()) != NULL)
+                item->flags = DLL_ITEM_TCACHE;
+#elif defined(DLL_LARGE_LISTS)
+        (void)size;
+        if ((item = (dll_item_t*)dll_prv_slaballoc()) != NULL)
+                item->flags = DLL_ITEM_SLAB;
+#else
+        if ((item = (dll_item_t*)prv_malloc(size)) != NULL)
+                item->flags = 0;
+#endif
+
+        return item;
+}
+
+/* Out of line data, flags tell where it came from */
+static void *prv_datamalloc(size_t size, unsigned int *flags)
+{
+#ifdef DLL_THREAD_CACHE
+        if (size <= DLL_TCACHE_CHUNK) {
+                *flags = DLL_ITEM_TCACHEDATA;
+                return dll_prv_tcachealloc();
+        }
+#endif
+
+        *flags = 0;
+        return prv_malloc(size);
+}
+
+static void prv_datamfree(void *data, unsigned int flags)
+{
+#ifdef DLL_THREAD_CACHE
+        if (flags & DLL_ITEM_TCACHEDATA) {
+                dll_prv_tcachefree(data);
+                return;
+        }
+#else
+        (void)flags;
+#endif
+
+        prv_free(data);
+}
+
 static void prv_free(void *ptr)
 {
         free(ptr);
@@ -38,6 +38,9 @@
 #define _DLL_LIST_H
 
 #include <stdio.h>
+#include <limits.h>
+
+#include "dll_config.h"
 
 /* ######################################################################### */
 /*                            TODO / Notes                                   */
@@ -52,6 +55,16 @@
 #define EDLLTILT    (2)   /* Iterator turnaround */
 #define EDLLNOMEM   (3)   /* Unable to allocate enough memory */
 #define EDLLINV     (4)   /* Invalid argument */
+#define EDLLIO      (5)   /* Input/output error */
+
+/** Item counts and positions, size_t with DLL_LARGE_LISTS */
+#ifdef DLL_LARGE_LISTS
+typedef size_t dll_count_t;
+#define DLL_COUNT_MAX       ((size_t)-1)
+#else
+typedef unsigned int dll_count_t;
+#define DLL_COUNT_MAX       (UINT_MAX)
+#endif
 
 /** List item type */
 typedef struct dll_item dll_item_t;
@@ -62,11 +75,30 @@ typedef struct dll_list dll_list_t;
 /** List iterator type */
 typedef struct dll_iterator dll_iterator_t;
 
+/** List statistics type, see dll_stats_get() */
+typedef struct dll_stats dll_stats_t;
+
+struct dll_stats
+{
+        unsigned long allocs;   /* Items allocated */
+        unsigned long frees;    /* Items freed */
+        size_t bytes;           /* Bytes held by items and their data */
+        unsigned long seeks;    /* Positional lookups by get/insert/remove */
+        unsigned long seekdist; /* Items walked past by those lookups */
+        unsigned long seekmax;  /* Longest single walk */
+        unsigned long compares; /* Comparator calls by sort/indexof */
+        unsigned long tilts;    /* Iterator turnarounds */
+};
+
 struct dll_list
 {
-        unsigned int count;
+        dll_count_t count;
         dll_item_t *first;
         dll_item_t *last;
+        void *share;
+#ifdef DLL_ENABLE_STATS
+        dll_stats_t stats;
+#endif
 };
 
 struct dll_iterator
@@ -107,6 +139,12 @@ int dll_init(dll_list_t *list);
 int dll_clear(dll_list_t *list);
 
 /** Append an item to the end of the list
+ *
+ * Data of up to 16 bytes is stored along with the item container in a
+ * single allocation, larger data gets its own. Either way the reference is
+ * aligned like malloc()'s and stays valid until the item is removed (see
+ * DLL_COMPACT_INLINE, DLL_COMPACT_DATA and dll_unshare() for the
+ * exceptions).
  *
  * @param list       Pointer to the list
  * @param data       Where to store the reference to the allocated memory
@@ -129,6 +167,58 @@ int dll_append(dll_list_t *list, void **data, size_t datasize);
  */
 int dll_extend(dll_list_t *list, dll_list_t *lext);
 
+/** Move all items of another list to the end of a list
+ *
+ * Unlike dll_extend() no data is copied, the item containers are relinked
+ * in constant time. lext is empty afterwards.
+ *
+ * @param list       Pointer to the list to be extended
+ * @param lext       Pointer to the list whose items are moved
+ *
+ * @return EDLLOK    No errors occured
+ * @return EDLLINV   An invalid argument has been passed
+ * @return EDLLERROR Something went wrong
+ */
+int dll_splice(dll_list_t *list, dll_list_t *lext);
+
+/** Merge a sorted list into another sorted list
+ *
+ * Both lists have to be sorted according to compar already. The item
+ * containers are relinked in O(n+m) without allocating anything, equal
+ * items of lext go behind those of list. If one list simply continues the
+ * other it takes two comparisons. lext is empty afterwards.
+ *
+ * @param list       Pointer to the sorted list to merge into
+ * @param lext       Pointer to the sorted list whose items are moved
+ * @param compar     Pointer to function comparing two data items
+ *
+ * @return EDLLOK    No errors occured
+ * @return EDLLINV   An invalid argument has been passed
+ * @return EDLLNOMEM Unable to allocate enough memory (shared lists only)
+ * @return EDLLERROR Something went wrong
+ */
+int dll_merge(dll_list_t *list, dll_list_t *lext, dll_fctcompare_t compar);
+
+/** Merge k sorted lists into a sorted list
+ *
+ * Like calling dll_merge() for each of lists in turn, but a min-heap over
+ * the lists' heads takes O(n log k) comparisons for n items in total. Equal
+ * items keep the order of list, lists[0], lists[1] and so on. The lists
+ * have to be distinct, they are all empty afterwards. The heap lives on the
+ * stack for up to 64 lists.
+ *
+ * @param list       Pointer to the sorted list to merge into
+ * @param lists      Array of k pointers to sorted lists whose items are moved
+ * @param k          Number of lists
+ * @param compar     Pointer to function comparing two data items
+ *
+ * @return EDLLOK    No errors occured
+ * @return EDLLINV   An invalid argument has been passed
+ * @return EDLLNOMEM Unable to allocate enough memory
+ * @return EDLLERROR Something went wrong
+ */
+int dll_merge_k(dll_list_t *list, dll_list_t *lists[], unsigned int k, dll_fctcompare_t compar);
+
 /** Insert a new item into the list at the specified position
  *
  * @param list       Pointer to the list
@@ -140,7 +230,7 @@ int dll_extend(dll_list_t *list, dll_list_t *lext);
  * @return EDLLINV   An invalid argument has been passed
  * @return EDLLERROR Something went wrong
  */
-int dll_insert(dll_list_t *list, void **data, size_t datasize, unsigned int position);
+int dll_insert(dll_list_t *list, void **data, size_t datasize, dll_count_t position);
 
 /** Remove a specific item from the list
  *
@@ -151,7 +241,22 @@ int dll_insert(dll_list_t *list, void **data, size_t datasize, unsigned int posi
  * @return EDLLINV   An invalid argument has been passed
  * @return EDLLERROR Something went wrong
  */
-int dll_remove(dll_list_t *list, unsigned int position);
+int dll_remove(dll_list_t *list, dll_count_t position);
+
+/** Remove the item a cursor is on
+ *
+ * Unlike dll_remove() this doesn't need to seek, the item is taken out in
+ * constant time. The item must belong to the list, see dll_inline.h for how
+ * to get hold of one. Cursors on the item are invalid afterwards.
+ *
+ * @param list       Pointer to the list
+ * @param item       Pointer to the item to be removed
+ *
+ * @return EDLLOK    No errors occured
+ * @return EDLLINV   An invalid argument has been passed
+ * @return EDLLNOMEM Unable to allocate enough memory
+ */
+int dll_remove_item(dll_list_t *list, dll_item_t *item);
 
 /** Get an item from the list
  *
@@ -164,18 +269,18 @@ int dll_remove(dll_list_t *list, unsigned int position);
  * @return EDLLINV   An invalid argument has been passed
  * @return EDLLERROR Something went wrong
  */
-int dll_get(dll_list_t *list, void **data, size_t *datasize, unsigned int position);
+int dll_get(dll_list_t *list, void **data, size_t *datasize, dll_count_t position);
 
 /** Get the current item count of the list
  *
  * @param list       Pointer to the list
- * @param count      Pointer to an unsigned int to store the count in
+ * @param count      Pointer to a dll_count_t to store the count in
  *
  * @return EDLLOK    No errors occured
  * @return EDLLINV   An invalid argument has been passed
  * @return EDLLERROR Something went wrong
  */
-int dll_count(dll_list_t *list, unsigned int *count);
+int dll_count(dll_list_t *list, dll_count_t *count);
 
 /** Make a deep copy of a list
  *
@@ -188,7 +293,49 @@ int dll_count(dll_list_t *list, unsigned int *count);
  */
 int dll_deepcopy(dll_list_t *from, dll_list_t *to);
 
+/** Take a snapshot of a list in constant time
+ *
+ * Both lists share all item containers and data afterwards. Whichever of
+ * them is modified first (adding, removing or relinking items) gets its own
+ * copy of the containers, the data stays shared until the last list
+ * referring to it is done with it. This goes for small data stored inline
+ * with its container (see dll_append()) as well. So any number of
+ * snapshots of a list which doesn't change take up hardly any memory, and
+ * one which does change costs a copy of the containers only.
+ *
+ * Item data is not copied on write, the library can't tell when it's being
+ * written to. Call dll_unshare() on a list before modifying its items'
+ * data in place. Snapshots may be used and cleared from other threads
+ * than the list they were taken from.
+ *
+ * @param from       List to take the snapshot of
+ * @param to         List instance to hold the snapshot (needs to be initialised and empty)
+ *
+ * @return EDLLOK    No errors occured
+ * @return EDLLINV   An invalid argument has been passed
+ * @return EDLLNOMEM Unable to allocate enough memory
+ * @return EDLLERROR Something went wrong
+ */
+int dll_snapshot(dll_list_t *from, dll_list_t *to);
+
+/** Give a list its own copy of everything it shares with snapshots
+ *
+ * Copies the item containers and the data still shared with other lists,
+ * after which the item data can be written to safely. References to data
+ * which had to be copied are invalid afterwards.
+ *
+ * @param list       Pointer to the list
+ *
+ * @return EDLLOK    No errors occured
+ * @return EDLLINV   An invalid argument has been passed
+ * @return EDLLNOMEM Unable to allocate enough memory
+ * @return EDLLERROR Something went wrong
+ */
+int dll_unshare(dll_list_t *list);
+
 /** Reverse a list
+ *
+ * The item containers are relinked, references to item data stay valid.
  *
  * @param list       Pointer to the list
  *
@@ -199,7 +346,10 @@ int dll_deepcopy(dll_list_t *from, dll_list_t *to);
 int dll_reverse(dll_list_t *list);
 
 /** Sort a doubly linked list
- * This implementation uses quicksort which is fast and in-place 
+ * This implementation uses a bottom-up merge sort which relinks the item
+ * containers in place. It is stable, needs no extra memory and runs in
+ * O(n log n) regardless of the input order. References to item data stay
+ * valid.
  *
  * @param list       List to be sorted
  * @param compar     Pointer to function comparing two data items
@@ -221,7 +371,7 @@ int dll_sort(dll_list_t *list, dll_fctcompare_t compar);
  * @return EDLLINV   An invalid argument has been passed
  * @return EDLLERROR Something went wrong / Item not found
  */
-int dll_indexof(dll_list_t *list, dll_fctcompare_t compar, void *cmpitem, unsigned int *index);
+int dll_indexof(dll_list_t *list, dll_fctcompare_t compar, void *cmpitem, dll_count_t *index);
 
 /** Create a new doubly-linked list iterator instance
  *
@@ -272,5 +422,48 @@ int dll_iterator_next(dll_iterator_t *iterator, void **data, size_t *datasize);
  */
 int dll_iterator_prev(dll_iterator_t *iterator, void **data, size_t *datasize);
 
+/** Move the iterator forward by up to n items at once
+ *
+ * Fills the caller's arrays with the data references (and sizes) of the next
+ * n items, stopping early at the end of the list. This is a lot cheaper than
+ * calling dll_iterator_next() n times and the payloads of the returned items
+ * are prefetched while the batch is being gathered. The iterator is left on
+ * the last item returned, so dll_iterator_next() and batch calls can be
+ * mixed.
+ *
+ * If the iterator is already on the last item the batch starts over at the
+ * first item and EDLLTILT is returned, just like dll_iterator_next() does.
+ *
+ * @param iterator   The iterator which is to be moved forward
+ * @param data       Array of at least n entries for the data references
+ * @param datasize   Array of at least n entries for the data sizes, or NULL
+ * @param n          Maximum number of items to return
+ * @param got        Where to store the number of items actually returned
+ *
+ * @return EDLLOK    No errors occured
+ * @return EDLLINV   An invalid argument has been passed
+ * @return EDLLTILT  Iterator turnaround (jump from last to first item)
+ * @return EDLLERROR Something went wrong
+ */
+int dll_iterator_next_batch(dll_iterator_t *iterator, void **data, size_t *datasize, size_t n, size_t *got);
+
+/** Move the iterator backward by up to n items at once
+ *
+ * Works like dll_iterator_next_batch() in the opposite direction, items are
+ * returned in reverse list order.
+ *
+ * @param iterator   The iterator which is to be moved backward
+ * @param data       Array of at least n entries for the data references
+ * @param datasize   Array of at least n entries for the data sizes, or NULL
+ * @param n          Maximum number of items to return
+ * @param got        Where to store the number of items actually returned
+ *
+ * @return EDLLOK    No errors occured
+ * @return EDLLINV   An invalid argument has been passed
+ * @return EDLLTILT  Iterator turnaround (jump from first to last item)
+ * @return EDLLERROR Something went wrong
+ */
+int dll_iterator_prev_batch(dll_iterator_t *iterator, void **data, size_t *datasize, size_t n, size_t *got);
+
 #endif /* _DLL_LIST_H */
 
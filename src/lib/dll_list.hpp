@@ -0,0 +1,406 @@
+/*
+* Copyright (c) 2008, Björn Rehm (bjoern@shugaa.de)
+* 
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+* 
+* The above copyright notice and this permission notice shall be included in
+* all copies or substantial portions of the Software.
+* 
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+* THE SOFTWARE.
+*/
+
+/** @file dll_list.hpp
+ *
+ * @brief Header-only C++ interface
+ *
+ * */
+
+#ifndef _DLL_LIST_HPP
+#define _DLL_LIST_HPP
+
+#include <cstddef>
+#include <iterator>
+#include <new>
+#include <type_traits>
+#include <utility>
+#include <initializer_list>
+
+extern "C" {
+#include "dll_list.h"
+#include "dll_inline.h"
+
+/* From dll_list_prv.h, which isn't installed */
+int dll_prv_emplace(dll_list_t *list, dll_item_t **item, size_t datasize, int front);
+}
+
+/* ######################################################################### */
+/*                            TODO / Notes                                   */
+/* ######################################################################### */
+
+/*
+ * dll::list<T> keeps each element in the data BLOB of its item, so it is
+ * constructed in place and never copied in or out through a void pointer.
+ * Everything but sort() goes through the C functions, sort() is the merge
+ * sort of dll_prv_linksort() (dll_list.c) instantiated for the comparator
+ * so the compiler is free to inline it.
+ *
+ * Elements of any size are stored right behind their item container, in
+ * one allocation (see dll_prv_emplace()). Builds with DLL_LARGE_LISTS or
+ * DLL_THREAD_CACHE take containers from fixed size chunks, there elements
+ * larger than 16 bytes get an allocation of their own like with
+ * dll_append().
+ *
+ * The underlying dll_list_t is available through native() for read-only C
+ * code such as DLL_FOREACH or dll_save() of trivially copyable elements.
+ * Functions which copy or relocate payloads behind the back of T, i.e.
+ * dll_snapshot(), dll_compact() and dll_load(), must not be used on it
+ * unless T is trivially copyable.
+ */
+
+/* ######################################################################### */
+/*                            Types & Defines                                */
+/* ######################################################################### */
+
+namespace dll {
+
+template <typename T>
+class list
+{
+public:
+        typedef T value_type;
+        typedef T &reference;
+        typedef const T &const_reference;
+        typedef std::size_t size_type;
+        typedef std::ptrdiff_t difference_type;
+
+        template <typename V>
+        class basic_iterator
+        {
+        public:
+                typedef std::bidirectional_iterator_tag iterator_category;
+                typedef T value_type;
+                typedef std::ptrdiff_t difference_type;
+                typedef V *pointer;
+                typedef V &reference;
+
+                basic_iterator() : item(NULL), owner(NULL) {}
+                /* iterator converts to const_iterator, not the other way */
+                template <typename W>
+                basic_iterator(const basic_iterator<W> &other,
+                               typename std::enable_if<std::is_convertible<W*, V*>::value>::type* = 0)
+                        : item(other.item), owner(other.owner) {}
+
+                reference operator*() const { return *static_cast<V*>(item->data); }
+                pointer operator->() const { return static_cast<V*>(item->data); }
+
+                basic_iterator &operator++() { item = item->next; return *this; }
+                basic_iterator &operator--()
+                {
+                        /* end() has no item, stepping back from it gets
+                         * the last one */
+                        item = (item != NULL) ? item->prev : owner->last;
+                        return *this;
+                }
+                basic_iterator operator++(int) { basic_iterator tmp(*this); ++*this; return tmp; }
+                basic_iterator operator--(int) { basic_iterator tmp(*this); --*this; return tmp; }
+
+                template <typename W>
+                bool operator==(const basic_iterator<W> &other) const { return item == other.item; }
+                template <typename W>
+                bool operator!=(const basic_iterator<W> &other) const { return item != other.item; }
+
+        private:
+                friend class list;
+                template <typename W> friend class basic_iterator;
+
+                basic_iterator(dll_item_t *i, const dll_list_t *l) : item(i), owner(l) {}
+
+                dll_item_t *item;
+                const dll_list_t *owner;
+        };
+
+        typedef basic_iterator<T> iterator;
+        typedef basic_iterator<const T> const_iterator;
+        typedef std::reverse_iterator<iterator> reverse_iterator;
+        typedef std::reverse_iterator<const_iterator> const_reverse_iterator;
+
+/* ######################################################################### */
+/*                            Public interface                               */
+/* ######################################################################### */
+
+        list() { dll_init(&l); }
+
+        list(std::initializer_list<T> init)
+        {
+                dll_init(&l);
+                assign(init.begin(), init.end());
+        }
+
+        list(const list &other)
+        {
+                dll_init(&l);
+                assign(other.begin(), other.end());
+        }
+
+        /** Moving hands over the item chain, no element is touched */
+        list(list &&other) noexcept
+        {
+                l = other.l;
+                dll_init(&other.l);
+        }
+
+        ~list() { clear(); }
+
+        list &operator=(const list &other)
+        {
+                if (this != &other) {
+                        list tmp(other);
+                        swap(tmp);
+                }
+                return *this;
+        }
+
+        list &operator=(list &&other) noexcept
+        {
+                if (this != &other) {
+                        clear();
+                        l = other.l;
+                        dll_init(&other.l);
+                }
+                return *this;
+        }
+
+        void swap(list &other) noexcept
+        {
+                dll_list_t tmp = l;
+                l = other.l;
+                other.l = tmp;
+        }
+
+        /** Construct an element at the end of the list
+         *
+         * @return Reference to the new element
+         *
+         * @throw std::bad_alloc if the item can't be allocated, anything
+         *        T's constructor throws (the list is left unchanged)
+         */
+        template <typename... Args>
+        T &emplace_back(Args&&... args)
+        {
+                dll_item_t *item;
+
+                if (dll_prv_emplace(&l, &item, sizeof(T), 0) != EDLLOK)
+                        throw std::bad_alloc();
+
+                return construct(item, item->data, std::forward<Args>(args)...);
+        }
+
+        /** Construct an element at the front of the list
+         *
+         * @see emplace_back
+         */
+        template <typename... Args>
+        T &emplace_front(Args&&... args)
+        {
+                dll_item_t *item;
+
+                if (dll_prv_emplace(&l, &item, sizeof(T), 1) != EDLLOK)
+                        throw std::bad_alloc();
+
+                return construct(item, item->data, std::forward<Args>(args)...);
+        }
+
+        void push_back(const T &value) { emplace_back(value); }
+        void push_back(T &&value) { emplace_back(std::move(value)); }
+        void push_front(const T &value) { emplace_front(value); }
+        void push_front(T &&value) { emplace_front(std::move(value)); }
+
+        void pop_back() { destroy(l.last); }
+        void pop_front() { destroy(l.first); }
+
+        /** Remove an element in constant time
+         *
+         * @return Iterator to the element following the removed one
+         */
+        iterator erase(const_iterator pos)
+        {
+                dll_item_t *next = pos.item->next;
+
+                destroy(pos.item);
+
+                return iterator(next, &l);
+        }
+
+        void clear() noexcept
+        {
+                dll_cursor_t c;
+                void *data;
+
+                DLL_FOREACH(&l, c, data)
+                        static_cast<T*>(data)->~T();
+
+                dll_clear(&l);
+        }
+
+        /** Sort the list
+         *
+         * Stable merge sort which relinks the items, elements are neither
+         * copied nor moved. The comparator is a template argument so calls
+         * to it are inlined.
+         *
+         * @param less       Strict weak ordering, less(a, b) is true if a
+         *                   goes before b
+         */
+        template <typename Compare>
+        void sort(Compare less)
+        {
+                dll_item_t *bins[sizeof(size_type)*8];
+                dll_item_t *run, *next, *prev;
+                size_type k, top = 0;
+
+                if (l.count < 2)
+                        return;
+
+                /* Shared containers get relinked, make our own first */
+                if ((l.share != NULL) && (dll_unshare(&l) != EDLLOK))
+                        throw std::bad_alloc();
+
+                l.last->next = NULL;
+                for (run = l.first; run != NULL; run = next) {
+                        next = run->next;
+                        run->next = NULL;
+
+                        for (k = 0; (k < top) && (bins[k] != NULL); k++) {
+                                run = merge(bins[k], run, less);
+                                bins[k] = NULL;
+                        }
+                        if (k == top)
+                                top++;
+                        bins[k] = run;
+                }
+
+                run = NULL;
+                for (k = 0; k < top; k++)
+                        if (bins[k] != NULL)
+                                run = (run == NULL) ? bins[k] : merge(bins[k], run, less);
+
+                l.first = run;
+                prev = NULL;
+                for (; run != NULL; run = run->next) {
+                        run->prev = prev;
+                        prev = run;
+                }
+                l.last = prev;
+        }
+
+        /** Sort the list in ascending order using T's operator< */
+        void sort() { sort(less_than()); }
+
+        size_type size() const { return l.count; }
+        bool empty() const { return l.count == 0; }
+
+        T &front() { return *static_cast<T*>(l.first->data); }
+        const T &front() const { return *static_cast<const T*>(l.first->data); }
+        T &back() { return *static_cast<T*>(l.last->data); }
+        const T &back() const { return *static_cast<const T*>(l.last->data); }
+
+        iterator begin() { return iterator(l.first, &l); }
+        iterator end() { return iterator(NULL, &l); }
+        const_iterator begin() const { return const_iterator(l.first, &l); }
+        const_iterator end() const { return const_iterator(NULL, &l); }
+        const_iterator cbegin() const { return begin(); }
+        const_iterator cend() const { return end(); }
+        reverse_iterator rbegin() { return reverse_iterator(end()); }
+        reverse_iterator rend() { return reverse_iterator(begin()); }
+        const_reverse_iterator rbegin() const { return const_reverse_iterator(end()); }
+        const_reverse_iterator rend() const { return const_reverse_iterator(begin()); }
+
+        /** The underlying C list, see the notes at the top of this file */
+        dll_list_t *native() { return &l; }
+        const dll_list_t *native() const { return &l; }
+
+private:
+        struct less_than
+        {
+                bool operator()(const T &a, const T &b) const { return a < b; }
+        };
+
+        /* Constructors use this, the destructor doesn't run if they throw */
+        template <typename InputIt>
+        void assign(InputIt first, InputIt last)
+        {
+                try {
+                        for (; first != last; ++first)
+                                emplace_back(*first);
+                } catch (...) {
+                        clear();
+                        throw;
+                }
+        }
+
+        template <typename... Args>
+        T &construct(dll_item_t *item, void *data, Args&&... args)
+        {
+                try {
+                        return *::new(data) T(std::forward<Args>(args)...);
+                } catch (...) {
+                        dll_remove_item(&l, item);
+                        throw;
+                }
+        }
+
+        void destroy(dll_item_t *item)
+        {
+                static_cast<T*>(item->data)->~T();
+                dll_remove_item(&l, item);
+        }
+
+        /** Merge step of sort() */
+        template <typename Compare>
+        static dll_item_t *merge(dll_item_t *a, dll_item_t *b, Compare &less)
+        {
+                dll_item_t head;
+                dll_item_t *tail = &head;
+
+                while ((a != NULL) && (b != NULL)) {
+                        if (less(*static_cast<const T*>(b->data), *static_cast<const T*>(a->data))) {
+                                tail->next = b;
+                                b = b->next;
+                        } else {
+                                tail->next = a;
+                                a = a->next;
+                        }
+                        tail = tail->next;
+                }
+                tail->next = (a != NULL) ? a : b;
+
+                return head.next;
+        }
+
+        /* Payloads are aligned like malloc()'s, inline ones as well */
+        static_assert(alignof(T) <= alignof(std::max_align_t),
+                      "dll::list can't hold over-aligned types");
+
+        dll_list_t l;
+};
+
+template <typename T>
+inline void swap(list<T> &a, list<T> &b) noexcept
+{
+        a.swap(b);
+}
+
+} /* namespace dll */
+
+#endif /* _DLL_LIST_HPP */
@@ -29,6 +29,17 @@
 #ifndef _DLL_LIST_PRV_H
 #define _DLL_LIST_PRV_H
 
+#include <stddef.h>
+
+#include "dll_inline.h"
+#include "dll_hooks.h"
+#include "dll_trace.h"
+#include "dll_numa.h"
+
+#ifdef DLL_HAVE_SDT
+#include <sys/sdt.h>
+#endif
+
 /* ######################################################################### */
 /*                            TODO / Notes                                   */
 /* ######################################################################### */
@@ -37,20 +48,264 @@
 /*                            Types & Defines                                */
 /* ######################################################################### */
 
-/** The dll_item implementation can be hidden from the client, that's why it's
- * not been put into dll_list.h. Some parts of the library however need to know
- * about container internals (e.g. iterators) */
-struct dll_item
-{
-        void *data;
-        struct dll_item *prev;
-        struct dll_item *next;
-        size_t datasize;
-};
+/** Assumed cache line size, used to keep per-thread data apart */
+#define DLL_CACHELINE   (64)
+
+/** Alignment of everything handed out from a compaction arena */
+#define DLL_ARENA_ALIGN         (16)
+
+/* Item container flags, tell where the container and its data live */
+#define DLL_ITEM_ARENA          (1<<0)  /* Container lives in a compaction arena */
+#define DLL_ITEM_ARENADATA      (1<<1)  /* Data lives in a compaction arena */
+#define DLL_ITEM_SHAREDDATA     (1<<2)  /* Data is shared with snapshots, see slot */
+#define DLL_ITEM_INLINEDATA     (1<<3)  /* Data lives right behind the container */
+#define DLL_ITEM_SLAB           (1<<4)  /* Container comes from dll_prv_slaballoc() */
+#define DLL_ITEM_TCACHE         (1<<5)  /* Container comes from dll_prv_tcachealloc() */
+#define DLL_ITEM_TCACHEDATA     (1<<6)  /* Data comes from dll_prv_tcachealloc() */
+#define DLL_ITEM_HOSTEDDATA     (1<<7)  /* Data is inline data of another container */
+
+/** Payloads up to this many bytes share their container's allocation
+ * instead of getting their own */
+#ifndef DLL_ITEM_INLINEMAX
+#define DLL_ITEM_INLINEMAX      (16)
+#endif
+
+/** Where inline data starts, keeps it as aligned as malloc() would */
+#define DLL_ITEM_INLINEOFF \
+        ((sizeof(dll_item_t) + DLL_ARENA_ALIGN - 1) & ~((size_t)DLL_ARENA_ALIGN - 1))
+
+/** Size of the containers handed out by dll_prv_slaballoc(), every
+ * container fits */
+#define DLL_SLAB_CHUNK \
+        ((DLL_ITEM_INLINEOFF + DLL_ITEM_INLINEMAX + DLL_ARENA_ALIGN - 1) & ~((size_t)DLL_ARENA_ALIGN - 1))
+
+/** Size of the chunks handed out by dll_prv_tcachealloc(), every container
+ * fits as well as data up to this size */
+#define DLL_TCACHE_CHUNK        DLL_SLAB_CHUNK
+
+/** Largest data dll_prv_emplace() puts behind the container, the chunks
+ * containers come from in some builds don't take more than inline data */
+#if defined(DLL_THREAD_CACHE)
+#define DLL_ITEM_EMPLACEMAX     (DLL_TCACHE_CHUNK - DLL_ITEM_INLINEOFF)
+#elif defined(DLL_LARGE_LISTS)
+#define DLL_ITEM_EMPLACEMAX     (DLL_SLAB_CHUNK - DLL_ITEM_INLINEOFF)
+#else
+#define DLL_ITEM_EMPLACEMAX     ((size_t)-1 - DLL_ITEM_INLINEOFF)
+#endif
+
+/** The nodes dll_prv_linksort() sorts. Links are pointers to nodes, or
+ * with base set uint64_t offsets of nodes from there (0 ends the chain). */
+typedef struct {
+        size_t nextoff;         /* Where a node's next link is */
+        size_t prevoff;         /* Where its prev link is */
+        ptrdiff_t keyoff;       /* The comparator gets the node's address plus this, */
+        int deref;              /* or with deref set, the pointer stored there */
+        char *base;
+        dll_fctcompare_t compar;
+        unsigned long compares; /* Comparator calls made */
+} dll_prv_linksort_t;
+
+/** Words in a NUMA node mask */
+#define DLL_NUMA_WORDS          (DLL_NUMA_MAXNODES / (8*sizeof(unsigned long)))
+
+/** Where a block of memory goes, an mbind() mode and node mask */
+typedef struct {
+        int mode;
+        unsigned long mask[DLL_NUMA_WORDS];
+} dll_prv_place_t;
+
+/** Bytes taken up by an item container including inline data */
+#define DLL_ITEM_SIZE(item) \
+        (((item)->flags & DLL_ITEM_INLINEDATA) ? \
+         DLL_ITEM_INLINEOFF + (item)->datasize : sizeof(dll_item_t))
+
+/** Bytes of an item container without inline data, as the hooks see it */
+#define DLL_ITEM_HEADSIZE(item) \
+        (((item)->flags & DLL_ITEM_INLINEDATA) ? \
+         DLL_ITEM_INLINEOFF : sizeof(dll_item_t))
+
+/** The container whose block holds an item's hosted data. When a container
+ * with inline data is replaced by a copy on write (see dll_unshare()) the
+ * new one points to the old block, which is kept until the data is freed. */
+#define DLL_ITEM_HOST(item) \
+        ((dll_item_t*)((char*)(item)->data - DLL_ITEM_INLINEOFF))
+
+/* Atomic reference counting, the counts are only ever touched through these */
+#if defined(__GNUC__)
+#define DLL_ATOMIC_INC(ptr)     __atomic_add_fetch((ptr), 1, __ATOMIC_RELAXED)
+#define DLL_ATOMIC_DEC(ptr)     __atomic_sub_fetch((ptr), 1, __ATOMIC_ACQ_REL)
+#define DLL_ATOMIC_LOAD(ptr)    __atomic_load_n((ptr), __ATOMIC_ACQUIRE)
+#else
+#define DLL_ATOMIC_INC(ptr)     (++*(ptr))
+#define DLL_ATOMIC_DEC(ptr)     (--*(ptr))
+#define DLL_ATOMIC_LOAD(ptr)    (*(ptr))
+#endif
+
+#if defined(__GNUC__)
+#define DLL_UNLIKELY(x)         __builtin_expect(!!(x), 0)
+#else
+#define DLL_UNLIKELY(x)         (x)
+#endif
+
+/* Static tracepoints */
+#ifdef DLL_HAVE_SDT
+#define DLL_PROBE2(name, a, b)          DTRACE_PROBE2(libdll, name, a, b)
+#define DLL_PROBE3(name, a, b, c)       DTRACE_PROBE3(libdll, name, a, b, c)
+#define DLL_PROBE1(name, a)             DTRACE_PROBE1(libdll, name, a)
+#else
+#define DLL_PROBE2(name, a, b)          ((void)0)
+#define DLL_PROBE3(name, a, b, c)       ((void)0)
+#define DLL_PROBE1(name, a)             ((void)0)
+#endif
+
+/* Hooks, see dll_set_hooks(). Unset hooks have been replaced by stubs, so
+ * without hooks this is a single branch on dll_prv_hooks. */
+#define DLL_HOOK_MEM(hook, list, ptr, size) do { \
+                DLL_PROBE3(hook, (list), (ptr), (size)); \
+                if (DLL_UNLIKELY(dll_prv_hooks != NULL)) \
+                        dll_prv_hooks->hook(dll_prv_hooks->ctx, (list), (ptr), (size)); \
+        } while (0)
+#define DLL_HOOK_LIST(hook, list) do { \
+                DLL_PROBE1(hook, (list)); \
+                if (DLL_UNLIKELY(dll_prv_hooks != NULL)) \
+                        dll_prv_hooks->hook(dll_prv_hooks->ctx, (list)); \
+        } while (0)
+#define DLL_HOOK_SEEK(list, position, dist) do { \
+                DLL_PROBE3(seek, (list), (position), (dist)); \
+                if (DLL_UNLIKELY(dll_prv_hooks != NULL)) \
+                        dll_prv_hooks->seek(dll_prv_hooks->ctx, (list), (position), (dist)); \
+        } while (0)
+
+#define DLL_HOOK_ITEMALLOC(list, item) \
+        DLL_HOOK_MEM(item_alloc, (list), (item), DLL_ITEM_HEADSIZE(item))
+#define DLL_HOOK_DATAALLOC(list, item) \
+        DLL_HOOK_MEM(data_alloc, (list), (item)->data, (item)->datasize)
+
+/* Trace recording, see dll_trace_start(). Same deal as with the hooks. */
+#define DLL_TRACE(op, obj, other, arg, datasize) do { \
+                if (DLL_UNLIKELY(dll_prv_tracing)) \
+                        dll_prv_record((op), (obj), (other), (arg), (datasize)); \
+        } while (0)
+
+/* Statistics bookkeeping, none of the arguments are evaluated unless
+ * DLL_ENABLE_STATS is set */
+#ifdef DLL_ENABLE_STATS
+#define DLL_STATS_ADD(list, field, n)   ((list)->stats.field += (n))
+#define DLL_STATS_SUB(list, field, n)   ((list)->stats.field -= (n))
+#define DLL_STATS_SET(list, field, v)   ((list)->stats.field = (v))
+#define DLL_STATS_SEEK(list, dist)      dll_prv_statseek((list), (dist))
+#define DLL_STATS_ITEMNEW(list, item)   dll_prv_statitem((list), (item), 1)
+#define DLL_STATS_ITEMFREE(list, item)  dll_prv_statitem((list), (item), 0)
+#else
+#define DLL_STATS_ADD(list, field, n)   ((void)0)
+#define DLL_STATS_SUB(list, field, n)   ((void)0)
+#define DLL_STATS_SET(list, field, v)   ((void)0)
+#define DLL_STATS_SEEK(list, dist)      ((void)0)
+#define DLL_STATS_ITEMNEW(list, item)   ((void)0)
+#define DLL_STATS_ITEMFREE(list, item)  ((void)0)
+#endif
 
 /* ######################################################################### */
 /*                           Private interface (Lib)                         */
 /* ######################################################################### */
 
+/** Hooks currently set, NULL if there are none (dll_hooks.c) */
+extern const dll_hooks_t *dll_prv_hooks;
+
+/** Nonzero while operations are being recorded (dll_trace.c) */
+extern int dll_prv_tracing;
+
+/** Record an operation, other is the second list involved or NULL */
+void dll_prv_record(unsigned int op, const void *obj, const void *other, size_t arg, size_t datasize);
+
+/** Free an item container of a list, wherever it has been allocated */
+void dll_prv_itemfree(dll_list_t *list, dll_item_t *item);
+
+/** Free an item's data, wherever it has been allocated */
+void dll_prv_datafree(dll_list_t *list, dll_item_t *item);
+
+/** Make a new item and link it behind prev, or at the front if prev is
+ * NULL. The list must not be shared. */
+int dll_prv_insertafter(dll_list_t *list, dll_item_t *prev, dll_item_t **item, size_t datasize);
+
+/** Make a new item at the end of the list or at its front, with data of
+ * up to DLL_ITEM_EMPLACEMAX bytes stored behind the container in one
+ * allocation. For dll::list (dll_list.hpp), which declares it itself. */
+int dll_prv_emplace(dll_list_t *list, dll_item_t **item, size_t datasize, int front);
+
+/** Stable merge sort of a NULL terminated chain of nodes of any type, as
+ * described by 'sort'. Returns the new first node and stores the new last
+ * one in 'last'. dll_sort(), dll_ilist_sort() and dll_mapped_sort() all
+ * come down to this. */
+void *dll_prv_linksort(void *first, dll_prv_linksort_t *sort, void **last);
+
+#ifdef DLL_ENABLE_STATS
+/** Bytes an item and its data take up, allocator overhead included */
+size_t dll_prv_itembytes(dll_item_t *item);
+
+/** Account for a positional lookup that walked past 'dist' items */
+void dll_prv_statseek(dll_list_t *list, dll_count_t dist);
+
+/** Account for an item being allocated (alloc != 0) or freed */
+void dll_prv_statitem(dll_list_t *list, dll_item_t *item, int alloc);
+#endif
+
+/* Snapshots (dll_snapshot.c). A list sharing its containers has 'share'
+ * set, it needs to be unshared before its items are modified. */
+
+/** Give a list its own copy of the containers it shares with others */
+int dll_prv_unshare(dll_list_t *list);
+
+/** Drop a list's reference to the containers it shares and empty it */
+void dll_prv_release(dll_list_t *list);
+
+/** Drop a reference to shared data, returns nonzero if it was the last */
+int dll_prv_slotput(unsigned int slot);
+
+/* Compaction arenas (dll_compact.c). An arena is a single block carved into
+ * chunks for item containers and data, it is freed once every chunk taken
+ * from it has been released again. */
+
+/** Number of arena bytes a chunk of 'size' bytes takes up */
+size_t dll_prv_arenachunk(size_t size);
+
+/** Allocate an arena with room for 'size' bytes worth of chunks, 'pos' is
+ * set to where the first chunk goes. With 'place' the arena is mapped on its
+ * own and bound accordingly, otherwise it comes from the heap. */
+void *dll_prv_arenanew(size_t size, char **pos, const dll_prv_place_t *place);
+
+/** Take a chunk from an arena and advance 'pos' past it */
+void *dll_prv_arenatake(void *arena, char **pos, size_t size);
+
+/** Free an arena none of whose chunks are in use */
+void dll_prv_arenafree(void *arena);
+
+/** Release a container or data chunk taken from an arena */
+void dll_prv_arenarelease(void *ptr);
+
+/** dll_compact() into a single arena placed as given */
+int dll_prv_compact(dll_list_t *list, int flags, const dll_prv_place_t *place);
+
+/* NUMA placement (dll_numa.c) */
+
+/** Bind a fresh mapping nothing has been written to yet */
+int dll_prv_numabind(void *addr, size_t size, const dll_prv_place_t *place);
+
+/* Huge page backed container slab (dll_slab.c), DLL_LARGE_LISTS only */
+
+/** Allocate DLL_SLAB_CHUNK bytes */
+void *dll_prv_slaballoc(void);
+
+/** Free a chunk from dll_prv_slaballoc() */
+void dll_prv_slabfree(void *chunk);
+
+/* Per-thread chunk caches (dll_tcache.c), DLL_THREAD_CACHE only */
+
+/** Allocate DLL_TCACHE_CHUNK bytes from the calling thread's cache */
+void *dll_prv_tcachealloc(void);
+
+/** Free a chunk from dll_prv_tcachealloc(), from any thread */
+void dll_prv_tcachefree(void *chunk);
+
 #endif /* _DLL_LIST_PRV_H */
 
@@ -0,0 +1,801 @@
+/*
+* Copyright (c) 2008, Björn Rehm (bjoern@shugaa.de)
+* 
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+* 
+* The above copyright notice and this permission notice shall be included in
+* all copies or substantial portions of the Software.
+* 
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+* THE SOFTWARE.
+*/
+
+#include <string.h>
+#include <stdint.h>
+#include <errno.h>
+#include <time.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "dll_list.h"
+#include "dll_list_prv.h"
+#include "dll_mapped.h"
+
+/* ######################################################################### */
+/*                            TODO / Notes                                   */
+/* ######################################################################### */
+
+/* ######################################################################### */
+/*                            Types & Defines                                */
+/* ######################################################################### */
+
+#define DLL_ITERATOR_INIT       (1<<0)
+
+#define PRV_MAP_MAGIC           "DLLM"
+#define PRV_MAP_VERSION         (1)
+#define PRV_MAP_HDRSIZE         (4096)
+#define PRV_MAP_INITSIZE        (64*1024)
+
+/* How long to wait for another process to finish setting up a new list */
+#define PRV_MAP_WAITTRIES       (1000)
+#define PRV_MAP_WAITNSEC        (1000000L)
+
+/* dll_mapped_t flags */
+#define PRV_MAP_SHARED          (1<<0)  /* Shared memory, never grown */
+
+/* Blocks are powers of two, from 64 bytes upwards. Each size class has its
+ * own free list. */
+#define PRV_MAP_MINCLASS        (6)
+#define PRV_MAP_NCLASSES        (64)
+
+/* Offset 0 is the header, so it doubles as the NULL offset */
+#define PRV_NODE(mapped, off)   ((prv_node_t*)((char*)(mapped)->base + (off)))
+#define PRV_DATA(node)          ((void*)((char*)(node) + sizeof(prv_node_t)))
+#define PRV_HEADER(mapped)      ((prv_header_t*)(mapped)->base)
+
+/* Publishing items to other processes needs ordered stores and loads */
+#if defined(__GNUC__)
+#define PRV_STORE_RELEASE(ptr, val)     __atomic_store_n((ptr), (val), __ATOMIC_RELEASE)
+#define PRV_LOAD_ACQUIRE(ptr)           __atomic_load_n((ptr), __ATOMIC_ACQUIRE)
+#define PRV_STORE_RELEASE32(ptr, val)   __atomic_store_n((ptr), (val), __ATOMIC_RELEASE)
+#define PRV_LOAD_ACQUIRE32(ptr)         __atomic_load_n((ptr), __ATOMIC_ACQUIRE)
+#else
+#define PRV_STORE_RELEASE(ptr, val)     (*(volatile uint64_t*)(ptr) = (val))
+#define PRV_LOAD_ACQUIRE(ptr)           (*(volatile uint64_t*)(ptr))
+#define PRV_STORE_RELEASE32(ptr, val)   (*(volatile uint32_t*)(ptr) = (val))
+#define PRV_LOAD_ACQUIRE32(ptr)         (*(volatile uint32_t*)(ptr))
+#endif
+
+/* The version is written last when a list is set up, a list whose version
+ * is still 0 is being set up by another process */
+
+typedef struct {
+        char magic[4];
+        uint32_t version;
+        uint64_t size;
+        uint64_t top;
+        uint64_t count;
+        uint64_t first;
+        uint64_t last;
+        uint64_t published;
+        uint64_t freelist[PRV_MAP_NCLASSES];
+} prv_header_t;
+
+typedef struct {
+        uint64_t prev;
+        uint64_t next;
+        uint64_t datasize;
+        uint32_t sclass;
+        uint32_t reserved;
+} prv_node_t;
+
+/* ######################################################################### */
+/*                           Private interface (Module)                      */
+/* ######################################################################### */
+
+static int prv_open(dll_mapped_t *mapped, const char *name, size_t size);
+static int prv_openfd(dll_mapped_t *mapped, const char *name, int oflag);
+static int prv_create(dll_mapped_t *mapped, size_t size);
+static int prv_attach(dll_mapped_t *mapped);
+static int prv_map(dll_mapped_t *mapped, size_t size);
+static int prv_grow(dll_mapped_t *mapped, uint64_t need);
+static int prv_sizeclass(size_t datasize, uint32_t *sclass);
+static int prv_alloc(dll_mapped_t *mapped, uint32_t sclass, uint64_t *off);
+static uint64_t prv_nodeat(dll_mapped_t *mapped, dll_count_t position);
+
+/* ######################################################################### */
+/*                           Implementation                                  */
+/* ######################################################################### */
+
+int dll_mapped_open(dll_mapped_t *mapped, const char *path)
+{
+        if (!mapped)
+                return EDLLINV;
+        if (!path)
+                return EDLLINV;
+
+        mapped->flags = 0;
+
+        return prv_open(mapped, path, PRV_MAP_INITSIZE);
+}
+
+int dll_mapped_open_shared(dll_mapped_t *mapped, const char *name, size_t size)
+{
+        if (!mapped)
+                return EDLLINV;
+        if (!name)
+                return EDLLINV;
+
+        mapped->flags = PRV_MAP_SHARED;
+
+        return prv_open(mapped, name, size);
+}
+
+int dll_mapped_unlink(const char *name)
+{
+        if (!name)
+                return EDLLINV;
+
+        if (shm_unlink(name) != 0)
+                return EDLLIO;
+
+        return EDLLOK;
+}
+
+int dll_mapped_close(dll_mapped_t *mapped)
+{
+        int rc = EDLLOK;
+
+        if (!mapped)
+                return EDLLINV;
+        if (mapped->base == NULL)
+                return EDLLINV;
+
+        if (munmap(mapped->base, mapped->size) != 0)
+                rc = EDLLIO;
+        if (close(mapped->fd) != 0)
+                rc = EDLLIO;
+
+        mapped->fd = -1;
+        mapped->base = NULL;
+        mapped->size = 0;
+
+        return rc;
+}
+
+int dll_mapped_flush(dll_mapped_t *mapped)
+{
+        if (!mapped)
+                return EDLLINV;
+        if (mapped->base == NULL)
+                return EDLLINV;
+
+        if (msync(mapped->base, mapped->size, MS_SYNC) != 0)
+                return EDLLIO;
+
+        return EDLLOK;
+}
+
+int dll_mapped_clear(dll_mapped_t *mapped)
+{
+        prv_header_t *hdr;
+
+        if (!mapped)
+                return EDLLINV;
+        if (mapped->base == NULL)
+                return EDLLINV;
+
+        /* Dropping everything including the free lists is enough, all
+         * blocks are below top */
+        hdr = PRV_HEADER(mapped);
+        hdr->count = 0;
+        hdr->first = 0;
+        hdr->last = 0;
+        hdr->published = 0;
+        hdr->top = PRV_MAP_HDRSIZE;
+        memset(hdr->freelist, 0, sizeof(hdr->freelist));
+
+        return EDLLOK;
+}
+
+int dll_mapped_append(dll_mapped_t *mapped, void **data, size_t datasize)
+{
+        int rc;
+        uint32_t sclass;
+        uint64_t off;
+        prv_header_t *hdr;
+        prv_node_t *node;
+
+        if (!mapped)
+                return EDLLINV;
+        if (mapped->base == NULL)
+                return EDLLINV;
+        if (!data)
+                return EDLLINV;
+
+        rc = prv_sizeclass(datasize, &sclass);
+        if (rc != EDLLOK)
+                return rc;
+
+        /* May move the mapping, so look at the header afterwards */
+        rc = prv_alloc(mapped, sclass, &off);
+        if (rc != EDLLOK)
+                return rc;
+
+        hdr = PRV_HEADER(mapped);
+        node = PRV_NODE(mapped, off);
+        node->datasize = datasize;
+        node->sclass = sclass;
+        node->reserved = 0;
+
+        /* node is now the last element in the list */
+        node->prev = hdr->last;
+        node->next = 0;
+
+        if (hdr->last != 0)
+                PRV_NODE(mapped, hdr->last)->next = off;
+
+        hdr->last = off;
+
+        if (hdr->count == 0)
+                hdr->first = off;
+
+        hdr->count++;
+
+        *data = PRV_DATA(node);
+
+        return EDLLOK;
+}
+
+int dll_mapped_publish(dll_mapped_t *mapped)
+{
+        prv_header_t *hdr;
+
+        if (!mapped)
+                return EDLLINV;
+        if (mapped->base == NULL)
+                return EDLLINV;
+
+        /* Everything up to and including the published item has been
+         * written before, consumers never look past it */
+        hdr = PRV_HEADER(mapped);
+        PRV_STORE_RELEASE(&hdr->published, hdr->last);
+
+        return EDLLOK;
+}
+
+int dll_mapped_remove(dll_mapped_t *mapped, dll_count_t position)
+{
+        uint64_t off;
+        prv_header_t *hdr;
+        prv_node_t *node;
+
+        if (!mapped)
+                return EDLLINV;
+        if (mapped->base == NULL)
+                return EDLLINV;
+
+        hdr = PRV_HEADER(mapped);
+        if (position >= hdr->count)
+                return EDLLINV;
+
+        off = prv_nodeat(mapped, position);
+        node = PRV_NODE(mapped, off);
+
+        if (hdr->published == off)
+                hdr->published = node->prev;
+
+        /* Unlink */
+        if (node->prev != 0)
+                PRV_NODE(mapped, node->prev)->next = node->next;
+        else
+                hdr->first = node->next;
+
+        if (node->next != 0)
+                PRV_NODE(mapped, node->next)->prev = node->prev;
+        else
+                hdr->last = node->prev;
+
+        hdr->count--;
+
+        /* Put the block on its free list, chained through next */
+        node->prev = 0;
+        node->next = hdr->freelist[node->sclass];
+        hdr->freelist[node->sclass] = off;
+
+        return EDLLOK;
+}
+
+int dll_mapped_get(dll_mapped_t *mapped, void **data, size_t *datasize, dll_count_t position)
+{
+        prv_node_t *node;
+
+        if (!mapped)
+                return EDLLINV;
+        if (mapped->base == NULL)
+                return EDLLINV;
+        if (!data)
+                return EDLLINV;
+        if (position >= PRV_HEADER(mapped)->count)
+                return EDLLINV;
+
+        node = PRV_NODE(mapped, prv_nodeat(mapped, position));
+
+        *data = PRV_DATA(node);
+        if (datasize != NULL)
+                *datasize = (size_t)node->datasize;
+
+        return EDLLOK;
+}
+
+int dll_mapped_count(dll_mapped_t *mapped, dll_count_t *count)
+{
+        if (!mapped)
+                return EDLLINV;
+        if (mapped->base == NULL)
+                return EDLLINV;
+        if (!count)
+                return EDLLINV;
+
+        if (PRV_HEADER(mapped)->count > (uint64_t)DLL_COUNT_MAX)
+                return EDLLERROR;
+
+        *count = (dll_count_t)PRV_HEADER(mapped)->count;
+
+        return EDLLOK;
+}
+
+int dll_mapped_sort(dll_mapped_t *mapped, dll_fctcompare_t compar)
+{
+        void *first, *last;
+        prv_header_t *hdr;
+        dll_prv_linksort_t sort;
+
+        if (!mapped)
+                return EDLLINV;
+        if (mapped->base == NULL)
+                return EDLLINV;
+        if (!compar)
+                return EDLLINV;
+
+        hdr = PRV_HEADER(mapped);
+        if (hdr->count < 2)
+                return EDLLOK;
+
+        /* Links are offsets into the mapping, the data follows its node */
+        sort.nextoff = offsetof(prv_node_t, next);
+        sort.prevoff = offsetof(prv_node_t, prev);
+        sort.keyoff = sizeof(prv_node_t);
+        sort.deref = 0;
+        sort.base = (char*)mapped->base;
+        sort.compar = compar;
+        sort.compares = 0;
+
+        first = dll_prv_linksort(PRV_NODE(mapped, hdr->first), &sort, &last);
+        hdr->first = (uint64_t)((char*)first - sort.base);
+        hdr->last = (uint64_t)((char*)last - sort.base);
+
+        return EDLLOK;
+}
+
+int dll_mapped_iterator_init(dll_mapped_iterator_t *iterator, dll_mapped_t *mapped)
+{
+        if (!iterator)
+                return EDLLINV;
+        if (!mapped)
+                return EDLLINV;
+
+        iterator->flags = 0;
+        iterator->mapped = mapped;
+        iterator->item = 0;
+
+        return EDLLOK;
+}
+
+int dll_mapped_iterator_next(dll_mapped_iterator_t *iterator, void **data, size_t *datasize)
+{
+        int ret = EDLLOK;
+        prv_header_t *hdr;
+        prv_node_t *node;
+
+        if (!iterator)
+                return EDLLINV;
+        if (!data)
+                return EDLLINV;
+
+        hdr = PRV_HEADER(iterator->mapped);
+
+        if ((iterator->flags & DLL_ITERATOR_INIT) < DLL_ITERATOR_INIT) {
+                iterator->flags = DLL_ITERATOR_INIT;
+                iterator->item = (size_t)hdr->first;
+        } else {
+                if (iterator->item == hdr->last) {
+                        iterator->item = (size_t)hdr->first;
+                        ret = EDLLTILT;
+                } else if (iterator->item != 0) {
+                        iterator->item = (size_t)PRV_NODE(iterator->mapped, iterator->item)->next;
+                }
+        }
+
+        if (iterator->item == 0)
+                return EDLLERROR;
+
+        node = PRV_NODE(iterator->mapped, iterator->item);
+        *data = PRV_DATA(node);
+        if (datasize != NULL)
+            *datasize = (size_t)node->datasize;
+
+        return ret;
+}
+
+int dll_mapped_iterator_prev(dll_mapped_iterator_t *iterator, void **data, size_t *datasize)
+{
+        int ret = EDLLOK;
+        prv_header_t *hdr;
+        prv_node_t *node;
+
+        if (!iterator)
+                return EDLLINV;
+        if (!data)
+                return EDLLINV;
+
+        hdr = PRV_HEADER(iterator->mapped);
+
+        if ((iterator->flags & DLL_ITERATOR_INIT) < DLL_ITERATOR_INIT) {
+                iterator->flags = DLL_ITERATOR_INIT;
+                iterator->item = (size_t)hdr->last;
+        } else {
+                if (iterator->item == hdr->first) {
+                        iterator->item = (size_t)hdr->last;
+                        ret = EDLLTILT;
+                } else if (iterator->item != 0) {
+                        iterator->item = (size_t)PRV_NODE(iterator->mapped, iterator->item)->prev;
+                }
+        }
+
+        if (iterator->item == 0)
+                return EDLLERROR;
+
+        node = PRV_NODE(iterator->mapped, iterator->item);
+        *data = PRV_DATA(node);
+        if (datasize != NULL)
+            *datasize = (size_t)node->datasize;
+
+        return ret;
+}
+
+int dll_mapped_iterator_poll(dll_mapped_iterator_t *iterator, void **data, size_t *datasize)
+{
+        uint64_t published;
+        prv_header_t *hdr;
+        prv_node_t *node;
+
+        if (!iterator)
+                return EDLLINV;
+        if (!data)
+                return EDLLINV;
+
+        hdr = PRV_HEADER(iterator->mapped);
+
+        /* The producer may be appending right now. Links up to the
+         * published item are complete, anything beyond is off limits. */
+        published = PRV_LOAD_ACQUIRE(&hdr->published);
+        if (published == 0)
+                return EDLLERROR;
+
+        if ((iterator->flags & DLL_ITERATOR_INIT) < DLL_ITERATOR_INIT) {
+                iterator->flags = DLL_ITERATOR_INIT;
+                iterator->item = (size_t)hdr->first;
+        } else {
+                if (iterator->item == published)
+                        return EDLLERROR;
+                iterator->item = (size_t)PRV_NODE(iterator->mapped, iterator->item)->next;
+        }
+
+        node = PRV_NODE(iterator->mapped, iterator->item);
+        *data = PRV_DATA(node);
+        if (datasize != NULL)
+                *datasize = (size_t)node->datasize;
+
+        return EDLLOK;
+}
+
+static int prv_open(dll_mapped_t *mapped, const char *name, size_t size)
+{
+        int rc;
+
+        mapped->base = NULL;
+        mapped->size = 0;
+
+        /* Whoever manages to create the file sets up the list, everybody
+         * else opens it and waits for that to be done */
+        if (size >= PRV_MAP_HDRSIZE) {
+                mapped->fd = prv_openfd(mapped, name, O_RDWR | O_CREAT | O_EXCL);
+                if (mapped->fd >= 0) {
+                        rc = prv_create(mapped, size);
+                        if (rc == EDLLOK)
+                                return EDLLOK;
+
+                        /* Don't leave others waiting for it */
+                        if (mapped->flags & PRV_MAP_SHARED)
+                                shm_unlink(name);
+                        else
+                                unlink(name);
+
+                        return rc;
+                }
+
+                if (errno != EEXIST)
+                        return EDLLIO;
+        }
+
+        mapped->fd = prv_openfd(mapped, name, O_RDWR);
+        if (mapped->fd < 0) {
+                /* Nothing to open and too small to create */
+                if ((errno == ENOENT) && (size < PRV_MAP_HDRSIZE))
+                        return EDLLINV;
+                return EDLLIO;
+        }
+
+        return prv_attach(mapped);
+}
+
+static int prv_openfd(dll_mapped_t *mapped, const char *name, int oflag)
+{
+        if (mapped->flags & PRV_MAP_SHARED)
+                return shm_open(name, oflag, 0666);
+
+        return open(name, oflag, 0666);
+}
+
+static int prv_create(dll_mapped_t *mapped, size_t size)
+{
+        int rc;
+        prv_header_t *hdr;
+
+        if (ftruncate(mapped->fd, (off_t)size) != 0) {
+                rc = EDLLIO;
+                goto fail;
+        }
+
+        rc = prv_map(mapped, size);
+        if (rc != EDLLOK)
+                goto fail;
+
+        /* Everything but the version, which tells others it's done */
+        hdr = PRV_HEADER(mapped);
+        memset(hdr, 0, sizeof(prv_header_t));
+        memcpy(hdr->magic, PRV_MAP_MAGIC, 4);
+        hdr->size = size;
+        hdr->top = PRV_MAP_HDRSIZE;
+        PRV_STORE_RELEASE32(&hdr->version, PRV_MAP_VERSION);
+
+        return EDLLOK;
+
+fail:
+        if (mapped->base != NULL)
+                munmap(mapped->base, mapped->size);
+        close(mapped->fd);
+        mapped->fd = -1;
+        mapped->base = NULL;
+        mapped->size = 0;
+
+        return rc;
+}
+
+static int prv_attach(dll_mapped_t *mapped)
+{
+        int rc, tries;
+        struct stat st;
+        struct timespec wait;
+        prv_header_t *hdr;
+
+        /* Wait for the creator to size the file and publish the header,
+         * peeking at it through a mapping of the header only */
+        for (tries=0; ; tries++) {
+                if (fstat(mapped->fd, &st) != 0) {
+                        rc = EDLLIO;
+                        goto fail;
+                }
+
+                if ((st.st_size > 0) && (st.st_size < PRV_MAP_HDRSIZE)) {
+                        rc = EDLLERROR;
+                        goto fail;
+                }
+
+                if ((st.st_size > 0) && (mapped->base == NULL)) {
+                        rc = prv_map(mapped, PRV_MAP_HDRSIZE);
+                        if (rc != EDLLOK)
+                                goto fail;
+                }
+
+                if ((mapped->base != NULL) &&
+                    (PRV_LOAD_ACQUIRE32(&PRV_HEADER(mapped)->version) != 0))
+                        break;
+
+                if (tries == PRV_MAP_WAITTRIES) {
+                        rc = EDLLERROR;
+                        goto fail;
+                }
+
+                wait.tv_sec = 0;
+                wait.tv_nsec = PRV_MAP_WAITNSEC;
+                nanosleep(&wait, NULL);
+        }
+
+        munmap(mapped->base, mapped->size);
+        mapped->base = NULL;
+        mapped->size = 0;
+
+        if (fstat(mapped->fd, &st) != 0) {
+                rc = EDLLIO;
+                goto fail;
+        }
+
+        if ((uint64_t)st.st_size > SIZE_MAX) {
+                rc = EDLLERROR;
+                goto fail;
+        }
+
+        rc = prv_map(mapped, (size_t)st.st_size);
+        if (rc != EDLLOK)
+                goto fail;
+
+        /* The file may have been grown without the header being updated if
+         * we went down in between, so it can be larger than recorded. The
+         * header is left alone, others may be using it. */
+        hdr = PRV_HEADER(mapped);
+        if ((memcmp(hdr->magic, PRV_MAP_MAGIC, 4) != 0) ||
+            (hdr->version != PRV_MAP_VERSION) ||
+            (hdr->size > mapped->size) ||
+            (hdr->top < PRV_MAP_HDRSIZE) ||
+            (hdr->top > mapped->size)) {
+                rc = EDLLERROR;
+                goto fail;
+        }
+
+        return EDLLOK;
+
+fail:
+        if (mapped->base != NULL)
+                munmap(mapped->base, mapped->size);
+        close(mapped->fd);
+        mapped->fd = -1;
+        mapped->base = NULL;
+        mapped->size = 0;
+
+        return rc;
+}
+
+static int prv_map(dll_mapped_t *mapped, size_t size)
+{
+        void *base;
+
+        base = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, mapped->fd, 0);
+        if (base == MAP_FAILED)
+                return EDLLIO;
+
+        mapped->base = base;
+        mapped->size = size;
+
+        return EDLLOK;
+}
+
+static int prv_grow(dll_mapped_t *mapped, uint64_t need)
+{
+        void *base;
+        size_t size;
+
+        /* Other processes couldn't follow */
+        if (mapped->flags & PRV_MAP_SHARED)
+                return EDLLNOMEM;
+
+        size = mapped->size;
+        while (size < need) {
+                if (size > SIZE_MAX/2)
+                        return EDLLNOMEM;
+                size *= 2;
+        }
+
+        if (ftruncate(mapped->fd, (off_t)size) != 0)
+                return EDLLNOMEM;
+
+        /* Map the grown file before dropping the old mapping, so we still
+         * have a valid one if this fails */
+        base = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, mapped->fd, 0);
+        if (base == MAP_FAILED)
+                return EDLLNOMEM;
+
+        munmap(mapped->base, mapped->size);
+
+        mapped->base = base;
+        mapped->size = size;
+        PRV_HEADER(mapped)->size = size;
+
+        return EDLLOK;
+}
+
+static int prv_sizeclass(size_t datasize, uint32_t *sclass)
+{
+        uint32_t c;
+        uint64_t need;
+
+        if (datasize > UINT64_MAX - sizeof(prv_node_t))
+                return EDLLNOMEM;
+
+        need = (uint64_t)datasize + sizeof(prv_node_t);
+        for (c = PRV_MAP_MINCLASS; c < PRV_MAP_NCLASSES; c++) {
+                if ((((uint64_t)1) << c) >= need) {
+                        *sclass = c;
+                        return EDLLOK;
+                }
+        }
+
+        return EDLLNOMEM;
+}
+
+static int prv_alloc(dll_mapped_t *mapped, uint32_t sclass, uint64_t *off)
+{
+        int rc;
+        uint64_t bsize;
+        prv_header_t *hdr;
+
+        /* Reuse a free block of the same size class if there is one */
+        hdr = PRV_HEADER(mapped);
+        if (hdr->freelist[sclass] != 0) {
+                *off = hdr->freelist[sclass];
+                hdr->freelist[sclass] = PRV_NODE(mapped, *off)->next;
+                return EDLLOK;
+        }
+
+        /* Otherwise carve it from the unused end of the file */
+        bsize = ((uint64_t)1) << sclass;
+        if (bsize > UINT64_MAX - hdr->top)
+                return EDLLNOMEM;
+
+        if (hdr->top + bsize > mapped->size) {
+                rc = prv_grow(mapped, hdr->top + bsize);
+                if (rc != EDLLOK)
+                        return rc;
+
+                hdr = PRV_HEADER(mapped);
+        }
+
+        *off = hdr->top;
+        hdr->top += bsize;
+
+        return EDLLOK;
+}
+
+static uint64_t prv_nodeat(dll_mapped_t *mapped, dll_count_t position)
+{
+        uint64_t i;
+        uint64_t off;
+        prv_header_t *hdr;
+
+        /* Walk from whichever end is closer */
+        hdr = PRV_HEADER(mapped);
+        if (position < hdr->count/2) {
+                off = hdr->first;
+                for (i=0; i<position; i++)
+                        off = PRV_NODE(mapped, off)->next;
+        } else {
+                off = hdr->last;
+                for (i=hdr->count-1; i>position; i--)
+                        off = PRV_NODE(mapped, off)->prev;
+        }
+
+        return off;
+}
@@ -0,0 +1,306 @@
+/*
+* Copyright (c) 2008, Björn Rehm (bjoern@shugaa.de)
+* 
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+* 
+* The above copyright notice and this permission notice shall be included in
+* all copies or substantial portions of the Software.
+* 
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+* THE SOFTWARE.
+*/
+
+/** @file dll_mapped.h
+ *
+ * @brief File-backed lists which live in a memory mapping
+ *
+ * */
+
+#ifndef _DLL_MAPPED_H
+#define _DLL_MAPPED_H
+
+#include "dll_list.h"
+
+/* ######################################################################### */
+/*                            TODO / Notes                                   */
+/* ######################################################################### */
+
+/*
+ * Item containers and data are stored in the mapped file itself and are
+ * linked by their offset from the start of the file rather than by pointers,
+ * so a list file can be mapped at any address. Space of removed items is
+ * kept on per-size free lists inside the file and reused by later appends.
+ *
+ * The file layout is the host's native one, use dll_save() to move lists
+ * between machines.
+ *
+ * A list can also live in a POSIX shared memory segment, which lets
+ * processes hand lists to each other without copying. A single producer can
+ * append and dll_mapped_publish() items while any number of consumers
+ * follow the list with dll_mapped_iterator_poll(), no locking involved.
+ * Removing or clearing items is only safe while nobody else looks at the
+ * list.
+ */
+
+/* ######################################################################### */
+/*                            Types & Defines                                */
+/* ######################################################################### */
+
+/** Mapped list instance type */
+typedef struct dll_mapped dll_mapped_t;
+
+/** Mapped list iterator type */
+typedef struct dll_mapped_iterator dll_mapped_iterator_t;
+
+struct dll_mapped
+{
+        int flags;
+        int fd;
+        size_t size;
+        void *base;
+};
+
+struct dll_mapped_iterator
+{
+        int flags;
+        size_t item;
+        dll_mapped_t *mapped;
+};
+
+/* ######################################################################### */
+/*                            Public interface                               */
+/* ######################################################################### */
+
+/** Open a mapped list file, creating an empty list if it doesn't exist
+ *
+ * An existing list can be used right away, nothing needs to be read or
+ * rebuilt. If several processes open a file which doesn't exist yet at the
+ * same time, one of them sets up the list and the others wait for it.
+ *
+ * @param mapped     Pointer to a dll_mapped_t to be initialized
+ * @param path       Path of the list file
+ *
+ * @return EDLLOK    No errors occured
+ * @return EDLLINV   An invalid argument has been passed
+ * @return EDLLIO    Opening or mapping the file failed, errno tells why
+ * @return EDLLERROR The file exists but doesn't hold a mapped list, or it
+ *                   wasn't set up within a second
+ */
+int dll_mapped_open(dll_mapped_t *mapped, const char *path);
+
+/** Create or open a list in a POSIX shared memory segment
+ *
+ * If the segment doesn't exist yet it's created with the given size and an
+ * empty list is set up in it. Processes opening a segment that is still
+ * being set up wait for that to be finished, so they may all be started at
+ * once. Unlike list files a segment never grows, so appends fail once it's
+ * full. Use dll_mapped_close() when done and
+ * dll_mapped_unlink() to remove the segment.
+ *
+ * @param mapped     Pointer to a dll_mapped_t to be initialized
+ * @param name       Name of the segment, see shm_open()
+ * @param size       Size of a new segment, ignored for existing ones
+ *
+ * @return EDLLOK    No errors occured
+ * @return EDLLINV   An invalid argument has been passed, or the size is too
+ *                   small for a new segment
+ * @return EDLLIO    Opening or mapping the segment failed, errno tells why
+ * @return EDLLERROR The segment exists but doesn't hold a mapped list, or it
+ *                   wasn't set up within a second
+ */
+int dll_mapped_open_shared(dll_mapped_t *mapped, const char *name, size_t size);
+
+/** Remove a shared memory segment
+ *
+ * Processes which have the segment open can keep using it.
+ *
+ * @param name       Name of the segment
+ *
+ * @return EDLLOK    No errors occured
+ * @return EDLLINV   An invalid argument has been passed
+ * @return EDLLIO    Removing failed, errno tells why
+ */
+int dll_mapped_unlink(const char *name);
+
+/** Unmap and close a mapped list file
+ *
+ * Changes end up in the file eventually, call dll_mapped_flush() first if
+ * they need to be on disk right away.
+ *
+ * @param mapped     Pointer to the mapped list
+ *
+ * @return EDLLOK    No errors occured
+ * @return EDLLINV   An invalid argument has been passed
+ * @return EDLLIO    Unmapping or closing the file failed
+ */
+int dll_mapped_close(dll_mapped_t *mapped);
+
+/** Write all changes made to a mapped list back to its file
+ *
+ * Blocks until the data has been handed to the storage device (msync()).
+ *
+ * @param mapped     Pointer to the mapped list
+ *
+ * @return EDLLOK    No errors occured
+ * @return EDLLINV   An invalid argument has been passed
+ * @return EDLLIO    Writing failed, errno tells why
+ */
+int dll_mapped_flush(dll_mapped_t *mapped);
+
+/** Clear all items from a mapped list
+ *
+ * The file keeps its size, all of its space is available for new items.
+ *
+ * @param mapped     Pointer to the mapped list
+ *
+ * @return EDLLOK    No errors occured
+ * @return EDLLINV   An invalid argument has been passed
+ * @return EDLLERROR Something went wrong
+ */
+int dll_mapped_clear(dll_mapped_t *mapped);
+
+/** Append an item to the end of a mapped list
+ *
+ * The file is grown when it's out of free space. Growing it may move the
+ * mapping, which invalidates all data references obtained before.
+ *
+ * @param mapped     Pointer to the mapped list
+ * @param data       Where to store the reference to the allocated memory
+ * @param datasize   Size of memory to be allocated for this item's data    
+ *
+ * @return EDLLOK    No errors occured
+ * @return EDLLINV   An invalid argument has been passed
+ * @return EDLLNOMEM Unable to grow the file, or the segment is full
+ * @return EDLLERROR Something went wrong
+ */
+int dll_mapped_append(dll_mapped_t *mapped, void **data, size_t datasize);
+
+/** Make all items appended so far visible to dll_mapped_iterator_poll()
+ *
+ * Call this after filling in the data of appended items. Publishing a
+ * batch of items at once is cheaper than publishing each one.
+ *
+ * @param mapped     Pointer to the mapped list
+ *
+ * @return EDLLOK    No errors occured
+ * @return EDLLINV   An invalid argument has been passed
+ */
+int dll_mapped_publish(dll_mapped_t *mapped);
+
+/** Remove a specific item from a mapped list
+ *
+ * @param mapped     Pointer to the mapped list
+ * @param position   Position of the item to be removed
+ *
+ * @return EDLLOK    No errors occured
+ * @return EDLLINV   An invalid argument has been passed
+ * @return EDLLERROR Something went wrong
+ */
+int dll_mapped_remove(dll_mapped_t *mapped, dll_count_t position);
+
+/** Get an item from a mapped list
+ *
+ * @param mapped     Pointer to the mapped list
+ * @param data       Where to store the reference to the specified item data
+ * @param datasize   Size of the data BLOB
+ * @param position   Position in the list of the requested item
+ *
+ * @return EDLLOK    No errors occured
+ * @return EDLLINV   An invalid argument has been passed
+ * @return EDLLERROR Something went wrong
+ */
+int dll_mapped_get(dll_mapped_t *mapped, void **data, size_t *datasize, dll_count_t position);
+
+/** Get the current item count of a mapped list
+ *
+ * @param mapped     Pointer to the mapped list
+ * @param count      Pointer to a dll_count_t to store the count in
+ *
+ * @return EDLLOK    No errors occured
+ * @return EDLLINV   An invalid argument has been passed
+ * @return EDLLERROR More items than a dll_count_t can hold (the file was
+ *                   written by a DLL_LARGE_LISTS build)
+ */
+int dll_mapped_count(dll_mapped_t *mapped, dll_count_t *count);
+
+/** Sort a mapped list
+ *
+ * Same algorithm as dll_sort(), the items are relinked in place inside the
+ * file.
+ *
+ * @param mapped     Pointer to the mapped list
+ * @param compar     Pointer to function comparing two data items
+ *
+ * @return EDLLOK    No errors occured
+ * @return EDLLINV   An invalid argument has been passed
+ * @return EDLLERROR Something went wrong
+ */
+int dll_mapped_sort(dll_mapped_t *mapped, dll_fctcompare_t compar);
+
+/** Create an iterator for a mapped list
+ *
+ * Works just like dll_iterator_init(). The list must not be appended to
+ * while it's being iterated.
+ *
+ * @param iterator   Pointer to a dll_mapped_iterator_t to be initialized 
+ * @param mapped     Pointer to the mapped list
+ *
+ * @return EDLLOK    No errors occured
+ * @return EDLLINV   An invalid argument has been passed
+ * @return EDLLERROR Something went wrong
+ */
+int dll_mapped_iterator_init(dll_mapped_iterator_t *iterator, dll_mapped_t *mapped);
+
+/** Move the mapped list iterator to the next position
+ *
+ * @param iterator   The iterator which is to be moved to the next element
+ * @param data       Storage for the reference to this item's data
+ * @param datasize   Size of the data BLOB
+ *
+ * @return EDLLOK    No errors occured
+ * @return EDLLINV   An invalid argument has been passed
+ * @return EDLLTILT  Iterator turnaround (jump from last to first item)
+ * @return EDLLERROR Something went wrong
+ */
+int dll_mapped_iterator_next(dll_mapped_iterator_t *iterator, void **data, size_t *datasize);
+
+/** Move the mapped list iterator to the previous position
+ *
+ * @param iterator   The iterator which is to be moved to the previous element
+ * @param data       Storage for the reference to this item's data
+ * @param datasize   Size of the data BLOB
+ *
+ * @return EDLLOK    No errors occured
+ * @return EDLLINV   An invalid argument has been passed
+ * @return EDLLTILT  Iterator turnaround (jump from first to last item)
+ * @return EDLLERROR Something went wrong
+ */
+int dll_mapped_iterator_prev(dll_mapped_iterator_t *iterator, void **data, size_t *datasize);
+
+/** Move the mapped list iterator to the next published item, if any
+ *
+ * Meant for following a list another process appends to. Unlike
+ * dll_mapped_iterator_next() there is no turnaround, the iterator stays on
+ * the last item until more items have been published.
+ *
+ * @param iterator   The iterator which is to be moved to the next element
+ * @param data       Storage for the reference to this item's data
+ * @param datasize   Size of the data BLOB
+ *
+ * @return EDLLOK    No errors occured
+ * @return EDLLINV   An invalid argument has been passed
+ * @return EDLLERROR No new item has been published yet
+ */
+int dll_mapped_iterator_poll(dll_mapped_iterator_t *iterator, void **data, size_t *datasize);
+
+#endif /* _DLL_MAPPED_H */
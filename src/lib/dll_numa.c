@@ -0,0 +1,231 @@
+/*
+* Copyright (c) 2008, Björn Rehm (bjoern@shugaa.de)
+* 
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+* 
+* The above copyright notice and this permission notice shall be included in
+* all copies or substantial portions of the Software.
+* 
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+* THE SOFTWARE.
+*/
+
+#include <string.h>
+#include <unistd.h>
+
+#include "dll_list.h"
+#include "dll_list_prv.h"
+#include "dll_compact.h"
+#include "dll_numa.h"
+
+#ifdef DLL_HAVE_NUMA
+#include <sys/syscall.h>
+#include <linux/mempolicy.h>
+#else
+/* Never handed to a kernel, just to get through the compiler */
+#define MPOL_DEFAULT            (0)
+#define MPOL_PREFERRED          (1)
+#define MPOL_BIND               (2)
+#define MPOL_INTERLEAVE         (3)
+#endif
+
+/* ######################################################################### */
+/*                            TODO / Notes                                   */
+/* ######################################################################### */
+
+/* The memory policy syscalls are used directly, so there is no dependency on
+ * libnuma. Without them (non Linux) every call fails with EDLLERROR. */
+
+/* ######################################################################### */
+/*                            Types & Defines                                */
+/* ######################################################################### */
+
+/** Mask length passed to the kernel, which reads one bit less than told */
+#define PRV_MAXNODE     ((unsigned long)DLL_NUMA_MAXNODES + 1)
+
+#define PRV_MASKBITS    (8*sizeof(unsigned long))
+
+/* ######################################################################### */
+/*                           Private interface (Module)                      */
+/* ######################################################################### */
+
+static int prv_place(int policy, int node, dll_prv_place_t *place);
+static int prv_allowed(unsigned long *mask);
+static int prv_localnode(int *node);
+static int prv_setpolicy(const dll_prv_place_t *place);
+
+/* ######################################################################### */
+/*                           Implementation                                  */
+/* ######################################################################### */
+
+int dll_numa_thread(int policy, int node)
+{
+        int rc;
+        dll_prv_place_t place;
+
+        rc = prv_place(policy, node, &place);
+        if (rc != EDLLOK)
+                return rc;
+
+        /* Local placement is what a thread gets by default, it keeps
+         * following the thread if the scheduler moves it */
+        if (policy == DLL_NUMA_LOCAL) {
+                place.mode = MPOL_DEFAULT;
+                memset(place.mask, 0, sizeof(place.mask));
+        }
+
+        return prv_setpolicy(&place);
+}
+
+int dll_numa_place(dll_list_t *list, int policy, int node, int flags)
+{
+        int rc;
+        dll_prv_place_t place;
+
+        if (!list)
+                return EDLLINV;
+
+        rc = prv_place(policy, node, &place);
+        if (rc != EDLLOK)
+                return rc;
+
+        return dll_prv_compact(list, flags, &place);
+}
+
+int dll_migrate(dll_list_t *list, int node)
+{
+        return dll_numa_place(list, DLL_NUMA_BIND, node, DLL_COMPACT_INLINE);
+}
+
+int dll_numa_where(const void *ptr, int *node)
+{
+        if (!ptr)
+                return EDLLINV;
+        if (!node)
+                return EDLLINV;
+
+#ifdef DLL_HAVE_NUMA
+        if (syscall(SYS_get_mempolicy, node, NULL, 0UL, ptr, MPOL_F_NODE|MPOL_F_ADDR) != 0)
+                return EDLLERROR;
+
+        return EDLLOK;
+#else
+        return EDLLERROR;
+#endif
+}
+
+int dll_prv_numabind(void *addr, size_t size, const dll_prv_place_t *place)
+{
+#ifdef DLL_HAVE_NUMA
+        if (syscall(SYS_mbind, addr, size, place->mode, place->mask, PRV_MAXNODE, 0U) != 0)
+                return EDLLERROR;
+
+        return EDLLOK;
+#else
+        (void)addr;
+        (void)size;
+        (void)place;
+
+        return EDLLERROR;
+#endif
+}
+
+/** Turn a policy into an mbind() mode and node mask. Nodes the calling thread
+ * may not allocate from are refused up front, so the later mbind() on a
+ * fresh block only fails for lack of memory. */
+static int prv_place(int policy, int node, dll_prv_place_t *place)
+{
+        unsigned long allowed[DLL_NUMA_WORDS];
+
+        if ((policy == DLL_NUMA_BIND) && ((node < 0) || (node >= DLL_NUMA_MAXNODES)))
+                return EDLLINV;
+
+        memset(place->mask, 0, sizeof(place->mask));
+
+        switch (policy) {
+        case DLL_NUMA_LOCAL:
+                if (prv_localnode(&node) != EDLLOK)
+                        return EDLLERROR;
+                place->mode = MPOL_PREFERRED;
+                break;
+        case DLL_NUMA_INTERLEAVE:
+                if (prv_allowed(place->mask) != EDLLOK)
+                        return EDLLERROR;
+                place->mode = MPOL_INTERLEAVE;
+                return EDLLOK;
+        case DLL_NUMA_BIND:
+                place->mode = MPOL_BIND;
+                break;
+        default:
+                return EDLLINV;
+        }
+
+        if (prv_allowed(allowed) != EDLLOK)
+                return EDLLERROR;
+        if (!(allowed[node/PRV_MASKBITS] & (1UL << (node%PRV_MASKBITS))))
+                return EDLLERROR;
+
+        place->mask[node/PRV_MASKBITS] = 1UL << (node%PRV_MASKBITS);
+
+        return EDLLOK;
+}
+
+static int prv_allowed(unsigned long *mask)
+{
+#ifdef DLL_HAVE_NUMA
+        if (syscall(SYS_get_mempolicy, NULL, mask, PRV_MAXNODE, NULL, MPOL_F_MEMS_ALLOWED) != 0)
+                return EDLLERROR;
+
+        return EDLLOK;
+#else
+        (void)mask;
+
+        return EDLLERROR;
+#endif
+}
+
+static int prv_localnode(int *node)
+{
+#ifdef DLL_HAVE_NUMA
+        unsigned int cpu, local;
+
+        if (syscall(SYS_getcpu, &cpu, &local, NULL) != 0)
+                return EDLLERROR;
+        if (local >= DLL_NUMA_MAXNODES)
+                return EDLLERROR;
+
+        *node = (int)local;
+
+        return EDLLOK;
+#else
+        (void)node;
+
+        return EDLLERROR;
+#endif
+}
+
+static int prv_setpolicy(const dll_prv_place_t *place)
+{
+#ifdef DLL_HAVE_NUMA
+        const unsigned long *mask = (place->mode == MPOL_DEFAULT) ? NULL : place->mask;
+
+        if (syscall(SYS_set_mempolicy, place->mode, mask, PRV_MAXNODE) != 0)
+                return EDLLERROR;
+
+        return EDLLOK;
+#else
+        (void)place;
+
+        return EDLLERROR;
+#endif
+}
@@ -0,0 +1,124 @@
+/*
+* Copyright (c) 2008, Björn Rehm (bjoern@shugaa.de)
+* 
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+* 
+* The above copyright notice and this permission notice shall be included in
+* all copies or substantial portions of the Software.
+* 
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+* THE SOFTWARE.
+*/
+
+/** @file dll_numa.h
+ *
+ * @brief NUMA placement of list storage
+ *
+ * */
+
+#ifndef _DLL_NUMA_H
+#define _DLL_NUMA_H
+
+#include "dll_list.h"
+
+/* ######################################################################### */
+/*                            TODO / Notes                                   */
+/* ######################################################################### */
+
+/* ######################################################################### */
+/*                            Types & Defines                                */
+/* ######################################################################### */
+
+/* Placement policies */
+#define DLL_NUMA_LOCAL          (0)     /* Node of the calling thread */
+#define DLL_NUMA_INTERLEAVE     (1)     /* Page by page over all allowed nodes */
+#define DLL_NUMA_BIND           (2)     /* One given node */
+
+/** Node numbers handled, nodes at or beyond this are invalid */
+#define DLL_NUMA_MAXNODES       (1024)
+
+/* ######################################################################### */
+/*                            Public interface                               */
+/* ######################################################################### */
+
+/** Set where the calling thread's future allocations go
+ *
+ * This applies the policy to the whole thread through Linux'
+ * set_mempolicy(), so every page it touches for the first time from now on,
+ * including those of the lists it builds, is placed accordingly. Pages
+ * already in use (e.g. by malloc() earlier on) stay where they are.
+ * DLL_NUMA_LOCAL restores the default of allocating on the node the thread
+ * runs on.
+ *
+ * @param policy     One of the DLL_NUMA_* policies
+ * @param node       Node for DLL_NUMA_BIND, ignored otherwise
+ *
+ * @return EDLLOK    No errors occured
+ * @return EDLLINV   An invalid argument has been passed
+ * @return EDLLERROR Something went wrong (e.g. no such node, no NUMA support)
+ */
+int dll_numa_thread(int policy, int node);
+
+/** Move a list's items into a block placed by policy
+ *
+ * Works like dll_compact(), the block the items are copied into is mapped
+ * separately and bound through mbind() before it is touched. DLL_NUMA_LOCAL
+ * puts it on the calling thread's node, call it from the thread which is
+ * going to use the list most. The same restrictions as for dll_compact()
+ * apply with respect to references, iterators and the flags.
+ *
+ * @param list       Pointer to the list
+ * @param policy     One of the DLL_NUMA_* policies
+ * @param node       Node for DLL_NUMA_BIND, ignored otherwise
+ * @param flags      0, DLL_COMPACT_INLINE or DLL_COMPACT_DATA (see
+ *                   dll_compact.h)
+ *
+ * @return EDLLOK    No errors occured
+ * @return EDLLINV   An invalid argument has been passed
+ * @return EDLLNOMEM Unable to allocate enough memory
+ * @return EDLLERROR Something went wrong (e.g. no such node, no NUMA support)
+ */
+int dll_numa_place(dll_list_t *list, int policy, int node, int flags);
+
+/** Move a list's item containers to a node
+ *
+ * Short for dll_numa_place(list, DLL_NUMA_BIND, node, DLL_COMPACT_INLINE).
+ * Data stored inline (see dll_append()) moves along with its container and
+ * references to it become invalid. Larger data stays where it is and
+ * references to it remain valid, use dll_numa_place() with
+ * DLL_COMPACT_DATA to move it as well.
+ *
+ * @param list       Pointer to the list
+ * @param node       Target node
+ *
+ * @return EDLLOK    No errors occured
+ * @return EDLLINV   An invalid argument has been passed
+ * @return EDLLNOMEM Unable to allocate enough memory
+ * @return EDLLERROR Something went wrong (e.g. no such node, no NUMA support)
+ */
+int dll_migrate(dll_list_t *list, int node);
+
+/** Find out which node the memory at an address is on
+ *
+ * The page is faulted in if it hasn't been touched yet.
+ *
+ * @param ptr        Any address, e.g. of an item or its data
+ * @param node       Where to store the node number
+ *
+ * @return EDLLOK    No errors occured
+ * @return EDLLINV   An invalid argument has been passed
+ * @return EDLLERROR Something went wrong (e.g. no NUMA support)
+ */
+int dll_numa_where(const void *ptr, int *node);
+
+#endif /* _DLL_NUMA_H */
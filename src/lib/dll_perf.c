@@ -0,0 +1,256 @@
+/*
+* Copyright (c) 2008, Björn Rehm (bjoern@shugaa.de)
+* 
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+* 
+* The above copyright notice and this permission notice shall be included in
+* all copies or substantial portions of the Software.
+* 
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+* THE SOFTWARE.
+*/
+
+#include <string.h>
+#include <unistd.h>
+
+#include "dll_list.h"
+#include "dll_perf.h"
+
+#ifdef DLL_HAVE_PERF_EVENT
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+#endif
+
+/* ######################################################################### */
+/*                            TODO / Notes                                   */
+/* ######################################################################### */
+
+/* ######################################################################### */
+/*                            Types & Defines                                */
+/* ######################################################################### */
+
+/* Indices into a reading, see PERF_FORMAT_TOTAL_TIME_* */
+#define PRV_VALUE       (0)
+#define PRV_ENABLED     (1)
+#define PRV_RUNNING     (2)
+
+/* ######################################################################### */
+/*                           Private interface (Module)                      */
+/* ######################################################################### */
+
+static int prv_open(unsigned int event);
+static int prv_read(int fd, uint64_t *reading);
+
+/* ######################################################################### */
+/*                           Implementation                                  */
+/* ######################################################################### */
+
+static const char *prv_names[DLL_PERF_NEVENTS] = {
+        "cycles",
+        "instructions",
+        "l1d_misses",
+        "llc_misses",
+        "dtlb_misses",
+        "branch_misses",
+};
+
+int dll_perf_init(dll_perf_t *perf)
+{
+        unsigned int i;
+        int rc = EDLLERROR;
+
+        if (!perf)
+                return EDLLINV;
+
+        memset(perf, 0, sizeof(dll_perf_t));
+
+        /* The events are opened one by one rather than as a group, so a
+         * single missing one doesn't take the others down with it */
+        for (i=0; i<DLL_PERF_NEVENTS; i++) {
+                perf->fd[i] = prv_open(i);
+                if (perf->fd[i] >= 0)
+                        rc = EDLLOK;
+        }
+
+        return rc;
+}
+
+int dll_perf_begin(dll_perf_t *perf)
+{
+        unsigned int i;
+
+        if (!perf)
+                return EDLLINV;
+
+        for (i=0; i<DLL_PERF_NEVENTS; i++) {
+                if (perf->fd[i] < 0)
+                        continue;
+
+                if (prv_read(perf->fd[i], perf->start[i]) != EDLLOK)
+                        memset(perf->start[i], 0, sizeof(perf->start[i]));
+        }
+
+        return EDLLOK;
+}
+
+int dll_perf_end(dll_perf_t *perf, unsigned long elements)
+{
+        unsigned int i;
+        uint64_t reading[3];
+        double value, enabled, running;
+
+        if (!perf)
+                return EDLLINV;
+
+        for (i=0; i<DLL_PERF_NEVENTS; i++) {
+                if (perf->fd[i] < 0)
+                        continue;
+                if (prv_read(perf->fd[i], reading) != EDLLOK)
+                        continue;
+
+                value = (double)(reading[PRV_VALUE] - perf->start[i][PRV_VALUE]);
+                enabled = (double)(reading[PRV_ENABLED] - perf->start[i][PRV_ENABLED]);
+                running = (double)(reading[PRV_RUNNING] - perf->start[i][PRV_RUNNING]);
+
+                /* The counter only ran for part of the region */
+                if ((running > 0.0) && (running < enabled))
+                        value *= enabled / running;
+
+                perf->count[i] += value;
+        }
+
+        perf->elements += elements;
+
+        return EDLLOK;
+}
+
+int dll_perf_get(dll_perf_t *perf, unsigned int event, double *value)
+{
+        if (!perf)
+                return EDLLINV;
+        if (event >= DLL_PERF_NEVENTS)
+                return EDLLINV;
+        if (!value)
+                return EDLLINV;
+
+        if (perf->fd[event] < 0)
+                return EDLLERROR;
+
+        *value = perf->count[event];
+        if (perf->elements > 0)
+                *value /= (double)perf->elements;
+
+        return EDLLOK;
+}
+
+const char *dll_perf_name(unsigned int event)
+{
+        if (event >= DLL_PERF_NEVENTS)
+                return NULL;
+
+        return prv_names[event];
+}
+
+int dll_perf_reset(dll_perf_t *perf)
+{
+        if (!perf)
+                return EDLLINV;
+
+        memset(perf->count, 0, sizeof(perf->count));
+        perf->elements = 0;
+
+        return EDLLOK;
+}
+
+int dll_perf_destroy(dll_perf_t *perf)
+{
+        unsigned int i;
+
+        if (!perf)
+                return EDLLINV;
+
+        for (i=0; i<DLL_PERF_NEVENTS; i++) {
+                if (perf->fd[i] >= 0)
+                        close(perf->fd[i]);
+                perf->fd[i] = -1;
+        }
+
+        return EDLLOK;
+}
+
+static int prv_open(unsigned int event)
+{
+#ifdef DLL_HAVE_PERF_EVENT
+        struct perf_event_attr attr;
+        int fd;
+
+        memset(&attr, 0, sizeof(attr));
+        attr.size = sizeof(attr);
+        attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED|PERF_FORMAT_TOTAL_TIME_RUNNING;
+        attr.exclude_kernel = 1;
+        attr.exclude_hv = 1;
+
+        switch (event) {
+        case DLL_PERF_CYCLES:
+                attr.type = PERF_TYPE_HARDWARE;
+                attr.config = PERF_COUNT_HW_CPU_CYCLES;
+                break;
+        case DLL_PERF_INSTRUCTIONS:
+                attr.type = PERF_TYPE_HARDWARE;
+                attr.config = PERF_COUNT_HW_INSTRUCTIONS;
+                break;
+        case DLL_PERF_L1DMISSES:
+                attr.type = PERF_TYPE_HW_CACHE;
+                attr.config = PERF_COUNT_HW_CACHE_L1D |
+                        (PERF_COUNT_HW_CACHE_OP_READ << 8) |
+                        (PERF_COUNT_HW_CACHE_RESULT_MISS << 16);
+                break;
+        case DLL_PERF_LLCMISSES:
+                attr.type = PERF_TYPE_HARDWARE;
+                attr.config = PERF_COUNT_HW_CACHE_MISSES;
+                break;
+        case DLL_PERF_DTLBMISSES:
+                attr.type = PERF_TYPE_HW_CACHE;
+                attr.config = PERF_COUNT_HW_CACHE_DTLB |
+                        (PERF_COUNT_HW_CACHE_OP_READ << 8) |
+                        (PERF_COUNT_HW_CACHE_RESULT_MISS << 16);
+                break;
+        case DLL_PERF_BRANCHMISSES:
+                attr.type = PERF_TYPE_HARDWARE;
+                attr.config = PERF_COUNT_HW_BRANCH_MISSES;
+                break;
+        default:
+                return -1;
+        }
+
+        /* Counting from here on, regions are told apart by reading the
+         * counters at both ends */
+        fd = (int)syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+        if (fd < 0)
+                return -1;
+
+        return fd;
+#else
+        (void)event;
+
+        return -1;
+#endif
+}
+
+static int prv_read(int fd, uint64_t *reading)
+{
+        if (read(fd, reading, 3*sizeof(uint64_t)) != (ssize_t)(3*sizeof(uint64_t)))
+                return EDLLERROR;
+
+        return EDLLOK;
+}
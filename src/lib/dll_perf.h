@@ -0,0 +1,146 @@
+/*
+* Copyright (c) 2008, Björn Rehm (bjoern@shugaa.de)
+* 
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+* 
+* The above copyright notice and this permission notice shall be included in
+* all copies or substantial portions of the Software.
+* 
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+* THE SOFTWARE.
+*/
+
+/** @file dll_perf.h
+ *
+ * @brief Hardware performance counters around list operations
+ *
+ * */
+
+#ifndef _DLL_PERF_H
+#define _DLL_PERF_H
+
+#include <stdint.h>
+
+#include "dll_list.h"
+
+/* ######################################################################### */
+/*                            TODO / Notes                                   */
+/* ######################################################################### */
+
+/* ######################################################################### */
+/*                            Types & Defines                                */
+/* ######################################################################### */
+
+/* Events counted by a profile */
+#define DLL_PERF_CYCLES         (0)     /* CPU cycles */
+#define DLL_PERF_INSTRUCTIONS   (1)     /* Instructions retired */
+#define DLL_PERF_L1DMISSES      (2)     /* L1 data cache read misses */
+#define DLL_PERF_LLCMISSES      (3)     /* Last level cache misses */
+#define DLL_PERF_DTLBMISSES     (4)     /* Data TLB read misses */
+#define DLL_PERF_BRANCHMISSES   (5)     /* Mispredicted branches */
+#define DLL_PERF_NEVENTS        (6)
+
+/** Profile type */
+typedef struct dll_perf dll_perf_t;
+
+struct dll_perf
+{
+        int flags;
+        int fd[DLL_PERF_NEVENTS];
+        uint64_t start[DLL_PERF_NEVENTS][3];
+        double count[DLL_PERF_NEVENTS];
+        unsigned long elements;
+};
+
+/* ######################################################################### */
+/*                            Public interface                               */
+/* ######################################################################### */
+
+/** Open the hardware counters for a profile
+ *
+ * Counters are opened for the calling thread (user space only) through
+ * Linux' perf_event_open(). Whatever isn't supported by the CPU, the kernel
+ * or the permissions at hand (see /proc/sys/kernel/perf_event_paranoid) is
+ * left out. If nothing can be counted at all EDLLERROR is returned, the
+ * profile may be used regardless, it just doesn't count anything. Pass it to
+ * dll_perf_destroy() in either case.
+ *
+ * @param perf       Pointer to a dll_perf_t to be initialized
+ *
+ * @return EDLLOK    No errors occured
+ * @return EDLLINV   An invalid argument has been passed
+ * @return EDLLERROR No counters available
+ */
+int dll_perf_init(dll_perf_t *perf);
+
+/** Start counting a region
+ *
+ * @param perf       Pointer to the profile
+ *
+ * @return EDLLOK    No errors occured
+ * @return EDLLINV   An invalid argument has been passed
+ */
+int dll_perf_begin(dll_perf_t *perf);
+
+/** Stop counting a region and add it to the profile's totals
+ *
+ * Counts are scaled up if the kernel had to multiplex the counters.
+ *
+ * @param perf       Pointer to the profile
+ * @param elements   Number of list elements the region dealt with
+ *
+ * @return EDLLOK    No errors occured
+ * @return EDLLINV   An invalid argument has been passed
+ */
+int dll_perf_end(dll_perf_t *perf, unsigned long elements);
+
+/** Get an event's count per element over all regions so far
+ *
+ * @param perf       Pointer to the profile
+ * @param event      One of the DLL_PERF_ event numbers
+ * @param value      Where to store the count per element (the total count if
+ *                   no elements have been passed to dll_perf_end())
+ *
+ * @return EDLLOK    No errors occured
+ * @return EDLLINV   An invalid argument has been passed
+ * @return EDLLERROR The event isn't counted
+ */
+int dll_perf_get(dll_perf_t *perf, unsigned int event, double *value);
+
+/** Get an event's name, e.g. "cycles"
+ *
+ * @param event      One of the DLL_PERF_ event numbers
+ *
+ * @return           Pointer to name string, NULL for an unknown event
+ */
+const char *dll_perf_name(unsigned int event);
+
+/** Set a profile's totals back to zero
+ *
+ * @param perf       Pointer to the profile
+ *
+ * @return EDLLOK    No errors occured
+ * @return EDLLINV   An invalid argument has been passed
+ */
+int dll_perf_reset(dll_perf_t *perf);
+
+/** Close a profile's counters
+ *
+ * @param perf       Pointer to the profile
+ *
+ * @return EDLLOK    No errors occured
+ * @return EDLLINV   An invalid argument has been passed
+ */
+int dll_perf_destroy(dll_perf_t *perf);
+
+#endif /* _DLL_PERF_H */
@@ -0,0 +1,200 @@
+/*
+* Copyright (c) 2008, Björn Rehm (bjoern@shugaa.de)
+* 
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+* 
+* The above copyright notice and this permission notice shall be included in
+* all copies or substantial portions of the Software.
+* 
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+* THE SOFTWARE.
+*/
+
+#include <string.h>
+#include <stdlib.h>
+
+#include "dll_config.h"
+#include "dll_list.h"
+#include "dll_list_prv.h"
+#include "dll_reduce.h"
+
+#ifdef DLL_HAVE_PTHREAD
+#include <pthread.h>
+#endif
+
+/* ######################################################################### */
+/*                            TODO / Notes                                   */
+/* ######################################################################### */
+
+/* ######################################################################### */
+/*                            Types & Defines                                */
+/* ######################################################################### */
+
+/** One partition of the list and the accumulator it is folded into */
+typedef struct {
+        dll_item_t *first;
+        dll_count_t count;
+        dll_fctmap_t map;
+        void *acc;
+#ifdef DLL_HAVE_PTHREAD
+        pthread_t thread;
+        int running;
+#endif
+} prv_reduce_part_t;
+
+/* ######################################################################### */
+/*                           Private interface (Module)                      */
+/* ######################################################################### */
+
+static void prv_reduce_fold(prv_reduce_part_t *part);
+#ifdef DLL_HAVE_PTHREAD
+static void *prv_reduce_thread(void *arg);
+#endif
+
+/* ######################################################################### */
+/*                           Implementation                                  */
+/* ######################################################################### */
+
+int dll_reduce(dll_list_t *list, dll_fctmap_t map, dll_fctcombine_t combine, 
+                const void *identity, void *result, size_t accsize, 
+                unsigned int nthreads)
+{
+        unsigned int i, step, nparts;
+        dll_count_t chunk;
+        size_t stride;
+        char *accmem, *accbase;
+        dll_item_t *item;
+        prv_reduce_part_t *parts;
+        prv_reduce_part_t single;
+
+        if (!list)
+                return EDLLINV;
+        if (!map)
+                return EDLLINV;
+        if (!combine)
+                return EDLLINV;
+        if (!identity)
+                return EDLLINV;
+        if (!result)
+                return EDLLINV;
+        if (nthreads == 0)
+                return EDLLINV;
+
+        memcpy(result, identity, accsize);
+
+#ifndef DLL_HAVE_PTHREAD
+        nthreads = 1;
+#endif
+
+        /* Nothing worth splitting up, fold everything right here */
+        nparts = (nthreads < list->count) ? nthreads : (unsigned int)list->count;
+        if (nparts <= 1) {
+                single.first = list->first;
+                single.count = list->count;
+                single.map = map;
+                single.acc = result;
+                prv_reduce_fold(&single);
+
+                return EDLLOK;
+        }
+
+        /* Every partial result gets its own cache line(s) so the threads don't
+         * invalidate each other's accumulators while folding */
+        stride = ((accsize + DLL_CACHELINE - 1) / DLL_CACHELINE) * DLL_CACHELINE;
+        if (stride == 0)
+                stride = DLL_CACHELINE;
+
+        parts = (prv_reduce_part_t*)malloc(nparts*sizeof(prv_reduce_part_t));
+        if (parts == NULL)
+                return EDLLNOMEM;
+
+        accmem = (char*)malloc(nparts*stride + DLL_CACHELINE);
+        if (accmem == NULL) {
+                free(parts);
+                return EDLLNOMEM;
+        }
+        accbase = accmem + ((DLL_CACHELINE - ((size_t)accmem % DLL_CACHELINE)) % DLL_CACHELINE);
+
+        /* Find the partition boundaries. This only chases next pointers, the
+         * payloads are left for the threads to touch. */
+        chunk = list->count / nparts;
+        item = list->first;
+        for (i=0; i<nparts; i++) {
+                dll_count_t j;
+
+                parts[i].first = item;
+                parts[i].count = (i == nparts-1) ? list->count - i*chunk : chunk;
+                parts[i].map = map;
+                parts[i].acc = accbase + i*stride;
+                memcpy(parts[i].acc, identity, accsize);
+
+                if (i < nparts-1)
+                        for (j=0; j<chunk; j++)
+                                item = item->next;
+        }
+
+#ifdef DLL_HAVE_PTHREAD
+        /* Partition 0 is done by the calling thread. If a thread can't be
+         * created its partition is folded here as well. */
+        for (i=1; i<nparts; i++) {
+                parts[i].running = (pthread_create(&parts[i].thread, NULL, 
+                                        prv_reduce_thread, &parts[i]) == 0);
+        }
+
+        prv_reduce_fold(&parts[0]);
+
+        for (i=1; i<nparts; i++) {
+                if (parts[i].running)
+                        pthread_join(parts[i].thread, NULL);
+                else
+                        prv_reduce_fold(&parts[i]);
+        }
+#else
+        for (i=0; i<nparts; i++)
+                prv_reduce_fold(&parts[i]);
+#endif
+
+        /* Merge the partials pairwise, keeping them in list order */
+        for (step=1; step<nparts; step*=2) {
+                for (i=0; i+step<nparts; i+=2*step)
+                        combine(parts[i].acc, parts[i+step].acc);
+        }
+
+        memcpy(result, parts[0].acc, accsize);
+
+        free(accmem);
+        free(parts);
+
+        return EDLLOK;
+}
+
+static void prv_reduce_fold(prv_reduce_part_t *part)
+{
+        dll_count_t i;
+        dll_item_t *item = part->first;
+        dll_fctmap_t map = part->map;
+        void *acc = part->acc;
+
+        for (i=0; i<part->count; i++) {
+                map(acc, item->data, item->datasize);
+                item = item->next;
+        }
+}
+
+#ifdef DLL_HAVE_PTHREAD
+static void *prv_reduce_thread(void *arg)
+{
+        prv_reduce_fold((prv_reduce_part_t*)arg);
+        return NULL;
+}
+#endif
@@ -0,0 +1,82 @@
+/*
+* Copyright (c) 2008, Björn Rehm (bjoern@shugaa.de)
+* 
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+* 
+* The above copyright notice and this permission notice shall be included in
+* all copies or substantial portions of the Software.
+* 
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+* THE SOFTWARE.
+*/
+
+/** @file dll_reduce.h
+ *
+ * @brief Aggregation over list items
+ *
+ * */
+
+#ifndef _DLL_REDUCE_H
+#define _DLL_REDUCE_H
+
+#include "dll_list.h"
+
+/* ######################################################################### */
+/*                            TODO / Notes                                   */
+/* ######################################################################### */
+
+/* ######################################################################### */
+/*                            Types & Defines                                */
+/* ######################################################################### */
+
+/** Map function prototype, folds one item's data into an accumulator */
+typedef void(*dll_fctmap_t)(void *acc, const void *data, size_t datasize);
+
+/** Combine function prototype, folds accumulator 'src' into 'acc' */
+typedef void(*dll_fctcombine_t)(void *acc, const void *src);
+
+/* ######################################################################### */
+/*                            Public interface                               */
+/* ######################################################################### */
+
+/** Reduce all items of a list to a single value
+ *
+ * The list is split into up to 'nthreads' consecutive partitions. Each
+ * partition is folded into its own copy of 'identity' by calling 'map' for
+ * every item, the partial results are kept on separate cache lines. The
+ * partials are then merged pairwise in list order using 'combine', which
+ * therefore has to be associative but need not be commutative.
+ *
+ * With nthreads == 1 (or without thread support) the whole list is folded in
+ * the calling thread by walking the item containers directly.
+ *
+ * The list must not be modified while the reduction is running.
+ *
+ * @param list       List to be reduced
+ * @param map        Pointer to function folding an item into an accumulator
+ * @param combine    Pointer to function merging two accumulators
+ * @param identity   Initial accumulator value (accsize bytes)
+ * @param result     Where to store the final accumulator value (accsize bytes)
+ * @param accsize    Size of an accumulator
+ * @param nthreads   Maximum number of threads to use
+ *
+ * @return EDLLOK    No errors occured
+ * @return EDLLINV   An invalid argument has been passed
+ * @return EDLLNOMEM Unable to allocate enough memory
+ * @return EDLLERROR Something went wrong
+ */
+int dll_reduce(dll_list_t *list, dll_fctmap_t map, dll_fctcombine_t combine, 
+                const void *identity, void *result, size_t accsize, 
+                unsigned int nthreads);
+
+#endif /* _DLL_REDUCE_H */
@@ -0,0 +1,326 @@
+/*
+* Copyright (c) 2008, Björn Rehm (bjoern@shugaa.de)
+* 
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+* 
+* The above copyright notice and this permission notice shall be included in
+* all copies or substantial portions of the Software.
+* 
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+* THE SOFTWARE.
+*/
+
+#include <stdlib.h>
+
+#include "dll_config.h"
+#include "dll_list.h"
+#include "dll_list_prv.h"
+#include "dll_sharded.h"
+
+#ifdef DLL_HAVE_PTHREAD
+#include <pthread.h>
+#include <unistd.h>
+#endif
+
+/* ######################################################################### */
+/*                            TODO / Notes                                   */
+/* ######################################################################### */
+
+/* ######################################################################### */
+/*                            Types & Defines                                */
+/* ######################################################################### */
+
+/** A shard, padded to a multiple of the cache line size in memory */
+typedef struct {
+        dll_list_t list;
+#ifdef DLL_HAVE_PTHREAD
+        pthread_mutex_t lock;
+#endif
+} prv_shard_t;
+
+#define PRV_SHARD_STRIDE \
+        (((sizeof(prv_shard_t) + DLL_CACHELINE - 1) / DLL_CACHELINE) * DLL_CACHELINE)
+
+/* Ordinals handed out to live threads are tracked up to this many, threads
+ * beyond that share them */
+#define PRV_ORDINAL_MAX         (1024)
+
+/* ######################################################################### */
+/*                           Private interface (Module)                      */
+/* ######################################################################### */
+
+static prv_shard_t *prv_shard(dll_sharded_t *sharded, unsigned int idx);
+static unsigned int prv_thread_ordinal(void);
+
+#ifdef DLL_HAVE_PTHREAD
+static void prv_ordinal_keyinit(void);
+static void prv_ordinal_release(void *val);
+
+static pthread_once_t prv_ordinal_once = PTHREAD_ONCE_INIT;
+static pthread_key_t prv_ordinal_key;
+static pthread_mutex_t prv_ordinal_lock = PTHREAD_MUTEX_INITIALIZER;
+static unsigned char prv_ordinal_used[PRV_ORDINAL_MAX];
+static unsigned int prv_ordinal_next = 0;
+#endif
+
+/* ######################################################################### */
+/*                           Implementation                                  */
+/* ######################################################################### */
+
+int dll_sharded_init(dll_sharded_t *sharded, unsigned int nshards)
+{
+        unsigned int i;
+
+        if (!sharded)
+                return EDLLINV;
+
+        if (nshards == 0) {
+                nshards = 1;
+#if defined(DLL_HAVE_PTHREAD) && defined(_SC_NPROCESSORS_ONLN)
+                {
+                        long ncpu = sysconf(_SC_NPROCESSORS_ONLN);
+                        if (ncpu > 0)
+                                nshards = (unsigned int)ncpu;
+                }
+#endif
+        }
+
+        sharded->mem = malloc(nshards*PRV_SHARD_STRIDE + DLL_CACHELINE);
+        if (sharded->mem == NULL)
+                return EDLLNOMEM;
+
+        /* Align the first shard to a cache line, the stride does the rest */
+        sharded->shards = (char*)sharded->mem + 
+                ((DLL_CACHELINE - ((size_t)sharded->mem % DLL_CACHELINE)) % DLL_CACHELINE);
+        sharded->nshards = nshards;
+
+        for (i=0; i<nshards; i++) {
+                prv_shard_t *shard = prv_shard(sharded, i);
+
+                dll_init(&shard->list);
+#ifdef DLL_HAVE_PTHREAD
+                pthread_mutex_init(&shard->lock, NULL);
+#endif
+        }
+
+        return EDLLOK;
+}
+
+int dll_sharded_destroy(dll_sharded_t *sharded)
+{
+        unsigned int i;
+
+        if (!sharded)
+                return EDLLINV;
+        if (sharded->mem == NULL)
+                return EDLLINV;
+
+        for (i=0; i<sharded->nshards; i++) {
+                prv_shard_t *shard = prv_shard(sharded, i);
+
+                dll_clear(&shard->list);
+#ifdef DLL_HAVE_PTHREAD
+                pthread_mutex_destroy(&shard->lock);
+#endif
+        }
+
+        free(sharded->mem);
+
+        sharded->mem = NULL;
+        sharded->shards = NULL;
+        sharded->nshards = 0;
+
+        return EDLLOK;
+}
+
+int dll_sharded_append(dll_sharded_t *sharded, void **data, size_t datasize)
+{
+        int rc;
+        prv_shard_t *shard;
+
+        if (!sharded)
+                return EDLLINV;
+        if (!data)
+                return EDLLINV;
+        if (sharded->mem == NULL)
+                return EDLLINV;
+
+        shard = prv_shard(sharded, prv_thread_ordinal() % sharded->nshards);
+
+        /* The lock is only ever contended if more threads append at a time
+         * than there are shards, it lives on the shard's own cache line */
+#ifdef DLL_HAVE_PTHREAD
+        pthread_mutex_lock(&shard->lock);
+#endif
+        rc = dll_append(&shard->list, data, datasize);
+#ifdef DLL_HAVE_PTHREAD
+        pthread_mutex_unlock(&shard->lock);
+#endif
+
+        return rc;
+}
+
+int dll_sharded_count(dll_sharded_t *sharded, dll_count_t *count)
+{
+        unsigned int i;
+
+        if (!sharded)
+                return EDLLINV;
+        if (!count)
+                return EDLLINV;
+
+        *count = 0;
+        for (i=0; i<sharded->nshards; i++)
+                *count += prv_shard(sharded, i)->list.count;
+
+        return EDLLOK;
+}
+
+int dll_sharded_collect(dll_sharded_t *sharded, dll_list_t *to)
+{
+        int rc = EDLLOK;
+        unsigned int i;
+
+        if (!sharded)
+                return EDLLINV;
+        if (!to)
+                return EDLLINV;
+
+        for (i=0; i<sharded->nshards; i++) {
+                prv_shard_t *shard = prv_shard(sharded, i);
+
+#ifdef DLL_HAVE_PTHREAD
+                pthread_mutex_lock(&shard->lock);
+#endif
+                rc = dll_splice(to, &shard->list);
+#ifdef DLL_HAVE_PTHREAD
+                pthread_mutex_unlock(&shard->lock);
+#endif
+                if (rc != EDLLOK)
+                        break;
+        }
+
+        if (rc != EDLLOK)
+                return EDLLERROR;
+
+        return EDLLOK;
+}
+
+int dll_sharded_iterator_init(dll_sharded_iterator_t *iterator, dll_sharded_t *sharded)
+{
+        if (!iterator)
+                return EDLLINV;
+        if (!sharded)
+                return EDLLINV;
+        if (sharded->mem == NULL)
+                return EDLLINV;
+
+        iterator->shard = 0;
+        iterator->sharded = sharded;
+
+        return dll_iterator_init(&iterator->it, &prv_shard(sharded, 0)->list);
+}
+
+int dll_sharded_iterator_next(dll_sharded_iterator_t *iterator, void **data, size_t *datasize)
+{
+        int rc;
+        int turned = 0;
+        unsigned int i;
+        dll_sharded_t *sharded;
+
+        if (!iterator)
+                return EDLLINV;
+        if (!data)
+                return EDLLINV;
+
+        sharded = iterator->sharded;
+
+        /* A shard iterator turning around or failing on an empty shard means
+         * we have to continue with the next shard. Visiting every shard once
+         * plus the one we started in is enough to find an item if there is
+         * any. */
+        for (i=0; i<=sharded->nshards; i++) {
+                rc = dll_iterator_next(&iterator->it, data, datasize);
+                if (rc == EDLLOK)
+                        return turned ? EDLLTILT : EDLLOK;
+
+                iterator->shard++;
+                if (iterator->shard == sharded->nshards) {
+                        iterator->shard = 0;
+                        turned = 1;
+                }
+
+                dll_iterator_init(&iterator->it, &prv_shard(sharded, iterator->shard)->list);
+        }
+
+        return EDLLERROR;
+}
+
+static prv_shard_t *prv_shard(dll_sharded_t *sharded, unsigned int idx)
+{
+        return (prv_shard_t*)((char*)sharded->shards + idx*PRV_SHARD_STRIDE);
+}
+
+/* Every thread gets a small number assigned the first time it appends to a
+ * sharded list, it picks the shard. It's the lowest one no other live
+ * thread has, and goes back when the thread exits. So n threads appending
+ * at a time always have n different ones, no matter how many came and
+ * went before. */
+static unsigned int prv_thread_ordinal(void)
+{
+#ifdef DLL_HAVE_PTHREAD
+        void *val;
+        unsigned int i;
+
+        pthread_once(&prv_ordinal_once, prv_ordinal_keyinit);
+
+        val = pthread_getspecific(prv_ordinal_key);
+        if (val == NULL) {
+                pthread_mutex_lock(&prv_ordinal_lock);
+                for (i=0; (i<PRV_ORDINAL_MAX) && prv_ordinal_used[i]; i++)
+                        ;
+                if (i < PRV_ORDINAL_MAX)
+                        prv_ordinal_used[i] = 1;
+                else
+                        i = PRV_ORDINAL_MAX + (prv_ordinal_next++ % PRV_ORDINAL_MAX);
+                pthread_mutex_unlock(&prv_ordinal_lock);
+
+                val = (void*)(size_t)(i + 1);
+                pthread_setspecific(prv_ordinal_key, val);
+        }
+
+        return (unsigned int)((size_t)val - 1);
+#else
+        return 0;
+#endif
+}
+
+#ifdef DLL_HAVE_PTHREAD
+static void prv_ordinal_keyinit(void)
+{
+        pthread_key_create(&prv_ordinal_key, prv_ordinal_release);
+}
+
+/* Runs when a thread which has an ordinal exits */
+static void prv_ordinal_release(void *val)
+{
+        size_t ordinal = (size_t)val - 1;
+
+        if (ordinal >= PRV_ORDINAL_MAX)
+                return;
+
+        pthread_mutex_lock(&prv_ordinal_lock);
+        prv_ordinal_used[ordinal] = 0;
+        pthread_mutex_unlock(&prv_ordinal_lock);
+}
+#endif
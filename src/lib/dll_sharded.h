@@ -0,0 +1,168 @@
+/*
+* Copyright (c) 2008, Björn Rehm (bjoern@shugaa.de)
+* 
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+* 
+* The above copyright notice and this permission notice shall be included in
+* all copies or substantial portions of the Software.
+* 
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+* THE SOFTWARE.
+*/
+
+/** @file dll_sharded.h
+ *
+ * @brief Sharded lists for concurrent appends
+ *
+ * */
+
+#ifndef _DLL_SHARDED_H
+#define _DLL_SHARDED_H
+
+#include "dll_list.h"
+
+/* ######################################################################### */
+/*                            TODO / Notes                                   */
+/* ######################################################################### */
+
+/* ######################################################################### */
+/*                            Types & Defines                                */
+/* ######################################################################### */
+
+/** Sharded list instance type */
+typedef struct dll_sharded dll_sharded_t;
+
+/** Sharded list iterator type */
+typedef struct dll_sharded_iterator dll_sharded_iterator_t;
+
+struct dll_sharded
+{
+        unsigned int nshards;
+        void *shards;
+        void *mem;
+};
+
+struct dll_sharded_iterator
+{
+        unsigned int shard;
+        dll_sharded_t *sharded;
+        dll_iterator_t it;
+};
+
+/* ######################################################################### */
+/*                            Public interface                               */
+/* ######################################################################### */
+
+/** Initialize a sharded list instance
+ *
+ * A sharded list keeps one sub-list per shard, each on its own cache lines.
+ * Every thread appends to the shard it has been assigned to, so threads
+ * appending concurrently don't contend as long as there are at least as many
+ * shards as threads using sharded lists at the same time. Shards are
+ * assigned when a thread first appends and become free again when it
+ * exits.
+ *
+ * @param sharded    Pointer to a dll_sharded_t to be initialized
+ * @param nshards    Number of shards, 0 to use one per online CPU
+ *
+ * @return EDLLOK    No errors occured
+ * @return EDLLINV   An invalid argument has been passed
+ * @return EDLLNOMEM Unable to allocate enough memory
+ * @return EDLLERROR Something went wrong
+ */
+int dll_sharded_init(dll_sharded_t *sharded, unsigned int nshards);
+
+/** Clear all items from all shards and release the shards themselves
+ *
+ * The instance needs to be initialized again before it can be reused.
+ *
+ * @param sharded    Pointer to the sharded list
+ *
+ * @return EDLLOK    No errors occured
+ * @return EDLLINV   An invalid argument has been passed
+ * @return EDLLERROR Something went wrong
+ */
+int dll_sharded_destroy(dll_sharded_t *sharded);
+
+/** Append an item to the calling thread's shard
+ *
+ * This function may be called from several threads at once.
+ *
+ * @param sharded    Pointer to the sharded list
+ * @param data       Where to store the reference to the allocated memory
+ * @param datasize   Size of memory to be allocated for this item's data    
+ *
+ * @return EDLLOK    No errors occured
+ * @return EDLLINV   An invalid argument has been passed
+ * @return EDLLNOMEM Unable to allocate enough memory
+ * @return EDLLERROR Something went wrong
+ */
+int dll_sharded_append(dll_sharded_t *sharded, void **data, size_t datasize);
+
+/** Get the total item count of all shards
+ *
+ * @param sharded    Pointer to the sharded list
+ * @param count      Pointer to a dll_count_t to store the count in
+ *
+ * @return EDLLOK    No errors occured
+ * @return EDLLINV   An invalid argument has been passed
+ * @return EDLLERROR Something went wrong
+ */
+int dll_sharded_count(dll_sharded_t *sharded, dll_count_t *count);
+
+/** Move the items of all shards to the end of a list
+ *
+ * Shards are relinked onto 'to' in shard order, each shard's items keep the
+ * order they were appended in. This takes O(shards) time, no data is copied.
+ * The shards are empty afterwards. Items from different threads are not
+ * put back into the order they were appended in, that would take a counter
+ * every append has to go through. Store a sequence number with the data
+ * and dll_sort() the result if it's needed.
+ *
+ * @param sharded    Pointer to the sharded list
+ * @param to         List the items are moved to
+ *
+ * @return EDLLOK    No errors occured
+ * @return EDLLINV   An invalid argument has been passed
+ * @return EDLLERROR Something went wrong
+ */
+int dll_sharded_collect(dll_sharded_t *sharded, dll_list_t *to);
+
+/** Create an iterator over all shards of a sharded list
+ *
+ * Shards are visited in shard order without being merged first. The sharded
+ * list must not be appended to while it's being iterated.
+ *
+ * @param iterator   Pointer to a dll_sharded_iterator_t to be initialized 
+ * @param sharded    Pointer to the sharded list
+ *
+ * @return EDLLOK    No errors occured
+ * @return EDLLINV   An invalid argument has been passed
+ * @return EDLLERROR Something went wrong
+ */
+int dll_sharded_iterator_init(dll_sharded_iterator_t *iterator, dll_sharded_t *sharded);
+
+/** Move the sharded iterator to the next position
+ *
+ * @param iterator   The iterator which is to be moved to the next element
+ * @param data       Storage for the reference to this item's data
+ * @param datasize   Size of the data BLOB
+ *
+ * @return EDLLOK    No errors occured
+ * @return EDLLINV   An invalid argument has been passed
+ * @return EDLLTILT  Iterator turnaround (jump from last to first item)
+ * @return EDLLERROR Something went wrong
+ */
+int dll_sharded_iterator_next(dll_sharded_iterator_t *iterator, void **data, size_t *datasize);
+
+#endif /* _DLL_SHARDED_H */
@@ -0,0 +1,388 @@
+/*
+* Copyright (c) 2008, Björn Rehm (bjoern@shugaa.de)
+* 
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+* 
+* The above copyright notice and this permission notice shall be included in
+* all copies or substantial portions of the Software.
+* 
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+* THE SOFTWARE.
+*/
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <sys/mman.h>
+
+#include "dll_list.h"
+#include "dll_list_prv.h"
+
+#ifdef DLL_LARGE_LISTS
+
+#ifdef DLL_HAVE_PTHREAD
+#include <pthread.h>
+#endif
+
+/* ######################################################################### */
+/*                            TODO / Notes                                   */
+/* ######################################################################### */
+
+/*
+ * With DLL_LARGE_LISTS item containers come from here instead of malloc().
+ * Every container, inline data included, fits into one DLL_SLAB_CHUNK, so
+ * chunks are simply carved off 2 MiB regions, one huge page each. The
+ * regions are backed by huge pages if the system has any to spare
+ * (MAP_HUGETLB), otherwise transparent huge pages are asked for. A list of
+ * a billion items walks through a few thousand TLB entries instead of
+ * millions.
+ *
+ * Regions are aligned to their size and start with a header, so a chunk's
+ * region is found by masking its address. Each region keeps its own free
+ * list and a count of the chunks handed out, the regions with chunks left
+ * are kept on a list of their own. All of that is shared and locked, but
+ * only touched in batches: every thread has a cache of free chunks which
+ * it allocates from and frees to, refilled from the regions
+ * PRV_SLAB_BATCH chunks at a time and flushed back once it holds twice as
+ * many. A thread's cache is flushed completely when it exits.
+ *
+ * A region none of whose chunks are handed out any more is unmapped, but
+ * for PRV_SLAB_KEEP of them which are kept for the next items allocated.
+ */
+
+/* ######################################################################### */
+/*                            Types & Defines                                */
+/* ######################################################################### */
+
+/** Regions are one huge page, aligned to it */
+#define PRV_SLAB_REGION         ((size_t)2*1024*1024)
+
+/** Chunks moved between a thread's cache and the regions in one go */
+#define PRV_SLAB_BATCH          (64)
+
+/** Regions with no chunk handed out which are kept for later */
+#define PRV_SLAB_KEEP           (1)
+
+typedef struct prv_region prv_region_t;
+
+/** Region header, only touched with the lock held */
+struct prv_region {
+        void *free;             /* Chunks given back, linked through their first word */
+        char *pos;              /* Rest of the region, never handed out yet */
+        size_t out;             /* Chunks in use or in thread caches */
+        prv_region_t *next;     /* Neighbours on the list of regions with chunks left */
+        prv_region_t *prev;
+};
+
+/** A thread's free chunks */
+typedef struct {
+        void *free;
+        unsigned int count;
+} prv_slabcache_t;
+
+/** The header takes up whole chunks, so the chunks behind it stay aligned */
+#define PRV_REGION_HDRSIZE \
+        (((sizeof(prv_region_t) + DLL_SLAB_CHUNK - 1) / DLL_SLAB_CHUNK) * DLL_SLAB_CHUNK)
+
+#define PRV_REGION(chunk) \
+        ((prv_region_t*)((uintptr_t)(chunk) & ~(uintptr_t)(PRV_SLAB_REGION - 1)))
+
+#define PRV_REGION_END(region) \
+        ((char*)(region) + PRV_REGION_HDRSIZE + \
+         ((PRV_SLAB_REGION - PRV_REGION_HDRSIZE) / DLL_SLAB_CHUNK) * DLL_SLAB_CHUNK)
+
+/* ######################################################################### */
+/*                           Private interface (Module)                      */
+/* ######################################################################### */
+
+static prv_slabcache_t *prv_cache(void);
+static void prv_refill(prv_slabcache_t *cache);
+static void prv_flush(prv_slabcache_t *cache, unsigned int n);
+static prv_region_t *prv_region(void);
+static void prv_list(prv_region_t *region);
+static void prv_unlist(prv_region_t *region);
+static void prv_lock(void);
+static void prv_unlock(void);
+
+static prv_region_t *prv_avail = NULL;  /* Regions with chunks left */
+static unsigned int prv_idle = 0;       /* Regions with none handed out */
+
+#ifdef DLL_HAVE_PTHREAD
+static void prv_keyinit(void);
+static void prv_cachedrop(void *cache);
+
+static pthread_mutex_t prv_slablock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_once_t prv_once = PTHREAD_ONCE_INIT;
+static pthread_key_t prv_key;
+#else
+static prv_slabcache_t prv_single = {NULL, 0};
+#endif
+
+/* ######################################################################### */
+/*                           Implementation                                  */
+/* ######################################################################### */
+
+void *dll_prv_slaballoc(void)
+{
+        prv_slabcache_t *cache;
+        void *chunk;
+
+        cache = prv_cache();
+        if (cache == NULL)
+                return NULL;
+
+        if (cache->free == NULL) {
+                prv_refill(cache);
+                if (cache->free == NULL)
+                        return NULL;
+        }
+
+        chunk = cache->free;
+        cache->free = *(void**)chunk;
+        cache->count--;
+
+        return chunk;
+}
+
+void dll_prv_slabfree(void *chunk)
+{
+        prv_slabcache_t *cache, single;
+
+        /* Without a cache of its own the chunk goes straight back */
+        cache = prv_cache();
+        if (cache == NULL) {
+                *(void**)chunk = NULL;
+                single.free = chunk;
+                single.count = 1;
+                prv_flush(&single, 1);
+                return;
+        }
+
+        *(void**)chunk = cache->free;
+        cache->free = chunk;
+        cache->count++;
+
+        if (cache->count >= 2*PRV_SLAB_BATCH)
+                prv_flush(cache, PRV_SLAB_BATCH);
+}
+
+/* The calling thread's cache, set up on first use */
+static prv_slabcache_t *prv_cache(void)
+{
+#ifdef DLL_HAVE_PTHREAD
+        prv_slabcache_t *cache;
+
+        pthread_once(&prv_once, prv_keyinit);
+
+        cache = (prv_slabcache_t*)pthread_getspecific(prv_key);
+        if (cache != NULL)
+                return cache;
+
+        cache = (prv_slabcache_t*)calloc(1, sizeof(prv_slabcache_t));
+        if (cache == NULL)
+                return NULL;
+
+        if (pthread_setspecific(prv_key, cache) != 0) {
+                free(cache);
+                return NULL;
+        }
+
+        return cache;
+#else
+        return &prv_single;
+#endif
+}
+
+/* Up to PRV_SLAB_BATCH chunks from the regions, the first of them that
+ * have any left */
+static void prv_refill(prv_slabcache_t *cache)
+{
+        prv_region_t *region;
+        void *chunk;
+
+        prv_lock();
+
+        while (cache->count < PRV_SLAB_BATCH) {
+                region = prv_avail;
+                if (region == NULL) {
+                        region = prv_region();
+                        if (region == NULL)
+                                break;
+                        prv_list(region);
+                        prv_idle++;
+                }
+
+                if (region->out == 0)
+                        prv_idle--;
+
+                while ((cache->count < PRV_SLAB_BATCH) && (region->free != NULL)) {
+                        chunk = region->free;
+                        region->free = *(void**)chunk;
+                        *(void**)chunk = cache->free;
+                        cache->free = chunk;
+                        cache->count++;
+                        region->out++;
+                }
+
+                while ((cache->count < PRV_SLAB_BATCH) && (region->pos < PRV_REGION_END(region))) {
+                        chunk = region->pos;
+                        region->pos += DLL_SLAB_CHUNK;
+                        *(void**)chunk = cache->free;
+                        cache->free = chunk;
+                        cache->count++;
+                        region->out++;
+                }
+
+                if ((region->free == NULL) && (region->pos == PRV_REGION_END(region)))
+                        prv_unlist(region);
+        }
+
+        prv_unlock();
+}
+
+/* Give n chunks back to their regions, releasing any that end up unused */
+static void prv_flush(prv_slabcache_t *cache, unsigned int n)
+{
+        prv_region_t *region;
+        void *chunk;
+
+        prv_lock();
+
+        for (; (n > 0) && (cache->free != NULL); n--) {
+                chunk = cache->free;
+                cache->free = *(void**)chunk;
+                cache->count--;
+
+                region = PRV_REGION(chunk);
+                if ((region->free == NULL) && (region->pos == PRV_REGION_END(region)))
+                        prv_list(region);
+
+                *(void**)chunk = region->free;
+                region->free = chunk;
+
+                if (--region->out > 0)
+                        continue;
+
+                if (prv_idle < PRV_SLAB_KEEP) {
+                        prv_idle++;
+                        continue;
+                }
+
+                prv_unlist(region);
+                munmap(region, PRV_SLAB_REGION);
+        }
+
+        prv_unlock();
+}
+
+/* A new region, its header set up and nothing handed out */
+static prv_region_t *prv_region(void)
+{
+        char *base, *aligned;
+        size_t head, tail;
+        prv_region_t *region;
+
+        aligned = NULL;
+
+#ifdef MAP_HUGETLB
+        /* Reserved huge pages, fails right away if there aren't enough. They
+         * may be larger than the region, then it wouldn't be aligned. */
+        base = (char*)mmap(NULL, PRV_SLAB_REGION, PROT_READ | PROT_WRITE,
+                        MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+        if (base != MAP_FAILED) {
+                if (((uintptr_t)base % PRV_SLAB_REGION) == 0)
+                        aligned = base;
+                else
+                        munmap(base, PRV_SLAB_REGION);
+        }
+#endif
+
+        /* Transparent huge pages need the region to be aligned to them */
+        if (aligned == NULL) {
+                base = (char*)mmap(NULL, 2*PRV_SLAB_REGION, PROT_READ | PROT_WRITE,
+                                MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+                if (base == MAP_FAILED)
+                        return NULL;
+
+                aligned = (char*)(((uintptr_t)base + PRV_SLAB_REGION - 1) & ~(uintptr_t)(PRV_SLAB_REGION - 1));
+                head = (size_t)(aligned - base);
+                tail = PRV_SLAB_REGION - head;
+
+                if (head > 0)
+                        munmap(base, head);
+                if (tail > 0)
+                        munmap(aligned + PRV_SLAB_REGION, tail);
+
+#ifdef MADV_HUGEPAGE
+                madvise(aligned, PRV_SLAB_REGION, MADV_HUGEPAGE);
+#endif
+        }
+
+        region = (prv_region_t*)aligned;
+        region->free = NULL;
+        region->pos = aligned + PRV_REGION_HDRSIZE;
+        region->out = 0;
+        region->next = NULL;
+        region->prev = NULL;
+
+        return region;
+}
+
+static void prv_list(prv_region_t *region)
+{
+        region->prev = NULL;
+        region->next = prv_avail;
+        if (prv_avail != NULL)
+                prv_avail->prev = region;
+        prv_avail = region;
+}
+
+static void prv_unlist(prv_region_t *region)
+{
+        if (region->prev != NULL)
+                region->prev->next = region->next;
+        else
+                prv_avail = region->next;
+
+        if (region->next != NULL)
+                region->next->prev = region->prev;
+}
+
+#ifdef DLL_HAVE_PTHREAD
+static void prv_keyinit(void)
+{
+        pthread_key_create(&prv_key, prv_cachedrop);
+}
+
+/* Thread exit, everything in the cache goes back */
+static void prv_cachedrop(void *cache)
+{
+        prv_flush((prv_slabcache_t*)cache, ((prv_slabcache_t*)cache)->count);
+        free(cache);
+}
+#endif
+
+static void prv_lock(void)
+{
+#ifdef DLL_HAVE_PTHREAD
+        pthread_mutex_lock(&prv_slablock);
+#endif
+}
+
+static void prv_unlock(void)
+{
+#ifdef DLL_HAVE_PTHREAD
+        pthread_mutex_unlock(&prv_slablock);
+#endif
+}
+
+#endif /* DLL_LARGE_LISTS */
@@ -0,0 +1,389 @@
+/*
+* Copyright (c) 2008, Björn Rehm (bjoern@shugaa.de)
+* 
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+* 
+* The above copyright notice and this permission notice shall be included in
+* all copies or substantial portions of the Software.
+* 
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+* THE SOFTWARE.
+*/
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "dll_config.h"
+#include "dll_list.h"
+#include "dll_list_prv.h"
+
+#ifdef DLL_HAVE_PTHREAD
+#include <pthread.h>
+#endif
+
+/* ######################################################################### */
+/*                            TODO / Notes                                   */
+/* ######################################################################### */
+
+/*
+ * A snapshot shares the whole chain of item containers with the list it
+ * was taken from. The chain carries a count of the lists sharing it, the
+ * first list to modify its items gets a private copy of the containers.
+ *
+ * Copying a single container isn't enough with a doubly linked list, its
+ * neighbours point to it and theirs to them. The copied containers still
+ * point to the same data though, and that's where the memory is. Shared
+ * data is reference counted through a slot in a global table, the slot's
+ * index lives in the item container.
+ *
+ * Inline data can't go with the copies, references to it have to stay
+ * valid. The copies point to it as hosted data instead (see DLL_ITEM_HOST)
+ * and it is counted like any other shared data. The block of the original
+ * container is freed with the last reference, the container proper may be
+ * gone long before.
+ */
+
+/* ######################################################################### */
+/*                            Types & Defines                                */
+/* ######################################################################### */
+
+/** A chain of containers shared by several lists */
+typedef struct {
+        unsigned int refs;
+} prv_chain_t;
+
+/* Reference count slots, allocated in pages which are never moved or
+ * freed so they can be used without holding the lock */
+#define PRV_SLOT_PAGEBITS       (16)
+#define PRV_SLOT_PAGESIZE       (1U << PRV_SLOT_PAGEBITS)
+#define PRV_SLOT_MAXPAGES       (1U << 14)
+
+#define PRV_SLOT(slot) \
+        (&prv_slotpages[(slot) >> PRV_SLOT_PAGEBITS][(slot) & (PRV_SLOT_PAGESIZE-1)])
+
+/* ######################################################################### */
+/*                           Private interface (Module)                      */
+/* ######################################################################### */
+
+static int prv_slotget(unsigned int *slot);
+static void prv_slotfree(unsigned int slot);
+static void prv_chain_release(dll_list_t *list, prv_chain_t *chain, dll_item_t *first);
+static dll_item_t *prv_rehome(dll_list_t *list, dll_item_t *item);
+static void prv_lock(void);
+static void prv_unlock(void);
+
+static unsigned int *prv_slotpages[PRV_SLOT_MAXPAGES];
+static unsigned int prv_slottop = 0;
+static unsigned int prv_slotnext = 0;   /* Free list head, slot index + 1 */
+
+#ifdef DLL_HAVE_PTHREAD
+static pthread_mutex_t prv_slotlock = PTHREAD_MUTEX_INITIALIZER;
+#endif
+
+/* ######################################################################### */
+/*                           Implementation                                  */
+/* ######################################################################### */
+
+int dll_snapshot(dll_list_t *from, dll_list_t *to)
+{
+        prv_chain_t *chain;
+
+        if (!from)
+                return EDLLINV;
+        if (!to)
+                return EDLLINV;
+        if (from == to)
+                return EDLLINV;
+        if (to->count != 0)
+                return EDLLINV;
+
+        DLL_TRACE(DLL_TRACE_SNAPSHOT, from, to, 0, 0);
+
+        if (from->count == 0)
+                return EDLLOK;
+
+        chain = (prv_chain_t*)from->share;
+        if (chain == NULL) {
+                chain = (prv_chain_t*)malloc(sizeof(prv_chain_t));
+                if (chain == NULL)
+                        return EDLLNOMEM;
+
+                chain->refs = 1;
+                from->share = chain;
+        }
+
+        DLL_ATOMIC_INC(&chain->refs);
+
+        to->count = from->count;
+        to->first = from->first;
+        to->last = from->last;
+        to->share = chain;
+
+        DLL_STATS_SET(to, bytes, from->stats.bytes);
+
+        return EDLLOK;
+}
+
+int dll_unshare(dll_list_t *list)
+{
+        unsigned int last;
+        void *data;
+        dll_item_t *item;
+
+        if (!list)
+                return EDLLINV;
+
+        DLL_TRACE(DLL_TRACE_UNSHARE, list, NULL, 0, 0);
+
+        if ((list->share != NULL) && (dll_prv_unshare(list) != EDLLOK))
+                return EDLLNOMEM;
+
+        /* The containers are ours now, make the data ours as well */
+        for (item = list->first; item != NULL; item = item->next) {
+                if (!(item->flags & DLL_ITEM_SHAREDDATA))
+                        continue;
+
+                /* Nobody else left, just drop the slot */
+                if (DLL_ATOMIC_LOAD(PRV_SLOT(item->slot)) == 1) {
+                        prv_slotfree(item->slot);
+                        item->flags &= ~DLL_ITEM_SHAREDDATA;
+                        continue;
+                }
+
+                /* Others are hosted by this container, leave it to them
+                 * and move to a new one */
+                if (item->flags & DLL_ITEM_INLINEDATA) {
+                        item = prv_rehome(list, item);
+                        if (item == NULL)
+                                return EDLLNOMEM;
+                        continue;
+                }
+
+                data = malloc(item->datasize);
+                if (data == NULL)
+                        return EDLLNOMEM;
+                memcpy(data, item->data, item->datasize);
+
+                /* The others may have let go in the meantime */
+                last = dll_prv_slotput(item->slot);
+                if (last) {
+                        item->flags &= ~DLL_ITEM_SHAREDDATA;
+                        dll_prv_datafree(list, item);
+                }
+
+                item->data = data;
+                DLL_HOOK_DATAALLOC(list, item);
+                item->flags &= ~(DLL_ITEM_SHAREDDATA|DLL_ITEM_ARENADATA|DLL_ITEM_TCACHEDATA|DLL_ITEM_HOSTEDDATA);
+        }
+
+        return EDLLOK;
+}
+
+int dll_prv_unshare(dll_list_t *list)
+{
+        prv_chain_t *chain;
+        dll_item_t *item, *itemnew, *first, *last;
+
+        chain = (prv_chain_t*)list->share;
+
+        /* Last one holding on to the chain, it's ours */
+        if (DLL_ATOMIC_LOAD(&chain->refs) == 1) {
+                free(chain);
+                list->share = NULL;
+                return EDLLOK;
+        }
+
+        /* Make sure every item's data is counted first. The counts belong
+         * to the shared containers, so failing later on leaves nothing to
+         * undo. */
+        prv_lock();
+        for (item = list->first; item != NULL; item = item->next) {
+                if (item->flags & DLL_ITEM_SHAREDDATA)
+                        continue;
+
+                if (prv_slotget(&item->slot) != EDLLOK) {
+                        prv_unlock();
+                        return EDLLNOMEM;
+                }
+
+                item->flags |= DLL_ITEM_SHAREDDATA;
+        }
+        prv_unlock();
+
+        /* Copy the containers, each copy takes a reference to the data */
+        first = last = NULL;
+        for (item = list->first; item != NULL; item = item->next) {
+                itemnew = (dll_item_t*)malloc(sizeof(dll_item_t));
+                if (itemnew == NULL)
+                        break;
+
+                *itemnew = *item;
+                itemnew->flags &= ~(DLL_ITEM_ARENA|DLL_ITEM_SLAB|DLL_ITEM_TCACHE);
+
+                if (item->flags & DLL_ITEM_INLINEDATA) {
+                        itemnew->flags &= ~DLL_ITEM_INLINEDATA;
+                        itemnew->flags |= DLL_ITEM_HOSTEDDATA;
+                }
+
+                DLL_ATOMIC_INC(PRV_SLOT(itemnew->slot));
+                DLL_HOOK_ITEMALLOC(list, itemnew);
+
+                itemnew->prev = last;
+                itemnew->next = NULL;
+                if (last != NULL)
+                        last->next = itemnew;
+                else
+                        first = itemnew;
+                last = itemnew;
+        }
+
+        if (item != NULL) {
+                for (item = first; item != NULL; item = itemnew) {
+                        itemnew = item->next;
+                        dll_prv_datafree(list, item);
+                        dll_prv_itemfree(list, item);
+                }
+                return EDLLNOMEM;
+        }
+
+        prv_chain_release(list, chain, list->first);
+
+        DLL_STATS_ADD(list, allocs, list->count);
+
+        list->first = first;
+        list->last = last;
+        list->share = NULL;
+
+        return EDLLOK;
+}
+
+void dll_prv_release(dll_list_t *list)
+{
+        prv_chain_release(list, (prv_chain_t*)list->share, list->first);
+
+        list->share = NULL;
+        list->count = 0;
+        list->first = NULL;
+        list->last = NULL;
+}
+
+int dll_prv_slotput(unsigned int slot)
+{
+        if (DLL_ATOMIC_DEC(PRV_SLOT(slot)) != 0)
+                return 0;
+
+        prv_slotfree(slot);
+
+        return 1;
+}
+
+static int prv_slotget(unsigned int *slot)
+{
+        unsigned int page;
+
+        /* Called with the lock held */
+        if (prv_slotnext != 0) {
+                *slot = prv_slotnext - 1;
+                prv_slotnext = *PRV_SLOT(*slot);
+        } else {
+                page = prv_slottop >> PRV_SLOT_PAGEBITS;
+                if (page >= PRV_SLOT_MAXPAGES)
+                        return EDLLNOMEM;
+
+                if (prv_slotpages[page] == NULL) {
+                        prv_slotpages[page] = (unsigned int*)malloc(PRV_SLOT_PAGESIZE*sizeof(unsigned int));
+                        if (prv_slotpages[page] == NULL)
+                                return EDLLNOMEM;
+                }
+
+                *slot = prv_slottop++;
+        }
+
+        *PRV_SLOT(*slot) = 1;
+
+        return EDLLOK;
+}
+
+static void prv_slotfree(unsigned int slot)
+{
+        prv_lock();
+        *PRV_SLOT(slot) = prv_slotnext;
+        prv_slotnext = slot + 1;
+        prv_unlock();
+}
+
+static void prv_chain_release(dll_list_t *list, prv_chain_t *chain, dll_item_t *first)
+{
+        dll_item_t *item, *itemnext;
+
+        if (DLL_ATOMIC_DEC(&chain->refs) != 0)
+                return;
+
+        /* Last one out */
+        for (item = first; item != NULL; item = itemnext) {
+                itemnext = item->next;
+                dll_prv_datafree(list, item);
+                dll_prv_itemfree(list, item);
+        }
+
+        free(chain);
+}
+
+/* Replace a container holding inline data others still refer to by one
+ * with a copy of the data of its own */
+static dll_item_t *prv_rehome(dll_list_t *list, dll_item_t *item)
+{
+        dll_item_t *itemnew;
+
+        itemnew = (dll_item_t*)malloc(DLL_ITEM_SIZE(item));
+        if (itemnew == NULL)
+                return NULL;
+
+        *itemnew = *item;
+        itemnew->data = (char*)itemnew + DLL_ITEM_INLINEOFF;
+        memcpy(itemnew->data, item->data, item->datasize);
+        itemnew->flags &= ~(DLL_ITEM_SHAREDDATA|DLL_ITEM_ARENA|DLL_ITEM_SLAB|DLL_ITEM_TCACHE);
+
+        DLL_STATS_SUB(list, bytes, dll_prv_itembytes(item));
+        DLL_STATS_ADD(list, bytes, dll_prv_itembytes(itemnew));
+        DLL_HOOK_ITEMALLOC(list, itemnew);
+        DLL_HOOK_DATAALLOC(list, itemnew);
+
+        if (itemnew->prev != NULL)
+                itemnew->prev->next = itemnew;
+        else
+                list->first = itemnew;
+
+        if (itemnew->next != NULL)
+                itemnew->next->prev = itemnew;
+        else
+                list->last = itemnew;
+
+        dll_prv_itemfree(list, item);
+
+        return itemnew;
+}
+
+static void prv_lock(void)
+{
+#ifdef DLL_HAVE_PTHREAD
+        pthread_mutex_lock(&prv_slotlock);
+#endif
+}
+
+static void prv_unlock(void)
+{
+#ifdef DLL_HAVE_PTHREAD
+        pthread_mutex_unlock(&prv_slotlock);
+#endif
+}
@@ -0,0 +1,457 @@
+/*
+* Copyright (c) 2008, Björn Rehm (bjoern@shugaa.de)
+* 
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+* 
+* The above copyright notice and this permission notice shall be included in
+* all copies or substantial portions of the Software.
+* 
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+* THE SOFTWARE.
+*/
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "dll_sorted.h"
+#include "dll_list_prv.h"
+
+/* ######################################################################### */
+/*                            TODO / Notes                                   */
+/* ######################################################################### */
+
+/*
+ * The bottom level of the skip list is the list itself, the items aren't
+ * touched apart from being linked in and out as usual. An item which draws
+ * a height of h > 0 (with probability 4^-h) gets a tower on the side, which
+ * links it into the h levels above. The towers only point at their items,
+ * not the other way round, so ordinary list code never notices them.
+ *
+ * A search goes down the towers and finishes along the items, which takes
+ * about three steps as every fourth item has a tower. Removing an item has
+ * to find its tower, if any, by searching for its key and then stepping
+ * over the towers of equal items.
+ *
+ * Unsharing the list (see dll_snapshot.c) replaces all the containers, the
+ * towers are simply built up again afterwards.
+ */
+
+/* ######################################################################### */
+/*                            Types & Defines                                */
+/* ######################################################################### */
+
+/** An item's links on the levels above the list */
+typedef struct dll_sorted_tower prv_tower_t;
+
+struct dll_sorted_tower
+{
+        dll_item_t *item;
+        unsigned int height;
+        prv_tower_t *next[1];   /* 'height' entries */
+};
+
+/** Size of a tower with h levels */
+#define PRV_TOWER_SIZE(h)       (sizeof(prv_tower_t) + ((h)-1)*sizeof(prv_tower_t*))
+
+/* ######################################################################### */
+/*                           Private interface (Module)                      */
+/* ######################################################################### */
+
+static dll_item_t *prv_seek(dll_sorted_t *sorted, const void *key, int upper, prv_tower_t **update);
+static prv_tower_t *prv_newtower(dll_item_t *item, unsigned int height);
+static unsigned int prv_height(dll_sorted_t *sorted);
+static void prv_freetowers(dll_sorted_t *sorted);
+static int prv_rebuild(dll_sorted_t *sorted);
+static int prv_unshare(dll_sorted_t *sorted);
+
+/* ######################################################################### */
+/*                           Implementation                                  */
+/* ######################################################################### */
+
+int dll_sorted_init(dll_sorted_t *sorted, dll_fctcompare_t compar)
+{
+        unsigned int i;
+
+        if (!sorted)
+                return EDLLINV;
+        if (!compar)
+                return EDLLINV;
+
+        dll_init(&sorted->list);
+
+        sorted->compar = compar;
+        sorted->levels = 0;
+        sorted->seed = 0x2545f491;
+
+        for (i=0; i<DLL_SORTED_LEVELS; i++)
+                sorted->head[i] = NULL;
+
+        return EDLLOK;
+}
+
+int dll_sorted_clear(dll_sorted_t *sorted)
+{
+        if (!sorted)
+                return EDLLINV;
+
+        prv_freetowers(sorted);
+
+        return dll_clear(&sorted->list);
+}
+
+int dll_insert_sorted(dll_sorted_t *sorted, void **data, size_t datasize, const void *src)
+{
+        unsigned int i, height;
+        dll_item_t *prev, *item;
+        prv_tower_t *tower = NULL;
+        prv_tower_t *update[DLL_SORTED_LEVELS];
+
+        if (!sorted)
+                return EDLLINV;
+        if (!src)
+                return EDLLINV;
+
+        if (prv_unshare(sorted) != EDLLOK)
+                return EDLLNOMEM;
+
+        /* Get the tower first, there's nothing to undo if that fails */
+        height = prv_height(sorted);
+        if (height > 0) {
+                tower = prv_newtower(NULL, height);
+                if (tower == NULL)
+                        return EDLLNOMEM;
+        }
+
+        prev = prv_seek(sorted, src, 1, update);
+
+        if (dll_prv_insertafter(&sorted->list, prev, &item, datasize) != EDLLOK) {
+                free(tower);
+                return EDLLNOMEM;
+        }
+
+        memcpy(item->data, src, datasize);
+
+        if (tower != NULL) {
+                tower->item = item;
+
+                /* Levels not in use yet start at the head */
+                for (i=sorted->levels; i<height; i++)
+                        update[i] = NULL;
+                if (height > sorted->levels)
+                        sorted->levels = height;
+
+                for (i=0; i<height; i++) {
+                        if (update[i] != NULL) {
+                                tower->next[i] = update[i]->next[i];
+                                update[i]->next[i] = tower;
+                        } else {
+                                tower->next[i] = sorted->head[i];
+                                sorted->head[i] = tower;
+                        }
+                }
+        }
+
+        if (data != NULL)
+                *data = item->data;
+
+        return EDLLOK;
+}
+
+int dll_find_sorted(dll_sorted_t *sorted, const void *cmpitem, dll_item_t **item)
+{
+        int rc;
+
+        rc = dll_lower_bound(sorted, cmpitem, item);
+        if (rc != EDLLOK)
+                return rc;
+
+        if (sorted->compar((*item)->data, cmpitem) != 0)
+                return EDLLERROR;
+
+        return EDLLOK;
+}
+
+int dll_lower_bound(dll_sorted_t *sorted, const void *cmpitem, dll_item_t **item)
+{
+        dll_item_t *prev;
+
+        if (!sorted)
+                return EDLLINV;
+        if (!cmpitem)
+                return EDLLINV;
+        if (!item)
+                return EDLLINV;
+
+        prev = prv_seek(sorted, cmpitem, 0, NULL);
+        *item = (prev != NULL) ? prev->next : sorted->list.first;
+
+        if (*item == NULL)
+                return EDLLERROR;
+
+        return EDLLOK;
+}
+
+int dll_remove_sorted(dll_sorted_t *sorted, dll_item_t *item)
+{
+        unsigned int i;
+        dll_count_t position = 0;
+        dll_item_t *itemseek;
+        prv_tower_t *tower, *next;
+        prv_tower_t *update[DLL_SORTED_LEVELS];
+
+        if (!sorted)
+                return EDLLINV;
+        if (!item)
+                return EDLLINV;
+
+        /* Unsharing replaces the containers, look the item up again */
+        if (sorted->list.share != NULL) {
+                for (itemseek = sorted->list.first; itemseek != item; itemseek = itemseek->next)
+                        position++;
+
+                if (prv_unshare(sorted) != EDLLOK)
+                        return EDLLNOMEM;
+
+                for (item = sorted->list.first; position > 0; position--)
+                        item = item->next;
+        }
+
+        if (sorted->levels > 0) {
+                prv_seek(sorted, item->data, 0, update);
+
+                /* The item's tower, if it has one, comes after those of the
+                 * items before it on the lowest level, possibly behind the
+                 * towers of some equal items */
+                tower = (update[0] != NULL) ? update[0]->next[0] : sorted->head[0];
+                while ((tower != NULL) && (tower->item != item) &&
+                                (sorted->compar(tower->item->data, item->data) == 0))
+                        tower = tower->next[0];
+
+                if ((tower != NULL) && (tower->item == item)) {
+                        for (i=0; i<tower->height; i++) {
+                                if (update[i] == NULL) {
+                                        if (sorted->head[i] == tower) {
+                                                sorted->head[i] = tower->next[i];
+                                                continue;
+                                        }
+                                        update[i] = sorted->head[i];
+                                }
+
+                                for (next = update[i]->next[i]; next != tower; next = next->next[i])
+                                        update[i] = next;
+
+                                update[i]->next[i] = tower->next[i];
+                        }
+
+                        free(tower);
+
+                        while ((sorted->levels > 0) && (sorted->head[sorted->levels-1] == NULL))
+                                sorted->levels--;
+                }
+        }
+
+        return dll_remove_item(&sorted->list, item);
+}
+
+int dll_range(dll_range_t *range, dll_sorted_t *sorted, const void *lo, const void *hi)
+{
+        dll_item_t *prev;
+
+        if (!range)
+                return EDLLINV;
+        if (!sorted)
+                return EDLLINV;
+
+        range->sorted = sorted;
+        range->hi = hi;
+
+        if (lo != NULL) {
+                prev = prv_seek(sorted, lo, 0, NULL);
+                range->item = (prev != NULL) ? prev->next : sorted->list.first;
+        } else {
+                range->item = sorted->list.first;
+        }
+
+        return EDLLOK;
+}
+
+int dll_range_next(dll_range_t *range, void **data, size_t *datasize)
+{
+        dll_item_t *item;
+
+        if (!range)
+                return EDLLINV;
+        if (!data)
+                return EDLLINV;
+
+        item = range->item;
+        if (item == NULL)
+                return EDLLERROR;
+
+        if ((range->hi != NULL) && (range->sorted->compar(item->data, range->hi) >= 0)) {
+                range->item = NULL;
+                return EDLLERROR;
+        }
+
+        range->item = item->next;
+
+        *data = item->data;
+        if (datasize != NULL)
+                *datasize = item->datasize;
+
+        return EDLLOK;
+}
+
+/* Find the last item less than key (upper == 0) or not greater than key
+ * (upper != 0), NULL if there is none. update[] receives the last tower
+ * before that on each level in use, NULL standing for the head. */
+static dll_item_t *prv_seek(dll_sorted_t *sorted, const void *key, int upper, prv_tower_t **update)
+{
+        int c;
+        unsigned int i;
+        dll_item_t *item, *next;
+        prv_tower_t *tower = NULL;
+        prv_tower_t *towernext;
+
+        for (i=sorted->levels; i-- > 0;) {
+                towernext = (tower != NULL) ? tower->next[i] : sorted->head[i];
+                while (towernext != NULL) {
+                        c = sorted->compar(towernext->item->data, key);
+                        if ((c > 0) || ((c == 0) && !upper))
+                                break;
+                        tower = towernext;
+                        towernext = tower->next[i];
+                }
+
+                if (update != NULL)
+                        update[i] = tower;
+        }
+
+        /* The last few steps are along the items themselves */
+        item = (tower != NULL) ? tower->item : NULL;
+        for (;;) {
+                next = (item != NULL) ? item->next : sorted->list.first;
+                if (next == NULL)
+                        break;
+
+                c = sorted->compar(next->data, key);
+                if ((c > 0) || ((c == 0) && !upper))
+                        break;
+
+                item = next;
+        }
+
+        return item;
+}
+
+static prv_tower_t *prv_newtower(dll_item_t *item, unsigned int height)
+{
+        prv_tower_t *tower;
+
+        tower = (prv_tower_t*)malloc(PRV_TOWER_SIZE(height));
+        if (tower == NULL)
+                return NULL;
+
+        tower->item = item;
+        tower->height = height;
+
+        return tower;
+}
+
+/* Number of levels above the list for a new item, h with probability
+ * 3/4 * 4^-h. Two bits of a xorshift generator per level. */
+static unsigned int prv_height(dll_sorted_t *sorted)
+{
+        unsigned int r, height = 0;
+
+        r = sorted->seed;
+        r ^= r << 13;
+        r ^= r >> 17;
+        r ^= r << 5;
+        sorted->seed = r;
+
+        while (((r & 3) == 0) && (height < DLL_SORTED_LEVELS)) {
+                height++;
+                r >>= 2;
+        }
+
+        return height;
+}
+
+static void prv_freetowers(dll_sorted_t *sorted)
+{
+        unsigned int i;
+        prv_tower_t *tower, *next;
+
+        /* Every tower is on the lowest level */
+        for (tower = sorted->head[0]; tower != NULL; tower = next) {
+                next = tower->next[0];
+                free(tower);
+        }
+
+        for (i=0; i<DLL_SORTED_LEVELS; i++)
+                sorted->head[i] = NULL;
+
+        sorted->levels = 0;
+}
+
+static int prv_rebuild(dll_sorted_t *sorted)
+{
+        unsigned int i, height;
+        dll_item_t *item;
+        prv_tower_t *tower;
+        prv_tower_t *last[DLL_SORTED_LEVELS];
+
+        prv_freetowers(sorted);
+
+        /* The items are in order already, append to each level */
+        for (item = sorted->list.first; item != NULL; item = item->next) {
+                height = prv_height(sorted);
+                if (height == 0)
+                        continue;
+
+                tower = prv_newtower(item, height);
+                if (tower == NULL) {
+                        prv_freetowers(sorted);
+                        return EDLLNOMEM;
+                }
+
+                for (i=0; i<height; i++) {
+                        tower->next[i] = NULL;
+                        if (i < sorted->levels)
+                                last[i]->next[i] = tower;
+                        else
+                                sorted->head[i] = tower;
+                        last[i] = tower;
+                }
+
+                if (height > sorted->levels)
+                        sorted->levels = height;
+        }
+
+        return EDLLOK;
+}
+
+/* Give the list its own containers, their towers have to be rebuilt */
+static int prv_unshare(dll_sorted_t *sorted)
+{
+        if (sorted->list.share == NULL)
+                return EDLLOK;
+
+        prv_freetowers(sorted);
+
+        if (dll_prv_unshare(&sorted->list) != EDLLOK)
+                return EDLLNOMEM;
+
+        return prv_rebuild(sorted);
+}
@@ -0,0 +1,191 @@
+/*
+* Copyright (c) 2008, Björn Rehm (bjoern@shugaa.de)
+* 
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+* 
+* The above copyright notice and this permission notice shall be included in
+* all copies or substantial portions of the Software.
+* 
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+* THE SOFTWARE.
+*/
+
+/** @file dll_sorted.h
+ *
+ * @brief Sorted lists with O(log n) insertion and lookup
+ *
+ * */
+
+#ifndef _DLL_SORTED_H
+#define _DLL_SORTED_H
+
+#include "dll_list.h"
+
+/* ######################################################################### */
+/*                            TODO / Notes                                   */
+/* ######################################################################### */
+
+/* ######################################################################### */
+/*                            Types & Defines                                */
+/* ######################################################################### */
+
+/** Skip list levels above the items, plenty for 4^16 items */
+#define DLL_SORTED_LEVELS       (16)
+
+/** Sorted list instance type */
+typedef struct dll_sorted dll_sorted_t;
+
+/** Range iterator type */
+typedef struct dll_range dll_range_t;
+
+struct dll_sorted
+{
+        dll_list_t list;
+        dll_fctcompare_t compar;
+        unsigned int levels;
+        unsigned int seed;
+        struct dll_sorted_tower *head[DLL_SORTED_LEVELS];
+};
+
+struct dll_range
+{
+        dll_sorted_t *sorted;
+        dll_item_t *item;
+        const void *hi;
+};
+
+/* ######################################################################### */
+/*                            Public interface                               */
+/* ######################################################################### */
+
+/** Initialize a sorted list instance
+ *
+ * A sorted list keeps its items in the order given by compar at all times.
+ * The items are those of an ordinary list, sorted->list, which can be read
+ * through the usual interface (iterators, dll_get(), dll_count(), ...). About
+ * every fourth item has a skip list tower on the side, these let the
+ * functions below find their way in O(log n) instead of walking the list.
+ *
+ * sorted->list must only be changed through the functions below. In
+ * particular it must not be compacted or placed (dll_compact(),
+ * dll_numa_place()), as that moves the items under the towers. Snapshots of
+ * it are fine.
+ *
+ * compar is called as compar(itemdata, cmpitem) when looking for cmpitem,
+ * see dll_indexof().
+ *
+ * @param sorted     Pointer to a dll_sorted_t to be initialized
+ * @param compar     Pointer to function comparing two data items
+ *
+ * @return EDLLOK    No errors occured
+ * @return EDLLINV   An invalid argument has been passed
+ * @return EDLLERROR Something went wrong
+ */
+int dll_sorted_init(dll_sorted_t *sorted, dll_fctcompare_t compar);
+
+/** Clear all items from a sorted list
+ *
+ * @param sorted     Pointer to the sorted list
+ *
+ * @return EDLLOK    No errors occured
+ * @return EDLLINV   An invalid argument has been passed
+ * @return EDLLERROR Something went wrong
+ */
+int dll_sorted_clear(dll_sorted_t *sorted);
+
+/** Insert a copy of some data at its place in a sorted list
+ *
+ * Unlike dll_append() and dll_insert() the data has to be known up front to
+ * find the place, so it's copied in from src. The new item goes behind any
+ * items comparing equal to it.
+ *
+ * @param sorted     Pointer to the sorted list
+ * @param data       Where to store the reference to the item's data, may be
+ *                   NULL
+ * @param datasize   Size of the data
+ * @param src        The data to copy into the new item
+ *
+ * @return EDLLOK    No errors occured
+ * @return EDLLINV   An invalid argument has been passed
+ * @return EDLLNOMEM Unable to allocate enough memory
+ * @return EDLLERROR Something went wrong
+ */
+int dll_insert_sorted(dll_sorted_t *sorted, void **data, size_t datasize, const void *src);
+
+/** Find the first item comparing equal to cmpitem
+ *
+ * @param sorted     Pointer to the sorted list
+ * @param cmpitem    What to look for
+ * @param item       Where to store the item
+ *
+ * @return EDLLOK    No errors occured
+ * @return EDLLINV   An invalid argument has been passed
+ * @return EDLLERROR No such item
+ */
+int dll_find_sorted(dll_sorted_t *sorted, const void *cmpitem, dll_item_t **item);
+
+/** Find the first item not less than cmpitem
+ *
+ * The items from there on can be walked through item->next.
+ *
+ * @param sorted     Pointer to the sorted list
+ * @param cmpitem    What to look for
+ * @param item       Where to store the item
+ *
+ * @return EDLLOK    No errors occured
+ * @return EDLLINV   An invalid argument has been passed
+ * @return EDLLERROR All items are less than cmpitem
+ */
+int dll_lower_bound(dll_sorted_t *sorted, const void *cmpitem, dll_item_t **item);
+
+/** Remove an item from a sorted list
+ *
+ * @param sorted     Pointer to the sorted list
+ * @param item       The item, as found by dll_find_sorted() for example
+ *
+ * @return EDLLOK    No errors occured
+ * @return EDLLINV   An invalid argument has been passed
+ * @return EDLLNOMEM Unable to allocate enough memory (shared lists only)
+ * @return EDLLERROR Something went wrong
+ */
+int dll_remove_sorted(dll_sorted_t *sorted, dll_item_t *item);
+
+/** Initialize an iterator over the items from lo up to but excluding hi
+ *
+ * Finding lo takes O(log n), each dll_range_next() after that one step.
+ * Like any iterator it must not be used after the list has been changed.
+ *
+ * @param range      Pointer to a dll_range_t to be initialized
+ * @param sorted     Pointer to the sorted list
+ * @param lo         Lowest item to return, NULL to start at the first one
+ * @param hi         First item not to return, NULL to go on to the end
+ *
+ * @return EDLLOK    No errors occured
+ * @return EDLLINV   An invalid argument has been passed
+ * @return EDLLERROR Something went wrong
+ */
+int dll_range(dll_range_t *range, dll_sorted_t *sorted, const void *lo, const void *hi);
+
+/** Get the next item of a range
+ *
+ * @param range      Pointer to the range iterator
+ * @param data       Where to store the reference to the item's data
+ * @param datasize   Where to store the data size, may be NULL
+ *
+ * @return EDLLOK    No errors occured
+ * @return EDLLINV   An invalid argument has been passed
+ * @return EDLLERROR The range is exhausted
+ */
+int dll_range_next(dll_range_t *range, void **data, size_t *datasize);
+
+#endif /* _DLL_SORTED_H */
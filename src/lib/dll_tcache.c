@@ -0,0 +1,315 @@
+/*
+* Copyright (c) 2008, Björn Rehm (bjoern@shugaa.de)
+* 
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+* 
+* The above copyright notice and this permission notice shall be included in
+* all copies or substantial portions of the Software.
+* 
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+* THE SOFTWARE.
+*/
+
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+
+#include "dll_list.h"
+#include "dll_list_prv.h"
+
+#ifdef DLL_THREAD_CACHE
+
+#if !defined(DLL_HAVE_PTHREAD) || !defined(__GNUC__)
+#error "DLL_THREAD_CACHE needs POSIX threads and GCC style atomics"
+#endif
+
+#ifdef DLL_LARGE_LISTS
+#error "DLL_THREAD_CACHE can't be combined with DLL_LARGE_LISTS"
+#endif
+
+#include <pthread.h>
+
+/* ######################################################################### */
+/*                            TODO / Notes                                   */
+/* ######################################################################### */
+
+/*
+ * With DLL_THREAD_CACHE item containers and small data come from here
+ * instead of malloc(). Threads building and tearing down lists of their own
+ * then never share an allocator lock.
+ *
+ * Every thread has a cache which owns a number of blocks. A block is carved
+ * into DLL_TCACHE_CHUNK sized chunks and starts with a header which refers
+ * to its owner, so a chunk's block and owner are found by masking its
+ * address. Each block keeps its own free list and a count of the chunks in
+ * use, the cache keeps a list of the blocks with free chunks. The owner
+ * frees to the block directly. Any other thread pushes the chunk onto the
+ * owner's return stack, which is lock-free: others only ever push, the
+ * owner takes the whole stack in one exchange once it has run out of free
+ * chunks.
+ *
+ * A cache holds on to PRV_TCACHE_KEEP blocks with no chunk in use, so a
+ * thread building and clearing a list over and over doesn't go to malloc()
+ * for every round. Any block emptied beyond that goes back to the system.
+ *
+ * Lists outlive the threads which built them, so a cache does too. When a
+ * thread exits its cache is put aside and the next thread without one
+ * adopts it, pending returns included.
+ */
+
+/* ######################################################################### */
+/*                            Types & Defines                                */
+/* ######################################################################### */
+
+/** Blocks are aligned to their size */
+#define PRV_TCACHE_BLOCK        ((size_t)64*1024)
+
+/** Empty blocks a cache keeps for later */
+#define PRV_TCACHE_KEEP         (4)
+
+typedef struct prv_tcache prv_tcache_t;
+typedef struct prv_block prv_block_t;
+
+struct prv_tcache {
+        /* The owning thread's, nobody else touches these */
+        prv_block_t *avail;     /* Blocks with free chunks */
+        unsigned int idle;      /* Blocks with none in use */
+        prv_tcache_t *next;     /* Next one put aside */
+
+        /* Pushed to by everybody else, keep it off the owner's line */
+        char pad[DLL_CACHELINE];
+        void *returned;
+};
+
+/** Block header, only ever touched by the owner */
+struct prv_block {
+        prv_tcache_t *owner;
+        void *free;             /* Chunks ready to go, linked through their first word */
+        unsigned int live;      /* Chunks in use or on their way back */
+        prv_block_t *next;      /* Neighbours on the owner's avail list */
+        prv_block_t *prev;
+};
+
+/** The header takes up whole chunks, so the chunks behind it stay aligned */
+#define PRV_BLOCK_HDRSIZE \
+        (((sizeof(prv_block_t) + DLL_TCACHE_CHUNK - 1) / DLL_TCACHE_CHUNK) * DLL_TCACHE_CHUNK)
+
+#define PRV_BLOCK(chunk) \
+        ((prv_block_t*)((uintptr_t)(chunk) & ~(uintptr_t)(PRV_TCACHE_BLOCK - 1)))
+
+/* ######################################################################### */
+/*                           Private interface (Module)                      */
+/* ######################################################################### */
+
+static prv_tcache_t *prv_cache(void);
+static int prv_block(prv_tcache_t *cache);
+static void prv_put(prv_tcache_t *cache, void *chunk);
+static void prv_drain(prv_tcache_t *cache);
+static void prv_unlist(prv_tcache_t *cache, prv_block_t *block);
+static void prv_keyinit(void);
+static void prv_putaside(void *cache);
+
+static pthread_once_t prv_once = PTHREAD_ONCE_INIT;
+static pthread_key_t prv_key;
+static pthread_mutex_t prv_asidelock = PTHREAD_MUTEX_INITIALIZER;
+static prv_tcache_t *prv_aside = NULL;  /* Caches of threads gone */
+
+/* ######################################################################### */
+/*                           Implementation                                  */
+/* ######################################################################### */
+
+void *dll_prv_tcachealloc(void)
+{
+        prv_tcache_t *cache;
+        prv_block_t *block;
+        void *chunk;
+
+        cache = prv_cache();
+        if (cache == NULL)
+                return NULL;
+
+        if (cache->avail == NULL) {
+                prv_drain(cache);
+                if ((cache->avail == NULL) && (prv_block(cache) != EDLLOK))
+                        return NULL;
+        }
+
+        block = cache->avail;
+        chunk = block->free;
+        block->free = *(void**)chunk;
+        if (block->live++ == 0)
+                cache->idle--;
+        if (block->free == NULL)
+                prv_unlist(cache, block);
+
+        return chunk;
+}
+
+void dll_prv_tcachefree(void *chunk)
+{
+        prv_tcache_t *owner = PRV_BLOCK(chunk)->owner;
+        void *head;
+
+        pthread_once(&prv_once, prv_keyinit);
+
+        if (owner == (prv_tcache_t*)pthread_getspecific(prv_key)) {
+                prv_put(owner, chunk);
+                return;
+        }
+
+        head = __atomic_load_n(&owner->returned, __ATOMIC_RELAXED);
+        do {
+                *(void**)chunk = head;
+        } while (!__atomic_compare_exchange_n(&owner->returned, &head, chunk, 1,
+                                __ATOMIC_RELEASE, __ATOMIC_RELAXED));
+}
+
+/* The calling thread's cache, set up (or adopted) on first use */
+static prv_tcache_t *prv_cache(void)
+{
+        prv_tcache_t *cache;
+        void *mem;
+
+        pthread_once(&prv_once, prv_keyinit);
+
+        cache = (prv_tcache_t*)pthread_getspecific(prv_key);
+        if (cache != NULL)
+                return cache;
+
+        pthread_mutex_lock(&prv_asidelock);
+        cache = prv_aside;
+        if (cache != NULL)
+                prv_aside = cache->next;
+        pthread_mutex_unlock(&prv_asidelock);
+
+        if (cache == NULL) {
+                if (posix_memalign(&mem, DLL_CACHELINE, sizeof(prv_tcache_t)) != 0)
+                        return NULL;
+                cache = (prv_tcache_t*)mem;
+                memset(cache, 0, sizeof(prv_tcache_t));
+        }
+
+        cache->next = NULL;
+        if (pthread_setspecific(prv_key, cache) != 0) {
+                prv_putaside(cache);
+                return NULL;
+        }
+
+        return cache;
+}
+
+/* A new block, all of its chunks free */
+static int prv_block(prv_tcache_t *cache)
+{
+        prv_block_t *block;
+        char *chunk, *end;
+        void *mem;
+
+        if (posix_memalign(&mem, PRV_TCACHE_BLOCK, PRV_TCACHE_BLOCK) != 0)
+                return EDLLNOMEM;
+
+        block = (prv_block_t*)mem;
+        block->owner = cache;
+        block->free = NULL;
+        block->live = 0;
+
+        /* Linked back to front, so they are handed out in address order */
+        end = (char*)mem + PRV_BLOCK_HDRSIZE;
+        chunk = end + ((PRV_TCACHE_BLOCK - PRV_BLOCK_HDRSIZE) / DLL_TCACHE_CHUNK) * DLL_TCACHE_CHUNK;
+        while (chunk > end) {
+                chunk -= DLL_TCACHE_CHUNK;
+                *(void**)chunk = block->free;
+                block->free = chunk;
+        }
+
+        block->prev = NULL;
+        block->next = cache->avail;
+        if (cache->avail != NULL)
+                cache->avail->prev = block;
+        cache->avail = block;
+        cache->idle++;
+
+        return EDLLOK;
+}
+
+/* A chunk back with its owner */
+static void prv_put(prv_tcache_t *cache, void *chunk)
+{
+        prv_block_t *block = PRV_BLOCK(chunk);
+
+        if (block->free == NULL) {
+                block->prev = NULL;
+                block->next = cache->avail;
+                if (cache->avail != NULL)
+                        cache->avail->prev = block;
+                cache->avail = block;
+        }
+
+        *(void**)chunk = block->free;
+        block->free = chunk;
+
+        if (--block->live > 0)
+                return;
+
+        if (cache->idle < PRV_TCACHE_KEEP) {
+                cache->idle++;
+                return;
+        }
+
+        prv_unlist(cache, block);
+        free(block);
+}
+
+/* Everything the others have given back, in one go */
+static void prv_drain(prv_tcache_t *cache)
+{
+        void *chunk, *next;
+
+        if (__atomic_load_n(&cache->returned, __ATOMIC_RELAXED) == NULL)
+                return;
+
+        chunk = __atomic_exchange_n(&cache->returned, NULL, __ATOMIC_ACQUIRE);
+        while (chunk != NULL) {
+                next = *(void**)chunk;
+                prv_put(cache, chunk);
+                chunk = next;
+        }
+}
+
+static void prv_unlist(prv_tcache_t *cache, prv_block_t *block)
+{
+        if (block->prev != NULL)
+                block->prev->next = block->next;
+        else
+                cache->avail = block->next;
+
+        if (block->next != NULL)
+                block->next->prev = block->prev;
+}
+
+static void prv_keyinit(void)
+{
+        pthread_key_create(&prv_key, prv_putaside);
+}
+
+/* Thread exit, chunks still in use elsewhere keep coming back to the cache
+ * and are picked up by whoever adopts it */
+static void prv_putaside(void *cache)
+{
+        pthread_mutex_lock(&prv_asidelock);
+        ((prv_tcache_t*)cache)->next = prv_aside;
+        prv_aside = (prv_tcache_t*)cache;
+        pthread_mutex_unlock(&prv_asidelock);
+}
+
+#endif /* DLL_THREAD_CACHE */
@@ -0,0 +1,347 @@
+/*
+* Copyright (c) 2008, Björn Rehm (bjoern@shugaa.de)
+* 
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+* 
+* The above copyright notice and this permission notice shall be included in
+* all copies or substantial portions of the Software.
+* 
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+* THE SOFTWARE.
+*/
+
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+
+#include "dll_config.h"
+#include "dll_list.h"
+#include "dll_list_prv.h"
+#include "dll_trace.h"
+
+#ifdef DLL_HAVE_PTHREAD
+#include <pthread.h>
+#endif
+
+/* ######################################################################### */
+/*                            TODO / Notes                                   */
+/* ######################################################################### */
+
+/*
+ * Records go into a buffer under the record lock, which also guards the id
+ * table. A full buffer is swapped for a spare one and written out after
+ * the record lock has been dropped, so other threads keep recording while
+ * it's being written. The write lock keeps the buffers in order: it's
+ * taken before the record lock is dropped and held until the buffer has
+ * been written and become the spare. Nobody waits for a write unless the
+ * other buffer fills up in the meantime.
+ *
+ * Ids are handed out on first use and records have to be written in call
+ * order for replays to work, so buffers per thread would need sequence
+ * numbers in the records and a merge when recording stops.
+ */
+
+/* ######################################################################### */
+/*                            Types & Defines                                */
+/* ######################################################################### */
+
+#define PRV_TRACE_BUFSIZE       (64*1024)
+#define PRV_TRACE_IDS           (1024)  /* Initial id table size, power of 2 */
+
+/** Id table entry, maps an address to its id */
+typedef struct {
+        const void *ptr;
+        uint32_t id;
+} prv_id_t;
+
+/* ######################################################################### */
+/*                           Private interface (Module)                      */
+/* ######################################################################### */
+
+static uint32_t prv_id(const void *ptr);
+static int prv_idgrow(void);
+static int prv_flush(void);
+static int prv_write(const void *buf, size_t size);
+static void prv_lock(void);
+static void prv_unlock(void);
+static void prv_writelock(void);
+static void prv_writeunlock(void);
+
+static int prv_fd = -1;
+static int prv_error;
+static int prv_writeerror; /* Under the write lock */
+static unsigned char *prv_buf = NULL;
+static unsigned char *prv_spare = NULL; /* Under the write lock */
+static size_t prv_fill;
+static prv_id_t *prv_ids;
+static size_t prv_idsize;
+static uint32_t prv_nextid;
+
+#ifdef DLL_HAVE_PTHREAD
+static pthread_mutex_t prv_tracelock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_mutex_t prv_writemutex = PTHREAD_MUTEX_INITIALIZER;
+#endif
+
+/* ######################################################################### */
+/*                           Implementation                                  */
+/* ######################################################################### */
+
+int dll_prv_tracing = 0;
+
+int dll_trace_start(int fd)
+{
+        uint32_t version = DLL_TRACE_VERSION;
+
+        if (fd < 0)
+                return EDLLINV;
+        if (prv_buf != NULL)
+                return EDLLERROR;
+
+        prv_buf = (unsigned char*)malloc(PRV_TRACE_BUFSIZE);
+        prv_spare = (unsigned char*)malloc(PRV_TRACE_BUFSIZE);
+        prv_ids = (prv_id_t*)calloc(PRV_TRACE_IDS, sizeof(prv_id_t));
+        if ((prv_buf == NULL) || (prv_spare == NULL) || (prv_ids == NULL)) {
+                free(prv_buf);
+                free(prv_spare);
+                free(prv_ids);
+                prv_buf = NULL;
+                prv_spare = NULL;
+                return EDLLNOMEM;
+        }
+
+        prv_fd = fd;
+        prv_error = EDLLOK;
+        prv_writeerror = EDLLOK;
+        prv_idsize = PRV_TRACE_IDS;
+        prv_nextid = 1;
+
+        memcpy(prv_buf, DLL_TRACE_MAGIC, 4);
+        memcpy(prv_buf + 4, &version, sizeof(version));
+        prv_fill = 4 + sizeof(version);
+
+        if (prv_flush() != EDLLOK) {
+                free(prv_buf);
+                free(prv_spare);
+                free(prv_ids);
+                prv_buf = NULL;
+                prv_spare = NULL;
+                return EDLLIO;
+        }
+
+        dll_prv_tracing = 1;
+
+        return EDLLOK;
+}
+
+int dll_trace_stop(void)
+{
+        int rc;
+
+        prv_lock();
+
+        if (prv_buf == NULL) {
+                prv_unlock();
+                return EDLLERROR;
+        }
+
+        dll_prv_tracing = 0;
+
+        /* After whatever is being written already */
+        prv_writelock();
+        if (prv_error == EDLLOK)
+                prv_error = prv_writeerror;
+        if ((prv_error == EDLLOK) && (prv_flush() != EDLLOK))
+                prv_error = EDLLIO;
+        prv_writeunlock();
+        rc = prv_error;
+
+        free(prv_buf);
+        free(prv_spare);
+        free(prv_ids);
+        prv_buf = NULL;
+        prv_spare = NULL;
+        prv_ids = NULL;
+        prv_fd = -1;
+
+        prv_unlock();
+
+        return rc;
+}
+
+void dll_prv_record(unsigned int op, const void *obj, const void *other, size_t arg, size_t datasize)
+{
+        dll_trace_record_t *rec;
+        unsigned char *full;
+        size_t size;
+
+        prv_lock();
+
+        /* Somebody stopped recording in the meantime */
+        if (!dll_prv_tracing) {
+                prv_unlock();
+                return;
+        }
+
+        rec = (dll_trace_record_t*)(prv_buf + prv_fill);
+        memset(rec, 0, sizeof(dll_trace_record_t));
+        rec->op = (uint8_t)op;
+        rec->id = prv_id(obj);
+        if (other != NULL)
+                rec->arg = prv_id(other);
+        else
+                rec->arg = (arg > UINT32_MAX) ? UINT32_MAX : (uint32_t)arg;
+        rec->datasize = (datasize > UINT32_MAX) ? UINT32_MAX : (uint32_t)datasize;
+
+        if ((rec->id == 0) || ((rec->arg == 0) && (other != NULL))) {
+                prv_error = EDLLNOMEM;
+                dll_prv_tracing = 0;
+        } else {
+                prv_fill += sizeof(dll_trace_record_t);
+        }
+
+        if (prv_fill + sizeof(dll_trace_record_t) <= PRV_TRACE_BUFSIZE) {
+                prv_unlock();
+                return;
+        }
+
+        /* Swap buffers and write the full one without holding up others */
+        prv_writelock();
+        if (prv_writeerror != EDLLOK) {
+                prv_error = prv_writeerror;
+                dll_prv_tracing = 0;
+                prv_writeunlock();
+                prv_unlock();
+                return;
+        }
+        full = prv_buf;
+        size = prv_fill;
+        prv_buf = prv_spare;
+        prv_fill = 0;
+        prv_unlock();
+
+        if (prv_write(full, size) != EDLLOK)
+                prv_writeerror = EDLLIO;
+        prv_spare = full;
+        prv_writeunlock();
+}
+
+static uint32_t prv_id(const void *ptr)
+{
+        size_t i, mask = prv_idsize - 1;
+
+        /* Open addressing, the table is kept at most half full */
+        i = (size_t)(((uintptr_t)ptr >> 4) * 2654435761U) & mask;
+        while (prv_ids[i].ptr != NULL) {
+                if (prv_ids[i].ptr == ptr)
+                        return prv_ids[i].id;
+                i = (i + 1) & mask;
+        }
+
+        if (2*prv_nextid > prv_idsize) {
+                if (prv_idgrow() != EDLLOK)
+                        return 0;
+                return prv_id(ptr);
+        }
+
+        prv_ids[i].ptr = ptr;
+        prv_ids[i].id = prv_nextid++;
+
+        return prv_ids[i].id;
+}
+
+static int prv_idgrow(void)
+{
+        size_t i, j, mask, size = prv_idsize;
+        prv_id_t *ids = prv_ids;
+
+        prv_ids = (prv_id_t*)calloc(2*size, sizeof(prv_id_t));
+        if (prv_ids == NULL) {
+                prv_ids = ids;
+                return EDLLNOMEM;
+        }
+
+        prv_idsize = 2*size;
+        mask = prv_idsize - 1;
+
+        for (i=0; i<size; i++) {
+                if (ids[i].ptr == NULL)
+                        continue;
+
+                j = (size_t)(((uintptr_t)ids[i].ptr >> 4) * 2654435761U) & mask;
+                while (prv_ids[j].ptr != NULL)
+                        j = (j + 1) & mask;
+                prv_ids[j] = ids[i];
+        }
+
+        free(ids);
+
+        return EDLLOK;
+}
+
+static int prv_flush(void)
+{
+        int rc;
+
+        rc = prv_write(prv_buf, prv_fill);
+        prv_fill = 0;
+
+        return rc;
+}
+
+static int prv_write(const void *buf, size_t size)
+{
+        ssize_t n;
+        const unsigned char *pos = (const unsigned char*)buf;
+
+        while (size > 0) {
+                n = write(prv_fd, pos, size);
+                if ((n < 0) && (errno == EINTR))
+                        continue;
+                if (n <= 0)
+                        return EDLLIO;
+
+                pos += n;
+                size -= (size_t)n;
+        }
+
+        return EDLLOK;
+}
+
+static void prv_lock(void)
+{
+#ifdef DLL_HAVE_PTHREAD
+        pthread_mutex_lock(&prv_tracelock);
+#endif
+}
+
+static void prv_unlock(void)
+{
+#ifdef DLL_HAVE_PTHREAD
+        pthread_mutex_unlock(&prv_tracelock);
+#endif
+}
+
+static void prv_writelock(void)
+{
+#ifdef DLL_HAVE_PTHREAD
+        pthread_mutex_lock(&prv_writemutex);
+#endif
+}
+
+static void prv_writeunlock(void)
+{
+#ifdef DLL_HAVE_PTHREAD
+        pthread_mutex_unlock(&prv_writemutex);
+#endif
+}
@@ -0,0 +1,122 @@
+/*
+* Copyright (c) 2008, Björn Rehm (bjoern@shugaa.de)
+* 
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+* 
+* The above copyright notice and this permission notice shall be included in
+* all copies or substantial portions of the Software.
+* 
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+* THE SOFTWARE.
+*/
+
+/** @file dll_trace.h
+ *
+ * @brief Recording list operations for later replay
+ *
+ * */
+
+#ifndef _DLL_TRACE_H
+#define _DLL_TRACE_H
+
+#include <stdint.h>
+
+#include "dll_list.h"
+
+/* ######################################################################### */
+/*                            TODO / Notes                                   */
+/* ######################################################################### */
+
+/* ######################################################################### */
+/*                            Types & Defines                                */
+/* ######################################################################### */
+
+/** First bytes of a trace, followed by DLL_TRACE_VERSION as a uint32_t in
+ * the recording machine's byte order */
+#define DLL_TRACE_MAGIC         "DLLT"
+#define DLL_TRACE_VERSION       (1)
+
+/* Recorded operations. Calls made up of other calls (e.g. dll_extend(),
+ * dll_get(), dll_compact()) show up as what they are made of. */
+#define DLL_TRACE_INIT          (1)     /* id */
+#define DLL_TRACE_CLEAR         (2)     /* id */
+#define DLL_TRACE_APPEND        (3)     /* id, datasize */
+#define DLL_TRACE_SPLICE        (4)     /* id, arg: id of the extension */
+#define DLL_TRACE_INSERT        (5)     /* id, arg: position, datasize */
+#define DLL_TRACE_REMOVE        (6)     /* id, arg: position */
+#define DLL_TRACE_COUNT         (7)     /* id */
+#define DLL_TRACE_SORT          (8)     /* id */
+#define DLL_TRACE_REVERSE       (9)     /* id */
+#define DLL_TRACE_ITERINIT      (10)    /* id: iterator, arg: id of the list */
+#define DLL_TRACE_ITERNEXT      (11)    /* id: iterator */
+#define DLL_TRACE_ITERPREV      (12)    /* id: iterator */
+#define DLL_TRACE_ITERNEXTBATCH (13)    /* id: iterator, arg: n */
+#define DLL_TRACE_ITERPREVBATCH (14)    /* id: iterator, arg: n */
+#define DLL_TRACE_SNAPSHOT      (15)    /* id, arg: id of the snapshot */
+#define DLL_TRACE_UNSHARE       (16)    /* id */
+#define DLL_TRACE_COMPACTINIT   (17)    /* id: compactor, arg: id of the list, datasize: flags */
+#define DLL_TRACE_COMPACTSTEP   (18)    /* id: compactor, arg: n */
+#define DLL_TRACE_MERGE         (19)    /* id, arg: id of the list merged in */
+
+/** Trace record type */
+typedef struct dll_trace_record dll_trace_record_t;
+
+/* Lists, iterators and compactors are told apart by ids handed out in the
+ * order they are first seen, starting at 1. An id stays with an address,
+ * a list initialized again at the same address keeps its id. Positions,
+ * counts and sizes beyond UINT32_MAX are recorded as UINT32_MAX. */
+struct dll_trace_record
+{
+        uint8_t op;
+        uint8_t reserved[3];
+        uint32_t id;
+        uint32_t arg;
+        uint32_t datasize;
+};
+
+/* ######################################################################### */
+/*                            Public interface                               */
+/* ######################################################################### */
+
+/** Start recording list operations
+ *
+ * From here on every call to the list, iterator, snapshot and compaction
+ * functions of the whole process is written to fd as a dll_trace_record_t,
+ * following a header made up of DLL_TRACE_MAGIC and DLL_TRACE_VERSION.
+ * Records are buffered, they only all make it to fd with
+ * dll_trace_stop(). Item data and comparators are not recorded. Start and
+ * stop recording while no other thread is using the library.
+ *
+ * @param fd         File descriptor open for writing
+ *
+ * @return EDLLOK    No errors occured
+ * @return EDLLINV   An invalid argument has been passed
+ * @return EDLLNOMEM Unable to allocate enough memory
+ * @return EDLLIO    Writing the header failed
+ * @return EDLLERROR Already recording
+ */
+int dll_trace_start(int fd);
+
+/** Stop recording and flush what's left
+ *
+ * If recording had to stop early because memory ran out or fd couldn't be
+ * written to, this is where it's reported.
+ *
+ * @return EDLLOK    No errors occured
+ * @return EDLLNOMEM Recording stopped early, out of memory
+ * @return EDLLIO    Recording stopped early, input/output error
+ * @return EDLLERROR Not recording
+ */
+int dll_trace_stop(void);
+
+#endif /* _DLL_TRACE_H */
@@ -0,0 +1,295 @@
+/*
+* Copyright (c) 2008, Björn Rehm (bjoern@shugaa.de)
+* 
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+* 
+* The above copyright notice and this permission notice shall be included in
+* all copies or substantial portions of the Software.
+* 
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+* THE SOFTWARE.
+*/
+
+/** @file dll_typed.h
+ *
+ * @brief Generator for lists of a fixed element type
+ *
+ * */
+
+#ifndef _DLL_TYPED_H
+#define _DLL_TYPED_H
+
+#include <stdlib.h>
+#include <stddef.h>
+
+#include "dll_list.h"
+#include "dll_inline.h"
+
+/* ######################################################################### */
+/*                            TODO / Notes                                   */
+/* ######################################################################### */
+
+/*
+ * A generic list item is a container plus a separately allocated payload,
+ * with its size kept along. When every element has the same type neither
+ * is needed: the node embeds the element, is allocated in one go and the
+ * comparator can be called directly instead of through a pointer.
+ *
+ * Typed lists are a separate type, they don't mix with dll_list_t and the
+ * hooks, statistics and tracing of the library don't see them.
+ */
+
+/* ######################################################################### */
+/*                            Types & Defines                                */
+/* ######################################################################### */
+
+/** Walk a typed list from the first to the last node
+ *
+ * @code
+ * DLL_DEFINE_TYPED(ilist, int, icmp)
+ *
+ * ilist_node_t *node;
+ *
+ * DLL_TYPED_FOREACH(&list, node)
+ *         sum += node->value;
+ * @endcode
+ *
+ * The current node may be removed inside the loop only if the next one has
+ * been saved before, the list must not be modified otherwise.
+ *
+ * @param list       Pointer to the typed list
+ * @param node       Node pointer variable
+ */
+#define DLL_TYPED_FOREACH(list, node) \
+        for ((node) = (list)->first; (node) != NULL; (node) = (node)->next)
+
+/** Walk a typed list from the last to the first node
+ *
+ * @see DLL_TYPED_FOREACH
+ */
+#define DLL_TYPED_FOREACH_REVERSE(list, node) \
+        for ((node) = (list)->last; (node) != NULL; (node) = (node)->prev)
+
+/** Define a list type for elements of type T
+ *
+ * Emits these types and functions, all of them static inline:
+ *
+ * @code
+ * typedef struct { name_node_t *prev, *next; T value; } name_node_t;
+ * typedef struct { dll_count_t count; name_node_t *first, *last; } name_t;
+ *
+ * int name_init(name_t *list);
+ * int name_clear(name_t *list);
+ * int name_append(name_t *list, T **data);
+ * int name_remove(name_t *list, T *data);
+ * int name_count(name_t *list, dll_count_t *count);
+ * int name_sort(name_t *list);
+ * @endcode
+ *
+ * The functions behave like their dll_ counterparts. name_append() hands
+ * out a pointer to the new element which is to be filled in by the caller,
+ * name_remove() takes such a pointer and unlinks its node in constant time.
+ * name_sort() is a stable merge sort.
+ *
+ * cmp is called as cmp(const T *a, const T *b) and returns less than, equal
+ * to or greater than zero like the comparators of dll_sort(). It may be a
+ * function or a function-like macro, either way the compiler gets to see
+ * and inline it.
+ *
+ * Use it once at file scope per element type:
+ *
+ * @code
+ * static int icmp(const int *a, const int *b)
+ * {
+ *         return (*a > *b) - (*a < *b);
+ * }
+ *
+ * DLL_DEFINE_TYPED(ilist, int, icmp)
+ * @endcode
+ *
+ * @param name       Prefix of the generated types and functions
+ * @param T          Element type
+ * @param cmp        Comparator for name_sort()
+ */
+#define DLL_DEFINE_TYPED(name, T, cmp) \
+ \
+typedef struct name##_node name##_node_t; \
+ \
+struct name##_node \
+{ \
+        name##_node_t *prev; \
+        name##_node_t *next; \
+        T value; \
+}; \
+ \
+typedef struct name \
+{ \
+        dll_count_t count; \
+        name##_node_t *first; \
+        name##_node_t *last; \
+} name##_t; \
+ \
+DLL_INLINE int name##_init(name##_t *list) \
+{ \
+        if (!list) \
+                return EDLLINV; \
+ \
+        list->count = 0; \
+        list->first = NULL; \
+        list->last = NULL; \
+ \
+        return EDLLOK; \
+} \
+ \
+DLL_INLINE int name##_clear(name##_t *list) \
+{ \
+        name##_node_t *node, *next; \
+ \
+        if (!list) \
+                return EDLLINV; \
+ \
+        for (node = list->first; node != NULL; node = next) { \
+                next = node->next; \
+                free(node); \
+        } \
+ \
+        return name##_init(list); \
+} \
+ \
+DLL_INLINE int name##_append(name##_t *list, T **data) \
+{ \
+        name##_node_t *node; \
+ \
+        if (!list) \
+                return EDLLINV; \
+        if (!data) \
+                return EDLLINV; \
+ \
+        if ((node = (name##_node_t*)malloc(sizeof(name##_node_t))) == NULL) \
+                return EDLLNOMEM; \
+ \
+        node->prev = list->last; \
+        node->next = NULL; \
+        if (list->last != NULL) \
+                list->last->next = node; \
+        else \
+                list->first = node; \
+        list->last = node; \
+        list->count++; \
+ \
+        *data = &node->value; \
+ \
+        return EDLLOK; \
+} \
+ \
+DLL_INLINE int name##_remove(name##_t *list, T *data) \
+{ \
+        name##_node_t *node; \
+ \
+        if (!list) \
+                return EDLLINV; \
+        if (!data) \
+                return EDLLINV; \
+ \
+        node = (name##_node_t*)((char*)data - offsetof(name##_node_t, value)); \
+ \
+        if (node->prev != NULL) \
+                node->prev->next = node->next; \
+        else \
+                list->first = node->next; \
+        if (node->next != NULL) \
+                node->next->prev = node->prev; \
+        else \
+                list->last = node->prev; \
+ \
+        free(node); \
+        list->count--; \
+ \
+        return EDLLOK; \
+} \
+ \
+DLL_INLINE int name##_count(name##_t *list, dll_count_t *count) \
+{ \
+        if (!list) \
+                return EDLLINV; \
+        if (!count) \
+                return EDLLINV; \
+ \
+        *count = list->count; \
+ \
+        return EDLLOK; \
+} \
+ \
+/* Merge step of name##_sort() */ \
+DLL_INLINE name##_node_t *name##_prv_merge(name##_node_t *a, name##_node_t *b) \
+{ \
+        name##_node_t head; \
+        name##_node_t *tail = &head; \
+ \
+        while ((a != NULL) && (b != NULL)) { \
+                if (cmp((const T*)&b->value, (const T*)&a->value) < 0) { \
+                        tail->next = b; \
+                        b = b->next; \
+                } else { \
+                        tail->next = a; \
+                        a = a->next; \
+                } \
+                tail = tail->next; \
+        } \
+        tail->next = (a != NULL) ? a : b; \
+ \
+        return head.next; \
+} \
+ \
+/* dll_prv_linksort() (dll_list.c), spelled out for the node type so that \
+ * calls to cmp can be inlined */ \
+DLL_INLINE int name##_sort(name##_t *list) \
+{ \
+        name##_node_t *bins[sizeof(dll_count_t)*8+1]; \
+        name##_node_t *run, *next, *prev; \
+        unsigned int k, top = 0; \
+ \
+        if (!list) \
+                return EDLLINV; \
+        if (list->count < 2) \
+                return EDLLOK; \
+ \
+        for (run = list->first; run != NULL; run = next) { \
+                next = run->next; \
+                run->next = NULL; \
+ \
+                for (k = 0; (k < top) && (bins[k] != NULL); k++) { \
+                        run = name##_prv_merge(bins[k], run); \
+                        bins[k] = NULL; \
+                } \
+                if (k == top) \
+                        top++; \
+                bins[k] = run; \
+        } \
+ \
+        run = NULL; \
+        for (k = 0; k < top; k++) \
+                if (bins[k] != NULL) \
+                        run = (run == NULL) ? bins[k] : name##_prv_merge(bins[k], run); \
+ \
+        list->first = run; \
+        for (prev = NULL; run != NULL; run = run->next) { \
+                run->prev = prev; \
+                prev = run; \
+        } \
+        list->last = prev; \
+ \
+        return EDLLOK; \
+}
+
+#endif /* _DLL_TYPED_H */
@@ -20,6 +20,8 @@
 * THE SOFTWARE.
 */
 
+#include <string.h>
+
 #include "dll_list.h"
 #include "dll_util.h"
 
@@ -50,6 +52,7 @@ static const dll_error_description_t dll_errdesc[] = {
         {EDLLTILT,  "Iterator turnaround"},
         {EDLLNOMEM, "Not enough memory"},
         {EDLLINV,   "Invalid argument"},
+        {EDLLIO,    "Input/output error"},
 };
 static const char *dll_errdesc_unknown = "Unknown error";
 
@@ -84,3 +87,39 @@ int dll_compar_int(const void *item1, const void *item2)
         return 0;
 }
 
+
+int dll_stats_get(dll_list_t *list, dll_stats_t *stats)
+{
+        if (!list)
+                return EDLLINV;
+        if (!stats)
+                return EDLLINV;
+
+#ifdef DLL_ENABLE_STATS
+        *stats = list->stats;
+
+        return EDLLOK;
+#else
+        return EDLLERROR;
+#endif
+}
+
+int dll_stats_reset(dll_list_t *list)
+{
+#ifdef DLL_ENABLE_STATS
+        size_t bytes;
+#endif
+
+        if (!list)
+                return EDLLINV;
+
+#ifdef DLL_ENABLE_STATS
+        bytes = list->stats.bytes;
+        memset(&list->stats, 0, sizeof(dll_stats_t));
+        list->stats.bytes = bytes;
+
+        return EDLLOK;
+#else
+        return EDLLERROR;
+#endif
+}
@@ -29,6 +29,8 @@
 #ifndef _DLL_UTIL_H
 #define _DLL_UTIL_H
 
+#include "dll_list.h"
+
 /* ######################################################################### */
 /*                            TODO / Notes                                   */
 /* ######################################################################### */
@@ -63,4 +65,33 @@ char const* dll_strerror(int errnum);
  */
 int dll_compar_int(const void *item1, const void *item2);
 
+/** Get a list's statistics
+ *
+ * Statistics are only kept if the library has been configured with
+ * DLL_ENABLE_STATS, otherwise there is nothing to get. Item counts and bytes
+ * follow the items, i.e. they move along with dll_splice(). Bytes include
+ * the allocator's overhead where it can be told.
+ *
+ * @param list       Pointer to the list
+ * @param stats      Where to store the statistics
+ *
+ * @return EDLLOK    No errors occured
+ * @return EDLLINV   An invalid argument has been passed
+ * @return EDLLERROR Statistics are not compiled in
+ */
+int dll_stats_get(dll_list_t *list, dll_stats_t *stats);
+
+/** Reset a list's statistics
+ *
+ * All counters start over from zero, bytes still reflects what the list
+ * holds.
+ *
+ * @param list       Pointer to the list
+ *
+ * @return EDLLOK    No errors occured
+ * @return EDLLINV   An invalid argument has been passed
+ * @return EDLLERROR Statistics are not compiled in
+ */
+int dll_stats_reset(dll_list_t *list);
+
 #endif /* _DLL_UTIL_H */
@@ -0,0 +1,326 @@
+/*
+* Copyright (c) 2008, Björn Rehm (bjoern@shugaa.de)
+* 
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+* 
+* The above copyright notice and this permission notice shall be included in
+* all copies or substantial portions of the Software.
+* 
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+* THE SOFTWARE.
+*/
+
+#include <cstdio>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <CUnit/CUnit.h>
+#include <CUnit/Basic.h>
+#include <CUnit/Automated.h>
+
+#include "dll_list.hpp"
+
+#define CU_ADD_TEST(suite, test) (CU_add_test(suite, #test, (CU_TestFunc)test))
+
+/* Elements which count themselves, so leaked or doubly destroyed ones show
+ * up. Constructing one from DLL_TEST_THROW throws. */
+#define DLL_TEST_THROW  (-1)
+
+static int live = 0;
+
+struct tracked
+{
+    tracked(int v) : value(v), name(std::to_string(v))
+    {
+        if (v == DLL_TEST_THROW)
+            throw std::runtime_error("no");
+        live++;
+    }
+    tracked(const tracked &other) : value(other.value), name(other.name) { live++; }
+    ~tracked() { live--; }
+
+    bool operator<(const tracked &other) const { return value < other.value; }
+
+    int value;
+    std::string name;
+};
+
+/* Sort key and the order the element was added in */
+struct keyed
+{
+    int key;
+    int seq;
+};
+
+/* Test emplace_back()/emplace_front() with a constructor that throws */
+static void test_emplace(void)
+{
+    int thrown = 0;
+
+    {
+        dll::list<tracked> list;
+
+        list.emplace_back(1);
+        list.emplace_back(2);
+        list.emplace_front(0);
+        CU_ASSERT(live == 3);
+
+#if !defined(DLL_LARGE_LISTS) && !defined(DLL_THREAD_CACHE)
+        /* Larger than inline data of the C interface, but still right
+         * behind the container */
+        CU_ASSERT(sizeof(tracked) > 16);
+        CU_ASSERT((char*)&list.front() > (char*)list.native()->first);
+        CU_ASSERT((char*)&list.front() <= (char*)list.native()->first + 2*sizeof(dll_item_t));
+        CU_ASSERT((char*)&list.back() > (char*)list.native()->last);
+        CU_ASSERT((char*)&list.back() <= (char*)list.native()->last + 2*sizeof(dll_item_t));
+#endif
+
+        /* The item allocated for it goes again, nothing else changes */
+        try {
+            list.emplace_back(DLL_TEST_THROW);
+        } catch (const std::runtime_error &) {
+            thrown++;
+        }
+        try {
+            list.emplace_front(DLL_TEST_THROW);
+        } catch (const std::runtime_error &) {
+            thrown++;
+        }
+        CU_ASSERT(thrown == 2);
+        CU_ASSERT(live == 3);
+        CU_ASSERT(list.size() == 3);
+        CU_ASSERT(list.native()->count == 3);
+        CU_ASSERT(list.front().value == 0);
+        CU_ASSERT(list.back().value == 2);
+        CU_ASSERT(list.back().name == "2");
+
+        /* A copy that fails half way leaves nothing behind either */
+        try {
+            dll::list<tracked> partial = { tracked(5), tracked(DLL_TEST_THROW) };
+        } catch (const std::runtime_error &) {
+            thrown++;
+        }
+        CU_ASSERT(thrown == 3);
+        CU_ASSERT(live == 3);
+    }
+
+    CU_ASSERT(live == 0);
+}
+
+/* Test copying, moving and destroying non-trivial elements */
+static void test_nontrivial(void)
+{
+    int i;
+    std::string s;
+
+    {
+        dll::list<tracked> list, moved;
+
+        for (i=0; i<100; i++)
+            list.push_back(tracked(i));
+        CU_ASSERT(live == 100);
+
+        /* Copies are deep, the strings don't share anything */
+        dll::list<tracked> copy(list);
+        CU_ASSERT(live == 200);
+        copy.front().name += "x";
+        CU_ASSERT(list.front().name == "0");
+        CU_ASSERT(copy.front().name == "0x");
+
+        /* Moving hands over the items */
+        moved = std::move(copy);
+        CU_ASSERT(live == 200);
+        CU_ASSERT(copy.empty());
+        CU_ASSERT(moved.size() == 100);
+
+        for (dll::list<tracked>::reverse_iterator it = list.rbegin(); it != list.rend(); ++it)
+            s += it->name;
+        CU_ASSERT(s.compare(0, 4, "9998") == 0);
+
+        list.pop_front();
+        list.pop_back();
+        CU_ASSERT(live == 198);
+        CU_ASSERT(list.front().value == 1);
+        CU_ASSERT(list.back().value == 98);
+
+        moved.clear();
+        CU_ASSERT(live == 98);
+    }
+
+    CU_ASSERT(live == 0);
+}
+
+/* Test that sort() keeps equal elements in the order they were added */
+static void test_sortstable(void)
+{
+    int i, n, prevkey, prevseq, ok;
+    int order[1000];
+    dll::list<keyed> list;
+    dll::list<tracked> values;
+
+    for (n=0; n<1000; n++) {
+        keyed k = { (n * 7919) % 13, n };
+        list.push_back(k);
+    }
+
+    list.sort([](const keyed &a, const keyed &b) { return a.key < b.key; });
+    CU_ASSERT(list.size() == 1000);
+
+    ok = 1;
+    n = 0;
+    prevkey = -1;
+    prevseq = -1;
+    for (dll::list<keyed>::const_iterator it = list.cbegin(); it != list.cend(); ++it) {
+        if ((it->key < prevkey) || ((it->key == prevkey) && (it->seq < prevseq)))
+            ok = 0;
+        prevkey = it->key;
+        prevseq = it->seq;
+        order[n++] = it->seq;
+    }
+    CU_ASSERT(ok);
+
+    /* The prev links are right as well */
+    for (dll::list<keyed>::const_reverse_iterator it = list.rbegin(); it != list.rend(); ++it)
+        if (it->seq != order[--n])
+            ok = 0;
+    CU_ASSERT(ok);
+    CU_ASSERT(n == 0);
+
+    /* Elements aren't copied or moved */
+    for (i=0; i<50; i++)
+        values.emplace_back(50 - i);
+    const tracked *first = &values.back();
+    values.sort();
+    CU_ASSERT(live == 50);
+    CU_ASSERT(&values.front() == first);
+    CU_ASSERT(values.front().value == 1);
+    CU_ASSERT(values.back().value == 50);
+}
+
+/* Test erase() while iterating over the list */
+static void test_erase(void)
+{
+    int i, sum;
+
+    {
+        dll::list<tracked> list;
+
+        for (i=0; i<100; i++)
+            list.emplace_back(i);
+
+        /* erase() hands back where to carry on */
+        for (dll::list<tracked>::iterator it = list.begin(); it != list.end(); ) {
+            if (it->value % 2)
+                it = list.erase(it);
+            else
+                ++it;
+        }
+        CU_ASSERT(list.size() == 50);
+        CU_ASSERT(live == 50);
+
+        sum = 0;
+        for (dll::list<tracked>::const_iterator it = list.begin(); it != list.end(); ++it)
+            sum += it->value;
+        CU_ASSERT(sum == 2450);
+
+        /* Erasing the last element hands back end() */
+        CU_ASSERT(list.erase(--list.end()) == list.end());
+        CU_ASSERT(list.back().value == 96);
+
+        /* And everything, one by one */
+        for (dll::list<tracked>::iterator it = list.begin(); it != list.end(); )
+            it = list.erase(it);
+        CU_ASSERT(list.empty());
+        CU_ASSERT(live == 0);
+    }
+
+    CU_ASSERT(live == 0);
+}
+
+int main(int argc, char *argv[])
+{
+    int ret = 0;
+    CU_ErrorCode cu_rc;
+    CU_pSuite cu_suite01;
+    CU_pTest cu_test;
+
+    (void)argc;
+    (void)argv;
+
+    /* Initialize test registry */
+    cu_rc = CU_initialize_registry();
+    if (cu_rc != CUE_SUCCESS) {
+        ret = 1;
+        goto finish;
+    }
+
+    /* Add a suite to the registry */
+    cu_suite01 = CU_add_suite("dllhpptest", NULL, NULL);
+    if (cu_suite01 == NULL) {
+        ret = 2;
+        goto finish;
+    }
+
+    /* Add tests to suite */
+    cu_test = CU_ADD_TEST(cu_suite01, test_emplace);
+    if (cu_test == NULL) {
+        ret = 3;
+        goto finish;
+    }
+    cu_test = CU_ADD_TEST(cu_suite01, test_nontrivial);
+    if (cu_test == NULL) {
+        ret = 3;
+        goto finish;
+    }
+    cu_test = CU_ADD_TEST(cu_suite01, test_sortstable);
+    if (cu_test == NULL) {
+        ret = 3;
+        goto finish;
+    }
+    cu_test = CU_ADD_TEST(cu_suite01, test_erase);
+    if (cu_test == NULL) {
+        ret = 3;
+        goto finish;
+    }
+
+    /* Be verbose */
+    CU_basic_set_mode(CU_BRM_VERBOSE);
+
+    /* Run all tests in our suite */
+    cu_rc = CU_basic_run_tests();
+    if (cu_rc != CUE_SUCCESS) {
+        ret = 4;
+        goto finish;
+    }
+
+finish:
+    switch (ret) {
+        case 1:
+            printf("CU_initialize_registry() failed\n");
+            break;
+        case 2:
+            printf("CU_add_suite() failed\n");
+            break;
+        case 3:
+            printf("CU_ADD_TEST() failed\n");
+            break;
+        case 4:
+            printf("CU_basic_run_tests() failed\n");
+            break;
+        default:
+            break;
+    }
+
+    CU_cleanup_registry();
+    return ret;
+}
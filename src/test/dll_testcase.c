@@ -21,12 +21,35 @@
 */
 
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/wait.h>
 #include <CUnit/CUnit.h>
 #include <CUnit/Basic.h>
 #include <CUnit/Automated.h>
 
 #include "dll_list.h"
+#include "dll_inline.h"
 #include "dll_util.h"
+#include "dll_reduce.h"
+#include "dll_sharded.h"
+#include "dll_compact.h"
+#include "dll_io.h"
+#include "dll_mapped.h"
+#include "dll_perf.h"
+#include "dll_hooks.h"
+#include "dll_trace.h"
+#include "dll_typed.h"
+#include "dll_intrusive.h"
+#include "dll_numa.h"
+#include "dll_sorted.h"
+#include "dll_config.h"
+
+#ifdef DLL_HAVE_PTHREAD
+#include <pthread.h>
+#endif
 
 #define CU_ADD_TEST(suite, test) (CU_add_test(suite, #test, (CU_TestFunc)test))
 
@@ -34,6 +57,20 @@
 #define DLL_TEST_LISTSIZE   (5000)
 #define DLL_TEST_GENERROR   "Unknown error"
 
+/* Payloads this large get their own allocation instead of being stored
+ * inline with the item container */
+#define DLL_TEST_OUTOFLINE  (8*sizeof(int))
+
+/* Sorts on the key only so stability can be checked */
+typedef struct {
+    int key;
+    int seq;
+} test_pair_t;
+
+#define TEST_PAIR_CMP(a, b) (((a)->key > (b)->key) - ((a)->key < (b)->key))
+
+DLL_DEFINE_TYPED(test_plist, test_pair_t, TEST_PAIR_CMP)
+
 /* Test dll_append() functionality  */
 static void test_append(void) 
 {
@@ -69,7 +106,7 @@ static void test_insert(void)
 {
     int rc, i;
     dll_list_t list;
-    unsigned int count;
+    dll_count_t count;
     void *data = NULL;
 
     rc = dll_init(&list);
@@ -150,7 +187,7 @@ static void test_insert(void)
 static void test_extend(void) 
 {
     int rc, i;
-    unsigned int count;
+    dll_count_t count;
     dll_list_t list, lext;
     void *data = NULL;
 
@@ -204,11 +241,74 @@ static void test_extend(void)
     CU_ASSERT(rc == EDLLOK);
 }
 
+/* Test dll_splice() functionality  */
+static void test_splice(void) 
+{
+    int rc, i;
+    dll_count_t count;
+    dll_list_t list, lext;
+    void *data = NULL;
+
+    rc = dll_init(&list);
+    CU_ASSERT(rc == EDLLOK);
+
+    rc = dll_init(&lext);
+    CU_ASSERT(rc == EDLLOK);
+
+    /* Splicing into an empty list just moves the items */
+    for(i=0;i<DLL_TEST_LISTSIZE/2;i++) {
+        rc = dll_append(&lext, &data, sizeof(int));
+        CU_ASSERT(rc == EDLLOK);
+
+        if (rc == EDLLOK)
+            *((int*)data) = i+1;
+    }
+
+    rc = dll_splice(&list, &lext);
+    CU_ASSERT(rc == EDLLOK);
+
+    /* Fill the second list with numbers (DLL_TEST_LISTSIZE/2)+1..DLL_TEST_LISTSIZE */
+    for(i=DLL_TEST_LISTSIZE/2;i<DLL_TEST_LISTSIZE;i++) {
+        rc = dll_append(&lext, &data, sizeof(int));
+        CU_ASSERT(rc == EDLLOK);
+
+        if (rc == EDLLOK)
+            *((int*)data) = i+1;
+    }
+
+    rc = dll_splice(&list, &lext);
+    CU_ASSERT(rc == EDLLOK);
+
+    rc = dll_splice(&list, &list);
+    CU_ASSERT(rc == EDLLINV);
+
+    rc = dll_count(&list, &count);
+    CU_ASSERT(rc == EDLLOK);
+    CU_ASSERT(count == DLL_TEST_LISTSIZE);
+
+    rc = dll_count(&lext, &count);
+    CU_ASSERT(rc == EDLLOK);
+    CU_ASSERT(count == 0);
+
+    /* Read back and check for consistency */
+    for(i=0;i<DLL_TEST_LISTSIZE;i++) {
+        rc = dll_get(&list, &data, NULL, (unsigned int)i);
+        CU_ASSERT(rc == EDLLOK);
+        CU_ASSERT(*((int*)data) == i+1);
+    }
+
+    rc = dll_clear(&list);
+    CU_ASSERT(rc == EDLLOK);
+
+    rc = dll_clear(&lext);
+    CU_ASSERT(rc == EDLLOK);
+}
+
 /* Test dll_deepcopy() functionality  */
 static void test_deepcopy(void) 
 {
     int rc, i;
-    unsigned int count;
+    dll_count_t count;
     dll_list_t from, to;
     void *data = NULL;
 
@@ -253,7 +353,7 @@ static void test_deepcopy(void)
 static void test_remove(void) 
 {
     int rc, i;
-    unsigned int count;
+    dll_count_t count;
     dll_list_t list;
     void *data = NULL;
 
@@ -303,11 +403,237 @@ static void test_remove(void)
     CU_ASSERT(rc == EDLLOK);
 }
 
+/* Test small payloads stored inline with their container */
+static void test_inline(void) 
+{
+    int rc, i, *data;
+    dll_list_t list, snap;
+    dll_item_t *item;
+    void *first;
+
+    rc = dll_init(&list);
+    CU_ASSERT(rc == EDLLOK);
+    rc = dll_init(&snap);
+    CU_ASSERT(rc == EDLLOK);
+
+    /* Payload sizes up to the threshold and beyond, all of them aligned
+     * like malloc() would */
+    for (i=0; i<DLL_TEST_LISTSIZE; i++) {
+        rc = dll_append(&list, (void**)&data, sizeof(int) + (i % 33));
+        CU_ASSERT(rc == EDLLOK);
+
+        if (rc == EDLLOK) {
+            memset(data, 0xa5, sizeof(int) + (i % 33));
+            *data = i;
+            CU_ASSERT(((size_t)data % sizeof(double)) == 0);
+            CU_ASSERT(list.last->datasize == sizeof(int) + (i % 33));
+        }
+    }
+    first = list.first->data;
+
+    /* References stay valid while the list changes around them */
+    rc = dll_remove(&list, 1);
+    CU_ASSERT(rc == EDLLOK);
+    rc = dll_reverse(&list);
+    CU_ASSERT(rc == EDLLOK);
+    rc = dll_sort(&list, dll_compar_int);
+    CU_ASSERT(rc == EDLLOK);
+    CU_ASSERT(list.first->data == first);
+
+    /* Snapshots and their copies of the containers keep their data */
+    rc = dll_snapshot(&list, &snap);
+    CU_ASSERT(rc == EDLLOK);
+    rc = dll_remove(&list, 0);
+    CU_ASSERT(rc == EDLLOK);
+    rc = dll_compact(&list, 0);
+    CU_ASSERT(rc == EDLLOK);
+    rc = dll_remove(&snap, snap.count-1);
+    CU_ASSERT(rc == EDLLOK);
+
+    i = 2;
+    for (item = list.first; item != NULL; item = item->next) {
+        CU_ASSERT(*(int*)item->data == i);
+        if (item->datasize > sizeof(int))
+            CU_ASSERT(((unsigned char*)item->data)[item->datasize-1] == 0xa5);
+        i++;
+    }
+    CU_ASSERT(i == DLL_TEST_LISTSIZE);
+
+    i = 0;
+    for (item = snap.first; item != NULL; item = item->next) {
+        CU_ASSERT(*(int*)item->data == i);
+        if (item->datasize > sizeof(int))
+            CU_ASSERT(((unsigned char*)item->data)[item->datasize-1] == 0xa5);
+        i += (i == 0) ? 2 : 1;
+    }
+    CU_ASSERT(i == DLL_TEST_LISTSIZE-1);
+    CU_ASSERT(snap.first->data == first);
+
+    rc = dll_compact(&snap, DLL_COMPACT_DATA);
+    CU_ASSERT(rc == EDLLOK);
+    CU_ASSERT(*(int*)snap.first->data == 0);
+    CU_ASSERT(*(int*)snap.last->data == DLL_TEST_LISTSIZE-2);
+
+    rc = dll_clear(&snap);
+    CU_ASSERT(rc == EDLLOK);
+    rc = dll_clear(&list);
+    CU_ASSERT(rc == EDLLOK);
+
+    /* References to inline data survive compaction and copies on write,
+     * the containers move but the data doesn't */
+    rc = dll_append(&list, (void**)&data, sizeof(int));
+    CU_ASSERT(rc == EDLLOK);
+    *data = 1;
+    rc = dll_compact(&list, 0);
+    CU_ASSERT(rc == EDLLOK);
+    CU_ASSERT(list.first->data == data);
+
+    rc = dll_snapshot(&list, &snap);
+    CU_ASSERT(rc == EDLLOK);
+    rc = dll_append(&list, (void**)&first, sizeof(int));
+    CU_ASSERT(rc == EDLLOK);
+    CU_ASSERT(list.first->data == data);
+    CU_ASSERT(snap.first->data == data);
+
+    /* Still good after the snapshot and the original container are gone */
+    rc = dll_clear(&snap);
+    CU_ASSERT(rc == EDLLOK);
+    rc = dll_compact(&list, 0);
+    CU_ASSERT(rc == EDLLOK);
+    *data = 2;
+    CU_ASSERT(list.first->data == data);
+    CU_ASSERT(*(int*)list.first->data == 2);
+
+    /* Private again after unsharing, with a snapshot still holding on */
+    rc = dll_snapshot(&list, &snap);
+    CU_ASSERT(rc == EDLLOK);
+    rc = dll_unshare(&snap);
+    CU_ASSERT(rc == EDLLOK);
+    *(int*)snap.first->data = 3;
+    CU_ASSERT(*data == 2);
+    rc = dll_unshare(&list);
+    CU_ASSERT(rc == EDLLOK);
+
+    rc = dll_clear(&list);
+    CU_ASSERT(rc == EDLLOK);
+    CU_ASSERT(*(int*)snap.first->data == 3);
+    rc = dll_clear(&snap);
+    CU_ASSERT(rc == EDLLOK);
+
+    /* The other way round, the snapshot's copies are hosted by the list's
+     * containers when the list is unshared */
+    rc = dll_append(&list, (void**)&data, sizeof(int));
+    CU_ASSERT(rc == EDLLOK);
+    *data = 4;
+    rc = dll_snapshot(&list, &snap);
+    CU_ASSERT(rc == EDLLOK);
+    rc = dll_append(&snap, (void**)&first, sizeof(int));
+    CU_ASSERT(rc == EDLLOK);
+    rc = dll_unshare(&list);
+    CU_ASSERT(rc == EDLLOK);
+    CU_ASSERT(snap.first->data == data);
+    CU_ASSERT(list.first->data != data);
+    *(int*)list.first->data = 5;
+    CU_ASSERT(*data == 4);
+
+    rc = dll_clear(&list);
+    CU_ASSERT(rc == EDLLOK);
+    CU_ASSERT(*data == 4);
+    rc = dll_clear(&snap);
+    CU_ASSERT(rc == EDLLOK);
+
+    /* Inline data only moves when asked to, larger data stays put */
+    rc = dll_append(&list, (void**)&data, sizeof(int));
+    CU_ASSERT(rc == EDLLOK);
+    *data = 6;
+    rc = dll_append(&list, &first, DLL_TEST_OUTOFLINE);
+    CU_ASSERT(rc == EDLLOK);
+    rc = dll_compact(&list, DLL_COMPACT_INLINE);
+    CU_ASSERT(rc == EDLLOK);
+    CU_ASSERT(list.first->data != data);
+    CU_ASSERT(*(int*)list.first->data == 6);
+    CU_ASSERT(list.last->data == first);
+
+    rc = dll_clear(&list);
+    CU_ASSERT(rc == EDLLOK);
+}
+
+/* Test dll_remove_item() functionality  */
+static void test_remove_item(void) 
+{
+    int rc, i, *data;
+    dll_count_t count;
+    dll_list_t list, snap;
+    dll_cursor_t c;
+    dll_item_t *item;
+
+    rc = dll_init(&list);
+    CU_ASSERT(rc == EDLLOK);
+    rc = dll_init(&snap);
+    CU_ASSERT(rc == EDLLOK);
+
+    for(i=0;i<DLL_TEST_LISTSIZE;i++) {
+        rc = dll_append(&list, (void**)&data, sizeof(int));
+        CU_ASSERT(rc == EDLLOK);
+
+        if (rc == EDLLOK)
+            *data = i;
+    }
+
+    rc = dll_remove_item(&list, NULL);
+    CU_ASSERT(rc == EDLLINV);
+
+    /* Remove the first and the last item, then every odd one */
+    rc = dll_remove_item(&list, list.first);
+    CU_ASSERT(rc == EDLLOK);
+    rc = dll_remove_item(&list, list.last);
+    CU_ASSERT(rc == EDLLOK);
+
+    for (item = list.first; item != NULL;) {
+        dll_item_t *next = item->next;
+
+        if (*(int*)item->data & 1) {
+            rc = dll_remove_item(&list, item);
+            CU_ASSERT(rc == EDLLOK);
+        }
+        item = next;
+    }
+
+    rc = dll_count(&list, &count);
+    CU_ASSERT(rc == EDLLOK);
+    CU_ASSERT(count == (DLL_TEST_LISTSIZE/2 - 1));
+
+    i = 2;
+    DLL_FOREACH(&list, c, data) {
+        CU_ASSERT(*data == i);
+        i += 2;
+    }
+    CU_ASSERT(*(int*)list.last->data == DLL_TEST_LISTSIZE-2);
+
+    /* An item of a shared list is looked up again after unsharing */
+    rc = dll_snapshot(&list, &snap);
+    CU_ASSERT(rc == EDLLOK);
+
+    item = list.first->next;
+    rc = dll_remove_item(&list, item);
+    CU_ASSERT(rc == EDLLOK);
+    CU_ASSERT(*(int*)list.first->data == 2);
+    CU_ASSERT(*(int*)list.first->next->data == 6);
+    CU_ASSERT(list.count == (DLL_TEST_LISTSIZE/2 - 2));
+    CU_ASSERT(*(int*)snap.first->next->data == 4);
+    CU_ASSERT(snap.count == (DLL_TEST_LISTSIZE/2 - 1));
+
+    rc = dll_clear(&snap);
+    CU_ASSERT(rc == EDLLOK);
+    rc = dll_clear(&list);
+    CU_ASSERT(rc == EDLLOK);
+}
+
 /* Test dll_indexof() functionality  */
 static void test_indexof(void) 
 {
     int rc, i, cmpitem;
-    unsigned int index;
+    dll_count_t index;
     dll_list_t list;
     void *data = NULL;
 
@@ -450,63 +776,2391 @@ static void test_iterator(void)
     CU_ASSERT(rc == EDLLOK);
 }
 
-static void test_strerror(void)
+/* Accumulator used by test_reduce() */
+typedef struct {
+    long sum;
+    int min;
+    int max;
+} test_reduce_acc_t;
+
+static void test_reduce_map(void *acc, const void *data, size_t datasize)
 {
-    int rc;
-    
-    rc = strcmp(dll_strerror(EDLLERROR), DLL_TEST_GENERROR);
-    CU_ASSERT(rc != 0);
+    test_reduce_acc_t *a = (test_reduce_acc_t*)acc;
+    int value = *((int*)data);
+
+    a->sum += value;
+    if (value < a->min)
+        a->min = value;
+    if (value > a->max)
+        a->max = value;
+}
 
-    rc = strcmp(dll_strerror(EDLLOK), DLL_TEST_GENERROR);
-    CU_ASSERT(rc != 0);
+static void test_reduce_combine(void *acc, const void *src)
+{
+    test_reduce_acc_t *a = (test_reduce_acc_t*)acc;
+    const test_reduce_acc_t *b = (const test_reduce_acc_t*)src;
+
+    a->sum += b->sum;
+    if (b->min < a->min)
+        a->min = b->min;
+    if (b->max > a->max)
+        a->max = b->max;
+}
 
-    rc = strcmp(dll_strerror(EDLLTILT), DLL_TEST_GENERROR);
-    CU_ASSERT(rc != 0);
+/* Test dll_reduce() functionality  */
+static void test_reduce(void) 
+{
+    int rc, i;
+    unsigned int nthreads;
+    dll_list_t list;
+    void *data = NULL;
+    test_reduce_acc_t identity = {0, DLL_TEST_LISTSIZE+1, 0};
+    test_reduce_acc_t result;
 
-    rc = strcmp(dll_strerror(EDLLNOMEM), DLL_TEST_GENERROR);
-    CU_ASSERT(rc != 0);
+    rc = dll_init(&list);
+    CU_ASSERT(rc == EDLLOK);
 
-    rc = strcmp(dll_strerror(EDLLINV), DLL_TEST_GENERROR);
-    CU_ASSERT(rc != 0);
+    /* Reducing an empty list yields the identity */
+    rc = dll_reduce(&list, test_reduce_map, test_reduce_combine, &identity,
+            &result, sizeof(result), 4);
+    CU_ASSERT(rc == EDLLOK);
+    CU_ASSERT(result.sum == 0);
+    CU_ASSERT(result.min == DLL_TEST_LISTSIZE+1);
 
-    rc = strcmp(dll_strerror(-1), DLL_TEST_GENERROR);
-    CU_ASSERT(rc == 0);
+    /* Fill the list with numbers 1..DLL_TEST_LISTSIZE */
+    for(i=0;i<DLL_TEST_LISTSIZE;i++) {
+        rc = dll_append(&list, &data, sizeof(int));
+        CU_ASSERT(rc == EDLLOK);
+
+        if (rc == EDLLOK)
+            *((int*)data) = i+1;
+    }
+
+    /* Same result no matter how many partitions are used */
+    for (nthreads=1;nthreads<=8;nthreads++) {
+        rc = dll_reduce(&list, test_reduce_map, test_reduce_combine, &identity,
+                &result, sizeof(result), nthreads);
+        CU_ASSERT(rc == EDLLOK);
+        CU_ASSERT(result.sum == ((long)DLL_TEST_LISTSIZE*(DLL_TEST_LISTSIZE+1))/2);
+        CU_ASSERT(result.min == 1);
+        CU_ASSERT(result.max == DLL_TEST_LISTSIZE);
+    }
+
+    rc = dll_reduce(&list, test_reduce_map, test_reduce_combine, &identity,
+            &result, sizeof(result), 0);
+    CU_ASSERT(rc == EDLLINV);
+
+    rc = dll_clear(&list);
+    CU_ASSERT(rc == EDLLOK);
 }
 
-int main(int argc, char *argv[]) 
+#ifdef DLL_HAVE_PTHREAD
+static void *test_sharded_worker(void *arg)
 {
-    int ret = 0;
-    CU_ErrorCode cu_rc;
-    CU_pSuite cu_suite01;
-    CU_pTest cu_test;
+    int i;
+    void *data;
 
-    /* Initialize test registry */
-    cu_rc = CU_initialize_registry();
-    if (cu_rc != CUE_SUCCESS) {
-        ret = 1;
-        goto finish;
+    for(i=0;i<DLL_TEST_LISTSIZE;i++) {
+        if (dll_sharded_append((dll_sharded_t*)arg, &data, sizeof(int)) == EDLLOK)
+            *((int*)data) = i+1;
     }
 
-    /* Add a suite to the registry */
-    cu_suite01 = CU_add_suite("dlltest", NULL, NULL);
-    if (cu_suite01 == NULL) {
-        ret = 2;
-        goto finish;
+    return NULL;
+}
+
+/* Appends like test_sharded_worker() and stays around until the others
+ * have appended as well */
+typedef struct {
+    dll_sharded_t *sharded;
+    pthread_barrier_t barrier;
+} test_sharded_live_t;
+
+static void *test_sharded_holder(void *arg)
+{
+    test_sharded_live_t *live = (test_sharded_live_t*)arg;
+
+    test_sharded_worker(live->sharded);
+    pthread_barrier_wait(&live->barrier);
+
+    return NULL;
+}
+#endif
+
+/* Test dll_sharded_*() functionality  */
+static void test_sharded(void) 
+{
+    int rc, i;
+    long sum;
+    dll_count_t count;
+    dll_sharded_t sharded;
+    dll_sharded_iterator_t it;
+    dll_iterator_t lit;
+    dll_list_t list;
+    void *data = NULL;
+
+    rc = dll_sharded_init(&sharded, 4);
+    CU_ASSERT(rc == EDLLOK);
+
+    /* Nothing to iterate yet */
+    rc = dll_sharded_iterator_init(&it, &sharded);
+    CU_ASSERT(rc == EDLLOK);
+    rc = dll_sharded_iterator_next(&it, &data, NULL);
+    CU_ASSERT(rc == EDLLERROR);
+
+    /* A single thread always appends to the same shard */
+    for(i=0;i<DLL_TEST_LISTSIZE;i++) {
+        rc = dll_sharded_append(&sharded, &data, sizeof(int));
+        CU_ASSERT(rc == EDLLOK);
+
+        if (rc == EDLLOK)
+            *((int*)data) = i+1;
     }
 
-    /* Add tests to suite */
-    cu_test = CU_ADD_TEST(cu_suite01, test_append);
-    if (cu_test == NULL) {
-        ret = 3;
-        goto finish;
+    rc = dll_sharded_iterator_init(&it, &sharded);
+    CU_ASSERT(rc == EDLLOK);
+
+    i = 1;
+    while ((rc = dll_sharded_iterator_next(&it, &data, NULL)) == EDLLOK) {
+        CU_ASSERT(i == *((int*)data));
+        i++;
     }
-    cu_test = CU_ADD_TEST(cu_suite01, test_insert);
-    if (cu_test == NULL) {
-        ret = 3;
-        goto finish;
+    CU_ASSERT(rc == EDLLTILT);
+    CU_ASSERT(i == DLL_TEST_LISTSIZE+1);
+
+#ifdef DLL_HAVE_PTHREAD
+    {
+        pthread_t threads[4];
+
+        for (i=0;i<4;i++)
+            CU_ASSERT(pthread_create(&threads[i], NULL, test_sharded_worker, &sharded) == 0);
+        for (i=0;i<4;i++)
+            pthread_join(threads[i], NULL);
     }
-    cu_test = CU_ADD_TEST(cu_suite01, test_extend);
-    if (cu_test == NULL) {
+
+    rc = dll_sharded_count(&sharded, &count);
+    CU_ASSERT(rc == EDLLOK);
+    CU_ASSERT(count == 5*DLL_TEST_LISTSIZE);
+#endif
+
+    /* Collecting moves everything into one list and empties the shards */
+    rc = dll_init(&list);
+    CU_ASSERT(rc == EDLLOK);
+
+    rc = dll_sharded_collect(&sharded, &list);
+    CU_ASSERT(rc == EDLLOK);
+
+    rc = dll_sharded_count(&sharded, &count);
+    CU_ASSERT(rc == EDLLOK);
+    CU_ASSERT(count == 0);
+
+    rc = dll_count(&list, &count);
+    CU_ASSERT(rc == EDLLOK);
+
+    sum = 0;
+    rc = dll_sharded_iterator_init(&it, &sharded);
+    CU_ASSERT(rc == EDLLOK);
+    rc = dll_sharded_iterator_next(&it, &data, NULL);
+    CU_ASSERT(rc == EDLLERROR);
+
+    rc = dll_iterator_init(&lit, &list);
+    CU_ASSERT(rc == EDLLOK);
+    while (dll_iterator_next(&lit, &data, NULL) == EDLLOK)
+        sum += *((int*)data);
+    CU_ASSERT(sum == (long)(count/DLL_TEST_LISTSIZE)*DLL_TEST_LISTSIZE*(DLL_TEST_LISTSIZE+1)/2);
+
+    rc = dll_clear(&list);
+    CU_ASSERT(rc == EDLLOK);
+
+    rc = dll_sharded_destroy(&sharded);
+    CU_ASSERT(rc == EDLLOK);
+
+#ifdef DLL_HAVE_PTHREAD
+    /* The threads from before are gone, their shards are free again. This
+     * thread and two live ones get one each. */
+    {
+        pthread_t threads[2];
+        test_sharded_live_t live;
+        dll_count_t shards[3] = {0, 0, 0};
+
+        rc = dll_sharded_init(&sharded, 3);
+        CU_ASSERT(rc == EDLLOK);
+        test_sharded_worker(&sharded);
+
+        live.sharded = &sharded;
+        pthread_barrier_init(&live.barrier, NULL, 2);
+        for (i=0;i<2;i++)
+            CU_ASSERT(pthread_create(&threads[i], NULL, test_sharded_holder, &live) == 0);
+        for (i=0;i<2;i++)
+            pthread_join(threads[i], NULL);
+        pthread_barrier_destroy(&live.barrier);
+
+        rc = dll_sharded_iterator_init(&it, &sharded);
+        CU_ASSERT(rc == EDLLOK);
+        while (dll_sharded_iterator_next(&it, &data, NULL) == EDLLOK)
+            shards[it.shard]++;
+        for (i=0;i<3;i++)
+            CU_ASSERT(shards[i] == DLL_TEST_LISTSIZE);
+
+        rc = dll_sharded_destroy(&sharded);
+        CU_ASSERT(rc == EDLLOK);
+    }
+#endif
+}
+
+/* Test dll_iterator_*_batch() functionality  */
+static void test_iterator_batch(void) 
+{
+    int rc, i;
+    size_t j, got;
+    dll_list_t list;
+    dll_iterator_t it;
+    void *data = NULL;
+    void *batch[7];
+    size_t sizes[7];
+
+    rc = dll_init(&list);
+    CU_ASSERT(rc == EDLLOK);
+
+    /* Empty lists have nothing to hand out */
+    rc = dll_iterator_init(&it, &list);
+    CU_ASSERT(rc == EDLLOK);
+    rc = dll_iterator_next_batch(&it, batch, sizes, 7, &got);
+    CU_ASSERT(rc == EDLLERROR);
+    CU_ASSERT(got == 0);
+
+    /* Fill the list with numbers 1..DLL_TEST_LISTSIZE */
+    for(i=0;i<DLL_TEST_LISTSIZE;i++) {
+        rc = dll_append(&list, &data, sizeof(int));
+        CU_ASSERT(rc == EDLLOK);
+
+        if (rc == EDLLOK)
+            *((int*)data) = i+1;
+    }
+
+    /* Iterate forward */
+    rc = dll_iterator_init(&it, &list);
+    CU_ASSERT(rc == EDLLOK);
+
+    i = 1;
+    while ((rc = dll_iterator_next_batch(&it, batch, sizes, 7, &got)) == EDLLOK) {
+        CU_ASSERT(got > 0 && got <= 7);
+        for (j=0;j<got;j++) {
+            CU_ASSERT(i == *((int*)batch[j]));
+            CU_ASSERT(sizes[j] == sizeof(int));
+            i++;
+        }
+    }
+    CU_ASSERT(rc == EDLLTILT);
+    CU_ASSERT(i == DLL_TEST_LISTSIZE+1);
+    CU_ASSERT(got > 0 && *((int*)batch[0]) == 1);
+
+    /* Iterate backward, mixing in single steps */
+    rc = dll_iterator_init(&it, &list);
+    CU_ASSERT(rc == EDLLOK);
+
+    rc = dll_iterator_prev(&it, &data, NULL);
+    CU_ASSERT(rc == EDLLOK);
+    CU_ASSERT(*((int*)data) == DLL_TEST_LISTSIZE);
+
+    i = DLL_TEST_LISTSIZE-1;
+    while ((rc = dll_iterator_prev_batch(&it, batch, NULL, 7, &got)) == EDLLOK) {
+        for (j=0;j<got;j++) {
+            CU_ASSERT(i == *((int*)batch[j]));
+            i--;
+        }
+    }
+    CU_ASSERT(rc == EDLLTILT);
+    CU_ASSERT(i == 0);
+
+    rc = dll_iterator_next_batch(&it, batch, NULL, 0, &got);
+    CU_ASSERT(rc == EDLLINV);
+
+    rc = dll_clear(&list);
+    CU_ASSERT(rc == EDLLOK);
+}
+
+/* Test dll_compact*() functionality  */
+static void test_compact(void) 
+{
+    int rc, i;
+    dll_count_t count, moved;
+    dll_list_t list;
+    dll_iterator_t it;
+    dll_compactor_t compactor;
+    void *data = NULL;
+    void *first = NULL;
+
+    rc = dll_init(&list);
+    CU_ASSERT(rc == EDLLOK);
+
+    rc = dll_compact(&list, 0);
+    CU_ASSERT(rc == EDLLOK);
+
+    /* Fill the list with numbers 1..DLL_TEST_LISTSIZE */
+    for(i=0;i<DLL_TEST_LISTSIZE;i++) {
+        rc = dll_append(&list, &data, sizeof(int));
+        CU_ASSERT(rc == EDLLOK);
+
+        if (rc == EDLLOK)
+            *((int*)data) = i+1;
+        if (i == 0)
+            first = data;
+    }
+
+    /* Containers only, data references stay valid */
+    rc = dll_compact(&list, 0);
+    CU_ASSERT(rc == EDLLOK);
+
+    rc = dll_get(&list, &data, NULL, 0);
+    CU_ASSERT(rc == EDLLOK);
+    CU_ASSERT(data == first);
+
+    /* Punch some holes into the block, then move everything again */
+    rc = dll_remove(&list, DLL_TEST_LISTSIZE/2);
+    CU_ASSERT(rc == EDLLOK);
+    rc = dll_remove(&list, 0);
+    CU_ASSERT(rc == EDLLOK);
+
+    rc = dll_compact(&list, DLL_COMPACT_DATA);
+    CU_ASSERT(rc == EDLLOK);
+
+    /* Incremental pass, appending in between steps */
+    rc = dll_compact_init(&compactor, &list, 0);
+    CU_ASSERT(rc == EDLLOK);
+
+    count = 0;
+    do {
+        rc = dll_compact_step(&compactor, 7, &moved);
+        CU_ASSERT(rc == EDLLOK);
+        count += moved;
+
+        if (count == 14) {
+            rc = dll_append(&list, &data, sizeof(int));
+            CU_ASSERT(rc == EDLLOK);
+            *((int*)data) = DLL_TEST_LISTSIZE+1;
+        }
+    } while (moved == 7);
+    CU_ASSERT(count == DLL_TEST_LISTSIZE-1);
+
+    rc = dll_count(&list, &count);
+    CU_ASSERT(rc == EDLLOK);
+    CU_ASSERT(count == DLL_TEST_LISTSIZE-1);
+
+    /* Forward and backward links must both be intact */
+    i = 2;
+    rc = dll_iterator_init(&it, &list);
+    CU_ASSERT(rc == EDLLOK);
+    while ((rc = dll_iterator_next(&it, &data, NULL)) == EDLLOK) {
+        CU_ASSERT(*((int*)data) == i);
+        i += (i == DLL_TEST_LISTSIZE/2) ? 2 : 1;
+    }
+    CU_ASSERT(i == DLL_TEST_LISTSIZE+2);
+
+    i = DLL_TEST_LISTSIZE+1;
+    rc = dll_iterator_init(&it, &list);
+    CU_ASSERT(rc == EDLLOK);
+    while ((rc = dll_iterator_prev(&it, &data, NULL)) == EDLLOK) {
+        CU_ASSERT(*((int*)data) == i);
+        i -= (i == DLL_TEST_LISTSIZE/2+2) ? 2 : 1;
+    }
+    CU_ASSERT(i == 1);
+
+    /* Compacted items behave like any other */
+    rc = dll_reverse(&list);
+    CU_ASSERT(rc == EDLLOK);
+    rc = dll_sort(&list, dll_compar_int);
+    CU_ASSERT(rc == EDLLOK);
+    rc = dll_get(&list, &data, NULL, 0);
+    CU_ASSERT(rc == EDLLOK);
+    CU_ASSERT(*((int*)data) == 2);
+
+    rc = dll_compact(&list, 4);
+    CU_ASSERT(rc == EDLLINV);
+
+    rc = dll_clear(&list);
+    CU_ASSERT(rc == EDLLOK);
+}
+
+/* Test dll_save()/dll_load() functionality  */
+static void test_saveload(void) 
+{
+    int rc, i, fd;
+    dll_count_t count;
+    size_t datasize;
+    off_t end;
+    dll_list_t list, loaded;
+    dll_iterator_t it;
+    FILE *file;
+    char byte;
+    void *data = NULL;
+
+    rc = dll_init(&list);
+    CU_ASSERT(rc == EDLLOK);
+
+    rc = dll_init(&loaded);
+    CU_ASSERT(rc == EDLLOK);
+
+    /* Numbers 1..DLL_TEST_LISTSIZE, every 1000th item is a large one */
+    for(i=0;i<DLL_TEST_LISTSIZE;i++) {
+        datasize = ((i % 1000) == 999) ? 1024*1024 + i : sizeof(int);
+        rc = dll_append(&list, &data, datasize);
+        CU_ASSERT(rc == EDLLOK);
+
+        if (rc == EDLLOK) {
+            memset(data, i & 0xff, datasize);
+            *((int*)data) = i+1;
+        }
+    }
+
+    file = tmpfile();
+    CU_ASSERT(file != NULL);
+    if (file == NULL)
+        return;
+    fd = fileno(file);
+
+    rc = dll_save(&list, fd);
+    CU_ASSERT(rc == EDLLOK);
+
+    /* Loading appends to what's already there */
+    rc = dll_append(&loaded, &data, sizeof(int));
+    CU_ASSERT(rc == EDLLOK);
+    *((int*)data) = 0;
+
+    CU_ASSERT(lseek(fd, 0, SEEK_SET) == 0);
+    rc = dll_load(&loaded, fd);
+    CU_ASSERT(rc == EDLLOK);
+
+    /* Nothing was read past the list */
+    end = lseek(fd, 0, SEEK_CUR);
+    CU_ASSERT(end == lseek(fd, 0, SEEK_END));
+
+    rc = dll_count(&loaded, &count);
+    CU_ASSERT(rc == EDLLOK);
+    CU_ASSERT(count == DLL_TEST_LISTSIZE+1);
+
+    i = 0;
+    rc = dll_iterator_init(&it, &loaded);
+    CU_ASSERT(rc == EDLLOK);
+    while (dll_iterator_next(&it, &data, &datasize) == EDLLOK) {
+        CU_ASSERT(*((int*)data) == i);
+        if (i > 0) {
+            CU_ASSERT(datasize == (((i-1) % 1000) == 999 ? 1024*1024 + (size_t)i-1 : sizeof(int)));
+            if (datasize > sizeof(int))
+                CU_ASSERT(((unsigned char*)data)[datasize-1] == (unsigned char)((i-1) & 0xff));
+        }
+        i++;
+    }
+    CU_ASSERT(i == DLL_TEST_LISTSIZE+1);
+
+    /* Loaded items can be removed one by one */
+    rc = dll_remove(&loaded, 1);
+    CU_ASSERT(rc == EDLLOK);
+    rc = dll_clear(&loaded);
+    CU_ASSERT(rc == EDLLOK);
+
+    /* Lists saved one after another are loaded one after another, with
+     * whatever follows them left in place */
+    rc = dll_save(&list, fd);
+    CU_ASSERT(rc == EDLLOK);
+    byte = 'x';
+    CU_ASSERT(write(fd, &byte, 1) == 1);
+
+    CU_ASSERT(lseek(fd, 0, SEEK_SET) == 0);
+    rc = dll_load(&loaded, fd);
+    CU_ASSERT(rc == EDLLOK);
+    CU_ASSERT(lseek(fd, 0, SEEK_CUR) == end);
+    rc = dll_load(&loaded, fd);
+    CU_ASSERT(rc == EDLLOK);
+    CU_ASSERT(read(fd, &byte, 1) == 1);
+    CU_ASSERT(byte == 'x');
+
+    rc = dll_count(&loaded, &count);
+    CU_ASSERT(rc == EDLLOK);
+    CU_ASSERT(count == 2*DLL_TEST_LISTSIZE);
+
+    rc = dll_get(&loaded, &data, &datasize, DLL_TEST_LISTSIZE);
+    CU_ASSERT(rc == EDLLOK);
+    CU_ASSERT(*((int*)data) == 1);
+
+    rc = dll_clear(&loaded);
+    CU_ASSERT(rc == EDLLOK);
+    CU_ASSERT(ftruncate(fd, end) == 0);
+
+    /* A damaged file must be rejected, leaving the list alone */
+    CU_ASSERT(lseek(fd, -2, SEEK_END) > 0);
+    CU_ASSERT(read(fd, &byte, 1) == 1);
+    byte ^= 0x01;
+    CU_ASSERT(lseek(fd, -2, SEEK_END) > 0);
+    CU_ASSERT(write(fd, &byte, 1) == 1);
+
+    CU_ASSERT(lseek(fd, 0, SEEK_SET) == 0);
+    rc = dll_load(&loaded, fd);
+    CU_ASSERT(rc == EDLLERROR);
+
+    rc = dll_count(&loaded, &count);
+    CU_ASSERT(rc == EDLLOK);
+    CU_ASSERT(count == 0);
+
+    /* So must a truncated one */
+    CU_ASSERT(ftruncate(fd, 100) == 0);
+    CU_ASSERT(lseek(fd, 0, SEEK_SET) == 0);
+    rc = dll_load(&loaded, fd);
+    CU_ASSERT(rc == EDLLERROR);
+
+    fclose(file);
+
+    rc = dll_clear(&list);
+    CU_ASSERT(rc == EDLLOK);
+}
+
+/* Test reading saved lists item by item */
+static void test_stream(void) 
+{
+    int rc, i, fd;
+    size_t datasize;
+    dll_list_t list;
+    dll_stream_iterator_t it;
+    FILE *file;
+    char byte;
+    void *data = NULL;
+
+    rc = dll_init(&list);
+    CU_ASSERT(rc == EDLLOK);
+
+    /* Numbers 1..DLL_TEST_LISTSIZE, a few of them too big for the read
+     * buffer */
+    for(i=0;i<DLL_TEST_LISTSIZE;i++) {
+        datasize = ((i % 1000) == 500) ? 3*1024*1024 + i : sizeof(int) + (i % 13);
+        rc = dll_append(&list, &data, datasize);
+        CU_ASSERT(rc == EDLLOK);
+
+        if (rc == EDLLOK) {
+            memset(data, i & 0xff, datasize);
+            *((int*)data) = i+1;
+        }
+    }
+
+    file = tmpfile();
+    CU_ASSERT(file != NULL);
+    if (file == NULL)
+        return;
+    fd = fileno(file);
+
+    rc = dll_save(&list, fd);
+    CU_ASSERT(rc == EDLLOK);
+    CU_ASSERT(lseek(fd, 0, SEEK_SET) == 0);
+
+    rc = dll_stream_iterator_init(&it, fd);
+    CU_ASSERT(rc == EDLLOK);
+
+    i = 0;
+    while ((rc = dll_stream_iterator_next(&it, &data, &datasize)) == EDLLOK) {
+        CU_ASSERT(*((int*)data) == i+1);
+        CU_ASSERT(datasize == (((i % 1000) == 500) ? 3*1024*1024 + (size_t)i : sizeof(int) + (i % 13)));
+        if (datasize > sizeof(int))
+            CU_ASSERT(((unsigned char*)data)[datasize-1] == (unsigned char)(i & 0xff));
+        i++;
+    }
+    CU_ASSERT(rc == EDLLTILT);
+    CU_ASSERT(i == DLL_TEST_LISTSIZE);
+
+    rc = dll_stream_iterator_destroy(&it);
+    CU_ASSERT(rc == EDLLOK);
+
+    /* Damage is noticed at the end */
+    CU_ASSERT(lseek(fd, -2, SEEK_END) > 0);
+    CU_ASSERT(read(fd, &byte, 1) == 1);
+    byte ^= 0x01;
+    CU_ASSERT(lseek(fd, -2, SEEK_END) > 0);
+    CU_ASSERT(write(fd, &byte, 1) == 1);
+    CU_ASSERT(lseek(fd, 0, SEEK_SET) == 0);
+
+    rc = dll_stream_iterator_init(&it, fd);
+    CU_ASSERT(rc == EDLLOK);
+
+    i = 0;
+    while ((rc = dll_stream_iterator_next(&it, &data, &datasize)) == EDLLOK)
+        i++;
+    CU_ASSERT(rc == EDLLERROR);
+    CU_ASSERT(i == DLL_TEST_LISTSIZE);
+
+    rc = dll_stream_iterator_destroy(&it);
+    CU_ASSERT(rc == EDLLOK);
+
+    /* And so is a truncated file */
+    CU_ASSERT(ftruncate(fd, 100) == 0);
+    CU_ASSERT(lseek(fd, 0, SEEK_SET) == 0);
+
+    rc = dll_stream_iterator_init(&it, fd);
+    CU_ASSERT(rc == EDLLOK);
+    while ((rc = dll_stream_iterator_next(&it, &data, &datasize)) == EDLLOK)
+        ;
+    CU_ASSERT(rc == EDLLERROR);
+
+    rc = dll_stream_iterator_destroy(&it);
+    CU_ASSERT(rc == EDLLOK);
+
+    fclose(file);
+
+    rc = dll_clear(&list);
+    CU_ASSERT(rc == EDLLOK);
+}
+
+#ifdef DLL_HAVE_PTHREAD
+static void *test_snapshot_reader(void *arg)
+{
+    int *data, first = 0;
+    unsigned int count = 0;
+    dll_iterator_t it;
+    dll_list_t *snap = (dll_list_t*)arg;
+
+    /* Every snapshot holds DLL_TEST_LISTSIZE consecutive numbers */
+    dll_iterator_init(&it, snap);
+    while (dll_iterator_next(&it, (void**)&data, NULL) == EDLLOK) {
+        if (count == 0)
+            first = *data;
+        else if (*data != first + (int)count)
+            break;
+        count++;
+    }
+
+    dll_clear(snap);
+
+    return (count == DLL_TEST_LISTSIZE) ? snap : NULL;
+}
+#endif
+
+/* Test dll_snapshot() and dll_unshare() functionality  */
+static void test_snapshot(void) 
+{
+    int rc, i;
+    dll_count_t count;
+    dll_list_t list, snap1, snap2;
+    dll_iterator_t it;
+    void *data = NULL, *data1 = NULL;
+
+    rc = dll_init(&list);
+    CU_ASSERT(rc == EDLLOK);
+    rc = dll_init(&snap1);
+    CU_ASSERT(rc == EDLLOK);
+    rc = dll_init(&snap2);
+    CU_ASSERT(rc == EDLLOK);
+
+    /* Nothing to share */
+    rc = dll_snapshot(&list, &snap1);
+    CU_ASSERT(rc == EDLLOK);
+    CU_ASSERT(snap1.count == 0);
+
+    for(i=0;i<DLL_TEST_LISTSIZE;i++) {
+        rc = dll_append(&list, &data, sizeof(int));
+        CU_ASSERT(rc == EDLLOK);
+
+        if (rc == EDLLOK)
+            *((int*)data) = i+1;
+    }
+
+    /* Both snapshots share everything with the list */
+    rc = dll_snapshot(&list, &snap1);
+    CU_ASSERT(rc == EDLLOK);
+    rc = dll_snapshot(&list, &snap2);
+    CU_ASSERT(rc == EDLLOK);
+    CU_ASSERT(snap1.first == list.first);
+    CU_ASSERT(snap2.first == list.first);
+    rc = dll_snapshot(&list, &snap1);
+    CU_ASSERT(rc == EDLLINV);
+
+    /* Modifying the list leaves the snapshots alone, the data is still
+     * shared */
+    rc = dll_remove(&list, 0);
+    CU_ASSERT(rc == EDLLOK);
+    rc = dll_reverse(&list);
+    CU_ASSERT(rc == EDLLOK);
+    CU_ASSERT(snap1.first != list.first);
+    CU_ASSERT(snap1.first == snap2.first);
+
+    rc = dll_get(&list, &data, NULL, 0);
+    CU_ASSERT(rc == EDLLOK);
+    CU_ASSERT(*((int*)data) == DLL_TEST_LISTSIZE);
+    rc = dll_get(&snap1, &data1, NULL, DLL_TEST_LISTSIZE-1);
+    CU_ASSERT(rc == EDLLOK);
+    CU_ASSERT(data == data1);
+
+    i = 1;
+    rc = dll_iterator_init(&it, &snap1);
+    CU_ASSERT(rc == EDLLOK);
+    while (dll_iterator_next(&it, &data, NULL) == EDLLOK) {
+        CU_ASSERT(*((int*)data) == i);
+        i++;
+    }
+    CU_ASSERT(i == DLL_TEST_LISTSIZE+1);
+
+    /* Same for a snapshot */
+    rc = dll_append(&snap2, &data, sizeof(int));
+    CU_ASSERT(rc == EDLLOK);
+    *((int*)data) = 0;
+    CU_ASSERT(snap1.first != snap2.first);
+    rc = dll_count(&snap1, &count);
+    CU_ASSERT(rc == EDLLOK);
+    CU_ASSERT(count == DLL_TEST_LISTSIZE);
+
+    /* The remaining sharer can go away first */
+    rc = dll_clear(&snap1);
+    CU_ASSERT(rc == EDLLOK);
+    rc = dll_count(&snap2, &count);
+    CU_ASSERT(rc == EDLLOK);
+    CU_ASSERT(count == DLL_TEST_LISTSIZE+1);
+
+    /* Writing data in place takes dll_unshare() */
+    rc = dll_snapshot(&snap2, &snap1);
+    CU_ASSERT(rc == EDLLOK);
+    rc = dll_unshare(&snap2);
+    CU_ASSERT(rc == EDLLOK);
+    rc = dll_get(&snap2, &data, NULL, 0);
+    CU_ASSERT(rc == EDLLOK);
+    *((int*)data) = -1;
+    rc = dll_get(&snap1, &data, NULL, 0);
+    CU_ASSERT(rc == EDLLOK);
+    CU_ASSERT(*((int*)data) == 1);
+
+    rc = dll_clear(&snap1);
+    CU_ASSERT(rc == EDLLOK);
+    rc = dll_clear(&snap2);
+    CU_ASSERT(rc == EDLLOK);
+
+    /* Compacting a list moves its shared data out of the way */
+    rc = dll_sort(&list, dll_compar_int);
+    CU_ASSERT(rc == EDLLOK);
+    rc = dll_snapshot(&list, &snap1);
+    CU_ASSERT(rc == EDLLOK);
+    rc = dll_compact(&list, DLL_COMPACT_DATA);
+    CU_ASSERT(rc == EDLLOK);
+    rc = dll_get(&list, &data, NULL, 0);
+    CU_ASSERT(rc == EDLLOK);
+    rc = dll_get(&snap1, &data1, NULL, 0);
+    CU_ASSERT(rc == EDLLOK);
+    CU_ASSERT(data != data1);
+    CU_ASSERT(*((int*)data) == *((int*)data1));
+    rc = dll_clear(&snap1);
+    CU_ASSERT(rc == EDLLOK);
+
+#ifdef DLL_HAVE_PTHREAD
+    {
+        pthread_t thread;
+        void *ret;
+
+        rc = dll_append(&list, &data, sizeof(int));
+        CU_ASSERT(rc == EDLLOK);
+        *((int*)data) = DLL_TEST_LISTSIZE+1;
+
+        /* Readers look at and drop their snapshots while the list keeps
+         * changing. Every other time the items start out in one block,
+         * so both threads release chunks of it. */
+        for (i=0;i<20;i++) {
+            if (i % 2 == 0) {
+                rc = dll_compact(&list, DLL_COMPACT_DATA);
+                CU_ASSERT(rc == EDLLOK);
+            }
+
+            rc = dll_snapshot(&list, &snap1);
+            CU_ASSERT(rc == EDLLOK);
+            CU_ASSERT(pthread_create(&thread, NULL, test_snapshot_reader, &snap1) == 0);
+
+            rc = dll_remove(&list, 0);
+            CU_ASSERT(rc == EDLLOK);
+            rc = dll_append(&list, &data, sizeof(int));
+            CU_ASSERT(rc == EDLLOK);
+            *((int*)data) = DLL_TEST_LISTSIZE+i+2;
+
+            pthread_join(thread, &ret);
+            CU_ASSERT(ret == &snap1);
+        }
+    }
+#endif
+
+    rc = dll_clear(&list);
+    CU_ASSERT(rc == EDLLOK);
+}
+
+static int test_compar_key(const void *a, const void *b)
+{
+    return ((const int*)a)[0] - ((const int*)b)[0];
+}
+
+static void test_extsort_check(dll_list_t *list)
+{
+    int rc, *data = NULL, *prev = NULL;
+    dll_count_t count;
+    dll_iterator_t it;
+
+    rc = dll_count(list, &count);
+    CU_ASSERT(rc == EDLLOK);
+    CU_ASSERT(count == DLL_TEST_LISTSIZE);
+
+    /* Sorted by key, equal keys in input order */
+    dll_iterator_init(&it, list);
+    while (dll_iterator_next(&it, (void**)&data, NULL) == EDLLOK) {
+        if (prev != NULL) {
+            CU_ASSERT(prev[0] <= data[0]);
+            if (prev[0] == data[0])
+                CU_ASSERT(prev[1] < data[1]);
+        }
+        prev = data;
+    }
+}
+
+/* Test the external merge sort */
+static void test_extsort(void) 
+{
+    int rc, i, infd, outfd;
+    dll_list_t list, sorted;
+    dll_extsort_opts_t opts;
+    FILE *in, *out;
+    int *data = NULL;
+
+    rc = dll_init(&list);
+    CU_ASSERT(rc == EDLLOK);
+    rc = dll_init(&sorted);
+    CU_ASSERT(rc == EDLLOK);
+
+    /* Random keys with lots of duplicates, the index tells the input
+     * order */
+    for(i=0;i<DLL_TEST_LISTSIZE;i++) {
+        rc = dll_append(&list, (void**)&data, 2*sizeof(int) + (i % 7));
+        CU_ASSERT(rc == EDLLOK);
+
+        if (rc == EDLLOK) {
+            data[0] = (int)(random() % 100);
+            data[1] = i;
+        }
+    }
+
+    in = tmpfile();
+    out = tmpfile();
+    CU_ASSERT((in != NULL) && (out != NULL));
+    if ((in == NULL) || (out == NULL))
+        return;
+    infd = fileno(in);
+    outfd = fileno(out);
+
+    rc = dll_save(&list, infd);
+    CU_ASSERT(rc == EDLLOK);
+
+    /* Fits into memory */
+    CU_ASSERT(lseek(infd, 0, SEEK_SET) == 0);
+    rc = dll_extsort_list(infd, &sorted, test_compar_key, NULL);
+    CU_ASSERT(rc == EDLLOK);
+    test_extsort_check(&sorted);
+    dll_clear(&sorted);
+
+    /* A tiny budget makes for lots of runs and several merge passes */
+    opts.budget = 64*1024;
+    opts.tmpdir = "/tmp";
+
+    CU_ASSERT(lseek(infd, 0, SEEK_SET) == 0);
+    rc = dll_extsort_list(infd, &sorted, test_compar_key, &opts);
+    CU_ASSERT(rc == EDLLOK);
+    test_extsort_check(&sorted);
+    dll_clear(&sorted);
+
+    CU_ASSERT(lseek(infd, 0, SEEK_SET) == 0);
+    rc = dll_extsort_file(infd, outfd, test_compar_key, &opts);
+    CU_ASSERT(rc == EDLLOK);
+
+    CU_ASSERT(lseek(outfd, 0, SEEK_SET) == 0);
+    rc = dll_load(&sorted, outfd);
+    CU_ASSERT(rc == EDLLOK);
+    test_extsort_check(&sorted);
+    dll_clear(&sorted);
+
+    /* No such directory */
+    opts.tmpdir = "/nonexistent";
+    CU_ASSERT(lseek(infd, 0, SEEK_SET) == 0);
+    rc = dll_extsort_list(infd, &sorted, test_compar_key, &opts);
+    CU_ASSERT(rc == EDLLIO);
+    CU_ASSERT(sorted.count == 0);
+
+    fclose(in);
+    fclose(out);
+
+    rc = dll_clear(&list);
+    CU_ASSERT(rc == EDLLOK);
+}
+
+/* Test the file-backed mapped list */
+static void test_mapped(void) 
+{
+    int rc, i, fd;
+    dll_count_t count;
+    size_t datasize, size;
+    dll_mapped_t mapped;
+    dll_mapped_iterator_t it;
+    char path[] = "/tmp/dlltestXXXXXX";
+    void *data = NULL;
+
+    fd = mkstemp(path);
+    CU_ASSERT(fd >= 0);
+    if (fd < 0)
+        return;
+    close(fd);
+    unlink(path);
+
+    rc = dll_mapped_open(&mapped, path);
+    CU_ASSERT(rc == EDLLOK);
+    if (rc != EDLLOK)
+        return;
+
+    /* Numbers DLL_TEST_LISTSIZE..1, enough to grow the file a few times */
+    for(i=0;i<DLL_TEST_LISTSIZE;i++) {
+        datasize = ((i % 100) == 99) ? 10000 : sizeof(int);
+        rc = dll_mapped_append(&mapped, &data, datasize);
+        CU_ASSERT(rc == EDLLOK);
+
+        if (rc == EDLLOK)
+            *((int*)data) = DLL_TEST_LISTSIZE-i;
+    }
+
+    /* Drop the first and the last one */
+    rc = dll_mapped_remove(&mapped, 0);
+    CU_ASSERT(rc == EDLLOK);
+    rc = dll_mapped_remove(&mapped, DLL_TEST_LISTSIZE-2);
+    CU_ASSERT(rc == EDLLOK);
+    rc = dll_mapped_remove(&mapped, DLL_TEST_LISTSIZE-2);
+    CU_ASSERT(rc == EDLLINV);
+
+    rc = dll_mapped_flush(&mapped);
+    CU_ASSERT(rc == EDLLOK);
+    rc = dll_mapped_close(&mapped);
+    CU_ASSERT(rc == EDLLOK);
+
+    /* Reopened, the list is there as it was */
+    rc = dll_mapped_open(&mapped, path);
+    CU_ASSERT(rc == EDLLOK);
+    if (rc != EDLLOK)
+        return;
+
+    rc = dll_mapped_count(&mapped, &count);
+    CU_ASSERT(rc == EDLLOK);
+    CU_ASSERT(count == DLL_TEST_LISTSIZE-2);
+
+    rc = dll_mapped_get(&mapped, &data, &datasize, 0);
+    CU_ASSERT(rc == EDLLOK);
+    CU_ASSERT(*((int*)data) == DLL_TEST_LISTSIZE-1);
+    rc = dll_mapped_get(&mapped, &data, &datasize, 98);
+    CU_ASSERT(rc == EDLLOK);
+    CU_ASSERT(datasize == 10000);
+
+    /* Sort in place and walk it both ways */
+    rc = dll_mapped_sort(&mapped, dll_compar_int);
+    CU_ASSERT(rc == EDLLOK);
+
+    i = 2;
+    rc = dll_mapped_iterator_init(&it, &mapped);
+    CU_ASSERT(rc == EDLLOK);
+    while (dll_mapped_iterator_next(&it, &data, NULL) == EDLLOK) {
+        CU_ASSERT(*((int*)data) == i);
+        i++;
+    }
+    CU_ASSERT(i == DLL_TEST_LISTSIZE);
+
+    i = DLL_TEST_LISTSIZE-1;
+    rc = dll_mapped_iterator_init(&it, &mapped);
+    CU_ASSERT(rc == EDLLOK);
+    while (dll_mapped_iterator_prev(&it, &data, NULL) == EDLLOK) {
+        CU_ASSERT(*((int*)data) == i);
+        i--;
+    }
+    CU_ASSERT(i == 1);
+
+    /* Space of removed items is reused, the file doesn't grow */
+    size = mapped.size;
+    for(i=0;i<1000;i++) {
+        rc = dll_mapped_remove(&mapped, 0);
+        CU_ASSERT(rc == EDLLOK);
+    }
+    for(i=0;i<1000;i++) {
+        rc = dll_mapped_append(&mapped, &data, sizeof(int));
+        CU_ASSERT(rc == EDLLOK);
+    }
+    CU_ASSERT(mapped.size == size);
+
+    rc = dll_mapped_clear(&mapped);
+    CU_ASSERT(rc == EDLLOK);
+    rc = dll_mapped_count(&mapped, &count);
+    CU_ASSERT(rc == EDLLOK);
+    CU_ASSERT(count == 0);
+    rc = dll_mapped_iterator_init(&it, &mapped);
+    CU_ASSERT(rc == EDLLOK);
+    rc = dll_mapped_iterator_next(&it, &data, NULL);
+    CU_ASSERT(rc == EDLLERROR);
+
+    rc = dll_mapped_close(&mapped);
+    CU_ASSERT(rc == EDLLOK);
+
+    /* Anything else is refused */
+    fd = open(path, O_WRONLY | O_TRUNC);
+    CU_ASSERT(fd >= 0);
+    if (fd >= 0) {
+        for(i=0;i<2000;i++)
+            CU_ASSERT(write(fd, "garbage", 7) == 7);
+        close(fd);
+    }
+    rc = dll_mapped_open(&mapped, path);
+    CU_ASSERT(rc == EDLLERROR);
+
+    unlink(path);
+}
+
+/* Test lists in shared memory, followed by a second mapping */
+static void test_mapped_shared(void) 
+{
+    int rc, i, status;
+    pid_t pid;
+    char name[64];
+    size_t datasize;
+    dll_count_t count;
+    dll_mapped_t producer, consumer;
+    dll_mapped_iterator_t it;
+    void *data = NULL;
+
+    sprintf(name, "/dlltest%d", (int)getpid());
+    dll_mapped_unlink(name);
+
+    rc = dll_mapped_open_shared(&producer, name, 64*1024);
+    CU_ASSERT(rc == EDLLOK);
+    if (rc != EDLLOK)
+        return;
+
+    rc = dll_mapped_open_shared(&consumer, name, 0);
+    CU_ASSERT(rc == EDLLOK);
+    if (rc != EDLLOK)
+        return;
+
+    rc = dll_mapped_iterator_init(&it, &consumer);
+    CU_ASSERT(rc == EDLLOK);
+    rc = dll_mapped_iterator_poll(&it, &data, NULL);
+    CU_ASSERT(rc == EDLLERROR);
+
+    /* Nothing shows up before it's been published */
+    for(i=0;i<10;i++) {
+        rc = dll_mapped_append(&producer, &data, sizeof(int));
+        CU_ASSERT(rc == EDLLOK);
+        *((int*)data) = i+1;
+    }
+    rc = dll_mapped_iterator_poll(&it, &data, NULL);
+    CU_ASSERT(rc == EDLLERROR);
+
+    rc = dll_mapped_publish(&producer);
+    CU_ASSERT(rc == EDLLOK);
+
+    for(i=0;i<10;i++) {
+        rc = dll_mapped_iterator_poll(&it, &data, &datasize);
+        CU_ASSERT(rc == EDLLOK);
+        CU_ASSERT(datasize == sizeof(int));
+        CU_ASSERT(*((int*)data) == i+1);
+    }
+    rc = dll_mapped_iterator_poll(&it, &data, NULL);
+    CU_ASSERT(rc == EDLLERROR);
+
+    /* The iterator picks up where it stopped */
+    rc = dll_mapped_append(&producer, &data, sizeof(int));
+    CU_ASSERT(rc == EDLLOK);
+    *((int*)data) = 11;
+    rc = dll_mapped_publish(&producer);
+    CU_ASSERT(rc == EDLLOK);
+    rc = dll_mapped_iterator_poll(&it, &data, NULL);
+    CU_ASSERT(rc == EDLLOK);
+    CU_ASSERT(*((int*)data) == 11);
+
+    /* Segments never grow */
+    for(i=0;i<1000;i++) {
+        rc = dll_mapped_append(&producer, &data, 1000);
+        if (rc != EDLLOK)
+            break;
+    }
+    CU_ASSERT(rc == EDLLNOMEM);
+    CU_ASSERT(producer.size == 64*1024);
+
+    rc = dll_mapped_close(&consumer);
+    CU_ASSERT(rc == EDLLOK);
+    rc = dll_mapped_close(&producer);
+    CU_ASSERT(rc == EDLLOK);
+
+    rc = dll_mapped_unlink(name);
+    CU_ASSERT(rc == EDLLOK);
+    rc = dll_mapped_open_shared(&producer, name, 0);
+    CU_ASSERT(rc == EDLLINV);
+    dll_mapped_unlink(name);
+
+    /* Processes racing to create the same segment all end up with the
+     * one list, set up once */
+    for (i=0; i<4; i++) {
+        pid = fork();
+        CU_ASSERT(pid >= 0);
+        if (pid == 0) {
+            rc = dll_mapped_open_shared(&consumer, name, 64*1024);
+            if (rc == EDLLOK)
+                rc = dll_mapped_count(&consumer, &count);
+            _exit(((rc == EDLLOK) && (count == 0)) ? 0 : 1);
+        }
+    }
+
+    rc = dll_mapped_open_shared(&producer, name, 64*1024);
+    CU_ASSERT(rc == EDLLOK);
+
+    for (i=0; i<4; i++) {
+        CU_ASSERT(wait(&status) > 0);
+        CU_ASSERT(WIFEXITED(status) && (WEXITSTATUS(status) == 0));
+    }
+
+    if (rc == EDLLOK) {
+        rc = dll_mapped_count(&producer, &count);
+        CU_ASSERT((rc == EDLLOK) && (count == 0));
+        dll_mapped_close(&producer);
+    }
+    dll_mapped_unlink(name);
+}
+
+static void test_stats(void)
+{
+    int rc;
+    dll_list_t list;
+    dll_stats_t stats;
+#ifdef DLL_ENABLE_STATS
+    int i, key;
+    dll_count_t index;
+    dll_list_t other;
+    dll_iterator_t it;
+    void *data;
+#endif
+
+    rc = dll_init(&list);
+    CU_ASSERT(rc == EDLLOK);
+
+    rc = dll_stats_get(NULL, &stats);
+    CU_ASSERT(rc == EDLLINV);
+    rc = dll_stats_get(&list, NULL);
+    CU_ASSERT(rc == EDLLINV);
+    rc = dll_stats_reset(NULL);
+    CU_ASSERT(rc == EDLLINV);
+
+#ifdef DLL_ENABLE_STATS
+    rc = dll_init(&other);
+    CU_ASSERT(rc == EDLLOK);
+
+    rc = dll_stats_get(&list, &stats);
+    CU_ASSERT(rc == EDLLOK);
+    CU_ASSERT((stats.allocs == 0) && (stats.bytes == 0) && (stats.seeks == 0));
+
+    for (i=0; i<100; i++) {
+        rc = dll_append(&list, &data, sizeof(int));
+        CU_ASSERT(rc == EDLLOK);
+        *(int*)data = 99-i;
+    }
+
+    dll_stats_get(&list, &stats);
+    CU_ASSERT(stats.allocs == 100);
+    CU_ASSERT(stats.frees == 0);
+    CU_ASSERT(stats.bytes >= 100*(3*sizeof(void*)+sizeof(int)));
+
+    /* Lookups walk from the nearer end */
+    dll_get(&list, &data, NULL, 10);
+    dll_get(&list, &data, NULL, 97);
+    dll_remove(&list, 20);
+    dll_insert(&list, &data, sizeof(int), 30);
+    *(int*)data = 1000;
+
+    dll_stats_get(&list, &stats);
+    CU_ASSERT(stats.seeks == 4);
+    CU_ASSERT(stats.seekdist == 10+2+20+29);
+    CU_ASSERT(stats.seekmax == 29);
+    CU_ASSERT(stats.allocs == 101);
+    CU_ASSERT(stats.frees == 1);
+
+    /* Counters start over, bytes stay */
+    rc = dll_stats_reset(&list);
+    CU_ASSERT(rc == EDLLOK);
+    dll_stats_get(&list, &stats);
+    CU_ASSERT((stats.allocs == 0) && (stats.frees == 0) && (stats.seeks == 0));
+    CU_ASSERT(stats.bytes >= 100*(3*sizeof(void*)+sizeof(int)));
+
+    key = 1000;
+    rc = dll_indexof(&list, dll_compar_int, &key, &index);
+    CU_ASSERT((rc == EDLLOK) && (index == 30));
+    dll_stats_get(&list, &stats);
+    CU_ASSERT(stats.compares == 31);
+
+    dll_sort(&list, dll_compar_int);
+    dll_stats_get(&list, &stats);
+    CU_ASSERT(stats.compares > 31);
+
+    dll_iterator_init(&it, &list);
+    for (i=0; i<101; i++)
+        dll_iterator_next(&it, &data, NULL);
+    dll_stats_get(&list, &stats);
+    CU_ASSERT(stats.tilts == 1);
+
+    /* Bytes follow the items */
+    rc = dll_splice(&other, &list);
+    CU_ASSERT(rc == EDLLOK);
+    dll_stats_get(&list, &stats);
+    CU_ASSERT(stats.bytes == 0);
+    dll_stats_get(&other, &stats);
+    CU_ASSERT(stats.bytes >= 100*(3*sizeof(void*)+sizeof(int)));
+
+    dll_clear(&other);
+    dll_stats_get(&other, &stats);
+    CU_ASSERT(stats.frees == 100);
+    CU_ASSERT(stats.bytes == 0);
+#else
+    rc = dll_stats_get(&list, &stats);
+    CU_ASSERT(rc == EDLLERROR);
+    rc = dll_stats_reset(&list);
+    CU_ASSERT(rc == EDLLERROR);
+#endif
+}
+
+static void test_perf(void)
+{
+    int rc, i, avail;
+    unsigned int event;
+    dll_list_t list;
+    dll_perf_t perf;
+    void *data;
+    double value;
+
+    rc = dll_perf_init(NULL);
+    CU_ASSERT(rc == EDLLINV);
+
+    /* No counters (e.g. in a VM) is fine, the profile just stays empty */
+    rc = dll_perf_init(&perf);
+    CU_ASSERT((rc == EDLLOK) || (rc == EDLLERROR));
+
+    dll_init(&list);
+    for (i=0; i<DLL_TEST_LISTSIZE; i++) {
+        dll_append(&list, &data, sizeof(int));
+        *(int*)data = DLL_TEST_LISTSIZE-i;
+    }
+
+    rc = dll_perf_begin(&perf);
+    CU_ASSERT(rc == EDLLOK);
+    dll_sort(&list, dll_compar_int);
+    rc = dll_perf_end(&perf, DLL_TEST_LISTSIZE);
+    CU_ASSERT(rc == EDLLOK);
+
+    avail = 0;
+    for (event=0; event<DLL_PERF_NEVENTS; event++) {
+        CU_ASSERT(dll_perf_name(event) != NULL);
+
+        rc = dll_perf_get(&perf, event, &value);
+        CU_ASSERT((rc == EDLLOK) || (rc == EDLLERROR));
+        if (rc == EDLLOK) {
+            CU_ASSERT(value >= 0.0);
+            avail++;
+        }
+    }
+    CU_ASSERT(dll_perf_name(DLL_PERF_NEVENTS) == NULL);
+    rc = dll_perf_get(&perf, DLL_PERF_NEVENTS, &value);
+    CU_ASSERT(rc == EDLLINV);
+
+    if (dll_perf_get(&perf, DLL_PERF_INSTRUCTIONS, &value) == EDLLOK)
+        CU_ASSERT(value > 0.0);
+
+    rc = dll_perf_reset(&perf);
+    CU_ASSERT(rc == EDLLOK);
+    for (event=0; event<DLL_PERF_NEVENTS; event++)
+        if (dll_perf_get(&perf, event, &value) == EDLLOK)
+            CU_ASSERT(value == 0.0);
+
+    rc = dll_perf_destroy(&perf);
+    CU_ASSERT(rc == EDLLOK);
+    for (event=0; event<DLL_PERF_NEVENTS; event++)
+        CU_ASSERT(dll_perf_get(&perf, event, &value) == EDLLERROR);
+
+    dll_clear(&list);
+}
+
+/* What the hooks in test_hooks() have seen */
+typedef struct {
+    long items, data, sorts, seeks, distance;
+    size_t bytes;
+} test_hooks_t;
+
+static void test_hooks_alloc(void *ctx, dll_list_t *list, const void *ptr, size_t size)
+{
+    test_hooks_t *seen = (test_hooks_t*)ctx;
+
+    if (size == 3*sizeof(int))
+        seen->data++;
+    else
+        seen->items++;
+    seen->bytes += size;
+}
+
+static void test_hooks_free(void *ctx, dll_list_t *list, const void *ptr, size_t size)
+{
+    test_hooks_t *seen = (test_hooks_t*)ctx;
+
+    if (size == 3*sizeof(int))
+        seen->data--;
+    else
+        seen->items--;
+    seen->bytes -= size;
+}
+
+static void test_hooks_sort(void *ctx, dll_list_t *list)
+{
+    ((test_hooks_t*)ctx)->sorts++;
+}
+
+static void test_hooks_seek(void *ctx, dll_list_t *list, dll_count_t position, dll_count_t distance)
+{
+    test_hooks_t *seen = (test_hooks_t*)ctx;
+
+    seen->seeks++;
+    seen->distance += distance;
+}
+
+static void test_hooks(void)
+{
+    int rc, i;
+    dll_list_t list, snap;
+    dll_hooks_t hooks;
+    test_hooks_t seen;
+    size_t bytes;
+    void *data;
+
+    memset(&seen, 0, sizeof(seen));
+    memset(&hooks, 0, sizeof(hooks));
+    hooks.item_alloc = test_hooks_alloc;
+    hooks.data_alloc = test_hooks_alloc;
+    hooks.item_free = test_hooks_free;
+    hooks.data_free = test_hooks_free;
+    hooks.sort_end = test_hooks_sort;
+    hooks.seek = test_hooks_seek;
+    hooks.ctx = &seen;
+
+    rc = dll_set_hooks(&hooks);
+    CU_ASSERT(rc == EDLLOK);
+
+    dll_init(&list);
+    dll_init(&snap);
+    for (i=0; i<100; i++) {
+        rc = dll_append(&list, &data, 3*sizeof(int));
+        CU_ASSERT(rc == EDLLOK);
+        *(int*)data = 100-i;
+    }
+    CU_ASSERT((seen.items == 100) && (seen.data == 100));
+    CU_ASSERT(seen.bytes > 100*3*sizeof(int));
+
+    dll_get(&list, &data, NULL, 10);
+    dll_remove(&list, 90);
+    CU_ASSERT((seen.seeks == 2) && (seen.distance == 10+90));
+    CU_ASSERT((seen.items == 99) && (seen.data == 99));
+
+    /* Only sort_end is set, sort_begin is a stub */
+    dll_sort(&list, dll_compar_int);
+    CU_ASSERT(seen.sorts == 1);
+
+    /* Shared items are freed once, by whoever lets go last, a copy of the
+     * containers shows up as allocations */
+    rc = dll_snapshot(&list, &snap);
+    CU_ASSERT(rc == EDLLOK);
+    CU_ASSERT(seen.items == 99);
+    dll_remove(&snap, 0);
+    CU_ASSERT(seen.items == 99+99-1);
+    CU_ASSERT(seen.data == 99);
+
+    dll_compact(&list, DLL_COMPACT_DATA);
+    CU_ASSERT((seen.items == 99+98) && (seen.data == 99+98));
+
+    dll_clear(&list);
+    dll_clear(&snap);
+    CU_ASSERT((seen.items == 0) && (seen.data == 0) && (seen.bytes == 0));
+
+    /* Compacting small items must not cost more memory than it saves.
+     * Without DLL_COMPACT_INLINE they aren't touched at all. */
+    for (i=0; i<100; i++) {
+        rc = dll_append(&list, &data, sizeof(int));
+        CU_ASSERT(rc == EDLLOK);
+        *(int*)data = i;
+    }
+    /* The data of each shows up as an allocation of its own */
+    bytes = seen.bytes;
+    CU_ASSERT(seen.items == 2*100);
+
+    rc = dll_compact(&list, 0);
+    CU_ASSERT(rc == EDLLOK);
+    CU_ASSERT((seen.items == 2*100) && (seen.bytes == bytes));
+
+    rc = dll_compact(&list, DLL_COMPACT_INLINE);
+    CU_ASSERT(rc == EDLLOK);
+    CU_ASSERT((seen.items == 2*100) && (seen.bytes == bytes));
+
+    dll_clear(&list);
+    CU_ASSERT((seen.items == 0) && (seen.bytes == 0));
+
+    rc = dll_set_hooks(NULL);
+    CU_ASSERT(rc == EDLLOK);
+    dll_append(&list, &data, 3*sizeof(int));
+    CU_ASSERT(seen.items == 0);
+    dll_clear(&list);
+}
+
+#ifdef DLL_HAVE_PTHREAD
+#define DLL_TEST_TRACEITEMS 20000
+
+static void *test_trace_worker(void *arg)
+{
+    int i;
+    void *data;
+    dll_list_t *list = (dll_list_t*)arg;
+
+    dll_init(list);
+    for (i=0; i<DLL_TEST_TRACEITEMS; i++)
+        dll_append(list, &data, sizeof(int));
+    dll_clear(list);
+
+    return NULL;
+}
+#endif
+
+static void test_trace(void)
+{
+    int rc, fd;
+    unsigned int i;
+    FILE *file;
+    dll_list_t list, other;
+    dll_iterator_t it;
+    dll_trace_record_t rec[16];
+    char magic[4];
+    uint32_t version;
+    void *data;
+
+    rc = dll_trace_stop();
+    CU_ASSERT(rc == EDLLERROR);
+    rc = dll_trace_start(-1);
+    CU_ASSERT(rc == EDLLINV);
+
+    file = tmpfile();
+    CU_ASSERT(file != NULL);
+    if (file == NULL)
+        return;
+    fd = fileno(file);
+
+    rc = dll_trace_start(fd);
+    CU_ASSERT(rc == EDLLOK);
+    rc = dll_trace_start(fd);
+    CU_ASSERT(rc == EDLLERROR);
+
+    dll_init(&list);
+    dll_init(&other);
+    dll_append(&list, &data, 12);
+    dll_insert(&list, &data, 20, 1);
+    dll_append(&other, &data, 4);
+    dll_splice(&list, &other);
+    dll_remove(&list, 2);
+    dll_iterator_init(&it, &list);
+    dll_iterator_next(&it, &data, NULL);
+    dll_sort(&list, dll_compar_int);
+    dll_clear(&list);
+
+    rc = dll_trace_stop();
+    CU_ASSERT(rc == EDLLOK);
+
+    /* Nothing is recorded any more */
+    dll_init(&list);
+
+    CU_ASSERT(lseek(fd, 0, SEEK_SET) == 0);
+    CU_ASSERT(read(fd, magic, 4) == 4);
+    CU_ASSERT(memcmp(magic, DLL_TRACE_MAGIC, 4) == 0);
+    CU_ASSERT(read(fd, &version, sizeof(version)) == sizeof(version));
+    CU_ASSERT(version == DLL_TRACE_VERSION);
+    CU_ASSERT(read(fd, rec, sizeof(rec)) == 11*sizeof(dll_trace_record_t));
+
+    CU_ASSERT((rec[0].op == DLL_TRACE_INIT) && (rec[0].id == 1));
+    CU_ASSERT((rec[1].op == DLL_TRACE_INIT) && (rec[1].id == 2));
+    CU_ASSERT((rec[2].op == DLL_TRACE_APPEND) && (rec[2].id == 1) && (rec[2].datasize == 12));
+    CU_ASSERT((rec[3].op == DLL_TRACE_INSERT) && (rec[3].arg == 1) && (rec[3].datasize == 20));
+    CU_ASSERT((rec[4].op == DLL_TRACE_APPEND) && (rec[4].id == 2));
+    CU_ASSERT((rec[5].op == DLL_TRACE_SPLICE) && (rec[5].id == 1) && (rec[5].arg == 2));
+    CU_ASSERT((rec[6].op == DLL_TRACE_REMOVE) && (rec[6].arg == 2));
+    CU_ASSERT((rec[7].op == DLL_TRACE_ITERINIT) && (rec[7].id == 3) && (rec[7].arg == 1));
+    CU_ASSERT((rec[8].op == DLL_TRACE_ITERNEXT) && (rec[8].id == 3));
+    CU_ASSERT(rec[9].op == DLL_TRACE_SORT);
+    CU_ASSERT((rec[10].op == DLL_TRACE_CLEAR) && (rec[10].id == 1));
+    for (i=0; i<11; i++)
+        CU_ASSERT(rec[i].reserved[0] == 0);
+
+    fclose(file);
+
+#ifdef DLL_HAVE_PTHREAD
+    /* Several threads fill up many buffers, each list's records in order */
+    {
+        pthread_t threads[4];
+        dll_list_t lists[4];
+        uint32_t seen[4];
+        unsigned int n, total = 0, bad = 0;
+        ssize_t got;
+
+        file = tmpfile();
+        CU_ASSERT(file != NULL);
+        if (file == NULL)
+            return;
+        fd = fileno(file);
+
+        rc = dll_trace_start(fd);
+        CU_ASSERT(rc == EDLLOK);
+        for (i=0; i<4; i++)
+            CU_ASSERT(pthread_create(&threads[i], NULL, test_trace_worker, &lists[i]) == 0);
+        for (i=0; i<4; i++)
+            pthread_join(threads[i], NULL);
+        rc = dll_trace_stop();
+        CU_ASSERT(rc == EDLLOK);
+
+        /* Ids 1 to 4 are the lists, appends come between init and clear */
+        memset(seen, 0, sizeof(seen));
+        CU_ASSERT(lseek(fd, 4 + sizeof(version), SEEK_SET) == (off_t)(4 + sizeof(version)));
+        while ((got = read(fd, rec, sizeof(rec))) > 0) {
+            for (n=0; n<(unsigned int)got/sizeof(dll_trace_record_t); n++, total++) {
+                if ((rec[n].id < 1) || (rec[n].id > 4)) {
+                    bad++;
+                    continue;
+                }
+                i = rec[n].id - 1;
+                if (rec[n].op == DLL_TRACE_INIT)
+                    bad += (seen[i] != 0);
+                else if (rec[n].op == DLL_TRACE_APPEND)
+                    bad += ((seen[i] < 1) || (seen[i] > DLL_TEST_TRACEITEMS));
+                else if (rec[n].op == DLL_TRACE_CLEAR)
+                    bad += (seen[i] != DLL_TEST_TRACEITEMS + 1);
+                else
+                    bad++;
+                seen[i]++;
+            }
+        }
+        CU_ASSERT(total == 4*(DLL_TEST_TRACEITEMS + 2));
+        CU_ASSERT(bad == 0);
+
+        fclose(file);
+    }
+#endif
+}
+
+/* Test DLL_DEFINE_TYPED() functionality */
+static void test_typed(void)
+{
+    int rc, i;
+    dll_count_t count;
+    test_plist_t list;
+    test_plist_node_t *node, *next;
+    test_pair_t *data;
+
+    /* The element is all the payload there is */
+    CU_ASSERT(sizeof(test_plist_node_t) == 2*sizeof(void*) + sizeof(test_pair_t));
+
+    rc = test_plist_init(&list);
+    CU_ASSERT(rc == EDLLOK);
+    rc = test_plist_append(&list, NULL);
+    CU_ASSERT(rc == EDLLINV);
+
+    rc = test_plist_sort(&list);
+    CU_ASSERT(rc == EDLLOK);
+
+    srand(4711);
+    for (i=0; i<DLL_TEST_LISTSIZE; i++) {
+        rc = test_plist_append(&list, &data);
+        CU_ASSERT(rc == EDLLOK);
+
+        if (rc == EDLLOK) {
+            data->key = rand() % 100;
+            data->seq = i;
+        }
+    }
+
+    rc = test_plist_count(&list, &count);
+    CU_ASSERT(rc == EDLLOK);
+    CU_ASSERT(count == DLL_TEST_LISTSIZE);
+    CU_ASSERT(list.last->value.seq == DLL_TEST_LISTSIZE-1);
+
+    /* Sorted by key, equal keys keep their order */
+    rc = test_plist_sort(&list);
+    CU_ASSERT(rc == EDLLOK);
+    CU_ASSERT(list.first->prev == NULL);
+    CU_ASSERT(list.last->next == NULL);
+
+    count = 0;
+    DLL_TYPED_FOREACH(&list, node) {
+        if (node->next != NULL) {
+            CU_ASSERT(node->next->prev == node);
+            CU_ASSERT((node->value.key < node->next->value.key) ||
+                      ((node->value.key == node->next->value.key) &&
+                       (node->value.seq < node->next->value.seq)));
+        }
+        count++;
+    }
+    CU_ASSERT(count == DLL_TEST_LISTSIZE);
+
+    /* Remove the first, the last and then all odd keys */
+    rc = test_plist_remove(&list, &list.first->value);
+    CU_ASSERT(rc == EDLLOK);
+    rc = test_plist_remove(&list, &list.last->value);
+    CU_ASSERT(rc == EDLLOK);
+
+    for (node = list.first; node != NULL; node = next) {
+        next = node->next;
+        if (node->value.key & 1) {
+            rc = test_plist_remove(&list, &node->value);
+            CU_ASSERT(rc == EDLLOK);
+        }
+    }
+
+    count = 0;
+    DLL_TYPED_FOREACH_REVERSE(&list, node) {
+        CU_ASSERT((node->value.key & 1) == 0);
+        count++;
+    }
+    CU_ASSERT(count == list.count);
+    CU_ASSERT(count > 0);
+
+    rc = test_plist_clear(&list);
+    CU_ASSERT(rc == EDLLOK);
+    CU_ASSERT(list.count == 0);
+    CU_ASSERT(list.first == NULL);
+    CU_ASSERT(list.last == NULL);
+}
+
+typedef struct {
+    int key;
+    int seq;
+    dll_link_t all;
+    dll_link_t even;
+} test_iobj_t;
+
+static int test_intrusive_compar(const void *item1, const void *item2)
+{
+    const test_iobj_t *a = (const test_iobj_t*)item1;
+    const test_iobj_t *b = (const test_iobj_t*)item2;
+
+    return (a->key > b->key) - (a->key < b->key);
+}
+
+/* Test dll_ilist_*() functionality */
+static void test_intrusive(void)
+{
+    int rc, i, prevkey, prevseq;
+    dll_count_t count;
+    dll_ilist_t all, even, tail;
+    dll_link_t *link, *next;
+    test_iobj_t *objs, *obj;
+
+    objs = (test_iobj_t*)malloc(DLL_TEST_LISTSIZE*sizeof(test_iobj_t));
+    CU_ASSERT(objs != NULL);
+    if (objs == NULL)
+        return;
+
+    rc = dll_ilist_init(&all);
+    CU_ASSERT(rc == EDLLOK);
+    rc = dll_ilist_init(&even);
+    CU_ASSERT(rc == EDLLOK);
+    rc = dll_ilist_init(&tail);
+    CU_ASSERT(rc == EDLLOK);
+
+    rc = dll_ilist_append(&all, NULL);
+    CU_ASSERT(rc == EDLLINV);
+    rc = dll_ilist_unlink(&all, &objs[0].all);
+    CU_ASSERT(rc == EDLLINV);
+
+    /* Every object goes on the all list, the even ones are on both. The
+     * second half of all is built separately and spliced on. */
+    srand(4711);
+    for (i=0; i<DLL_TEST_LISTSIZE; i++) {
+        objs[i].key = rand() % 100;
+        objs[i].seq = i;
+
+        rc = dll_ilist_append((i < DLL_TEST_LISTSIZE/2) ? &all : &tail, &objs[i].all);
+        CU_ASSERT(rc == EDLLOK);
+        if ((i & 1) == 0) {
+            rc = dll_ilist_insert(&even, &objs[i].even, even.first);
+            CU_ASSERT(rc == EDLLOK);
+        }
+    }
+
+    rc = dll_ilist_splice(&all, &tail);
+    CU_ASSERT(rc == EDLLOK);
+    CU_ASSERT(tail.count == 0);
+    CU_ASSERT(tail.first == NULL);
+
+    rc = dll_ilist_count(&all, &count);
+    CU_ASSERT(rc == EDLLOK);
+    CU_ASSERT(count == DLL_TEST_LISTSIZE);
+    rc = dll_ilist_count(&even, &count);
+    CU_ASSERT(rc == EDLLOK);
+    CU_ASSERT(count == DLL_TEST_LISTSIZE/2);
+
+    /* Insertion at the front reversed the even list */
+    i = 0;
+    DLL_ILIST_FOREACH_REVERSE(&even, link) {
+        CU_ASSERT(DLL_CONTAINER_OF(link, test_iobj_t, even)->seq == i);
+        i += 2;
+    }
+
+    /* Sorting one list leaves the other alone */
+    rc = dll_ilist_sort(&all, test_intrusive_compar, offsetof(test_iobj_t, all));
+    CU_ASSERT(rc == EDLLOK);
+
+    prevkey = -1;
+    prevseq = -1;
+    count = 0;
+    DLL_ILIST_FOREACH(&all, link) {
+        obj = DLL_CONTAINER_OF(link, test_iobj_t, all);
+        CU_ASSERT((obj->key > prevkey) || ((obj->key == prevkey) && (obj->seq > prevseq)));
+        if (link->next != NULL)
+            CU_ASSERT(link->next->prev == link);
+        prevkey = obj->key;
+        prevseq = obj->seq;
+        count++;
+    }
+    CU_ASSERT(count == DLL_TEST_LISTSIZE);
+    CU_ASSERT(all.first->prev == NULL);
+    CU_ASSERT(all.last->next == NULL);
+
+    i = DLL_TEST_LISTSIZE - 2;
+    DLL_ILIST_FOREACH(&even, link) {
+        CU_ASSERT(DLL_CONTAINER_OF(link, test_iobj_t, even)->seq == i);
+        i -= 2;
+    }
+
+    rc = dll_ilist_sort(&even, test_intrusive_compar, offsetof(test_iobj_t, even));
+    CU_ASSERT(rc == EDLLOK);
+    prevkey = -1;
+    DLL_ILIST_FOREACH(&even, link) {
+        obj = DLL_CONTAINER_OF(link, test_iobj_t, even);
+        CU_ASSERT(obj->key >= prevkey);
+        prevkey = obj->key;
+    }
+
+    /* Take the even objects off the all list */
+    for (link = all.first; link != NULL; link = next) {
+        next = link->next;
+        if ((DLL_CONTAINER_OF(link, test_iobj_t, all)->seq & 1) == 0) {
+            rc = dll_ilist_unlink(&all, link);
+            CU_ASSERT(rc == EDLLOK);
+        }
+    }
+
+    CU_ASSERT(all.count == DLL_TEST_LISTSIZE/2);
+    CU_ASSERT(all.first->prev == NULL);
+    CU_ASSERT(all.last->next == NULL);
+    count = 0;
+    DLL_ILIST_FOREACH_REVERSE(&all, link) {
+        CU_ASSERT(DLL_CONTAINER_OF(link, test_iobj_t, all)->seq & 1);
+        count++;
+    }
+    CU_ASSERT(count == DLL_TEST_LISTSIZE/2);
+    CU_ASSERT(even.count == DLL_TEST_LISTSIZE/2);
+
+    free(objs);
+}
+
+/* Checks the list holds 1..DLL_TEST_LISTSIZE */
+static int test_check_seq(dll_list_t *list)
+{
+    int i = 0;
+    void *data;
+    dll_iterator_t it;
+
+    dll_iterator_init(&it, list);
+    while (dll_iterator_next(&it, &data, NULL) == EDLLOK) {
+        if (*(int*)data != ++i)
+            return 0;
+    }
+
+    return (i == DLL_TEST_LISTSIZE);
+}
+
+static void test_numa(void)
+{
+    int rc, i, node;
+    dll_list_t list;
+    void *data, *first = NULL;
+
+    rc = dll_numa_where(NULL, &node);
+    CU_ASSERT(rc == EDLLINV);
+    rc = dll_numa_place(NULL, DLL_NUMA_LOCAL, 0, 0);
+    CU_ASSERT(rc == EDLLINV);
+    rc = dll_migrate(NULL, 0);
+    CU_ASSERT(rc == EDLLINV);
+
+    dll_init(&list);
+
+    rc = dll_numa_place(&list, 42, 0, 0);
+    CU_ASSERT(rc == EDLLINV);
+    rc = dll_migrate(&list, -1);
+    CU_ASSERT(rc == EDLLINV);
+    rc = dll_migrate(&list, DLL_NUMA_MAXNODES);
+    CU_ASSERT(rc == EDLLINV);
+    rc = dll_numa_thread(DLL_NUMA_BIND, -1);
+    CU_ASSERT(rc == EDLLINV);
+
+#ifdef DLL_HAVE_NUMA
+    for (i=0; i<DLL_TEST_LISTSIZE; i++) {
+        rc = dll_append(&list, &data, sizeof(int));
+        CU_ASSERT(rc == EDLLOK);
+        *(int*)data = i+1;
+        if (i == 0)
+            first = data;
+    }
+
+    /* Node 0 is there on every machine, the last one we can name isn't.
+     * Inline data goes along with the containers. */
+    rc = dll_migrate(&list, 0);
+    CU_ASSERT(rc == EDLLOK);
+    rc = dll_numa_where(list.first, &node);
+    CU_ASSERT((rc == EDLLOK) && (node == 0));
+    rc = dll_numa_where(list.first->data, &node);
+    CU_ASSERT((rc == EDLLOK) && (node == 0));
+    rc = dll_numa_where(list.last, &node);
+    CU_ASSERT((rc == EDLLOK) && (node == 0));
+    rc = dll_numa_where(list.last->data, &node);
+    CU_ASSERT((rc == EDLLOK) && (node == 0));
+    CU_ASSERT(list.first->data != first);
+    CU_ASSERT(test_check_seq(&list));
+
+    rc = dll_migrate(&list, DLL_NUMA_MAXNODES-1);
+    CU_ASSERT(rc == EDLLERROR);
+    CU_ASSERT(test_check_seq(&list));
+
+    rc = dll_numa_place(&list, DLL_NUMA_INTERLEAVE, 0, DLL_COMPACT_DATA);
+    CU_ASSERT(rc == EDLLOK);
+    CU_ASSERT(list.first->data != first);
+    rc = dll_numa_where(list.first->data, &node);
+    CU_ASSERT(rc == EDLLOK);
+    CU_ASSERT(test_check_seq(&list));
+
+    rc = dll_numa_place(&list, DLL_NUMA_LOCAL, 0, DLL_COMPACT_DATA);
+    CU_ASSERT(rc == EDLLOK);
+    CU_ASSERT(test_check_seq(&list));
+
+    /* Taking items out of a placed block and dropping it altogether */
+    rc = dll_remove(&list, DLL_TEST_LISTSIZE-1);
+    CU_ASSERT(rc == EDLLOK);
+    rc = dll_append(&list, &data, sizeof(int));
+    CU_ASSERT(rc == EDLLOK);
+    *(int*)data = DLL_TEST_LISTSIZE;
+    CU_ASSERT(test_check_seq(&list));
+
+    rc = dll_numa_thread(DLL_NUMA_BIND, 0);
+    CU_ASSERT(rc == EDLLOK);
+    rc = dll_numa_thread(DLL_NUMA_INTERLEAVE, 0);
+    CU_ASSERT(rc == EDLLOK);
+    rc = dll_numa_thread(DLL_NUMA_BIND, DLL_NUMA_MAXNODES-1);
+    CU_ASSERT(rc == EDLLERROR);
+    rc = dll_numa_thread(DLL_NUMA_LOCAL, 0);
+    CU_ASSERT(rc == EDLLOK);
+#else
+    (void)i;
+    (void)data;
+    (void)first;
+
+    rc = dll_migrate(&list, 0);
+    CU_ASSERT(rc == EDLLERROR);
+#endif
+
+    dll_clear(&list);
+}
+
+#ifdef DLL_HAVE_PTHREAD
+/* Fills a list with 1..DLL_TEST_LISTSIZE, inline, small and large payloads */
+static void *test_tcache_builder(void *arg)
+{
+    int i;
+    void *data;
+    size_t sizes[3];
+
+    sizes[0] = sizeof(int);
+    sizes[1] = DLL_TEST_OUTOFLINE;
+    sizes[2] = 256;
+
+    for (i=0; i<DLL_TEST_LISTSIZE; i++) {
+        if (dll_append((dll_list_t*)arg, &data, sizes[i%3]) == EDLLOK)
+            *(int*)data = i+1;
+    }
+
+    return NULL;
+}
+
+static void *test_tcache_clearer(void *arg)
+{
+    dll_clear((dll_list_t*)arg);
+
+    return NULL;
+}
+#endif
+
+/* Lists built, freed and rebuilt by different threads. This is mostly about
+ * the per-thread caches (DLL_THREAD_CACHE) but holds for any build. */
+static void test_tcache(void)
+{
+    int rc, i;
+    dll_list_t lists[4];
+    dll_count_t count;
+    void *data;
+
+    for (i=0; i<4; i++)
+        dll_init(&lists[i]);
+
+#ifdef DLL_HAVE_PTHREAD
+    {
+        pthread_t threads[4];
+
+        /* The builders are gone by the time their items are freed */
+        for (i=0; i<4; i++)
+            CU_ASSERT(pthread_create(&threads[i], NULL, test_tcache_builder, &lists[i]) == 0);
+        for (i=0; i<4; i++)
+            pthread_join(threads[i], NULL);
+
+        for (i=0; i<4; i++)
+            CU_ASSERT(test_check_seq(&lists[i]));
+
+        for (i=0; i<DLL_TEST_LISTSIZE/2; i++) {
+            rc = dll_remove(&lists[0], i);
+            CU_ASSERT(rc == EDLLOK);
+        }
+
+        /* Threads coming later take over what the others left behind */
+        for (i=1; i<3; i++) {
+            dll_clear(&lists[i]);
+            CU_ASSERT(pthread_create(&threads[i], NULL, test_tcache_builder, &lists[i]) == 0);
+        }
+        for (i=1; i<3; i++)
+            pthread_join(threads[i], NULL);
+
+        CU_ASSERT(test_check_seq(&lists[1]));
+        CU_ASSERT(test_check_seq(&lists[2]));
+
+        /* Everybody frees somebody else's items at the same time */
+        for (i=0; i<4; i++)
+            CU_ASSERT(pthread_create(&threads[i], NULL, test_tcache_clearer, &lists[i]) == 0);
+        for (i=0; i<4; i++)
+            pthread_join(threads[i], NULL);
+    }
+#endif
+
+    for (i=0; i<4; i++) {
+        rc = dll_count(&lists[i], &count);
+        CU_ASSERT((rc == EDLLOK) && (count == 0));
+    }
+
+    /* And the other way round, built here and freed by threads */
+    for (i=0; i<DLL_TEST_LISTSIZE; i++) {
+        rc = dll_append(&lists[0], &data, (i%2) ? sizeof(int) : DLL_TEST_OUTOFLINE);
+        CU_ASSERT(rc == EDLLOK);
+        *(int*)data = i+1;
+    }
+    CU_ASSERT(test_check_seq(&lists[0]));
+
+#ifdef DLL_HAVE_PTHREAD
+    {
+        pthread_t thread;
+
+        CU_ASSERT(pthread_create(&thread, NULL, test_tcache_clearer, &lists[0]) == 0);
+        pthread_join(thread, NULL);
+    }
+#endif
+
+    dll_clear(&lists[0]);
+}
+
+/* Appends a pair, keys have to be appended in order */
+static void test_merge_add(dll_list_t *list, int key, int seq)
+{
+    void *data;
+
+    if (dll_append(list, &data, sizeof(test_pair_t)) == EDLLOK) {
+        ((test_pair_t*)data)->key = key;
+        ((test_pair_t*)data)->seq = seq;
+    }
+}
+
+/* Sorted by key and seq, properly linked both ways and of the right length */
+static int test_merge_check(dll_list_t *list, dll_count_t expected)
+{
+    dll_count_t n = 0;
+    dll_item_t *item, *prev = NULL;
+    test_pair_t *p, *q;
+
+    for (item = list->first; item != NULL; item = item->next) {
+        if (item->prev != prev)
+            return 0;
+
+        if (prev != NULL) {
+            p = (test_pair_t*)prev->data;
+            q = (test_pair_t*)item->data;
+            if ((p->key > q->key) || ((p->key == q->key) && (p->seq >= q->seq)))
+                return 0;
+        }
+
+        prev = item;
+        n++;
+    }
+
+    return (prev == list->last) && (n == expected) && (list->count == expected);
+}
+
+static void test_merge(void)
+{
+    int rc, i, j, k, key;
+    dll_list_t list, lext, snap, many[70], *ptrs[70];
+    dll_count_t total;
+
+    dll_init(&list);
+    dll_init(&lext);
+
+    rc = dll_merge(NULL, &lext, test_compar_key);
+    CU_ASSERT(rc == EDLLINV);
+    rc = dll_merge(&list, NULL, test_compar_key);
+    CU_ASSERT(rc == EDLLINV);
+    rc = dll_merge(&list, &list, test_compar_key);
+    CU_ASSERT(rc == EDLLINV);
+    rc = dll_merge(&list, &lext, NULL);
+    CU_ASSERT(rc == EDLLINV);
+
+    rc = dll_merge(&list, &lext, test_compar_key);
+    CU_ASSERT(rc == EDLLOK);
+    CU_ASSERT(test_merge_check(&list, 0));
+
+    /* Interleaved with duplicates on both sides, seq is the expected order:
+     * equal keys of list come first */
+    for (i=0; i<DLL_TEST_LISTSIZE; i++) {
+        test_merge_add(&list, i/2, (i/2)*10 + i%2);
+        test_merge_add(&lext, i/3, (i/3)*10 + 5 + i%3);
+    }
+    rc = dll_merge(&list, &lext, test_compar_key);
+    CU_ASSERT(rc == EDLLOK);
+    CU_ASSERT(test_merge_check(&list, 2*DLL_TEST_LISTSIZE));
+    CU_ASSERT(test_merge_check(&lext, 0));
+    CU_ASSERT((lext.first == NULL) && (lext.last == NULL));
+    dll_clear(&list);
+
+    /* Into an empty list, one after the other, one before the other */
+    test_merge_add(&lext, 5, 0);
+    test_merge_add(&lext, 6, 1);
+    rc = dll_merge(&list, &lext, test_compar_key);
+    CU_ASSERT(rc == EDLLOK);
+    CU_ASSERT(test_merge_check(&list, 2));
+    test_merge_add(&lext, 6, 2);
+    test_merge_add(&lext, 9, 3);
+    rc = dll_merge(&list, &lext, test_compar_key);
+    CU_ASSERT(rc == EDLLOK);
+    CU_ASSERT(test_merge_check(&list, 4));
+    test_merge_add(&lext, 1, -2);
+    test_merge_add(&lext, 4, -1);
+    rc = dll_merge(&list, &lext, test_compar_key);
+    CU_ASSERT(rc == EDLLOK);
+    CU_ASSERT(test_merge_check(&list, 6));
+
+    /* Snapshots keep what they had */
+    dll_init(&snap);
+    rc = dll_snapshot(&list, &snap);
+    CU_ASSERT(rc == EDLLOK);
+    test_merge_add(&lext, 2, 0);
+    rc = dll_merge(&list, &lext, test_compar_key);
+    CU_ASSERT(rc == EDLLOK);
+    CU_ASSERT(test_merge_check(&list, 7));
+    CU_ASSERT(test_merge_check(&snap, 6));
+    CU_ASSERT(((test_pair_t*)snap.first->next->data)->key == 4);
+    dll_clear(&snap);
+    dll_clear(&list);
+
+    for (j=0; j<70; j++) {
+        dll_init(&many[j]);
+        ptrs[j] = &many[j];
+    }
+
+    rc = dll_merge_k(NULL, ptrs, 70, test_compar_key);
+    CU_ASSERT(rc == EDLLINV);
+    rc = dll_merge_k(&list, NULL, 2, test_compar_key);
+    CU_ASSERT(rc == EDLLINV);
+    rc = dll_merge_k(&list, ptrs, 70, NULL);
+    CU_ASSERT(rc == EDLLINV);
+    ptrs[3] = &list;
+    rc = dll_merge_k(&list, ptrs, 70, test_compar_key);
+    CU_ASSERT(rc == EDLLINV);
+    ptrs[3] = &many[3];
+    rc = dll_merge_k(&list, ptrs, 0, test_compar_key);
+    CU_ASSERT(rc == EDLLOK);
+
+    /* More lists than the heap on the stack takes, a few, just one. Some
+     * are empty. Keys repeat within and across the lists, seq gives the
+     * expected order: list first, then the others in turn. */
+    for (k=70; k>0; k=(k == 70) ? 5 : k-4) {
+        total = 0;
+
+        for (i=0, key=0; i<100; i++) {
+            key += i % 3;
+            test_merge_add(&list, key, i);
+        }
+        total += list.count;
+
+        for (j=0; j<k; j++) {
+            if (j % 7 == 3)
+                continue;
+
+            for (i=0, key=0; i<(j*37)%97; i++) {
+                key += (i + j) % 4;
+                test_merge_add(&many[j], key, (j+1)*1000 + i);
+            }
+            total += many[j].count;
+        }
+
+        rc = dll_merge_k(&list, ptrs, k, test_compar_key);
+        CU_ASSERT(rc == EDLLOK);
+        CU_ASSERT(test_merge_check(&list, total));
+
+        for (j=0; j<k; j++)
+            CU_ASSERT(test_merge_check(&many[j], 0));
+
+        dll_clear(&list);
+    }
+}
+
+static unsigned long test_sorted_calls;
+
+static int test_compar_counted(const void *a, const void *b)
+{
+    test_sorted_calls++;
+    return TEST_PAIR_CMP((const test_pair_t*)a, (const test_pair_t*)b);
+}
+
+/* Counts a range, which has to be in order */
+static int test_range_count(dll_sorted_t *sorted, int lo, int hi, int uselo, int usehi)
+{
+    int n = 0, last = -1;
+    void *data;
+    dll_range_t range;
+    test_pair_t plo, phi;
+
+    plo.key = lo;
+    phi.key = hi;
+
+    if (dll_range(&range, sorted, uselo ? &plo : NULL, usehi ? &phi : NULL) != EDLLOK)
+        return -1;
+
+    while (dll_range_next(&range, &data, NULL) == EDLLOK) {
+        if ((((test_pair_t*)data)->key < last) ||
+                (uselo && (((test_pair_t*)data)->key < lo)) ||
+                (usehi && (((test_pair_t*)data)->key >= hi)))
+            return -1;
+        last = ((test_pair_t*)data)->key;
+        n++;
+    }
+
+    return n;
+}
+
+static void test_sorted(void)
+{
+    int rc, i;
+    dll_sorted_t sorted;
+    dll_list_t snap;
+    dll_range_t range;
+    dll_item_t *item;
+    test_pair_t pair;
+    void *data;
+    size_t datasize;
+
+    rc = dll_sorted_init(NULL, test_compar_counted);
+    CU_ASSERT(rc == EDLLINV);
+    rc = dll_sorted_init(&sorted, NULL);
+    CU_ASSERT(rc == EDLLINV);
+    rc = dll_sorted_init(&sorted, test_compar_counted);
+    CU_ASSERT(rc == EDLLOK);
+
+    /* Nothing to be found in an empty list */
+    pair.key = 0;
+    rc = dll_lower_bound(&sorted, &pair, &item);
+    CU_ASSERT(rc == EDLLERROR);
+    rc = dll_find_sorted(&sorted, &pair, &item);
+    CU_ASSERT(rc == EDLLERROR);
+    rc = dll_range(&range, &sorted, NULL, NULL);
+    CU_ASSERT(rc == EDLLOK);
+    rc = dll_range_next(&range, &data, NULL);
+    CU_ASSERT(rc == EDLLERROR);
+    rc = dll_insert_sorted(&sorted, NULL, sizeof(test_pair_t), NULL);
+    CU_ASSERT(rc == EDLLINV);
+
+    /* Even keys only, each twice, in scrambled order */
+    for (i=0; i<DLL_TEST_LISTSIZE; i++) {
+        pair.key = 2*((i*3643) % (DLL_TEST_LISTSIZE/2));
+        pair.seq = i;
+        rc = dll_insert_sorted(&sorted, &data, sizeof(test_pair_t), &pair);
+        CU_ASSERT(rc == EDLLOK);
+        CU_ASSERT(memcmp(data, &pair, sizeof(test_pair_t)) == 0);
+    }
+
+    /* The list itself is plain, sorted and stable */
+    CU_ASSERT(test_merge_check(&sorted.list, DLL_TEST_LISTSIZE));
+
+    /* Every lookup finds the first of the equal items, or the next key */
+    test_sorted_calls = 0;
+    for (i=0; i<DLL_TEST_LISTSIZE; i++) {
+        pair.key = i;
+        rc = dll_find_sorted(&sorted, &pair, &item);
+        CU_ASSERT(rc == ((i % 2 == 0) ? EDLLOK : EDLLERROR));
+        if (rc == EDLLOK) {
+            CU_ASSERT(((test_pair_t*)item->data)->key == i);
+            CU_ASSERT(item->prev == NULL || ((test_pair_t*)item->prev->data)->key < i);
+        }
+
+        rc = dll_lower_bound(&sorted, &pair, &item);
+        CU_ASSERT(rc == ((i < DLL_TEST_LISTSIZE-1) ? EDLLOK : EDLLERROR));
+        if (rc == EDLLOK)
+            CU_ASSERT(((test_pair_t*)item->data)->key == i + (i % 2));
+    }
+
+    /* That wasn't a walk through the list */
+    CU_ASSERT(test_sorted_calls < 2UL*DLL_TEST_LISTSIZE*64);
+
+    CU_ASSERT(test_range_count(&sorted, 1000, 2000, 1, 1) == 1000);
+    CU_ASSERT(test_range_count(&sorted, 999, 1001, 1, 1) == 2);
+    CU_ASSERT(test_range_count(&sorted, 1001, 1001, 1, 1) == 0);
+    CU_ASSERT(test_range_count(&sorted, 0, 10, 0, 1) == 10);
+    CU_ASSERT(test_range_count(&sorted, DLL_TEST_LISTSIZE-4, 0, 1, 0) == 4);
+    CU_ASSERT(test_range_count(&sorted, DLL_TEST_LISTSIZE, 0, 1, 0) == 0);
+    CU_ASSERT(test_range_count(&sorted, 0, 0, 0, 0) == DLL_TEST_LISTSIZE);
+
+    /* Remove every multiple of four, both of each, and the first of each of
+     * the others */
+    for (i=0; i<DLL_TEST_LISTSIZE; i+=2) {
+        pair.key = i;
+        while (dll_find_sorted(&sorted, &pair, &item) == EDLLOK) {
+            rc = dll_remove_sorted(&sorted, item);
+            CU_ASSERT(rc == EDLLOK);
+            if (i % 4 != 0)
+                break;
+        }
+    }
+
+    CU_ASSERT(sorted.list.count == DLL_TEST_LISTSIZE/4);
+    for (i=0; i<DLL_TEST_LISTSIZE; i+=2) {
+        pair.key = i;
+        rc = dll_find_sorted(&sorted, &pair, &item);
+        CU_ASSERT(rc == ((i % 4 == 0) ? EDLLERROR : EDLLOK));
+    }
+    CU_ASSERT(test_merge_check(&sorted.list, DLL_TEST_LISTSIZE/4));
+
+    /* Changing it after a snapshot leaves the snapshot alone */
+    dll_init(&snap);
+    rc = dll_snapshot(&sorted.list, &snap);
+    CU_ASSERT(rc == EDLLOK);
+
+    pair.key = 4;
+    pair.seq = -1;
+    rc = dll_insert_sorted(&sorted, NULL, sizeof(test_pair_t), &pair);
+    CU_ASSERT(rc == EDLLOK);
+    CU_ASSERT(test_merge_check(&sorted.list, DLL_TEST_LISTSIZE/4 + 1));
+    CU_ASSERT(test_merge_check(&snap, DLL_TEST_LISTSIZE/4));
+
+    rc = dll_find_sorted(&sorted, &pair, &item);
+    CU_ASSERT(rc == EDLLOK);
+    CU_ASSERT(((test_pair_t*)item->data)->seq == -1);
+
+    dll_clear(&snap);
+    rc = dll_snapshot(&sorted.list, &snap);
+    CU_ASSERT(rc == EDLLOK);
+
+    pair.key = 6;
+    rc = dll_find_sorted(&sorted, &pair, &item);
+    CU_ASSERT(rc == EDLLOK);
+    rc = dll_remove_sorted(&sorted, item);
+    CU_ASSERT(rc == EDLLOK);
+    rc = dll_find_sorted(&sorted, &pair, &item);
+    CU_ASSERT(rc == EDLLERROR);
+    rc = dll_get(&snap, &data, &datasize, 2);
+    CU_ASSERT(rc == EDLLOK);
+    CU_ASSERT(((test_pair_t*)data)->key == 6);
+    CU_ASSERT(test_merge_check(&sorted.list, DLL_TEST_LISTSIZE/4));
+    dll_clear(&snap);
+
+    rc = dll_sorted_clear(&sorted);
+    CU_ASSERT(rc == EDLLOK);
+    CU_ASSERT(sorted.list.count == 0);
+    CU_ASSERT(sorted.levels == 0);
+
+    /* And it can be used again */
+    pair.key = 1;
+    rc = dll_insert_sorted(&sorted, NULL, sizeof(test_pair_t), &pair);
+    CU_ASSERT(rc == EDLLOK);
+    rc = dll_find_sorted(&sorted, &pair, &item);
+    CU_ASSERT(rc == EDLLOK);
+    dll_sorted_clear(&sorted);
+}
+
+static void test_strerror(void)
+{
+    int rc;
+    
+    rc = strcmp(dll_strerror(EDLLERROR), DLL_TEST_GENERROR);
+    CU_ASSERT(rc != 0);
+
+    rc = strcmp(dll_strerror(EDLLOK), DLL_TEST_GENERROR);
+    CU_ASSERT(rc != 0);
+
+    rc = strcmp(dll_strerror(EDLLTILT), DLL_TEST_GENERROR);
+    CU_ASSERT(rc != 0);
+
+    rc = strcmp(dll_strerror(EDLLNOMEM), DLL_TEST_GENERROR);
+    CU_ASSERT(rc != 0);
+
+    rc = strcmp(dll_strerror(EDLLINV), DLL_TEST_GENERROR);
+    CU_ASSERT(rc != 0);
+
+    rc = strcmp(dll_strerror(EDLLIO), DLL_TEST_GENERROR);
+    CU_ASSERT(rc != 0);
+
+    rc = strcmp(dll_strerror(-1), DLL_TEST_GENERROR);
+    CU_ASSERT(rc == 0);
+}
+
+int main(int argc, char *argv[]) 
+{
+    int ret = 0;
+    CU_ErrorCode cu_rc;
+    CU_pSuite cu_suite01;
+    CU_pTest cu_test;
+
+    /* Initialize test registry */
+    cu_rc = CU_initialize_registry();
+    if (cu_rc != CUE_SUCCESS) {
+        ret = 1;
+        goto finish;
+    }
+
+    /* Add a suite to the registry */
+    cu_suite01 = CU_add_suite("dlltest", NULL, NULL);
+    if (cu_suite01 == NULL) {
+        ret = 2;
+        goto finish;
+    }
+
+    /* Add tests to suite */
+    cu_test = CU_ADD_TEST(cu_suite01, test_append);
+    if (cu_test == NULL) {
+        ret = 3;
+        goto finish;
+    }
+    cu_test = CU_ADD_TEST(cu_suite01, test_insert);
+    if (cu_test == NULL) {
+        ret = 3;
+        goto finish;
+    }
+    cu_test = CU_ADD_TEST(cu_suite01, test_extend);
+    if (cu_test == NULL) {
+        ret = 3;
+        goto finish;
+    }
+    cu_test = CU_ADD_TEST(cu_suite01, test_splice);
+    if (cu_test == NULL) {
         ret = 3;
         goto finish;
     }
@@ -520,6 +3174,16 @@ int main(int argc, char *argv[])
         ret = 3;
         goto finish;
     }
+    cu_test = CU_ADD_TEST(cu_suite01, test_inline);
+    if (cu_test == NULL) {
+        ret = 3;
+        goto finish;
+    }
+    cu_test = CU_ADD_TEST(cu_suite01, test_remove_item);
+    if (cu_test == NULL) {
+        ret = 3;
+        goto finish;
+    }
     cu_test = CU_ADD_TEST(cu_suite01, test_indexof);
     if (cu_test == NULL) {
         ret = 3;
@@ -540,6 +3204,106 @@ int main(int argc, char *argv[])
         ret = 3;
         goto finish;
     }
+    cu_test = CU_ADD_TEST(cu_suite01, test_iterator_batch);
+    if (cu_test == NULL) {
+        ret = 3;
+        goto finish;
+    }
+    cu_test = CU_ADD_TEST(cu_suite01, test_reduce);
+    if (cu_test == NULL) {
+        ret = 3;
+        goto finish;
+    }
+    cu_test = CU_ADD_TEST(cu_suite01, test_sharded);
+    if (cu_test == NULL) {
+        ret = 3;
+        goto finish;
+    }
+    cu_test = CU_ADD_TEST(cu_suite01, test_compact);
+    if (cu_test == NULL) {
+        ret = 3;
+        goto finish;
+    }
+    cu_test = CU_ADD_TEST(cu_suite01, test_saveload);
+    if (cu_test == NULL) {
+        ret = 3;
+        goto finish;
+    }
+    cu_test = CU_ADD_TEST(cu_suite01, test_stream);
+    if (cu_test == NULL) {
+        ret = 3;
+        goto finish;
+    }
+    cu_test = CU_ADD_TEST(cu_suite01, test_snapshot);
+    if (cu_test == NULL) {
+        ret = 3;
+        goto finish;
+    }
+    cu_test = CU_ADD_TEST(cu_suite01, test_extsort);
+    if (cu_test == NULL) {
+        ret = 3;
+        goto finish;
+    }
+    cu_test = CU_ADD_TEST(cu_suite01, test_mapped);
+    if (cu_test == NULL) {
+        ret = 3;
+        goto finish;
+    }
+    cu_test = CU_ADD_TEST(cu_suite01, test_mapped_shared);
+    if (cu_test == NULL) {
+        ret = 3;
+        goto finish;
+    }
+    cu_test = CU_ADD_TEST(cu_suite01, test_stats);
+    if (cu_test == NULL) {
+        ret = 3;
+        goto finish;
+    }
+    cu_test = CU_ADD_TEST(cu_suite01, test_perf);
+    if (cu_test == NULL) {
+        ret = 3;
+        goto finish;
+    }
+    cu_test = CU_ADD_TEST(cu_suite01, test_hooks);
+    if (cu_test == NULL) {
+        ret = 3;
+        goto finish;
+    }
+    cu_test = CU_ADD_TEST(cu_suite01, test_trace);
+    if (cu_test == NULL) {
+        ret = 3;
+        goto finish;
+    }
+    cu_test = CU_ADD_TEST(cu_suite01, test_typed);
+    if (cu_test == NULL) {
+        ret = 3;
+        goto finish;
+    }
+    cu_test = CU_ADD_TEST(cu_suite01, test_intrusive);
+    if (cu_test == NULL) {
+        ret = 3;
+        goto finish;
+    }
+    cu_test = CU_ADD_TEST(cu_suite01, test_numa);
+    if (cu_test == NULL) {
+        ret = 3;
+        goto finish;
+    }
+    cu_test = CU_ADD_TEST(cu_suite01, test_tcache);
+    if (cu_test == NULL) {
+        ret = 3;
+        goto finish;
+    }
+    cu_test = CU_ADD_TEST(cu_suite01, test_merge);
+    if (cu_test == NULL) {
+        ret = 3;
+        goto finish;
+    }
+    cu_test = CU_ADD_TEST(cu_suite01, test_sorted);
+    if (cu_test == NULL) {
+        ret = 3;
+        goto finish;
+    }
     cu_test = CU_ADD_TEST(cu_suite01, test_strerror);
     if (cu_test == NULL) {
         ret = 3;
@@ -0,0 +1,180 @@
+/*
+* Copyright (c) 2008, Björn Rehm (bjoern@shugaa.de)
+* 
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+* 
+* The above copyright notice and this permission notice shall be included in
+* all copies or substantial portions of the Software.
+* 
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+* THE SOFTWARE.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <dll_list.h>
+#include <dll_inline.h>
+#include <dll_compact.h>
+
+/* Compares list traversal through dll_iterator_next() (as in sorttest.c), the
+ * batched iterator and the inline DLL_FOREACH fast path, on a list in
+ * allocation order, a scattered one and the scattered one after dll_compact().
+ * The caches are flushed before every run. */
+
+#define ITERBENCH_DEFAULT_SIZE  (10000000)
+#define ITERBENCH_FLUSH_SIZE    (64*1024*1024)
+#define ITERBENCH_BATCH         (64)
+#define ITERBENCH_RUNS          (5)
+#define ITERBENCH_SCATTER       (4096)
+
+static char *flushbuf;
+static dll_list_t scatter[ITERBENCH_SCATTER];
+
+static double now(void)
+{
+        struct timespec ts;
+
+        clock_gettime(CLOCK_MONOTONIC, &ts);
+        return (double)ts.tv_sec*1e9 + (double)ts.tv_nsec;
+}
+
+static void flush_caches(void)
+{
+        size_t i;
+
+        for (i=0; i<ITERBENCH_FLUSH_SIZE; i+=64)
+                flushbuf[i]++;
+}
+
+static long run_iterator(dll_list_t *list)
+{
+        dll_iterator_t it;
+        int *data = NULL;
+        long sum = 0;
+
+        dll_iterator_init(&it, list);
+        while(dll_iterator_next(&it, (void**)&data, NULL) == EDLLOK)
+                sum += *data;
+
+        return sum;
+}
+
+static long run_batch(dll_list_t *list)
+{
+        dll_iterator_t it;
+        void *batch[ITERBENCH_BATCH];
+        size_t i, got;
+        long sum = 0;
+
+        dll_iterator_init(&it, list);
+        while(dll_iterator_next_batch(&it, batch, NULL, ITERBENCH_BATCH, &got) == EDLLOK)
+                for (i=0; i<got; i++)
+                        sum += *((int*)batch[i]);
+
+        return sum;
+}
+
+static long run_foreach(dll_list_t *list)
+{
+        dll_cursor_t c;
+        int *data;
+        long sum = 0;
+
+        DLL_FOREACH(list, c, data)
+                sum += *data;
+
+        return sum;
+}
+
+static void bench(const char *name, long (*fct)(dll_list_t*), dll_list_t *list, unsigned int count)
+{
+        int i;
+        long sum = 0;
+        double t, best = 0.0;
+
+        for (i=0; i<ITERBENCH_RUNS; i++) {
+                flush_caches();
+
+                t = now();
+                sum += fct(list);
+                t = now() - t;
+
+                if ((i == 0) || (t < best))
+                        best = t;
+        }
+
+        printf("%-16s %8.2f ns/item (checksum %ld)\n", name, best/count, sum);
+}
+
+int main(int argc, char *argv[])
+{
+        dll_list_t list;
+        unsigned int i, count = ITERBENCH_DEFAULT_SIZE;
+        int *data = NULL;
+
+        if (argc > 1)
+                count = (unsigned int)strtoul(argv[1], NULL, 10);
+
+        flushbuf = (char*)calloc(ITERBENCH_FLUSH_SIZE, 1);
+        if (flushbuf == NULL)
+                return 1;
+
+        dll_init(&list);
+        for(i=0;i<count;i++) {
+                if (dll_append(&list, (void**)&data, sizeof(int)) != EDLLOK)
+                        return 1;
+                *data = (int)(((double)random()/(double)RAND_MAX)*1000.0);
+        }
+
+        printf("%u items, allocation order\n", count);
+        bench("iterator_next", run_iterator, &list, count);
+        bench("iterator_batch", run_batch, &list, count);
+        bench("DLL_FOREACH", run_foreach, &list, count);
+
+        dll_clear(&list);
+
+        /* Appending to randomly chosen lists and joining them afterwards
+         * leaves the list order scattered across the heap, which is what
+         * long-lived lists end up looking like */
+        for (i=0; i<ITERBENCH_SCATTER; i++)
+                dll_init(&scatter[i]);
+
+        for(i=0;i<count;i++) {
+                if (dll_append(&scatter[random() % ITERBENCH_SCATTER], (void**)&data, sizeof(int)) != EDLLOK)
+                        return 1;
+                *data = (int)(((double)random()/(double)RAND_MAX)*1000.0);
+        }
+
+        for (i=0; i<ITERBENCH_SCATTER; i++)
+                dll_splice(&list, &scatter[i]);
+
+        printf("%u items, scattered\n", count);
+        bench("iterator_next", run_iterator, &list, count);
+        bench("iterator_batch", run_batch, &list, count);
+        bench("DLL_FOREACH", run_foreach, &list, count);
+
+        /* Same list, relocated into list order */
+        dll_compact(&list, DLL_COMPACT_DATA);
+
+        printf("%u items, scattered then compacted\n", count);
+        bench("iterator_next", run_iterator, &list, count);
+        bench("iterator_batch", run_batch, &list, count);
+        bench("DLL_FOREACH", run_foreach, &list, count);
+
+        dll_clear(&list);
+        free(flushbuf);
+
+        return 0;
+}
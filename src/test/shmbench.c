@@ -0,0 +1,252 @@
+/*
+* Copyright (c) 2008, Björn Rehm (bjoern@shugaa.de)
+* 
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+* 
+* The above copyright notice and this permission notice shall be included in
+* all copies or substantial portions of the Software.
+* 
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+* THE SOFTWARE.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sched.h>
+#include <sys/wait.h>
+#include <dll_list.h>
+#include <dll_mapped.h>
+
+/* Hands messages from a producer process to several consumer processes,
+ * once serialized through one pipe per consumer and once through a list in
+ * shared memory which the consumers read in place. Every consumer gets
+ * every message. */
+
+#define SHMBENCH_DEFAULT_COUNT  (1000000)
+#define SHMBENCH_CONSUMERS      (2)
+#define SHMBENCH_MSGSIZE        (64)
+#define SHMBENCH_PUBLISH        (64)
+#define SHMBENCH_NAME           "/dllshmbench"
+
+static double now(void)
+{
+        struct timespec ts;
+
+        clock_gettime(CLOCK_MONOTONIC, &ts);
+        return (double)ts.tv_sec + (double)ts.tv_nsec/1e9;
+}
+
+/* Sums up the first int of each message so the work can't be skipped */
+static void consume_pipe(int fd)
+{
+        FILE *in;
+        dll_list_t list;
+        unsigned int size;
+        void *data = NULL;
+        long sum = 0;
+
+        in = fdopen(fd, "r");
+        dll_init(&list);
+
+        while (fread(&size, sizeof(size), 1, in) == 1) {
+                if (dll_append(&list, &data, size) != EDLLOK)
+                        exit(1);
+                if (fread(data, size, 1, in) != 1)
+                        exit(1);
+                sum += *((int*)data);
+        }
+
+        fclose(in);
+        dll_clear(&list);
+
+        exit(sum > 0 ? 0 : 1);
+}
+
+static void consume_shared(void)
+{
+        dll_mapped_t mapped;
+        dll_mapped_iterator_t it;
+        size_t size;
+        void *data = NULL;
+        long sum = 0;
+
+        if (dll_mapped_open_shared(&mapped, SHMBENCH_NAME, 0) != EDLLOK)
+                exit(1);
+
+        /* An empty message marks the end */
+        dll_mapped_iterator_init(&it, &mapped);
+        for (;;) {
+                if (dll_mapped_iterator_poll(&it, &data, &size) != EDLLOK) {
+                        sched_yield();
+                        continue;
+                }
+                if (size == 0)
+                        break;
+                sum += *((int*)data);
+        }
+
+        dll_mapped_close(&mapped);
+
+        exit(sum > 0 ? 0 : 1);
+}
+
+static int wait_consumers(unsigned int consumers)
+{
+        unsigned int i;
+        int status, ret = 0;
+
+        for (i=0; i<consumers; i++) {
+                if ((wait(&status) < 0) || !WIFEXITED(status) || (WEXITSTATUS(status) != 0))
+                        ret = 1;
+        }
+
+        return ret;
+}
+
+static int bench_pipe(unsigned int count, unsigned int consumers)
+{
+        unsigned int i, j, size = SHMBENCH_MSGSIZE;
+        int fds[2];
+        FILE **out;
+        dll_list_t list;
+        dll_iterator_t it;
+        void *data = NULL;
+        double t;
+
+        /* The messages exist in a list already, like they would in the
+         * producer */
+        dll_init(&list);
+        for (i=0; i<count; i++) {
+                if (dll_append(&list, &data, SHMBENCH_MSGSIZE) != EDLLOK)
+                        return 1;
+                memset(data, 0, SHMBENCH_MSGSIZE);
+                *((int*)data) = (int)i+1;
+        }
+
+        out = (FILE**)malloc(consumers*sizeof(FILE*));
+        if (out == NULL)
+                return 1;
+
+        /* Children would write out whatever is still buffered */
+        fflush(stdout);
+        t = now();
+
+        for (j=0; j<consumers; j++) {
+                if (pipe(fds) != 0)
+                        return 1;
+
+                if (fork() == 0) {
+                        close(fds[1]);
+                        for (i=0; i<j; i++)
+                                fclose(out[i]);
+                        consume_pipe(fds[0]);
+                }
+
+                close(fds[0]);
+                out[j] = fdopen(fds[1], "w");
+        }
+
+        dll_iterator_init(&it, &list);
+        while (dll_iterator_next(&it, &data, NULL) == EDLLOK) {
+                for (j=0; j<consumers; j++) {
+                        fwrite(&size, sizeof(size), 1, out[j]);
+                        fwrite(data, SHMBENCH_MSGSIZE, 1, out[j]);
+                }
+        }
+
+        for (j=0; j<consumers; j++)
+                fclose(out[j]);
+
+        if (wait_consumers(consumers) != 0)
+                return 1;
+
+        t = now() - t;
+        printf("%-8s %12.0f messages/s\n", "pipe", count/t);
+
+        free(out);
+        dll_clear(&list);
+
+        return 0;
+}
+
+static int bench_shared(unsigned int count, unsigned int consumers)
+{
+        unsigned int i, j;
+        dll_mapped_t mapped;
+        void *data = NULL;
+        double t;
+
+        dll_mapped_unlink(SHMBENCH_NAME);
+        if (dll_mapped_open_shared(&mapped, SHMBENCH_NAME,
+                                (size_t)(count+1)*128 + 64*1024) != EDLLOK)
+                return 1;
+
+        fflush(stdout);
+        t = now();
+
+        for (j=0; j<consumers; j++) {
+                if (fork() == 0)
+                        consume_shared();
+        }
+
+        /* Messages are built right in the shared list */
+        for (i=0; i<count; i++) {
+                if (dll_mapped_append(&mapped, &data, SHMBENCH_MSGSIZE) != EDLLOK)
+                        return 1;
+                memset(data, 0, SHMBENCH_MSGSIZE);
+                *((int*)data) = (int)i+1;
+
+                if ((i % SHMBENCH_PUBLISH) == SHMBENCH_PUBLISH-1)
+                        dll_mapped_publish(&mapped);
+        }
+
+        if (dll_mapped_append(&mapped, &data, 0) != EDLLOK)
+                return 1;
+        dll_mapped_publish(&mapped);
+
+        if (wait_consumers(consumers) != 0)
+                return 1;
+
+        t = now() - t;
+        printf("%-8s %12.0f messages/s\n", "shared", count/t);
+
+        dll_mapped_close(&mapped);
+        dll_mapped_unlink(SHMBENCH_NAME);
+
+        return 0;
+}
+
+int main(int argc, char *argv[])
+{
+        unsigned int count = SHMBENCH_DEFAULT_COUNT;
+        unsigned int consumers = SHMBENCH_CONSUMERS;
+
+        if (argc > 1)
+                count = (unsigned int)strtoul(argv[1], NULL, 10);
+        if (argc > 2)
+                consumers = (unsigned int)strtoul(argv[2], NULL, 10);
+        if ((count == 0) || (consumers == 0))
+                return 1;
+
+        printf("%u messages of %d bytes, %u consumers\n", count, SHMBENCH_MSGSIZE, consumers);
+
+        if (bench_pipe(count, consumers) != 0)
+                return 1;
+        if (bench_shared(count, consumers) != 0)
+                return 1;
+
+        return 0;
+}